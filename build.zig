@@ -38,12 +38,15 @@ pub fn build(b: *std.Build) void {
             "source/mididevices/music_timidity_mididevice.cpp",
             "source/mididevices/music_wildmidi_mididevice.cpp",
             "source/mididevices/music_wavewriter_mididevice.cpp",
+            "source/mididevices/music_devicepool.cpp",
             "source/midisources/midisource.cpp",
             "source/midisources/midisource_mus.cpp",
             "source/midisources/midisource_smf.cpp",
             "source/midisources/midisource_hmi.cpp",
             "source/midisources/midisource_xmi.cpp",
             "source/midisources/midisource_mids.cpp",
+            "source/midisources/midisource_seek.cpp",
+            "source/midisources/midisource_timeline.cpp",
             "source/streamsources/music_dumb.cpp",
             "source/streamsources/music_gme.cpp",
             "source/streamsources/music_libsndfile.cpp",
@@ -58,6 +61,20 @@ pub fn build(b: *std.Build) void {
             "source/zmsx/configuration.cpp",
             "source/zmsx/zmsx.cpp",
             "source/zmsx/critsec.cpp",
+            "source/zmsx/renderahead.cpp",
+            "source/zmsx/songqueue.cpp",
+            "source/zmsx/mixer.cpp",
+            "source/zmsx/threadpool.cpp",
+            "source/zmsx/renderbatch.cpp",
+            "source/zmsx/wavefile.cpp",
+            "source/zmsx/musinfo.cpp",
+            "source/zmsx/mappedfile.cpp",
+            "source/zmsx/gzipreader.cpp",
+            "source/zmsx/formatid.cpp",
+            "source/zmsx/sampleconv.cpp",
+            "source/zmsx/resampler.cpp",
+            "source/zmsx/perfcounters.cpp",
+            "source/zmsx/trace.cpp",
         },
     });
     lib.addCSourceFile(.{
@@ -122,6 +139,66 @@ pub fn build(b: *std.Build) void {
     });
 
     b.installArtifact(lib);
+
+    const render = b.addExecutable(.{
+        .name = "zmsx-render",
+        .root_module = b.createModule(.{ .optimize = optimize, .target = target }),
+    });
+    render.linkLibC();
+    render.linkLibCpp();
+    render.addCSourceFile(.{
+        .file = b.path("tools/zmsx-render.cpp"),
+        .flags = cxx_flags[0..],
+    });
+    render.addIncludePath(b.path("include"));
+    render.linkLibrary(lib);
+    b.installArtifact(render);
+
+    const scan = b.addExecutable(.{
+        .name = "zmsx-scan",
+        .root_module = b.createModule(.{ .optimize = optimize, .target = target }),
+    });
+    scan.linkLibC();
+    scan.linkLibCpp();
+    scan.addCSourceFile(.{
+        .file = b.path("tools/zmsx-scan.cpp"),
+        .flags = cxx_flags[0..],
+    });
+    scan.addIncludePath(b.path("include"));
+    scan.linkLibrary(lib);
+    b.installArtifact(scan);
+
+    const bench = b.addExecutable(.{
+        .name = "zmsx-bench",
+        .root_module = b.createModule(.{ .optimize = optimize, .target = target }),
+    });
+    bench.linkLibC();
+    bench.linkLibCpp();
+    bench.addCSourceFile(.{
+        .file = b.path("tools/zmsx-bench.cpp"),
+        .flags = cxx_flags[0..],
+    });
+    bench.addIncludePath(b.path("include"));
+    bench.linkLibrary(lib);
+    b.installArtifact(bench);
+
+    // Replaces malloc and the pthread locks, which only works against glibc.
+    if (target.result.os.tag == .linux and target.result.abi.isGnu()) {
+        const rtcheck = b.addExecutable(.{
+            .name = "zmsx-rtcheck",
+            .root_module = b.createModule(.{ .optimize = optimize, .target = target }),
+        });
+        rtcheck.linkLibC();
+        rtcheck.linkLibCpp();
+        rtcheck.addCSourceFile(.{
+            .file = b.path("tools/zmsx-rtcheck.cpp"),
+            .flags = cxx_flags[0..],
+        });
+        rtcheck.addIncludePath(b.path("include"));
+        rtcheck.linkLibrary(lib);
+        rtcheck.rdynamic = true;
+        b.installArtifact(rtcheck);
+    }
 }
 
 fn adlmidi(
@@ -328,6 +405,7 @@ fn fluidsynth(
             "thirdparty/fluidsynth/src/sfloader/fluid_sfont.c",
             "thirdparty/fluidsynth/src/sfloader/fluid_sffile.c",
             "thirdparty/fluidsynth/src/sfloader/fluid_samplecache.c",
+            "thirdparty/fluidsynth/src/sfloader/fluid_sfontcache.c",
             "thirdparty/fluidsynth/src/rvoice/fluid_adsr_env.c",
             "thirdparty/fluidsynth/src/rvoice/fluid_chorus.c",
             "thirdparty/fluidsynth/src/rvoice/fluid_iir_filter.c",
@@ -36,6 +36,22 @@ typedef enum ZMSXMidiType {
 	zmsx_midi_mids,
 } ZMSXMidiType;
 
+/// What `zmsx_identify_song_format` found in a file's header.
+typedef enum ZMSXSongFormat {
+	/// No known signature. Opening such a file tries the sound decoders in turn.
+	zmsx_format_unknown,
+	zmsx_format_gzip,
+	zmsx_format_midi,
+	zmsx_format_cdda,
+	zmsx_format_opl,
+	zmsx_format_xa,
+	zmsx_format_gme,
+	zmsx_format_module,
+	/// Anything libsndfile reads: WAV, AIFF, FLAC, Ogg and so on.
+	zmsx_format_sndfile,
+	zmsx_format_mp3,
+} ZMSXSongFormat;
+
 typedef enum ZMSXMidiDevice {
 	zmsx_mdev_default = -1,
 	zmsx_mdev_standard = 0,
@@ -86,6 +102,79 @@ typedef struct ZMSXSoundStreamInfoEx {
 	ZMSXChannelConfig channel_config;
 } ZMSXSoundStreamInfoEx;
 
+typedef enum ZMSXSampleLayout {
+	zmsx_layout_interleaved,
+	/// All samples of the left channel come first, followed by the right ones.
+	zmsx_layout_planar
+} ZMSXSampleLayout;
+
+/// The format `zmsx_fill_stream_ex` delivers, independent of the song's own.
+typedef struct ZMSXOutputFormat {
+	/// Only zmsx_sample_int16 and zmsx_sample_float32 are supported.
+	ZMSXSampleType sample_type;
+	ZMSXChannelConfig channel_config;
+	ZMSXSampleLayout layout;
+	/// Adds TPDF dither when the output has less precision than the song.
+	bool dither;
+} ZMSXOutputFormat;
+
+/// Rendering statistics of a song since it was last started.
+typedef struct ZMSXPerfCounters {
+	/// Number of blocks rendered.
+	uint64_t blocks;
+	/// Wall clock time it took to render one block, in microseconds.
+	double block_min_us;
+	double block_avg_us;
+	double block_p99_us;
+	/// Seconds of audio rendered per second of rendering time.
+	double realtime_factor;
+	/// Share of the rendering time spent in the synthesizer itself, 0 if the song does not report it.
+	double synth_fraction;
+	/// Voices sounding after the last block, -1 if the song does not report it.
+	int active_voices;
+	/// MIDI events the synthesizer has handled.
+	uint64_t events_processed;
+	/// Blocks that took more than half of their own playing time to render.
+	uint64_t underrun_risk;
+	/// Size of the buffers the library keeps for streaming the song.
+	uint64_t bytes_allocated;
+} ZMSXPerfCounters;
+
+typedef enum ZMSXQueueState {
+	/// Nothing is queued.
+	zmsx_queue_none,
+	/// The next song is being started in the background.
+	zmsx_queue_preparing,
+	/// The next song is started and waits for its time.
+	zmsx_queue_ready,
+	/// The output is fading or switching over to the next song.
+	zmsx_queue_transition,
+	/// Only the next song is heard now. Reading from it directly continues
+	/// where the current song's output left off.
+	zmsx_queue_done,
+	/// The next song could not be started or does not fit the current one.
+	zmsx_queue_failed
+} ZMSXQueueState;
+
+typedef struct ZMSXTempoChange {
+	/// When the tempo changes, in milliseconds from the start of the song.
+	unsigned time_ms;
+	/// Microseconds per quarter note.
+	int tempo;
+} ZMSXTempoChange;
+
+typedef struct ZMSXSongInfo {
+	/// Length of the song in milliseconds, playing every loop in it once. -1 if unknown.
+	int duration_ms;
+	/// Where the song continues when it loops and where it jumps back from. -1 if unknown.
+	int loop_start_ms;
+	int loop_end_ms;
+	/// Tempo map of MIDI songs, starting with the initial tempo. Empty for everything else.
+	/// The array stays valid until the song is closed or its subsong changes.
+	int num_tempo_changes;
+	const ZMSXTempoChange* tempo_changes;
+} ZMSXSongInfo;
+
 typedef enum ZMSXIntConfigKey {
 	zmusic_adl_chips_count,
 	zmusic_adl_emulator_id,
@@ -150,6 +239,38 @@ typedef enum ZMSXIntConfigKey {
 
 	zmusic_snd_mididevice,
 	zmusic_snd_outputrate,
+	/// Milliseconds of audio to render ahead on a worker thread; 0 disables it.
+	/// Takes effect on the next call to `zmsx_start`.
+	zmsx_snd_renderahead,
+	/// If set, `zmsx_start` makes the song allocate everything it would
+	/// otherwise allocate lazily while rendering, and backends avoid internal
+	/// locking where the library's own threading makes it unnecessary.
+	/// Control calls and live setting changes are then carried out on the
+	/// calling thread, and `zmsx_fill_stream` neither allocates nor locks,
+	/// which tools/zmsx-rtcheck checks. Timidity++ songs are not covered,
+	/// they share global state and load instruments while playing, and
+	/// neither is the mixer, which takes locks to hand work to its threads.
+	/// Takes effect on the next call to `zmsx_start`.
+	zmsx_snd_realtime,
+	/// Resamples every song to `zmusic_snd_outputrate` as it was when the song
+	/// was opened. 0 is off, songs play at their own rate; 1 is fast, 2 balanced
+	/// and 3 best quality. Resampled songs are delivered as float32.
+	zmsx_snd_resampler,
+	/// Number of MIDI synths kept open after their song stopped, so that the
+	/// next song on the same device can start without creating it again.
+	/// Changing any MIDI device setting frees them. 0 disables the pool.
+	zmsx_snd_mididevicepool,
+	/// Megabytes of SoundFonts FluidSynth keeps loaded after no song uses
+	/// them anymore. SoundFonts in use are always shared between all songs,
+	/// unless dynamic sample loading is enabled. 0 unloads them right away.
+	zmsx_fluid_sfcache,
+	/// Frames a soft synth renders at once between MIDI events. Events that
+	/// fall within a block are played at its start, which saves the synth
+	/// from rendering a few frames at a time for dense controller or pitch
+	/// bend changes. 0 renders up to every event. Synths which work in blocks
+	/// internally, like FluidSynth, use at least their own block size.
+	/// Takes effect on the next call to `zmsx_start`.
+	zmsx_snd_midiblocksize,
 
 	NUM_ZMUSIC_INT_CONFIGS
 } ZMSXIntConfigKey;
@@ -191,6 +312,30 @@ typedef enum ZMSXStringConfigKey {
 	NUM_STRING_CONFIGS
 } ZMSXStringConfigKey;
 
+/// One song to render with `zmsx_render_batch`.
+typedef struct ZMSXRenderJob {
+	const char* input_path;
+	/// The wave file gets written in the song's native output format.
+	const char* output_path;
+	ZMSXMidiDevice device;
+	const char* device_args;
+	int subsong;
+	/// Rendering stops after this many seconds. If 0, the song plays until it ends.
+	/// Songs which never end on their own need a limit.
+	double max_seconds;
+} ZMSXRenderJob;
+
+typedef struct ZMSXRenderResult {
+	bool success;
+	/// Length of the rendered audio.
+	double audio_seconds;
+	/// Time spent opening and rendering the song.
+	double wall_seconds;
+	/// Seconds of audio rendered per second of wall time.
+	double realtime_factor;
+	char error[256];
+} ZMSXRenderResult;
+
 typedef struct ZMSXCustomReader {
 	void* handle;
 	char* (*gets)(struct ZMSXCustomReader* handle, char* buff, int n);
@@ -275,6 +420,7 @@ typedef struct zmsx_Setting_ {
 // Note that the internal 'class' definitions are not C compatible!
 typedef struct ZMSXMidiSource { int zm1; } ZMSXMidiSource;
 typedef struct ZMSXMusicStream { int zm2; } ZMSXMusicStream;
+typedef struct ZMSXMixer { int zm3; } ZMSXMixer;
 struct SoundDecoder;
 
 #endif // ifndef ZMSX_HPP
@@ -285,6 +431,9 @@ struct SoundDecoder;
 extern "C" {
 #endif
 
+	/// Returns the last error of a call made on the calling thread. If that
+	/// thread has had none, it returns the last error of any thread instead.
+	/// The string stays valid until the next call on the same thread.
 	DLL_IMPORT const char* zmsx_get_last_error(void);
 
 	/// Sets callbacks for functionality that the client needs to provide.
@@ -308,6 +457,11 @@ extern "C" {
 	/// because they need access to the client's file system.
 	DLL_IMPORT ZMSXMidiType zmsx_identify_midi_type(const uint32_t* id, int size);
 
+	/// Classifies a file by the signature in its header without opening it.
+	/// Pass the first 1084 bytes, or the whole file if it is shorter; some
+	/// module signatures are that far in.
+	DLL_IMPORT ZMSXSongFormat zmsx_identify_song_format(const void* header, size_t size);
+
 	DLL_IMPORT ZMSXMidiSource*
 		zmsx_create_midi_source(const uint8_t* data, size_t length, ZMSXMidiType miditype);
 
@@ -326,6 +480,19 @@ extern "C" {
 	DLL_IMPORT ZMSXMusicStream*
 		zmsx_open_song_file(const char* filename, ZMSXMidiDevice device, const char* args);
 
+	/// Like `zmsx_open_song_mem`, but the data is not copied. It must stay valid
+	/// until `release` gets called with `userdata`, which happens once the song
+	/// no longer needs it, at the latest when it gets closed. Also called if
+	/// opening fails. `release` may be NULL.
+	DLL_IMPORT ZMSXMusicStream* zmsx_open_song_mem_borrowed(
+		const void* mem,
+		size_t size,
+		void (*release)(void* userdata),
+		void* userdata,
+		ZMSXMidiDevice device,
+		const char* args
+	);
+
 	DLL_IMPORT ZMSXMusicStream* zmsx_open_song_mem(
 		const void* mem,
 		size_t size,
@@ -337,6 +504,16 @@ extern "C" {
 
 	DLL_IMPORT bool zmsx_fill_stream(ZMSXMusicStream* stream, void* buff, int len);
 
+	/// Like `zmsx_fill_stream`, but converts the song's output to `format`.
+	/// Unlike there, the length is given in frames. For planar output the
+	/// buffer holds `frames` samples per channel.
+	DLL_IMPORT bool zmsx_fill_stream_ex(
+		ZMSXMusicStream* stream,
+		const ZMSXOutputFormat* format,
+		void* buff,
+		int frames
+	);
+
 	DLL_IMPORT bool zmsx_start(ZMSXMusicStream* song, int subsong, bool loop);
 
 	DLL_IMPORT void zmsx_pause(ZMSXMusicStream* song);
@@ -353,6 +530,31 @@ extern "C" {
 
 	DLL_IMPORT bool zmsx_set_subsong(ZMSXMusicStream* song, int subsong);
 
+	/// Continues a playing song `ms` milliseconds from its start. MIDI songs
+	/// count every loop inside the song once, and seeking past the end ends
+	/// them. The first seek in a MIDI song has to look at the whole song
+	/// once; later ones only at a few events. Returns false if the song
+	/// cannot seek.
+	DLL_IMPORT bool zmsx_set_position(ZMSXMusicStream* song, unsigned int ms);
+
+	/// Queues `next` to follow `song` without a gap. `next` must be stopped
+	/// and gets started in the background right away, so that its device,
+	/// precaching and first block of output are ready before it is needed.
+	/// Once `song` has delivered `at_ms` more milliseconds of output, or has
+	/// ended if `at_ms` is negative, reading from `song` fades over to `next`
+	/// in `crossfade_ms`, or switches right away if that is 0. A song that
+	/// ends cannot be faded out, so it is always switched over.
+	///
+	/// The output stays in `song`'s format, so `next` needs the same sample
+	/// rate. `next` stays the caller's, but may not be used while it is
+	/// queued. Once zmsx_get_queue_state returns zmsx_queue_done it is
+	/// independent of `song` and the caller can read from it instead.
+	/// Stopping, restarting or closing `song` before that stops `next` as
+	/// well. Passing nullptr for `next` does the same.
+	DLL_IMPORT bool zmsx_queue_next(ZMSXMusicStream* song, ZMSXMusicStream* next, int subsong, bool loop, int at_ms, int crossfade_ms);
+
+	DLL_IMPORT ZMSXQueueState zmsx_get_queue_state(ZMSXMusicStream* song);
+
 	DLL_IMPORT bool zmsx_is_looping(const ZMSXMusicStream* song);
 
 	DLL_IMPORT int zmsx_get_device_type(const ZMSXMusicStream* song);
@@ -373,6 +575,8 @@ extern "C" {
 
 	// Configuration interface. The return value specifies if a music restart is needed.
 	// RealValue should be written back to the CVAR or whatever other method the client uses to store configuration state.
+	// These may be called from any thread, also while songs are playing. Devices take the settings as they are when
+	// they get opened, and settings that can change live reach the song's rendering thread before its next block.
 
 	DLL_IMPORT bool zmsx_config_set_int(
 		ZMSXIntConfigKey key,
@@ -394,7 +598,28 @@ extern "C" {
 		const char* value
 	);
 
+	/// Keeps the song's rendering threads out while it reads the synth's
+	/// state, like `zmsx_set_position` does, so it is meant for displays
+	/// that refresh now and then rather than for every audio block.
 	DLL_IMPORT const char* zmsx_get_stats(ZMSXMusicStream* song);
+	/// Fills `counters` with the song's rendering statistics. They are cheap
+	/// to keep, so this works on any song without enabling anything first.
+	DLL_IMPORT bool zmsx_get_perf_counters(ZMSXMusicStream* song, ZMSXPerfCounters* counters);
+	/// Fills `info` with the song's length and loop points. MIDI songs are
+	/// gone through once without rendering them, which is only done while the
+	/// song is stopped or when it gets started. Returns false if nothing is known.
+	DLL_IMPORT bool zmsx_get_song_info(ZMSXMusicStream* song, ZMSXSongInfo* info);
+
+	// Trace zones in the rendering path. They are only recorded if the library
+	// was built with ZMSX_TRACE, otherwise these do nothing and the dump is empty.
+
+	/// Turns recording on or off. It is on from the start.
+	DLL_IMPORT void zmsx_trace_enable(bool on);
+	/// Drops everything recorded so far.
+	DLL_IMPORT void zmsx_trace_clear(void);
+	/// Returns the most recent zones as Chrome trace JSON, for chrome://tracing
+	/// or Perfetto. The text stays valid until the next call.
+	DLL_IMPORT const char* zmsx_trace_dump(void);
 
 	DLL_IMPORT struct SoundDecoder* zmsx_create_decoder(
 		const uint8_t* data,
@@ -423,6 +648,43 @@ extern "C" {
 		bool* endass
 	);
 
+	/// Creates a mixer which renders several streams in parallel and sums them
+	/// into interleaved stereo float output at `samplerate`.
+	/// Timidity++ songs are excluded from this. They share global state, so
+	/// the mixer renders them one after another on a single thread.
+	/// `threads` is the number of worker threads; -1 uses one per extra CPU core.
+	DLL_IMPORT ZMSXMixer* zmsx_mixer_create(int samplerate, int threads);
+
+	/// Closes all streams still owned by the mixer.
+	DLL_IMPORT void zmsx_mixer_destroy(ZMSXMixer* mixer);
+
+	/// Hands a stream over to the mixer, which closes it when it gets removed.
+	/// The stream still needs to be started and controlled by the client.
+	/// Returns a handle for the other mixer functions, or -1 on failure.
+	DLL_IMPORT int zmsx_mixer_add_stream(ZMSXMixer* mixer, ZMSXMusicStream* song, float gain);
+
+	DLL_IMPORT void zmsx_mixer_remove_stream(ZMSXMixer* mixer, int handle);
+
+	/// Moves a stream's gain to `gain` over `ramp_ms` milliseconds.
+	DLL_IMPORT bool zmsx_mixer_set_gain(ZMSXMixer* mixer, int handle, float gain, int ramp_ms);
+
+	/// Fills `len` bytes of interleaved stereo float samples. A partial frame
+	/// at the end gets filled with silence.
+	/// Returns false once none of the streams produce any more output.
+	DLL_IMPORT bool zmsx_mixer_fill(ZMSXMixer* mixer, void* buff, int len);
+
+	/// Renders every job to a wave file, spread over `threads` threads;
+	/// if that is 0 or less, one thread per CPU core is used.
+	/// Timidity++ jobs are excluded from this and render one after another.
+	/// `results` must have room for `count` entries.
+	/// Returns the number of jobs that succeeded.
+	DLL_IMPORT int zmsx_render_batch(
+		const ZMSXRenderJob* jobs,
+		ZMSXRenderResult* results,
+		int count,
+		int threads
+	);
+
 	// The rest of the decoder interface is only useful for streaming music.
 
 	DLL_IMPORT const ZMSXMidiOutDevice *zmsx_get_midi_devices(int *pAmount);
@@ -498,6 +760,8 @@ typedef const zmsx_Setting* (*pfn_zmsx_get_config)();
 
 typedef ZMSXMidiType (*pfn_zmsx_identify_midi_type)(uint32_t* id, int size);
 
+typedef ZMSXSongFormat (*pfn_zmsx_identify_song_format)(const void* header, size_t size);
+
 typedef ZMSXMidiSource (*pfn_zmsx_create_midi_source)(
 	const uint8_t* data,
 	size_t length,
@@ -525,6 +789,11 @@ typedef ZMSXMusicStream* (*pfn_zmsx_open_song_mem)(
 	const void* mem, size_t size, ZMSXMidiDevice device, const char* Args
 );
 
+typedef ZMSXMusicStream* (*pfn_zmsx_open_song_mem_borrowed)(
+	const void* mem, size_t size, void (*release)(void* userdata), void* userdata,
+	ZMSXMidiDevice device, const char* Args
+);
+
 typedef ZMSXMusicStream* (*pfn_zmsx_open_song_cd)(int track, int cdid);
 
 typedef bool (*pfn_zmsx_fill_stream)(
@@ -533,6 +802,13 @@ typedef bool (*pfn_zmsx_fill_stream)(
 	int len
 );
 
+typedef bool (*pfn_zmsx_fill_stream_ex)(
+	ZMSXMusicStream* stream,
+	const ZMSXOutputFormat* format,
+	void* buff,
+	int frames
+);
+
 typedef bool (*pfn_zmsx_start)(
 	ZMSXMusicStream* song,
 	int subsong,
@@ -553,6 +829,12 @@ typedef void (*pfn_zmsx_close)(ZMSXMusicStream* song);
 
 typedef bool (*pfn_zmsx_set_subsong)(ZMSXMusicStream* song, int subsong);
 
+typedef bool (*pfn_zmsx_set_position)(ZMSXMusicStream* song, unsigned int ms);
+
+typedef bool (*pfn_zmsx_queue_next)(ZMSXMusicStream* song, ZMSXMusicStream* next, int subsong, bool loop, int at_ms, int crossfade_ms);
+
+typedef ZMSXQueueState (*pfn_zmsx_get_queue_state)(ZMSXMusicStream* song);
+
 typedef bool (*pfn_zmsx_is_looping)(ZMSXMusicStream* song);
 
 typedef bool (*pfn_zmsx_is_midi)(ZMSXMusicStream* song);
@@ -593,6 +875,11 @@ typedef bool (*pfn_zmsx_config_set_string)(
 );
 
 typedef const char* (*pfn_zmsx_get_stats)(ZMSXMusicStream* song);
+typedef bool (*pfn_zmsx_get_perf_counters)(ZMSXMusicStream* song, ZMSXPerfCounters* counters);
+typedef bool (*pfn_zmsx_get_song_info)(ZMSXMusicStream* song, ZMSXSongInfo* info);
+typedef void (*pfn_zmsx_trace_enable)(bool on);
+typedef void (*pfn_zmsx_trace_clear)(void);
+typedef const char* (*pfn_zmsx_trace_dump)(void);
 
 typedef struct SoundDecoder* (*pfn_zmsx_create_decoder)(
 	const uint8_t* data,
@@ -626,4 +913,23 @@ typedef void (*pfn_zmsx_find_loop_tags)(
 
 typedef const ZMSXMidiOutDevice* (*pfn_zmsx_get_midi_devices)(int* pAmount);
 
+typedef ZMSXMixer* (*pfn_zmsx_mixer_create)(int samplerate, int threads);
+
+typedef void (*pfn_zmsx_mixer_destroy)(ZMSXMixer* mixer);
+
+typedef int (*pfn_zmsx_mixer_add_stream)(ZMSXMixer* mixer, ZMSXMusicStream* song, float gain);
+
+typedef void (*pfn_zmsx_mixer_remove_stream)(ZMSXMixer* mixer, int handle);
+
+typedef bool (*pfn_zmsx_mixer_set_gain)(ZMSXMixer* mixer, int handle, float gain, int ramp_ms);
+
+typedef bool (*pfn_zmsx_mixer_fill)(ZMSXMixer* mixer, void* buff, int len);
+
+typedef int (*pfn_zmsx_render_batch)(
+	const ZMSXRenderJob* jobs,
+	ZMSXRenderResult* results,
+	int count,
+	int threads
+);
+
 #endif
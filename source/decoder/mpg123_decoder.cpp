@@ -35,6 +35,7 @@
 #include <stdio.h>
 #include "mpg123_decoder.h"
 #include "loader/i_module.h"
+#include "zmsx/trace.h"
 
 #ifdef HAVE_MPG123
 
@@ -171,6 +172,7 @@ void MPG123Decoder::getInfo(int *samplerate, ChannelConfig *chans, SampleType *t
 
 size_t MPG123Decoder::read(char *buffer, size_t bytes)
 {
+    ZMSX_TRACE_ZONE("MPG123Decoder::read");
     size_t amt = 0;
     while(!Done && bytes > 0)
     {
@@ -34,6 +34,7 @@
 #include <algorithm>
 #include "sndfile_decoder.h"
 #include "loader/i_module.h"
+#include "zmsx/trace.h"
 
 #ifdef HAVE_SNDFILE
 
@@ -146,6 +147,7 @@ void SndFileDecoder::getInfo(int *samplerate, ZMSXChannelConfig *chans, ZMSXSamp
 
 size_t SndFileDecoder::read(char *buffer, size_t bytes)
 {
+    ZMSX_TRACE_ZONE("SndFileDecoder::read");
     short *out = (short*)buffer;
     size_t frames = bytes / SndInfo.channels / 2;
     size_t total = 0;
@@ -36,31 +36,49 @@
 #include "zmsx/zmsx.hpp"
 #include "sndfile_decoder.h"
 #include "mpg123_decoder.h"
+#include "zmsx/formatid.h"
 
+template<class T>
+static SoundDecoder *TryDecoder(MusicIO::FileInterface *reader, long pos)
+{
+	SoundDecoder *decoder = new T;
+	if (decoder->open(reader))
+		return decoder;
+	reader->seek(pos, SEEK_SET);
+	delete decoder;
+	return nullptr;
+}
+
+// Files with a reliable signature go straight to the decoder that handles
+// them. Only if there is none does each decoder get a try.
 SoundDecoder *SoundDecoder::zmsx_create_decoder(MusicIO::FileInterface *reader)
 {
-    SoundDecoder *decoder = NULL;
-    auto pos = reader->tell();
+	SoundDecoder *decoder = nullptr;
+	auto pos = reader->tell();
 
-#ifdef HAVE_SNDFILE
-		decoder = new SndFileDecoder;
-		if (decoder->open(reader))
-			return decoder;
-		reader->seek(pos, SEEK_SET);
+	uint8_t header[32];
+	long len = reader->read(header, sizeof(header));
+	reader->seek(pos, SEEK_SET);
+	SongSignature sig = IdentifySongFormat(header, len > 0 ? len : 0);
 
-		delete decoder;
-		decoder = NULL;
+#ifdef HAVE_MPG123
+	if (sig.Format == zmsx_format_mp3)
+	{
+		decoder = TryDecoder<MPG123Decoder>(reader, pos);
+		if (decoder || !sig.Weak) return decoder;
+	}
+#endif
+#ifdef HAVE_SNDFILE
+	decoder = TryDecoder<SndFileDecoder>(reader, pos);
+	if (decoder || (sig.Format == zmsx_format_sndfile && !sig.Weak)) return decoder;
 #endif
 #ifdef HAVE_MPG123
-		decoder = new MPG123Decoder;
-		if (decoder->open(reader))
-			return decoder;
-		reader->seek(pos, SEEK_SET);
-
-		delete decoder;
-		decoder = NULL;
+	if (sig.Format != zmsx_format_mp3)
+	{
+		decoder = TryDecoder<MPG123Decoder>(reader, pos);
+	}
 #endif
-    return decoder;
+	return decoder;
 }
 
 
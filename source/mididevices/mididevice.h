@@ -1,8 +1,11 @@
 #pragma once
 
 #include <mutex>
+#include <string.h>
 #include "zmsx/midiconfig.h"
 #include "zmsx/mididefs.h"
+#include "zmsx/wavefile.h"
+#include "zmsx/perfcounters.h"
 
 typedef void(*MidiCallback)(void *);
 
@@ -17,6 +20,19 @@ struct MidiHeader
 	MidiHeader *lpNext;
 };
 
+// Where a soft synth takes its events from while it renders, instead of
+// having them queued up for it with StreamOut.
+
+class MIDISequencer
+{
+public:
+	virtual ~MIDISequencer() = default;
+	// Writes the events that are due within the next max_time microseconds,
+	// in the same format StreamOut takes them, and returns the end of what it
+	// wrote. Writing nothing means the song is over.
+	virtual uint32_t *PullEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time) = 0;
+};
+
 class MIDIDevice
 {
 public:
@@ -45,6 +61,7 @@ public:
 	virtual void InitPlayback();
 	virtual bool Update();
 	virtual void PrecacheInstruments(const uint16_t *instruments, int count);
+	virtual void PrepareRealtime() {}
 	virtual void ChangeSettingInt(const char *setting, int value);
 	virtual void ChangeSettingNum(const char *setting, double value);
 	virtual void ChangeSettingString(const char *setting, const char *value);
@@ -52,6 +69,10 @@ public:
 	virtual int GetDeviceType() const { return zmsx_mdev_default; }
 	virtual bool CanHandleSysex() const { return true; }
 	virtual ZMSXSoundStreamInfoEx GetStreamInfoEx() const;
+	virtual int GetActiveVoices() const { return -1; }	// -1 if the device cannot tell.
+	virtual bool CanReuse() const { return false; }	// Whether Open can restart it for another song after Close.
+	virtual bool FlushStream() { return false; }	// Drops all buffers passed to StreamOut that have not been played yet.
+	virtual bool SetSequencer(MIDISequencer *sequencer) { return false; }	// False if the device only takes events through StreamOut.
 
 protected:
 	MidiCallback Callback;
@@ -82,6 +103,10 @@ public:
 	virtual bool ServiceStream(void* buff, int numbytes);
 	int GetSampleRate() const { return SampleRate; }
 	ZMSXSoundStreamInfoEx GetStreamInfoEx() const override;
+	bool CanReuse() const override { return true; }
+	bool FlushStream() override;
+	bool SetSequencer(MIDISequencer *sequencer) override;
+	PerfWork TakeWork() { PerfWork work = Work; Work = {}; return work; }
 
 protected:
 	double Tempo;
@@ -95,16 +120,75 @@ protected:
 	uint32_t Position;
 	int SampleRate;
 	int StreamBlockSize = 2;
+	int RenderQuantum = 1;	// Frames ServiceStream renders at once, from Open.
+	PerfWork Work;	// What PlayTick and ComputeOutput did since the last TakeWork.
+
+	// With a sequencer, PlayTick asks it for the events up to the end of the
+	// block being rendered whenever it runs out, and Events only ever points
+	// at PulledEvents.
+	MIDISequencer *Sequencer = nullptr;
+	MidiHeader PulledEvents = {};
+	int PullSamples = 0;	// Samples left to render in the current block.
+	uint32_t PullBuffer[MAX_MIDI_EVENTS * 3];
 
 	virtual void CalcTickRate();
 	int PlayTick();
+	bool PullEvents();
+	void TimedComputeOutput(float *buffer, int len);
 
 	virtual int OpenRenderer() = 0;
+	virtual int GetRenderQuantum() const { return 1; }	// Frames the synth cannot time events more precisely than.
 	virtual void HandleEvent(int status, int parm1, int parm2) = 0;
 	virtual void HandleLongEvent(const uint8_t *data, int len) = 0;
 	virtual void ComputeOutput(float *buffer, int len) = 0;
 };
 
+// Keeps track of the keys that are down, for synths which cannot change some
+// settings without resetting their chips. The MIDI channel state survives
+// that, so striking the held keys again afterwards is all it takes to carry
+// on where they were.
+
+struct MIDIHeldNotes
+{
+	uint8_t Velocity[16][128] = {};
+
+	void Clear()
+	{
+		memset(Velocity, 0, sizeof(Velocity));
+	}
+
+	void HandleEvent(int status, int parm1, int parm2)
+	{
+		int chan = status & 0x0F;
+		switch (status & 0xF0)
+		{
+		case 0x90:
+			Velocity[chan][parm1 & 127] = parm2;
+			break;
+
+		case 0x80:
+			Velocity[chan][parm1 & 127] = 0;
+			break;
+
+		case 0xB0:
+			if (parm1 == 120 || parm1 == 123)	// All sound off, all notes off
+				memset(Velocity[chan], 0, sizeof(Velocity[chan]));
+			break;
+		}
+	}
+
+	template<class NoteOn> void Restrike(NoteOn noteOn) const
+	{
+		for (int chan = 0; chan < 16; chan++)
+		{
+			for (int key = 0; key < 128; key++)
+			{
+				if (Velocity[chan][key] != 0) noteOn(chan, key, Velocity[chan][key]);
+			}
+		}
+	}
+};
+
 
 // Internal disk writing version of a MIDI device ------------------
 
@@ -121,6 +205,7 @@ public:
 		return playDevice->Open();
 	}
 	int OpenRenderer() override { return playDevice->OpenRenderer();  }
+	int GetRenderQuantum() const override { return playDevice->GetRenderQuantum(); }
 	void Stop() override;
 	void HandleEvent(int status, int parm1, int parm2) override { playDevice->HandleEvent(status, parm1, parm2);  }
 	void HandleLongEvent(const uint8_t *data, int len) override { playDevice->HandleLongEvent(data, len);  }
@@ -133,10 +218,13 @@ public:
 	int SetTempo(int tempo) override { return playDevice->SetTempo(tempo); }
 	int SetTimeDiv(int timediv) override { return playDevice->SetTimeDiv(timediv); }
 	bool IsOpen() const override { return playDevice->IsOpen(); }
+	bool CanReuse() const override { return false; }
+	bool FlushStream() override { return playDevice->FlushStream(); }
+	bool SetSequencer(MIDISequencer *sequencer) override { return playDevice->SetSequencer(sequencer); }
 	void CalcTickRate() override { playDevice->CalcTickRate(); }
 
 protected:
-	FILE *File;
+	WaveFileWriter Writer;
 	SoftSynthMIDIDevice *playDevice;
 };
 
@@ -144,6 +232,7 @@ protected:
 // MIDI devices
 
 MIDIDevice *CreateFluidSynthMIDIDevice(int samplerate, const char *Args);
+void Fluid_SetSoundFontCacheSize(int megabytes);
 MIDIDevice *CreateADLMIDIDevice(const char* args);
 MIDIDevice *CreateOPNMIDIDevice(const char *args);
 MIDIDevice *CreateOplMIDIDevice(const char* Args);
@@ -151,6 +240,32 @@ MIDIDevice *CreateTimidityMIDIDevice(const char* Args, int samplerate);
 MIDIDevice *CreateTimidityPPMIDIDevice(const char *Args, int samplerate);
 MIDIDevice *CreateWildMIDIDevice(const char *Args, int samplerate);
 
+// Devices which songs hand back when they stop, so that the next song can
+// skip creating the synth and loading its instruments. A device is only
+// reused for the same type, arguments and sample rate it was created with,
+// and only while the configuration has not changed since.
+
+struct MIDIDeviceKey
+{
+	int DeviceType = zmsx_mdev_default;
+	std::string Args;
+	int SampleRate = 0;
+	bool Realtime = false;	// FluidSynth drops its API lock for zmsx_snd_realtime.
+	unsigned Serial = 0;	// Set by MIDIDevicePool::Take.
+};
+
+namespace MIDIDevicePool
+{
+	// Returns a closed device or nullptr if there is none for this key.
+	MIDIDevice *Take(MIDIDeviceKey &key);
+	// Takes ownership of a closed device.
+	void Put(const MIDIDeviceKey &key, MIDIDevice *device);
+	// For configuration changes that affect newly created devices.
+	void Invalidate();
+	// Frees devices until no more than snd_mididevicepool are left.
+	void Trim();
+}
+
 #ifdef _WIN32
 MIDIDevice* CreateWinMIDIDevice(int mididevice);
 #endif
@@ -34,6 +34,7 @@
 
 // HEADER FILES ------------------------------------------------------------
 
+#include <algorithm>
 #include <stdexcept>
 #include <stdlib.h>
 
@@ -43,8 +44,6 @@
 #ifdef HAVE_ADL
 #include "adlmidi.h"
 
-ADLConfig adlConfig;
-
 class ADLMIDIDevice : public SoftSynthMIDIDevice
 {
 	struct ADL_MIDIPlayer *Renderer;
@@ -55,6 +54,7 @@ public:
 
 	int OpenRenderer() override;
 	int GetDeviceType() const override { return zmsx_mdev_adl; }
+	void ChangeSettingInt(const char *setting, int value) override;
 
 protected:
 
@@ -64,6 +64,8 @@ protected:
 
 private:
 	int LoadCustomBank(const ADLConfig *config);
+
+	MIDIHeldNotes HeldNotes;
 };
 
 
@@ -176,9 +178,39 @@ int ADLMIDIDevice::LoadCustomBank(const ADLConfig *config)
 int ADLMIDIDevice::OpenRenderer()
 {
 	adl_rt_resetState(Renderer);
+	HeldNotes.Clear();
 	return 0;
 }
 
+//==========================================================================
+//
+// ADLMIDIDevice :: ChangeSettingInt
+//
+// Switching the emulator or the number of chips resets the chips, which
+// silences everything that is playing, so the held keys get struck again.
+//
+//==========================================================================
+
+void ADLMIDIDevice::ChangeSettingInt(const char *setting, int value)
+{
+	int res;
+	// The library keeps the count even when it refuses it, so it only gets
+	// counts the config setter lets through.
+	if (!strcmp(setting, "adl.numchips")) res = adl_setNumChips(Renderer, std::clamp(value, 1, 100));
+	else if (!strcmp(setting, "adl.emulator")) res = adl_switchEmulator(Renderer, value);
+	else return;
+
+	if (res < 0)
+	{
+		ZMusic_Printf(zmsx_msg_error, "%s: %s\n", setting, adl_errorInfo(Renderer));
+		return;
+	}
+	HeldNotes.Restrike([=](int chan, int key, int velocity)
+	{
+		adl_rt_noteOn(Renderer, chan, key, velocity);
+	});
+}
+
 //==========================================================================
 //
 // ADLMIDIDevice :: HandleEvent
@@ -190,6 +222,7 @@ void ADLMIDIDevice::HandleEvent(int status, int parm1, int parm2)
 	int command = status & 0xF0;
 	int chan	= status & 0x0F;
 
+	HeldNotes.HandleEvent(status, parm1, parm2);
 	switch (command)
 	{
 	case ME_NOTEON:
@@ -263,13 +296,11 @@ void ADLMIDIDevice::ComputeOutput(float *buffer, int len)
 //
 //==========================================================================
 
-extern ADLConfig adlConfig;
-
 MIDIDevice *CreateADLMIDIDevice(const char *Args)
 {
-	ADLConfig config = adlConfig;
+	ADLConfig config = GetConfig()->adl;
 
-	const char* bank = Args && *Args ? Args : adlConfig.adl_use_custom_bank ? adlConfig.adl_custom_bank.c_str() : nullptr;
+	const char* bank = Args && *Args ? Args : config.adl_use_custom_bank ? config.adl_custom_bank.c_str() : nullptr;
 	if (bank && *bank)
 	{
 		if (*bank >= '0' && *bank <= '9')
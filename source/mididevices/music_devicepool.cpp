@@ -0,0 +1,174 @@
+/*
+** music_devicepool.cpp
+** Keeps opened MIDI devices for reuse by later songs.
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "mididevice.h"
+
+// TYPES -------------------------------------------------------------------
+
+struct PooledDevice
+{
+	MIDIDeviceKey Key;
+	std::unique_ptr<MIDIDevice> Device;
+};
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+static std::mutex PoolMutex;
+static std::list<PooledDevice> Pool;	// Least recently used first.
+static unsigned PoolSerial = 1;
+
+typedef std::vector<std::unique_ptr<MIDIDevice>> DeviceList;
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// SameDevice
+//
+//==========================================================================
+
+static bool SameDevice(const MIDIDeviceKey &a, const MIDIDeviceKey &b)
+{
+	return a.DeviceType == b.DeviceType && a.SampleRate == b.SampleRate && a.Realtime == b.Realtime && a.Args == b.Args;
+}
+
+//==========================================================================
+//
+// EvictDevices
+//
+// Must be called with the lock held.
+//
+//==========================================================================
+
+static void EvictDevices(DeviceList &freed)
+{
+	size_t limit = std::max(GetConfig()->misc.snd_mididevicepool, 0);
+	while (Pool.size() > limit)
+	{
+		freed.push_back(std::move(Pool.front().Device));
+		Pool.pop_front();
+	}
+}
+
+//==========================================================================
+//
+// MIDIDevicePool :: Take
+//
+// Also stamps the key with the current configuration, so a device created
+// for it after a miss can go into the pool later.
+//
+//==========================================================================
+
+MIDIDevice *MIDIDevicePool::Take(MIDIDeviceKey &key)
+{
+	std::lock_guard<std::mutex> lock(PoolMutex);
+	key.Serial = PoolSerial;
+	for (auto it = Pool.begin(); it != Pool.end(); ++it)
+	{
+		if (SameDevice(it->Key, key))
+		{
+			MIDIDevice *device = it->Device.release();
+			Pool.erase(it);
+			return device;
+		}
+	}
+	return nullptr;
+}
+
+//==========================================================================
+//
+// MIDIDevicePool :: Put
+//
+// The devices that no longer fit get destroyed outside the lock, because
+// that can take a while for the larger synths.
+//
+//==========================================================================
+
+void MIDIDevicePool::Put(const MIDIDeviceKey &key, MIDIDevice *device)
+{
+	std::unique_ptr<MIDIDevice> owned(device);
+	DeviceList freed;
+	{
+		std::lock_guard<std::mutex> lock(PoolMutex);
+		if (key.Serial != PoolSerial || !device->CanReuse())
+		{
+			freed.push_back(std::move(owned));
+		}
+		else
+		{
+			Pool.push_back({ key, std::move(owned) });
+			EvictDevices(freed);
+		}
+	}
+}
+
+//==========================================================================
+//
+// MIDIDevicePool :: Invalidate
+//
+// Devices which are playing right now get freed when they are handed back.
+//
+//==========================================================================
+
+void MIDIDevicePool::Invalidate()
+{
+	std::list<PooledDevice> freed;
+	{
+		std::lock_guard<std::mutex> lock(PoolMutex);
+		PoolSerial++;
+		freed.swap(Pool);
+	}
+}
+
+//==========================================================================
+//
+// MIDIDevicePool :: Trim
+//
+//==========================================================================
+
+void MIDIDevicePool::Trim()
+{
+	DeviceList freed;
+	{
+		std::lock_guard<std::mutex> lock(PoolMutex);
+		EvictDevices(freed);
+	}
+}
@@ -45,8 +45,6 @@
 
 // FluidSynth implementation of a MIDI device -------------------------------
 
-FluidConfig fluidConfig;
-
 #include "../thirdparty/fluidsynth/include/fluidsynth.h"
 
 class FluidSynthMIDIDevice : public SoftSynthMIDIDevice
@@ -57,6 +55,7 @@ public:
 
 	int OpenRenderer() override;
 	std::string GetStats() override;
+	int GetActiveVoices() const override;
 	void ChangeSettingInt(const char *setting, int value) override;
 	void ChangeSettingNum(const char *setting, double value) override;
 	void ChangeSettingString(const char *setting, const char *value) override;
@@ -66,10 +65,12 @@ protected:
 	void HandleEvent(int status, int parm1, int parm2) override;
 	void HandleLongEvent(const uint8_t *data, int len) override;
 	void ComputeOutput(float *buffer, int len) override;
+	int GetRenderQuantum() const override;
 	int LoadPatchSets(const std::vector<std::string>& config);
 
 	fluid_settings_t *FluidSettings;
 	fluid_synth_t *FluidSynth;
+	ConfigPtr Config;	// Taken when the device gets opened.
 
 	// Possible results returned by fluid_settings_...() functions
 	// Initial values are for FluidSynth 2.x
@@ -105,9 +106,11 @@ const char *BaseFileSearch(const char *file, const char *ext, bool lookfirstinpr
 //==========================================================================
 
 FluidSynthMIDIDevice::FluidSynthMIDIDevice(int samplerate, std::vector<std::string> &config)
-	: SoftSynthMIDIDevice(samplerate <= 0? fluidConfig.fluid_samplerate : samplerate, 22050, 96000)
+	: SoftSynthMIDIDevice(samplerate <= 0? GetConfig()->fluid.fluid_samplerate : samplerate, 22050, 96000)
 {
 	StreamBlockSize = 4;
+	Config = GetConfig();
+	const FluidConfig &fluidConfig = Config->fluid;
 
 	FluidSynth = NULL;
 	FluidSettings = NULL;
@@ -123,6 +126,9 @@ FluidSynthMIDIDevice::FluidSynthMIDIDevice(int samplerate, std::vector<std::stri
 	fluid_settings_setint(FluidSettings, "synth.chorus.active", fluidConfig.fluid_chorus);
 	fluid_settings_setint(FluidSettings, "synth.polyphony", fluidConfig.fluid_voices);
 	fluid_settings_setint(FluidSettings, "synth.cpu-cores", fluidConfig.fluid_threads);
+	// All calls into the synth come from the thread rendering the song, so
+	// FluidSynth's API lock is not needed and only costs a lock per event.
+	if (Config->misc.snd_realtime) fluid_settings_setint(FluidSettings, "synth.threadsafe-api", 0);
 	FluidSynth = new_fluid_synth(FluidSettings);
 	if (FluidSynth == NULL)
 	{
@@ -135,6 +141,11 @@ FluidSynthMIDIDevice::FluidSynthMIDIDevice(int samplerate, std::vector<std::stri
 	fluid_synth_set_chorus(FluidSynth, fluidConfig.fluid_chorus_voices, fluidConfig.fluid_chorus_level,
 		fluidConfig.fluid_chorus_speed, fluidConfig.fluid_chorus_depth, fluidConfig.fluid_chorus_type);
 
+	// Share the SoundFonts with the other FluidSynth devices. It gets tried
+	// before the default loader, which takes over where it declines.
+	Fluid_SetSoundFontCacheSize(Config->misc.fluid_sfcache);
+	fluid_synth_add_sfloader(FluidSynth, new_fluid_shared_sfloader(FluidSettings));
+
 	// try loading a patch set that got specified with $mididevice.
 
 	if (LoadPatchSets(config))
@@ -181,7 +192,10 @@ FluidSynthMIDIDevice::~FluidSynthMIDIDevice()
 int FluidSynthMIDIDevice::OpenRenderer()
 {
 	// Send MIDI system reset command (big red 'panic' button), turns off notes, resets controllers and restores initial basic channel configuration.
-	//fluid_synth_system_reset(FluidSynth);
+	// This is for devices that played a song before, and it also resets the interpolation.
+	fluid_synth_system_reset(FluidSynth);
+	Config = GetConfig();
+	fluid_synth_set_interp_method(FluidSynth, -1, Config->fluid.fluid_interp);
 	return 0;
 }
 
@@ -258,6 +272,20 @@ void FluidSynthMIDIDevice::ComputeOutput(float *buffer, int len)
 		buffer, 1, 2);
 }
 
+//==========================================================================
+//
+// FluidSynthMIDIDevice :: GetRenderQuantum
+//
+// FluidSynth renders in blocks of its own and only looks at the events it
+// got at their start, so splitting the output any finer is wasted effort.
+//
+//==========================================================================
+
+int FluidSynthMIDIDevice::GetRenderQuantum() const
+{
+	return fluid_synth_get_internal_bufsize(FluidSynth);
+}
+
 //==========================================================================
 //
 // FluidSynthMIDIDevice :: LoadPatchSets
@@ -343,13 +371,44 @@ void FluidSynthMIDIDevice::ChangeSettingNum(const char *setting, double value)
 	}
 	setting += 11;
 
-	if (strcmp(setting, "z.reverb") == 0)
+	// The reverb and chorus parameters change one at a time, each with the
+	// value that came with the change, so that the thread which renders
+	// the song never has to look at the config.
+	if (strcmp(setting, "z.reverb.roomsize") == 0)
+	{
+		fluid_synth_set_reverb_group_roomsize(FluidSynth, -1, value);
+	}
+	else if (strcmp(setting, "z.reverb.damp") == 0)
+	{
+		fluid_synth_set_reverb_group_damp(FluidSynth, -1, value);
+	}
+	else if (strcmp(setting, "z.reverb.width") == 0)
+	{
+		fluid_synth_set_reverb_group_width(FluidSynth, -1, value);
+	}
+	else if (strcmp(setting, "z.reverb.level") == 0)
+	{
+		fluid_synth_set_reverb_group_level(FluidSynth, -1, value);
+	}
+	else if (strcmp(setting, "z.chorus.nr") == 0)
+	{
+		fluid_synth_set_chorus_group_nr(FluidSynth, -1, (int)value);
+	}
+	else if (strcmp(setting, "z.chorus.level") == 0)
 	{
-		fluid_synth_set_reverb(FluidSynth, fluidConfig.fluid_reverb_roomsize, fluidConfig.fluid_reverb_damping, fluidConfig.fluid_reverb_width, fluidConfig.fluid_reverb_level);
+		fluid_synth_set_chorus_group_level(FluidSynth, -1, value);
 	}
-	else if (strcmp(setting, "z.chorus") == 0)
+	else if (strcmp(setting, "z.chorus.speed") == 0)
 	{
-		fluid_synth_set_chorus(FluidSynth, fluidConfig.fluid_chorus_voices, fluidConfig.fluid_chorus_level, fluidConfig.fluid_chorus_speed, fluidConfig.fluid_chorus_depth, fluidConfig.fluid_chorus_type);
+		fluid_synth_set_chorus_group_speed(FluidSynth, -1, value);
+	}
+	else if (strcmp(setting, "z.chorus.depth") == 0)
+	{
+		fluid_synth_set_chorus_group_depth(FluidSynth, -1, value);
+	}
+	else if (strcmp(setting, "z.chorus.type") == 0)
+	{
+		fluid_synth_set_chorus_group_type(FluidSynth, -1, (int)value);
 	}
 	else if (FluidSettingsResultFailed == fluid_settings_setnum(FluidSettings, setting, value))
 	{
@@ -380,6 +439,17 @@ void FluidSynthMIDIDevice::ChangeSettingString(const char *setting, const char *
 	}
 }
 
+//==========================================================================
+//
+// FluidSynthMIDIDevice :: GetActiveVoices
+//
+//==========================================================================
+
+int FluidSynthMIDIDevice::GetActiveVoices() const
+{
+	return FluidSynth != NULL ? fluid_synth_get_active_voice_count(FluidSynth) : -1;
+}
+
 //==========================================================================
 //
 // FluidSynthMIDIDevice :: GetStats
@@ -420,7 +490,8 @@ extern "C" unsigned __stdcall GetSystemDirectoryA(char* lpBuffer, unsigned uSize
 
 void Fluid_SetupConfig(const char* patches, std::vector<std::string> &patch_paths, bool systemfallback)
 {
-	if (*patches == 0) patches = fluidConfig.fluid_patchset.c_str();
+	auto config = GetConfig();
+	if (*patches == 0) patches = config->fluid.fluid_patchset.c_str();
 
 	//Resolve the paths here, the renderer will only get a final list of file names.
 
@@ -521,3 +592,14 @@ MIDIDevice *CreateFluidSynthMIDIDevice(int samplerate, const char *Args)
 	Fluid_SetupConfig(Args, fluid_patchset, true);
 	return new FluidSynthMIDIDevice(samplerate, fluid_patchset);
 }
+
+//==========================================================================
+//
+// Fluid_SetSoundFontCacheSize
+//
+//==========================================================================
+
+void Fluid_SetSoundFontCacheSize(int megabytes)
+{
+	fluid_shared_sfloader_set_cache_size(megabytes);
+}
@@ -38,6 +38,7 @@
 #include <stdexcept>
 #include "zmsx/zmsx.hpp"
 #include "mididevice.h"
+#include "zmsx/trace.h"
 #include "zmsx/mus2midi.h"
 
 #ifdef HAVE_OPL
@@ -56,18 +57,17 @@
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
-OPLConfig oplConfig;
-
 // OPL implementation of a MIDI output device -------------------------------
 
 class OPLMIDIDevice : public SoftSynthMIDIDevice, protected OPLmusicBlock
 {
 public:
-	OPLMIDIDevice(int core);
+	OPLMIDIDevice(int core, const OPLConfig &oplConfig);
 	int OpenRenderer() override;
 	void Close() override;
 	int GetTechnology() const override;
 	std::string GetStats() override;
+	int GetActiveVoices() const override;
 
 protected:
 	void CalcTickRate() override;
@@ -90,11 +90,11 @@ protected:
 //
 //==========================================================================
 
-OPLMIDIDevice::OPLMIDIDevice(int core)
+OPLMIDIDevice::OPLMIDIDevice(int core, const OPLConfig &oplConfig)
 	: SoftSynthMIDIDevice((int)OPL_SAMPLE_RATE), OPLmusicBlock(core, oplConfig.numchips)
 {
 	FullPan = oplConfig.fullpan;
-	memcpy(OPLinstruments, oplConfig.OPLinstruments, sizeof(OPLinstruments));
+	memcpy(OPLinstruments, oplConfig.OPLinstruments->data(), sizeof(OPLinstruments));
 	StreamBlockSize = 14;
 }
 
@@ -284,7 +284,31 @@ void OPLMIDIDevice::ComputeOutput(float *buffer, int len)
 
 bool OPLMIDIDevice::ServiceStream(void *buff, int numbytes)
 {
-	return OPLmusicBlock::ServiceStream(buff, numbytes);
+	ZMSX_TRACE_ZONE("OPLMIDIDevice::ServiceStream");
+	// The chips get updated in between the ticks, so all of it counts as synth time.
+	auto start = PerfCounters::Clock::now();
+	bool res = OPLmusicBlock::ServiceStream(buff, numbytes);
+	Work.SynthNs += std::chrono::duration_cast<std::chrono::nanoseconds>(PerfCounters::Clock::now() - start).count();
+	return res;
+}
+
+//==========================================================================
+//
+// OPLMIDIDevice :: GetActiveVoices
+//
+//==========================================================================
+
+int OPLMIDIDevice::GetActiveVoices() const
+{
+	int count = 0;
+	for (uint32_t i = 0; i < io->NumChannels; ++i)
+	{
+		if (voices[i].index != ~0u)
+		{
+			count++;
+		}
+	}
+	return count;
 }
 
 //==========================================================================
@@ -323,10 +347,11 @@ std::string OPLMIDIDevice::GetStats()
 
 MIDIDevice* CreateOplMIDIDevice(const char *Args)
 {
-	if (!oplConfig.genmidiset) throw std::runtime_error("Cannot play OPL without GENMIDI data");
-	int core = oplConfig.core;
+	auto config = GetConfig();
+	if (!config->opl.genmidiset) throw std::runtime_error("Cannot play OPL without GENMIDI data");
+	int core = config->opl.core;
 	if (Args != NULL && *Args >= '0' && *Args < '4') core = *Args - '0';
-	return new OPLMIDIDevice(core);
+	return new OPLMIDIDevice(core, config->opl);
 }
 
 #else
@@ -34,6 +34,7 @@
 
 // HEADER FILES ------------------------------------------------------------
 
+#include <algorithm>
 #include <stdexcept>
 #include "mididevice.h"
 #include "zmsx/zmsx.hpp"
@@ -41,8 +42,6 @@
 #ifdef HAVE_OPN
 #include "opnmidi.h"
 
-OpnConfig opnConfig;
-
 class OPNMIDIDevice : public SoftSynthMIDIDevice
 {
 	struct OPN2_MIDIPlayer *Renderer;
@@ -53,6 +52,7 @@ public:
 
 	int OpenRenderer() override;
 	int GetDeviceType() const override { return zmsx_mdev_opn; }
+	void ChangeSettingInt(const char *setting, int value) override;
 
 protected:
 	void HandleEvent(int status, int parm1, int parm2) override;
@@ -61,6 +61,8 @@ protected:
 
 private:
 	int LoadCustomBank(const OpnConfig *config);
+
+	MIDIHeldNotes HeldNotes;
 };
 
 
@@ -91,11 +93,11 @@ OPNMIDIDevice::OPNMIDIDevice(const OpnConfig *config)
 	{
 		if (!LoadCustomBank(config))
 		{
-			if(config->default_bank.size() == 0)
+			if(config->default_bank == nullptr || config->default_bank->size() == 0)
 			{
 				opn2_openBankData(Renderer, xg_default, sizeof(xg_default));
 			}
-			else opn2_openBankData(Renderer, config->default_bank.data(), (long)config->default_bank.size());
+			else opn2_openBankData(Renderer, config->default_bank->data(), (long)config->default_bank->size());
 		}
 
 		opn2_switchEmulator(Renderer, (int)config->opn_emulator_id);
@@ -155,9 +157,39 @@ int OPNMIDIDevice::LoadCustomBank(const OpnConfig *config)
 int OPNMIDIDevice::OpenRenderer()
 {
 	opn2_rt_resetState(Renderer);
+	HeldNotes.Clear();
 	return 0;
 }
 
+//==========================================================================
+//
+// OPNMIDIDevice :: ChangeSettingInt
+//
+// Switching the emulator or the number of chips resets the chips, which
+// silences everything that is playing, so the held keys get struck again.
+//
+//==========================================================================
+
+void OPNMIDIDevice::ChangeSettingInt(const char *setting, int value)
+{
+	int res;
+	// The library keeps the count even when it refuses it, so it only gets
+	// counts the config setter lets through.
+	if (!strcmp(setting, "opn.numchips")) res = opn2_setNumChips(Renderer, std::clamp(value, 1, 100));
+	else if (!strcmp(setting, "opn.emulator")) res = opn2_switchEmulator(Renderer, value);
+	else return;
+
+	if (res < 0)
+	{
+		ZMusic_Printf(zmsx_msg_error, "%s: %s\n", setting, opn2_errorInfo(Renderer));
+		return;
+	}
+	HeldNotes.Restrike([=](int chan, int key, int velocity)
+	{
+		opn2_rt_noteOn(Renderer, chan, key, velocity);
+	});
+}
+
 //==========================================================================
 //
 // OPNMIDIDevice :: HandleEvent
@@ -169,6 +201,7 @@ void OPNMIDIDevice::HandleEvent(int status, int parm1, int parm2)
 	int command = status & 0xF0;
 	int chan	= status & 0x0F;
 
+	HeldNotes.HandleEvent(status, parm1, parm2);
 	switch (command)
 	{
 	case ME_NOTEON:
@@ -240,9 +273,9 @@ void OPNMIDIDevice::ComputeOutput(float *buffer, int len)
 
 MIDIDevice *CreateOPNMIDIDevice(const char *Args)
 {
-	OpnConfig config = opnConfig;
+	OpnConfig config = GetConfig()->opn;
 
-	const char* bank = Args && *Args ? Args : opnConfig.opn_use_custom_bank ? opnConfig.opn_custom_bank.c_str() : nullptr;
+	const char* bank = Args && *Args ? Args : config.opn_use_custom_bank ? config.opn_custom_bank.c_str() : nullptr;
 	if (bank && *bank)
 	{
 		const char* info;
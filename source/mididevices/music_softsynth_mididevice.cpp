@@ -38,6 +38,7 @@
 #include <algorithm>
 #include <assert.h>
 #include "mididevice.h"
+#include "zmsx/trace.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -111,11 +112,22 @@ ZMSXSoundStreamInfoEx SoftSynthMIDIDevice::GetStreamInfoEx() const
 
 int SoftSynthMIDIDevice::Open()
 {
+	// The device may have played another song before.
+	Events = NULL;
+	Position = 0;
+	NextTickIn = 0;
+	PullSamples = SampleRate / StreamBlockSize;
+	Work = {};
 	Tempo = 500000;
 	Division = 100;
 	CalcTickRate();
 	isOpen = true;
-	return OpenRenderer();
+	int res = OpenRenderer();
+	if (res == 0)
+	{
+		RenderQuantum = std::max({ 1, GetConfig()->misc.snd_midiblocksize, GetRenderQuantum() });
+	}
+	return res;
 }
 
 //==========================================================================
@@ -257,6 +269,72 @@ int SoftSynthMIDIDevice::StreamOut(MidiHeader *header)
 	return 0;
 }
 
+//==========================================================================
+//
+// SoftSynthMIDIDevice :: FlushStream
+//
+// Only for the player thread, like StreamOut.
+//
+//==========================================================================
+
+bool SoftSynthMIDIDevice::FlushStream()
+{
+	Events = NULL;
+	Position = 0;
+	if (Sequencer != NULL)
+	{ // Pull from the new position right away.
+		NextTickIn = 0;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// SoftSynthMIDIDevice :: SetSequencer
+//
+// From here on PlayTick gets its events from the sequencer, and StreamOut
+// must not be used anymore. Passing NULL goes back to StreamOut.
+//
+//==========================================================================
+
+bool SoftSynthMIDIDevice::SetSequencer(MIDISequencer *sequencer)
+{
+	Sequencer = sequencer;
+	Events = NULL;
+	Position = 0;
+	NextTickIn = 0;
+	return true;
+}
+
+//==========================================================================
+//
+// SoftSynthMIDIDevice :: PullEvents
+//
+// Gets the events up to the end of the block being rendered from the
+// sequencer. Returns false if there are none left.
+//
+//==========================================================================
+
+bool SoftSynthMIDIDevice::PullEvents()
+{
+	ZMSX_TRACE_ZONE("MIDISequencer::PullEvents");
+	uint32_t max_time = uint32_t(int64_t(std::max(PullSamples, 0)) * 1000000 / SampleRate);
+	// The final event is for a NOP to hold the delay from the last event.
+	uint32_t *end = Sequencer->PullEvents(PullBuffer, PullBuffer + (MAX_MIDI_EVENTS - 1) * 3, max_time);
+
+	Position = 0;
+	if (end == PullBuffer)
+	{
+		Events = NULL;
+		return false;
+	}
+	PulledEvents.lpData = (uint8_t *)PullBuffer;
+	PulledEvents.dwBufferLength = PulledEvents.dwBytesRecorded = uint32_t((uint8_t *)end - PulledEvents.lpData);
+	PulledEvents.lpNext = NULL;
+	Events = &PulledEvents;
+	return true;
+}
+
 //==========================================================================
 //
 // SoftSynthMIDIDevice :: Pause
@@ -280,8 +358,18 @@ bool SoftSynthMIDIDevice::Pause(bool paused)
 
 int SoftSynthMIDIDevice::PlayTick()
 {
+	ZMSX_TRACE_ZONE("SoftSynthMIDIDevice::PlayTick");
 	uint32_t delay = 0;
 
+	if (Events == NULL && Sequencer != NULL)
+	{ // Starting out, or the stream was flushed.
+		if (!PullEvents())
+		{
+			return int(Division);
+		}
+		delay = PullBuffer[0];
+	}
+
 	while (delay == 0 && Events != NULL)
 	{
 		uint32_t *event = (uint32_t *)(Events->lpData + Position);
@@ -292,6 +380,7 @@ int SoftSynthMIDIDevice::PlayTick()
 		else if (MEVENT_EVENTTYPE(event[2]) == MEVENT_LONGMSG)
 		{
 			HandleLongEvent((uint8_t *)&event[3], MEVENT_EVENTPARM(event[2]));
+			Work.Events++;
 		}
 		else if (MEVENT_EVENTTYPE(event[2]) == 0)
 		{ // Short MIDI event
@@ -299,6 +388,7 @@ int SoftSynthMIDIDevice::PlayTick()
 			int parm1 = (event[2] >> 8) & 0x7f;
 			int parm2 = (event[2] >> 16) & 0x7f;
 			HandleEvent(status, parm1, parm2);
+			Work.Events++;
 
 #if 0
 			if (synth_watch)
@@ -338,12 +428,19 @@ int SoftSynthMIDIDevice::PlayTick()
 		// Did we use up this buffer?
 		if (Position >= Events->dwBytesRecorded)
 		{
-			Events = Events->lpNext;
-			Position = 0;
-
-			if (Callback != NULL)
+			if (Sequencer != NULL)
 			{
-				Callback(CallbackData);
+				PullEvents();
+			}
+			else
+			{
+				Events = Events->lpNext;
+				Position = 0;
+
+				if (Callback != NULL)
+				{
+					Callback(CallbackData);
+				}
 			}
 		}
 
@@ -358,6 +455,22 @@ int SoftSynthMIDIDevice::PlayTick()
 	return delay;
 }
 
+//==========================================================================
+//
+// SoftSynthMIDIDevice :: TimedComputeOutput
+//
+// Keeps track of the time spent in the synth for the perf counters.
+//
+//==========================================================================
+
+void SoftSynthMIDIDevice::TimedComputeOutput(float *buffer, int len)
+{
+	ZMSX_TRACE_ZONE("SoftSynthMIDIDevice::ComputeOutput");
+	auto start = PerfCounters::Clock::now();
+	ComputeOutput(buffer, len);
+	Work.SynthNs += std::chrono::duration_cast<std::chrono::nanoseconds>(PerfCounters::Clock::now() - start).count();
+}
+
 //==========================================================================
 //
 // SoftSynthMIDIDevice :: ServiceStream
@@ -374,41 +487,34 @@ bool SoftSynthMIDIDevice::ServiceStream (void *buff, int numbytes)
 	samples1 = samples;
 	memset(buff, 0, numbytes);
 
-	while (Events != NULL && numsamples > 0)
+	// A sequencer is asked for more events by PlayTick, even if it has none
+	// at the moment because the stream was just flushed.
+	while ((Events != NULL || Sequencer != NULL) && numsamples > 0)
 	{
-		double ticky = NextTickIn;
-		int tick_in = int(NextTickIn);
-		int samplesleft = std::min(numsamples, tick_in);
-
-		if (samplesleft > 0)
-		{
-			ComputeOutput(samples1, samplesleft);
-			assert(NextTickIn == ticky);
-			NextTickIn -= samplesleft;
-			assert(NextTickIn >= 0);
-			numsamples -= samplesleft;
-			samples1 += samplesleft * 2;
-		}
-
-		if (NextTickIn < 1)
+		// Play the ticks that are due before the end of the block first,
+		// then render up to the block in which the next tick falls. Without
+		// a render quantum that is the next tick itself, so every event gets
+		// played at its exact sample.
+		int block = std::min(numsamples, RenderQuantum);
+		while (NextTickIn < block)
 		{
+			PullSamples = numsamples;
 			int next = PlayTick();
 			assert(next >= 0);
 			if (next == 0)
 			{ // end of song
-				if (numsamples > 0)
-				{
-					ComputeOutput(samples1, numsamples);
-				}
-				res = false;
-				break;
-			}
-			else
-			{
-				NextTickIn += SamplesPerTick * next;
-				assert(NextTickIn >= 0);
+				TimedComputeOutput(samples1, numsamples);
+				return false;
 			}
+			NextTickIn += SamplesPerTick * next;
+			assert(NextTickIn >= 0);
 		}
+		block = std::min(numsamples, std::max(block, int(NextTickIn) / RenderQuantum * RenderQuantum));
+
+		TimedComputeOutput(samples1, block);
+		NextTickIn -= block;
+		numsamples -= block;
+		samples1 += block * 2;
 	}
 
 	if (Events == NULL)
@@ -60,7 +60,7 @@
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
-GUSConfig gusConfig;
+GUSInstrumentCache gusCache;
 
 //==========================================================================
 //
@@ -72,17 +72,19 @@ namespace Timidity { struct Renderer; }
 
 class TimidityMIDIDevice : public SoftSynthMIDIDevice
 {
-	void LoadInstruments();
+	void LoadInstruments(const GUSConfig &gusConfig);
 public:
-	TimidityMIDIDevice(int samplerate);
+	TimidityMIDIDevice(int samplerate, const GUSConfig &gusConfig);
 	~TimidityMIDIDevice();
 
 	int OpenRenderer() override;
 	void PrecacheInstruments(const uint16_t *instruments, int count) override;
 	int GetDeviceType() const override { return zmsx_mdev_gus; }
+	int GetActiveVoices() const override;
 
 protected:
 	Timidity::Renderer *Renderer;
+	std::shared_ptr<Timidity::Instruments> instruments;
 
 	void HandleEvent(int status, int parm1, int parm2) override;
 	void HandleLongEvent(const uint8_t *data, int len) override;
@@ -93,9 +95,9 @@ protected:
 // CODE --------------------------------------------------------------------
 
 
-void TimidityMIDIDevice::LoadInstruments()
+void TimidityMIDIDevice::LoadInstruments(const GUSConfig &gusConfig)
 {
-	if (gusConfig.reader)
+	if (gusCache.reader)
 	{
 		// Check if we got some GUS data before using it.
 		std::string ultradir;
@@ -105,44 +107,45 @@ void TimidityMIDIDevice::LoadInstruments()
 		if (ultradir.length())
 		{
 			ultradir += "/midi";
-			gusConfig.reader->add_search_path(ultradir.c_str());
+			gusCache.reader->add_search_path(ultradir.c_str());
 		}
 		// Load DMXGUS lump and patches from gus_patchdir
-		if (gusConfig.gus_patchdir.length() != 0) gusConfig.reader->add_search_path(gusConfig.gus_patchdir.c_str());
+		if (gusConfig.gus_patchdir.length() != 0) gusCache.reader->add_search_path(gusConfig.gus_patchdir.c_str());
 
-		gusConfig.instruments.reset(new Timidity::Instruments(gusConfig.reader));
-		gusConfig.loadedConfig = gusConfig.readerName;
+		gusCache.instruments.reset(new Timidity::Instruments(gusCache.reader));
+		gusCache.loadedConfig = gusCache.readerName;
 	}
 
-	if (gusConfig.instruments == nullptr)
+	if (gusCache.instruments == nullptr)
 	{
 		throw std::runtime_error("No instruments set for GUS device");
 	}
 
-	if (gusConfig.gus_dmxgus && gusConfig.dmxgus.size())
+	if (gusConfig.gus_dmxgus && gusConfig.dmxgus && gusConfig.dmxgus->size())
 	{
-		bool success = gusConfig.instruments->LoadDMXGUS(gusConfig.gus_memsize, (const char*)gusConfig.dmxgus.data(), gusConfig.dmxgus.size()) >= 0;
-		gusConfig.reader = nullptr;
+		bool success = gusCache.instruments->LoadDMXGUS(gusConfig.gus_memsize, (const char*)gusConfig.dmxgus->data(), gusConfig.dmxgus->size()) >= 0;
+		gusCache.reader = nullptr;
 
 		if (!success)
 		{
-			gusConfig.instruments.reset();
-			gusConfig.loadedConfig = "";
+			gusCache.instruments.reset();
+			gusCache.loadedConfig = "";
 			throw std::runtime_error("Unable to initialize DMXGUS for GUS MIDI device");
 		}
 	}
 	else
 	{
-		bool err = gusConfig.instruments->LoadConfig() < 0;
-		gusConfig.reader = nullptr;
+		bool err = gusCache.instruments->LoadConfig() < 0;
+		gusCache.reader = nullptr;
 
 		if (err)
 		{
-			gusConfig.instruments.reset();
-			gusConfig.loadedConfig = "";
+			gusCache.instruments.reset();
+			gusCache.loadedConfig = "";
 			throw std::runtime_error("Unable to initialize instruments for GUS MIDI device");
 		}
 	}
+	instruments = gusCache.instruments;
 }
 
 //==========================================================================
@@ -151,11 +154,11 @@ void TimidityMIDIDevice::LoadInstruments()
 //
 //==========================================================================
 
-TimidityMIDIDevice::TimidityMIDIDevice(int samplerate)
+TimidityMIDIDevice::TimidityMIDIDevice(int samplerate, const GUSConfig &gusConfig)
 	: SoftSynthMIDIDevice(samplerate, 11025, 65535)
 {
-	LoadInstruments();
-	Renderer = new Timidity::Renderer((float)SampleRate, gusConfig.midi_voices, gusConfig.instruments.get());
+	LoadInstruments(gusConfig);
+	Renderer = new Timidity::Renderer((float)SampleRate, gusConfig.midi_voices, instruments.get());
 }
 
 //==========================================================================
@@ -241,6 +244,25 @@ void TimidityMIDIDevice::ComputeOutput(float *buffer, int len)
 	for (int i = 0; i < len * 2; i++) buffer[i] *= 0.7f;
 }
 
+//==========================================================================
+//
+// TimidityMIDIDevice :: GetActiveVoices
+//
+//==========================================================================
+
+int TimidityMIDIDevice::GetActiveVoices() const
+{
+	int count = 0;
+	for (int i = 0; i < Renderer->voices; ++i)
+	{
+		if (Renderer->voice[i].status & Timidity::VOICE_RUNNING)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
 //==========================================================================
 //
 //
@@ -254,11 +276,11 @@ void TimidityMIDIDevice::ComputeOutput(float *buffer, int len)
 //
 //==========================================================================
 
-bool GUS_SetupConfig(const char* args)
+bool GUS_SetupConfig(const GUSConfig &gusConfig, const char* args)
 {
 	if (*args == 0) args = gusConfig.gus_config.c_str();
 	if (gusConfig.gus_dmxgus && *args == 0) args = "DMXGUS";
-	//if (stricmp(gusConfig.loadedConfig.c_str(), args) == 0) return false; // aleady loaded
+	//if (stricmp(gusCache.loadedConfig.c_str(), args) == 0) return false; // aleady loaded
 
 	MusicIO::SoundFontReaderInterface* reader = MusicIO::ClientOpenSoundFont(args, zmsx_sf_gus);
 	if (!reader && MusicIO::fileExists(args))
@@ -287,16 +309,17 @@ bool GUS_SetupConfig(const char* args)
 		snprintf(error, 80, "GUS: %s: Unable to load sound font\n", args);
 		throw std::runtime_error(error);
 	}
-	gusConfig.reader = reader;
-	gusConfig.readerName = args;
+	gusCache.reader = reader;
+	gusCache.readerName = args;
 	return true;
 }
 
 #
 MIDIDevice* CreateTimidityMIDIDevice(const char* Args, int samplerate)
 {
-	GUS_SetupConfig(Args);
-	return new TimidityMIDIDevice(samplerate);
+	auto config = GetConfig();
+	GUS_SetupConfig(config->gus, Args);
+	return new TimidityMIDIDevice(samplerate, config->gus);
 }
 
 #else
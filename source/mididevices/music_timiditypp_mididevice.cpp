@@ -43,7 +43,7 @@
 #include "timiditypp/playmidi.h"
 
 
-TimidityConfig timidityConfig;
+TimidityInstrumentCache timidityCache;
 
 class TimidityPPMIDIDevice : public SoftSynthMIDIDevice
 {
@@ -56,6 +56,9 @@ public:
 	void PrecacheInstruments(const uint16_t *instruments, int count) override;
 	//std::string GetStats();
 	int GetDeviceType() const override { return zmsx_mdev_timidity; }
+	int GetActiveVoices() const override;
+	bool ServiceStream(void *buff, int numbytes) override;
+	void PrepareRealtime() override;
 
 	double test[3] = { 0, 0, 0 };
 
@@ -76,25 +79,25 @@ protected:
 
 void TimidityPPMIDIDevice::LoadInstruments()
 {
-	if (timidityConfig.reader)
+	if (timidityCache.reader)
 	{
-		timidityConfig.loadedConfig = timidityConfig.readerName;
-		timidityConfig.instruments.reset(new TimidityPlus::Instruments());
-		bool success = timidityConfig.instruments->load(timidityConfig.reader);
-		timidityConfig.reader = nullptr;
+		timidityCache.loadedConfig = timidityCache.readerName;
+		timidityCache.instruments.reset(new TimidityPlus::Instruments());
+		bool success = timidityCache.instruments->load(timidityCache.reader);
+		timidityCache.reader = nullptr;
 
 		if (!success)
 		{
-			timidityConfig.instruments.reset();
-			timidityConfig.loadedConfig = "";
+			timidityCache.instruments.reset();
+			timidityCache.loadedConfig = "";
 			throw std::runtime_error("Unable to initialize instruments for Timidity++ MIDI device");
 		}
 	}
-	else if (timidityConfig.instruments == nullptr)
+	else if (timidityCache.instruments == nullptr)
 	{
 		throw std::runtime_error("No instruments set for Timidity++ device");
 	}
-	instruments = timidityConfig.instruments;
+	instruments = timidityCache.instruments;
 }
 
 //==========================================================================
@@ -134,6 +137,8 @@ TimidityPPMIDIDevice::~TimidityPPMIDIDevice ()
 
 int TimidityPPMIDIDevice::OpenRenderer()
 {
+	// Another device may have changed the global rate since this one was created.
+	TimidityPlus::set_playback_rate(SampleRate);
 	Renderer->playmidi_stream_init();
 	return 0;
 }
@@ -191,16 +196,72 @@ void TimidityPPMIDIDevice::ComputeOutput(float *buffer, int len)
 		Renderer->compute_data(buffer, len);
 }
 
+//==========================================================================
+//
+// TimidityPPMIDIDevice :: GetActiveVoices
+//
+//==========================================================================
+
+int TimidityPPMIDIDevice::GetActiveVoices() const
+{
+	if (Renderer == nullptr)
+		return -1;
+
+	int count = 0;
+	for (int i = 0; i < TimidityPlus::max_voices; ++i)
+	{
+		if (!(Renderer->voice[i].status & VOICE_FREE))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+//==========================================================================
+//
+// TimidityPPMIDIDevice :: ServiceStream
+//
+// Timidity++ keeps global state and shares its instruments between all
+// players, so only one of them may run at a time, even for songs that are
+// rendered on different threads. Timidity++ songs are therefore excluded
+// from parallel rendering: the mixer renders them one after another in a
+// single job, and everywhere else they wait for each other here.
+//
+//==========================================================================
+
+bool TimidityPPMIDIDevice::ServiceStream(void *buff, int numbytes)
+{
+	std::lock_guard<FCriticalSection> lock(TimidityPlus::ConfigMutex);
+	return SoftSynthMIDIDevice::ServiceStream(buff, numbytes);
+}
+
+//==========================================================================
+//
+// TimidityPPMIDIDevice :: PrepareRealtime
+//
+// This only takes care of the mixing buffers. ServiceStream still locks,
+// and instruments still get loaded when they are first played, so
+// Timidity++ songs are not realtime safe.
+//
+//==========================================================================
+
+void TimidityPPMIDIDevice::PrepareRealtime()
+{
+	if (Renderer != nullptr)
+		Renderer->preallocate_buffers();
+}
+
 //==========================================================================
 //
 //
 //
 //==========================================================================
 
-bool Timidity_SetupConfig(const char* args)
+bool Timidity_SetupConfig(const TimidityConfig &timidityConfig, const char* args)
 {
 	if (*args == 0) args = timidityConfig.timidity_config.c_str();
-	if (stricmp(timidityConfig.loadedConfig.c_str(), args) == 0) return false; // aleady loaded
+	if (stricmp(timidityCache.loadedConfig.c_str(), args) == 0) return false; // aleady loaded
 
 	MusicIO::SoundFontReaderInterface* reader = MusicIO::ClientOpenSoundFont(args, zmsx_sf_gus | zmsx_sf_sf2);
 	if (!reader && MusicIO::fileExists(args))
@@ -224,14 +285,14 @@ bool Timidity_SetupConfig(const char* args)
 		snprintf(error, 80, "Timidity++: %s: Unable to load sound font\n", args);
 		throw std::runtime_error(error);
 	}
-	timidityConfig.reader = reader;
-	timidityConfig.readerName = args;
+	timidityCache.reader = reader;
+	timidityCache.readerName = args;
 	return true;
 }
 
 MIDIDevice *CreateTimidityPPMIDIDevice(const char *Args, int samplerate)
 {
-	Timidity_SetupConfig(Args);
+	Timidity_SetupConfig(GetConfig()->timidity, Args);
 	return new TimidityPPMIDIDevice(samplerate);
 }
 
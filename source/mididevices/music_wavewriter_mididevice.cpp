@@ -36,34 +36,15 @@
 // HEADER FILES ------------------------------------------------------------
 
 #include "mididevice.h"
-#include "zmsx/m_swap.h"
 #include "fileio.h"
 #include <stdexcept>
 #include <errno.h>
+#include <string.h>
 
 // MACROS ------------------------------------------------------------------
 
 // TYPES -------------------------------------------------------------------
 
-struct FmtChunk
-{
-	//uint32_t ChunkID;
-	uint32_t ChunkLen;
-	uint16_t  FormatTag;
-	uint16_t  Channels;
-	uint32_t SamplesPerSec;
-	uint32_t AvgBytesPerSec;
-	uint16_t  BlockAlign;
-	uint16_t  BitsPerSample;
-	uint16_t  ExtensionSize;
-	uint16_t  ValidBitsPerSample;
-	uint32_t ChannelMask;
-	uint32_t SubFormatA;
-	uint16_t  SubFormatB;
-	uint16_t  SubFormatC;
-	uint8_t  SubFormatD[8];
-};
-
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 
 // PUBLIC FUNCTION PROTOTYPES ----------------------------------------------
@@ -87,45 +68,11 @@ struct FmtChunk
 MIDIWaveWriter::MIDIWaveWriter(const char *filename, SoftSynthMIDIDevice *playdevice)
 	: SoftSynthMIDIDevice(playdevice->GetSampleRate())
 {
-	File = MusicIO::utf8_fopen(filename, "wb");
 	playDevice = playdevice;
-	if (File != nullptr)
-	{ // Write wave header
-		FmtChunk fmt;
-
-		if (fwrite("RIFF\0\0\0\0WAVEfmt ", 1, 16, File) != 16) goto fail;
-
-		playDevice->CalcTickRate();
-		fmt.ChunkLen = LittleLong(uint32_t(sizeof(fmt) - 4));
-		fmt.FormatTag = LittleShort((uint16_t)0xFFFE);		// WAVE_FORMAT_EXTENSIBLE
-		fmt.Channels = LittleShort((uint16_t)2);
-		fmt.SamplesPerSec = LittleLong(SampleRate);
-		fmt.AvgBytesPerSec = LittleLong(SampleRate * 8);
-		fmt.BlockAlign = LittleShort((uint16_t)8);
-		fmt.BitsPerSample = LittleShort((uint16_t)32);
-		fmt.ExtensionSize = LittleShort((uint16_t)(2 + 4 + 16));
-		fmt.ValidBitsPerSample = LittleShort((uint16_t)32);
-		fmt.ChannelMask = LittleLong(3);
-		fmt.SubFormatA = LittleLong(0x00000003);	// Set subformat to KSDATAFORMAT_SUBTYPE_IEEE_FLOAT
-		fmt.SubFormatB = 0x0000;
-		fmt.SubFormatC = LittleShort((uint16_t)0x0010);
-		fmt.SubFormatD[0] = 0x80;
-		fmt.SubFormatD[1] = 0x00;
-		fmt.SubFormatD[2] = 0x00;
-		fmt.SubFormatD[3] = 0xaa;
-		fmt.SubFormatD[4] = 0x00;
-		fmt.SubFormatD[5] = 0x38;
-		fmt.SubFormatD[6] = 0x9b;
-		fmt.SubFormatD[7] = 0x71;
-		if (sizeof(fmt) != fwrite(&fmt, 1, sizeof(fmt), File)) goto fail;
-
-		if (fwrite("data\0\0\0\0", 1, 8, File) != 8) goto fail;
-
-		return;
-	fail:
+	playDevice->CalcTickRate();
+	if (!Writer.Open(filename, SampleRate, zmsx_chancfg_stereo, zmsx_sample_float32))
+	{
 		char buffer[80];
-		fclose(File);
-		File = nullptr;
 		snprintf(buffer, 80, "Failed to write %s: %s\n", filename, strerror(errno));
 		throw std::runtime_error(buffer);
 	}
@@ -133,39 +80,13 @@ MIDIWaveWriter::MIDIWaveWriter(const char *filename, SoftSynthMIDIDevice *playde
 
 //==========================================================================
 //
-// MIDIWaveWriter Destructor
+// MIDIWaveWriter :: CloseFile
 //
 //==========================================================================
 
 bool MIDIWaveWriter::CloseFile()
 {
-	if (File != nullptr)
-	{
-		auto pos = ftell(File);
-		uint32_t size;
-
-		// data chunk size
-		size = LittleLong(uint32_t(pos - 8));
-		if (0 == fseek(File, 4, SEEK_SET))
-		{
-			if (4 == fwrite(&size, 1, 4, File))
-			{
-				size = LittleLong(uint32_t(pos - 12 - sizeof(FmtChunk) - 8));
-				if (0 == fseek(File, 4 + sizeof(FmtChunk) + 8, SEEK_CUR))
-				{
-					if (4 == fwrite(&size, 1, 4, File))
-					{
-						fclose(File);
-						File = nullptr;
-						return true;
-					}
-				}
-			}
-		}
-		fclose(File);
-		File = nullptr;
-	}
-	return false;
+	return Writer.Close();
 }
 
 //==========================================================================
@@ -180,10 +101,8 @@ int MIDIWaveWriter::Resume()
 
 	while (ServiceStream(writebuffer, sizeof(writebuffer)))
 	{
-		if (fwrite(writebuffer, 1, sizeof(writebuffer), File) != sizeof(writebuffer))
+		if (!Writer.Write(writebuffer, sizeof(writebuffer)))
 		{
-			fclose(File);
-			File = nullptr;
 			char buffer[80];
 			snprintf(buffer, 80, "Could not write entire wave file: %s\n", strerror(errno));
 			throw std::runtime_error(buffer);
@@ -46,19 +46,20 @@
 
 // TYPES -------------------------------------------------------------------
 
-WildMidiConfig wildMidiConfig;
+WildMidiInstrumentCache wildMidiCache;
 
 // WildMidi implementation of a MIDI device ---------------------------------
 
 class WildMIDIDevice : public SoftSynthMIDIDevice
 {
 public:
-	WildMIDIDevice(int samplerate);
+	WildMIDIDevice(int samplerate, const WildMidiConfig &wildMidiConfig);
 	~WildMIDIDevice();
 
 	int OpenRenderer() override;
 	void PrecacheInstruments(const uint16_t *instruments, int count) override;
 	std::string GetStats() override;
+	int GetActiveVoices() const override;
 	int GetDeviceType() const override { return zmsx_mdev_wildmidi; }
 
 protected:
@@ -84,21 +85,21 @@ protected:
 
 void WildMIDIDevice::LoadInstruments()
 {
-	if (wildMidiConfig.reader)
+	if (wildMidiCache.reader)
 	{
-		wildMidiConfig.loadedConfig = wildMidiConfig.readerName;
-		wildMidiConfig.instruments.reset(new WildMidi::Instruments(wildMidiConfig.reader, SampleRate));
-		wildMidiConfig.reader = nullptr;
+		wildMidiCache.loadedConfig = wildMidiCache.readerName;
+		wildMidiCache.instruments.reset(new WildMidi::Instruments(wildMidiCache.reader, SampleRate));
+		wildMidiCache.reader = nullptr;
 	}
-	else if (wildMidiConfig.instruments == nullptr)
+	else if (wildMidiCache.instruments == nullptr)
 	{
 		throw std::runtime_error("No instruments set for WildMidi device");
 	}
-	instruments = wildMidiConfig.instruments;
+	instruments = wildMidiCache.instruments;
 	if (instruments->LoadConfig(nullptr) < 0)
 	{
-		wildMidiConfig.instruments.reset();
-		wildMidiConfig.loadedConfig = "";
+		wildMidiCache.instruments.reset();
+		wildMidiCache.loadedConfig = "";
 		throw std::runtime_error("Unable to initialize instruments for WildMidi device");
 	}
 }
@@ -109,7 +110,7 @@ void WildMIDIDevice::LoadInstruments()
 //
 //==========================================================================
 
-WildMIDIDevice::WildMIDIDevice(int samplerate)
+WildMIDIDevice::WildMIDIDevice(int samplerate, const WildMidiConfig &wildMidiConfig)
 	:SoftSynthMIDIDevice(samplerate, 11025, 65535)
 {
 	Renderer = NULL;
@@ -147,7 +148,14 @@ WildMIDIDevice::~WildMIDIDevice()
 
 int WildMIDIDevice::OpenRenderer()
 {
-	return 0;	// This one's a no-op
+	// Only matters if the device played a song before.
+	static const uint8_t gm_reset[] = { 0xf0, 0x7e, 0x7f, 0x09, 0x01, 0xf7 };
+	for (int chan = 0; chan < 16; ++chan)
+	{
+		Renderer->ShortEvent(0xB0 | chan, 120, 0);	// All sound off
+	}
+	Renderer->LongEvent(gm_reset, sizeof(gm_reset));
+	return 0;
 }
 
 //==========================================================================
@@ -203,6 +211,17 @@ void WildMIDIDevice::ComputeOutput(float *buffer, int len)
 	Renderer->ComputeOutput(buffer, len);
 }
 
+//==========================================================================
+//
+// WildMIDIDevice :: GetActiveVoices
+//
+//==========================================================================
+
+int WildMIDIDevice::GetActiveVoices() const
+{
+	return Renderer->GetVoiceCount();
+}
+
 //==========================================================================
 //
 // WildMIDIDevice :: GetStats
@@ -238,10 +257,10 @@ void WildMIDIDevice::ChangeSettingInt(const char *opt, int set)
 //
 //==========================================================================
 
-bool WildMidi_SetupConfig(const char* args)
+bool WildMidi_SetupConfig(const WildMidiConfig &wildMidiConfig, const char* args)
 {
 	if (*args == 0) args = wildMidiConfig.config.c_str();
-	if (stricmp(wildMidiConfig.loadedConfig.c_str(), args) == 0) return false; // aleady loaded
+	if (stricmp(wildMidiCache.loadedConfig.c_str(), args) == 0) return false; // aleady loaded
 
 	MusicIO::SoundFontReaderInterface* reader = MusicIO::ClientOpenSoundFont(args, zmsx_sf_gus);
 	if (!reader && MusicIO::fileExists(args))
@@ -256,8 +275,8 @@ bool WildMidi_SetupConfig(const char* args)
 		throw std::runtime_error(error);
 	}
 
-	wildMidiConfig.reader = reader;
-	wildMidiConfig.readerName = args;
+	wildMidiCache.reader = reader;
+	wildMidiCache.readerName = args;
 	return true;
 }
 
@@ -270,8 +289,9 @@ bool WildMidi_SetupConfig(const char* args)
 
 MIDIDevice *CreateWildMIDIDevice(const char *Args, int samplerate)
 {
-	WildMidi_SetupConfig(Args);
-	return new WildMIDIDevice(samplerate);
+	auto config = GetConfig();
+	WildMidi_SetupConfig(config->wildMidi, Args);
+	return new WildMIDIDevice(samplerate, config->wildMidi);
 }
 
 #else
@@ -688,7 +688,7 @@ static bool IgnoreMIDIVolume(UINT id)
 
 MIDIDevice *CreateWinMIDIDevice(int mididevice)
 {
-	return new WinMIDIDevice(mididevice, miscConfig.snd_midiprecache);
+	return new WinMIDIDevice(mididevice, GetConfig()->misc.snd_midiprecache);
 }
 #endif
 
@@ -71,7 +71,7 @@ void MIDISource::SetTempo(int new_tempo)
 // interpretation where 1 means to loop it once.
 //
 // If LoopLimit is 1, we limit all loops, since this pass over the song is
-// used to determine instruments for precaching.
+// used to compile the timeline.
 //
 // If LoopLimit is higher, we only limit infinite loops, since this song is
 // being exported.
@@ -86,6 +86,7 @@ int MIDISource::ClampLoopCount(int loopcount)
 	}
 	if (LoopLimit == 1)
 	{
+		if (loopcount != 1) LoopsClamped = true;
 		return 1;
 	}
 	if (loopcount == 0)
@@ -117,104 +118,103 @@ int MIDISource::VolumeControllerChange(int channel, int volume)
 //
 // MIDISource :: Precache
 //
-// Generates a list of instruments this song uses and passes them to the
-// MIDI device for precaching. The default implementation here pretends to
-// play the song and watches for program change events on normal channels
-// and note on events on channel 10.
+// Returns a list of instruments this song uses, for the MIDI device to
+// precache. The default implementation here returns what CompileTimeline
+// found while going through the song, so this only costs something for
+// the first device of a kind.
 //
 //==========================================================================
 
 std::vector<uint16_t> MIDISource::PrecacheData()
 {
-	uint32_t Events[2][MAX_MIDI_EVENTS*3];
-	uint8_t found_instruments[256] = { 0, };
-	uint8_t found_banks[256] = { 0, };
-	bool multiple_banks = false;
+	return GetTimeline().Instruments;
+}
 
-	LoopLimit = 1;
-	DoRestart();
-	found_banks[0] = true;		// Bank 0 is always used.
-	found_banks[128] = true;
+//==========================================================================
+//
+// MIDISource :: SimulationScope
+//
+//==========================================================================
 
-	// Simulate playback to pick out used instruments.
-	while (!CheckDone())
-	{
-		uint32_t *event_end = MakeEvents(Events[0], &Events[0][MAX_MIDI_EVENTS*3], 1000000*600);
-		for (uint32_t *event = Events[0]; event < event_end; )
-		{
-			if (MEVENT_EVENTTYPE(event[2]) == 0)
-			{
-				int command = (event[2] & 0x70);
-				int channel = (event[2] & 0x0f);
-				int data1 = (event[2] >> 8) & 0x7f;
-				int data2 = (event[2] >> 16) & 0x7f;
+MIDISource::SimulationScope::SimulationScope(MIDISource *source)
+	: Source(source), LoopLimit(source->LoopLimit), Exporting(source->Exporting),
+	  TempoCallback(std::move(source->TempoCallback))
+{
+	Source->LoopLimit = 1;
+	Source->Exporting = true;
+	Source->TempoCallback = [](int t) { return false; };
+}
 
-				if (channel != 9 && command == (MIDI_PRGMCHANGE & 0x70))
-				{
-					found_instruments[data1] = true;
-				}
-				else if (channel == 9 && command == (MIDI_PRGMCHANGE & 0x70) && data1 != 0)
-				{ // On a percussion channel, program change also serves as bank select.
-					multiple_banks = true;
-					found_banks[data1 | 128] = true;
-				}
-				else if (channel == 9 && command == (MIDI_NOTEON & 0x70) && data2 != 0)
-				{
-					found_instruments[data1 | 128] = true;
-				}
-				else if (command == (MIDI_CTRLCHANGE & 0x70) && data1 == 0 && data2 != 0)
-				{
-					multiple_banks = true;
-					if (channel == 9)
-					{
-						found_banks[data2 | 128] = true;
-					}
-					else
-					{
-						found_banks[data2] = true;
-					}
-				}
-			}
-			// Advance to next event
-			if (event[2] < 0x80000000)
-			{ // short message
-				event += 3;
-			}
-			else
-			{ // long message
-				event += 3 + ((MEVENT_EVENTPARM(event[2]) + 3) >> 2);
-			}
-		}
+MIDISource::SimulationScope::~SimulationScope()
+{
+	Source->LoopLimit = LoopLimit;
+	Source->Exporting = Exporting;
+	Source->TempoCallback = std::move(TempoCallback);
+}
+
+//==========================================================================
+//
+// MIDISource :: AnalyzeSong
+//
+// Finds the song's length, where it loops and its tempo changes from the
+// timeline. The result is kept for as long as the timeline.
+//
+// Only endless loops count. Without one, the whole song loops.
+//
+//==========================================================================
+
+const MIDISongInfo &MIDISource::AnalyzeSong()
+{
+	if (SongInfo != nullptr)
+	{
+		return *SongInfo;
 	}
-	DoRestart();
 
-	// Now pack everything into a contiguous region for the PrecacheInstruments call().
-	std::vector<uint16_t> packed;
+	auto &timeline = GetTimeline();
+	auto info = std::make_unique<MIDISongInfo>();
+	double time = 0, loopstart = -1, loopend = -1;
+	uint32_t tick = 0;
+	int tempo = InitialTempo;
+	info->TempoChanges.push_back({ 0, tempo });
 
-	for (int i = 0; i < 256; ++i)
+	for (size_t i = 0; i < timeline.Messages.size(); ++i)
 	{
-		if (found_instruments[i])
+		uint32_t message = timeline.Messages[i];
+		time += double(timeline.Ticks[i] - tick) * tempo / Division;
+		tick = timeline.Ticks[i];
+		if (MEVENT_EVENTTYPE(message) == MEVENT_TEMPO)
 		{
-			uint16_t packnum = (i & 127) | ((i & 128) << 7);
-			if (!multiple_banks)
+			tempo = MEVENT_EVENTPARM(message);
+			auto &last = info->TempoChanges.back();
+			if (last.time_ms == unsigned(time / 1000))
 			{
-				packed.push_back(packnum);
+				last.tempo = tempo;
 			}
-			else
-			{ // In order to avoid having to multiplex tracks in a type 1 file,
-				// precache every used instrument in every used bank, even if not
-				// all combinations are actually used.
-				for (int j = 0; j < 128; ++j)
-				{
-					if (found_banks[j + (i & 128)])
-					{
-						packed.push_back(packnum | (j << 7));
-					}
-				}
+			else if (last.tempo != tempo)
+			{
+				info->TempoChanges.push_back({ unsigned(time / 1000), tempo });
 			}
 		}
+		else if (message == ((MEVENT_NOP << 24) | MEVENT_NOP_LOOPBEGIN) && loopstart < 0)
+		{
+			loopstart = time;
+		}
+		else if (message == ((MEVENT_NOP << 24) | MEVENT_NOP_LOOPEND) && loopstart >= 0 && loopend < 0)
+		{
+			loopend = time;
+		}
+	}
+
+	info->Duration = int(time / 1000);
+	if (loopend < 0)
+	{
+		loopstart = 0;
+		loopend = time;
 	}
-	return packed;
+	info->LoopStart = int(loopstart / 1000);
+	info->LoopEnd = int(loopend / 1000);
+	SongInfo = std::move(info);
+	return *SongInfo;
 }
 
 //==========================================================================
@@ -275,9 +275,11 @@ static void WriteVarLen (std::vector<uint8_t> &file, uint32_t value)
 
 //==========================================================================
 //
-// MIDIStreamer :: CreateSMF
+// MIDISource :: CreateSMF
 //
-// Simulates playback to create a Standard MIDI File.
+// Simulates playback to create a Standard MIDI File. Unless the song's
+// loops have to be played more than once this just goes through the
+// timeline.
 //
 //==========================================================================
 
@@ -302,10 +304,9 @@ void MIDISource::CreateSMF(std::vector<uint8_t> &file, int looplimit)
 	uint8_t running_status = 255;
 
 	// Always create songs aimed at GM devices.
-	CheckCaps(zmsx_devcls_midiport);
-	LoopLimit = looplimit <= 0 ? EXPORT_LOOP_LIMIT : looplimit;
-	DoRestart();
-	StartPlayback(false, LoopLimit);
+	SetCaps(zmsx_devcls_midiport);
+	StartPlayback(false, looplimit <= 0 ? EXPORT_LOOP_LIMIT : looplimit);
+	RestartPlayback();
 
 	file.resize(sizeof(StaticMIDIhead));
 	memcpy(file.data(), StaticMIDIhead, sizeof(StaticMIDIhead));
@@ -315,9 +316,9 @@ void MIDISource::CreateSMF(std::vector<uint8_t> &file, int looplimit)
 	file[27] = InitialTempo >> 8;
 	file[28] = InitialTempo;
 
-	while (!CheckDone())
+	while (!CheckPlaybackDone())
 	{
-		uint32_t *event_end = MakeEvents(Events[0], &Events[0][MAX_MIDI_EVENTS*3], 1000000*600);
+		uint32_t *event_end = MakePlaybackEvents(Events[0], &Events[0][MAX_MIDI_EVENTS*3], 1000000*600);
 		for (uint32_t *event = Events[0]; event < event_end; )
 		{
 			delay += event[0];
@@ -472,9 +473,12 @@ DLL_EXPORT ZMSXMidiType zmsx_identify_midi_type(const uint32_t *id, int size)
 //
 // create a source based on MIDI file type
 //
+// If an owner is passed, the data is not copied but referenced for as long
+// as the source exists.
+//
 //==========================================================================
 
-DLL_EXPORT ZMSXMidiSource* zmsx_create_midi_source(const uint8_t *data, size_t length, ZMSXMidiType miditype)
+MIDISource *CreateMIDISource(const uint8_t *data, size_t length, ZMSXMidiType miditype, std::shared_ptr<void> owner)
 {
 	try
 	{
@@ -482,19 +486,19 @@ DLL_EXPORT ZMSXMidiSource* zmsx_create_midi_source(const uint8_t *data, size_t l
 		switch (miditype)
 		{
 		case zmsx_midi_mus:
-			source = new MUSSong2(data, length);
+			source = new MUSSong2(data, length, std::move(owner));
 			break;
 
 		case zmsx_midi_midi:
-			source = new MIDISong2(data, length);
+			source = new MIDISong2(data, length, std::move(owner));
 			break;
 
 		case zmsx_midi_hmi:
-			source = new HMISong(data, length);
+			source = new HMISong(data, length, std::move(owner));
 			break;
 
 		case zmsx_midi_xmi:
-			source = new XMISong(data, length);
+			source = new XMISong(data, length, std::move(owner));
 			break;
 
 		case zmsx_midi_mids:
@@ -514,3 +518,8 @@ DLL_EXPORT ZMSXMidiSource* zmsx_create_midi_source(const uint8_t *data, size_t l
 		return nullptr;
 	}
 }
+
+DLL_EXPORT ZMSXMidiSource* zmsx_create_midi_source(const uint8_t *data, size_t length, ZMSXMidiType miditype)
+{
+	return CreateMIDISource(data, length, miditype, nullptr);
+}
@@ -11,15 +11,104 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdint.h>
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <vector>
 #include "zmsx/mus2midi.h"
 #include "zmsx/mididefs.h"
+#include "zmsx/zmsx.hpp"
 
 extern char MIDI_EventLengths[7];
 extern char MIDI_CommonLengths[15];
 
 
+// The raw data a MIDI source is parsed from. Normally this is a private copy,
+// but it can also reference memory that belongs to someone else, which then
+// is kept alive through the owner for as long as the source exists.
+
+class MIDIData
+{
+public:
+	void Assign(const uint8_t *data, size_t len, std::shared_ptr<void> owner)
+	{
+		Owner = std::move(owner);
+		if (Owner != nullptr)
+		{
+			Ptr = data;
+		}
+		else
+		{
+			Copy.assign(data, data + len);
+			Ptr = Copy.data();
+		}
+		Len = len;
+	}
+
+	const uint8_t *data() const { return Ptr; }
+	size_t size() const { return Len; }
+	const uint8_t &operator[](size_t index) const { return Ptr[index]; }
+
+private:
+	std::vector<uint8_t> Copy;
+	std::shared_ptr<void> Owner;
+	const uint8_t *Ptr = nullptr;
+	size_t Len = 0;
+};
+
+// Event timeline ---------------------------------------------------------
+//
+// The song compiled into one flat list of events, with every loop played
+// once, so that playback, precaching, exporting, seeking and AnalyzeSong
+// all just scan it instead of decoding the song's own format again. All
+// arrays but the checkpoints and the pool are indexed by event.
+
+struct MIDIChannelState
+{
+	uint8_t Controllers[128];	// 0xff if not set
+	uint8_t Program;			// 0xff if not set
+	uint8_t Pressure;			// 0xff if not set
+	uint16_t PitchBend;
+	uint16_t Rpn[3];			// Pitch bend range, fine and coarse tuning, 0xffff if not set
+	uint16_t SelectedRpn;		// For data entry, 0x3fff if none or an NRPN is selected
+
+	void Reset();
+	void ResetControllers();
+};
+
+// What every channel has been set to every so many events, so that a seek
+// only needs to look at the events after the closest one.
+
+struct MIDISeekCheckpoint
+{
+	size_t Offset;			// Of the next event
+	double Time;			// In microseconds, before the next event's delay
+	int Tempo;
+	MIDIChannelState Channels[16];
+};
+
+struct MIDITimeline
+{
+	std::vector<uint32_t> Ticks;		// Absolute time
+	std::vector<uint32_t> Messages;		// dwEvent as MakeEvents writes it
+	std::vector<uint32_t> SysexOffsets;	// Into SysexPool, for long messages
+	std::vector<uint32_t> SysexPool;	// Long message data, padded like in a stream buffer
+	std::vector<MIDISeekCheckpoint> Checkpoints;	// Made by the first seek.
+	std::vector<uint16_t> Instruments;	// What PrecacheData returns.
+	bool HasLoops = false;				// Its loops may need to play more than once.
+};
+
+// What AnalyzeSong found out about a song. All times are in milliseconds,
+// counted with every loop played once like the ones Seek takes.
+
+struct MIDISongInfo
+{
+	int Duration;
+	int LoopStart;
+	int LoopEnd;
+	std::vector<ZMSXTempoChange> TempoChanges;
+};
+
 // base class for the different MIDI sources --------------------------------------
 
 class MIDISource
@@ -28,6 +117,44 @@ class MIDISource
 	int LoopLimit = 0;
 	std::function<bool(int)> TempoCallback = [](int t) { return false; };
 
+	// The timeline, see midisource_timeline.cpp. It is compiled for the kind
+	// of device the song plays on, since CheckCaps may change what gets
+	// played. Songs with loops play from the subclass instead unless they
+	// are only played once or a seek started them somewhere in the middle.
+	std::unique_ptr<MIDITimeline> Timeline;
+	int Technology = -1;				// As passed to SetCaps
+	bool LoopsClamped = false;			// Set by ClampLoopCount while compiling.
+	size_t TimelinePos = 0;
+	uint32_t TimelineTick = 0;			// Of the last event played
+	bool PlayingTimeline = false;
+
+	// Seeking, see midisource_seek.cpp.
+	std::vector<uint32_t> SeekState;	// Restores the state at the seek position before anything else is played.
+	size_t SeekStatePos = 0;
+
+	std::unique_ptr<MIDISongInfo> SongInfo;
+
+	// While this exists, the song plays every loop once, keeps the volumes
+	// as they are in the song and leaves the device's tempo alone, so that
+	// it can be run through without a device.
+	class SimulationScope
+	{
+		MIDISource *Source;
+		int LoopLimit;
+		bool Exporting;
+		std::function<bool(int)> TempoCallback;
+
+	public:
+		SimulationScope(MIDISource *source);
+		~SimulationScope();
+	};
+
+	void CompileTimeline();
+	const MIDITimeline &GetTimeline();
+	void BuildCheckpoints();
+	void MakeSeekState(const MIDISeekCheckpoint &state);
+	uint32_t *MakeTimelineEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time);
+
 protected:
 
 	bool isLooping = false;
@@ -40,7 +167,7 @@ protected:
 	int VolumeControllerChange(int channel, int volume);
 	void SetTempo(int new_tempo);
 	int ClampLoopCount(int loopcount);
-
+	void InvalidateTimeline();
 
 public:
 	bool Exporting = false;
@@ -55,14 +182,19 @@ public:
 	virtual bool SetMIDISubsong(int subsong);
 	virtual uint32_t *MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time) = 0;
 
-	void StartPlayback(bool looped = true, int looplimit = 0)
-	{
-		Tempo = InitialTempo;
-		LoopLimit = looplimit;
-		isLooping = looped;
-	}
+	void SetCaps(int tech);
+	void StartPlayback(bool looped = true, int looplimit = 0);
+
+	// What the streamer plays. These go to the timeline or the subclass.
+	bool Seek(uint32_t ms);
+	bool CheckPlaybackDone();
+	void RestartPlayback();
+	uint32_t *MakePlaybackEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time);
+
+	const MIDISongInfo &AnalyzeSong();
+	bool HasSongInfo() const { return SongInfo != nullptr; }
 
-	void SkipSysex() { skipSysex = true; }
+	void SkipSysex();
 
 	bool isValid() const { return Division > 0; }
 	int getDivision() const { return Division; }
@@ -85,7 +217,7 @@ public:
 class MUSSong2 : public MIDISource
 {
 public:
-	MUSSong2(const uint8_t *data, size_t len);
+	MUSSong2(const uint8_t *data, size_t len, std::shared_ptr<void> owner = nullptr);
 
 protected:
 	void DoInitialSetup() override;
@@ -95,19 +227,56 @@ protected:
 	uint32_t *MakeEvents(uint32_t *events, uint32_t *max_events_p, uint32_t max_time) override;
 
 private:
-	std::vector<uint8_t> MusData;
-	uint8_t* MusBuffer;
+	MIDIData MusData;
+	const uint8_t* MusBuffer;
 	uint8_t LastVelocity[16];
 	size_t MusP, MaxMusP;
 };
 
 
+// The tracks of a multi-track song that have events left, ordered by the
+// absolute time of their next one, so that finding it does not need to look
+// at every track. Tracks that are due at the same time come out in the
+// order they are stored in. Endless loops make the song time wrap around,
+// so times are compared by their distance, which is never more than the
+// longest delay between two events of a track.
+
+template<class Track> class TrackQueue
+{
+public:
+	void Clear() { Heap.clear(); }
+	bool Empty() const { return Heap.empty(); }
+	Track *Top() const { return Heap.front(); }
+
+	void Push(Track *track)
+	{
+		Heap.push_back(track);
+		std::push_heap(Heap.begin(), Heap.end(), Later);
+	}
+
+	Track *Pop()
+	{
+		std::pop_heap(Heap.begin(), Heap.end(), Later);
+		Track *track = Heap.back();
+		Heap.pop_back();
+		return track;
+	}
+
+private:
+	static bool Later(const Track *a, const Track *b)
+	{
+		return a->Due != b->Due ? int32_t(a->Due - b->Due) > 0 : a > b;
+	}
+
+	std::vector<Track *> Heap;
+};
+
 // MIDI file played with a MIDI stream --------------------------------------
 
 class MIDISong2 : public MIDISource
 {
 public:
-	MIDISong2(const uint8_t* data, size_t len);
+	MIDISong2(const uint8_t* data, size_t len, std::shared_ptr<void> owner = nullptr);
 
 protected:
 	void CheckCaps(int tech) override;
@@ -117,17 +286,20 @@ protected:
 	uint32_t *MakeEvents(uint32_t *events, uint32_t *max_events_p, uint32_t max_time) override;
 
 private:
-	void AdvanceTracks(uint32_t time);
-
 	struct TrackInfo;
 
 	void ProcessInitialMetaEvents ();
 	uint32_t *SendCommand (uint32_t *event, TrackInfo *track, uint32_t delay, ptrdiff_t room, bool &sysex_noroom);
 	TrackInfo *FindNextDue ();
+	void QueueTracks ();
+	void SetFinished (TrackInfo *track, bool finished);
+	uint32_t PlayedTime (const TrackInfo *track) const;
 
-	std::vector<uint8_t> MusHeader;
+	MIDIData MusHeader;
 	std::vector<TrackInfo> Tracks;
 	TrackInfo *TrackDue;
+	TrackQueue<TrackInfo> TracksDue;	// All unfinished tracks but TrackDue
+	uint32_t SongTime;					// In ticks
 	int NumTracks;
 	int Format;
 	uint16_t DesignationMask;
@@ -159,7 +331,7 @@ protected:
 class HMISong : public MIDISource
 {
 public:
-	HMISong(const uint8_t* data, size_t len);
+	HMISong(const uint8_t* data, size_t len, std::shared_ptr<void> owner = nullptr);
 
 protected:
 
@@ -172,7 +344,7 @@ protected:
 private:
 	void SetupForHMI(int len);
 	void SetupForHMP(int len);
-	void AdvanceTracks(uint32_t time);
+	void AdvanceTime(uint32_t time);
 
 	struct TrackInfo;
 
@@ -183,11 +355,13 @@ private:
 	static uint32_t ReadVarLenHMI(TrackInfo *);
 	static uint32_t ReadVarLenHMP(TrackInfo *);
 
-	std::vector<uint8_t> MusHeader;
+	MIDIData MusHeader;
 	int NumTracks;
 	std::vector<TrackInfo> Tracks;
 	TrackInfo *TrackDue;
 	TrackInfo *FakeTrack;
+	TrackQueue<TrackInfo> TracksDue;	// All enabled, unfinished tracks but TrackDue
+	uint32_t SongTime;					// In ticks
 	uint32_t (*ReadVarLen)(TrackInfo *);
 	NoteOffQueue NoteOffs;
 };
@@ -197,7 +371,7 @@ private:
 class XMISong : public MIDISource
 {
 public:
-	XMISong(const uint8_t* data, size_t len);
+	XMISong(const uint8_t* data, size_t len, std::shared_ptr<void> owner = nullptr);
 
 protected:
 	bool SetMIDISubsong(int subsong) override;
@@ -218,7 +392,7 @@ private:
 	uint32_t *SendCommand (uint32_t *event, EventSource track, uint32_t delay, ptrdiff_t room, bool &sysex_noroom);
 	EventSource FindNextDue();
 
-	std::vector<uint8_t> MusHeader;
+	MIDIData MusHeader;
 	int NumSongs;
 	std::vector<TrackInfo> Songs;
 	TrackInfo *CurrSong;
@@ -247,4 +421,6 @@ private:
 	void ProcessInitialTempoEvents();
 };
 
+MIDISource *CreateMIDISource(const uint8_t *data, size_t length, ZMSXMidiType miditype, std::shared_ptr<void> owner);
+
 #endif /* midisources_h */
@@ -92,8 +92,7 @@ struct HMISong::TrackInfo
 	const uint8_t *TrackBegin;
 	size_t TrackP;
 	size_t MaxTrackP;
-	uint32_t Delay;
-	uint32_t PlayedTime;
+	uint32_t Due;			// Song time of the next event
 	uint16_t Designation[NUM_HMI_DESIGNATIONS];
 	bool Enabled;
 	bool Finished;
@@ -125,14 +124,13 @@ struct HMISong::TrackInfo
 //
 //==========================================================================
 
-HMISong::HMISong (const uint8_t *data, size_t len)
+HMISong::HMISong (const uint8_t *data, size_t len, std::shared_ptr<void> owner)
 {
 	if (len < 0x100)
 	{ // Way too small to be HMI.
 		return;
 	}
-	MusHeader.resize(len);
-	memcpy(MusHeader.data(), data, len);
+	MusHeader.Assign(data, len, std::move(owner));
 	NumTracks = 0;
 
 	// Do some validation of the MIDI file
@@ -438,16 +436,24 @@ void HMISong :: DoRestart()
 		Tracks[i].TrackP = 0;
 		Tracks[i].Finished = false;
 		Tracks[i].RunningStatus = 0;
-		Tracks[i].PlayedTime = 0;
 	}
+	SongTime = 0;
 	ProcessInitialMetaEvents ();
 	for (i = 0; i < NumTracks; ++i)
 	{
-		Tracks[i].Delay = ReadVarLen(&Tracks[i]);
+		Tracks[i].Due = ReadVarLen(&Tracks[i]);
 	}
-	Tracks[i].Delay = 0;	// for the FakeTrack
+	Tracks[i].Due = 0;	// for the FakeTrack
 	Tracks[i].Enabled = true;
 	TrackDue = Tracks.data();
+	TracksDue.Clear();
+	for (i = 1; i < NumTracks; ++i)
+	{
+		if (Tracks[i].Enabled && !Tracks[i].Finished)
+		{
+			TracksDue.Push(&Tracks[i]);
+		}
+	}
 	TrackDue = FindNextDue();
 }
 
@@ -487,11 +493,10 @@ uint32_t *HMISong::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_t
 		// device.
 		do
 		{
-			delay = TrackDue->Delay;
+			delay = TrackDue->Due - SongTime;
 			time += delay;
-			// Advance time for all tracks by the amount needed for the one up next.
 			tot_time += delay * Tempo / Division;
-			AdvanceTracks(delay);
+			AdvanceTime(delay);
 			// Play all events for this tick.
 			do
 			{
@@ -508,7 +513,7 @@ uint32_t *HMISong::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_t
 				}
 				events = new_events;
 			}
-			while (TrackDue && TrackDue->Delay == 0 && events < max_event_p);
+			while (TrackDue && TrackDue->Due == SongTime && events < max_event_p);
 		}
 		while (start_events == events && TrackDue);
 		time = 0;
@@ -518,22 +523,15 @@ uint32_t *HMISong::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_t
 
 //==========================================================================
 //
-// HMISong :: AdvanceTracks
+// HMISong :: AdvanceTime
 //
-// Advances time for all tracks by the specified amount.
+// Advances the song and the pending note-offs by the specified amount.
 //
 //==========================================================================
 
-void HMISong::AdvanceTracks(uint32_t time)
+void HMISong::AdvanceTime(uint32_t time)
 {
-	for (int i = 0; i <= NumTracks; ++i)
-	{
-		if (Tracks[i].Enabled && !Tracks[i].Finished)
-		{
-			Tracks[i].Delay -= time;
-			Tracks[i].PlayedTime += time;
-		}
-	}
+	SongTime += time;
 	NoteOffs.AdvanceTime(time);
 }
 
@@ -725,7 +723,7 @@ uint32_t *HMISong::SendCommand (uint32_t *events, TrackInfo *track, uint32_t del
 	}
 	if (!track->Finished)
 	{
-		track->Delay = ReadVarLen(track);
+		track->Due = SongTime + ReadVarLen(track);
 	}
 	// Advance events pointer unless this is a non-delaying NOP.
 	if (events[0] != 0 || MEVENT_EVENTTYPE(events[2]) != MEVENT_NOP)
@@ -952,7 +950,7 @@ void NoteOffQueue::Heapify()
 //
 // HMISong :: FindNextDue
 //
-// Scans every track for the next event to play. Returns nullptr if all events
+// Picks the track with the next event to play. Returns nullptr if all events
 // have been consumed.
 //
 //==========================================================================
@@ -961,36 +959,36 @@ HMISong::TrackInfo *HMISong::FindNextDue ()
 {
 	TrackInfo *track;
 	uint32_t best;
-	int i;
 
-	// Give precedence to whichever track last had events taken from it.
-	if (TrackDue != FakeTrack && !TrackDue->Finished && TrackDue->Delay == 0)
+	if (TrackDue != FakeTrack)
 	{
-		return TrackDue;
+		if (!TrackDue->Finished)
+		{
+			// Give precedence to whichever track last had events taken from it.
+			if (TrackDue->Due == SongTime)
+			{
+				return TrackDue;
+			}
+			if (TrackDue->Enabled)
+			{
+				TracksDue.Push(TrackDue);
+			}
+		}
 	}
-	if (TrackDue == FakeTrack && NoteOffs.size() != 0 && NoteOffs[0].Delay == 0)
+	else if (NoteOffs.size() != 0 && NoteOffs[0].Delay == 0)
 	{
-		FakeTrack->Delay = 0;
+		FakeTrack->Due = SongTime;
 		return FakeTrack;
 	}
 
 	// Check regular tracks.
-	track = nullptr;
-	best = 0xFFFFFFFF;
-	for (i = 0; i < NumTracks; ++i)
-	{
-		if (Tracks[i].Enabled && !Tracks[i].Finished && Tracks[i].Delay < best)
-		{
-			best = Tracks[i].Delay;
-			track = &Tracks[i];
-		}
-	}
+	track = TracksDue.Empty() ? nullptr : TracksDue.Top();
+	best = track == nullptr ? 0xFFFFFFFF : track->Due - SongTime;
 	// Check automatic note-offs.
 	if (NoteOffs.size() != 0 && NoteOffs[0].Delay <= best)
 	{
-		FakeTrack->Delay = NoteOffs[0].Delay;
+		FakeTrack->Due = SongTime + NoteOffs[0].Delay;
 		return FakeTrack;
 	}
-	return track;
+	return track == nullptr ? nullptr : TracksDue.Pop();
 }
-
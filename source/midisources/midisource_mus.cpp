@@ -34,6 +34,7 @@
 // HEADER FILES ------------------------------------------------------------
 
 #include <algorithm>
+#include <string.h>
 #include "midisource.h"
 #include "zmsx/m_swap.h"
 
@@ -49,6 +50,8 @@ int MUSHeaderSearch(const uint8_t *head, int len);
 
 // PRIVATE FUNCTION PROTOTYPES ---------------------------------------------
 
+static MUSHeader ReadHeader(const uint8_t *data);
+
 // EXTERNAL DATA DECLARATIONS ----------------------------------------------
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
@@ -76,6 +79,22 @@ static const uint8_t CtrlTranslate[15] =
 
 // CODE --------------------------------------------------------------------
 
+//==========================================================================
+//
+// ReadHeader
+//
+// The song data may be borrowed or mapped from a file at any alignment,
+// so the header gets copied out instead of being accessed in place.
+//
+//==========================================================================
+
+static MUSHeader ReadHeader(const uint8_t *data)
+{
+	MUSHeader header;
+	memcpy(&header, data, sizeof(header));
+	return header;
+}
+
 //==========================================================================
 //
 // MUSSong2 Constructor
@@ -85,7 +104,7 @@ static const uint8_t CtrlTranslate[15] =
 //
 //==========================================================================
 
-MUSSong2::MUSSong2 (const uint8_t *data, size_t len)
+MUSSong2::MUSSong2 (const uint8_t *data, size_t len, std::shared_ptr<void> owner)
 {
 	int start;
 
@@ -106,18 +125,17 @@ MUSSong2::MUSSong2 (const uint8_t *data, size_t len)
 	{ // It's too short.
 		return;
 	}
-	MusData.resize(len);
-	memcpy(MusData.data(), data, len);
-	auto MusHeader = (MUSHeader*)MusData.data();
+	MusData.Assign(data, len, std::move(owner));
+	const MUSHeader MusHeader = ReadHeader(MusData.data());
 
 	// Do some validation of the MUS file.
-	if (LittleShort(MusHeader->NumChans) > 15)
+	if (LittleShort(MusHeader.NumChans) > 15)
 	{
 		return;
 	}
 
-	MusBuffer = MusData.data() + LittleShort(MusHeader->SongStart);
-	MaxMusP = std::min<int>(LittleShort(MusHeader->SongLen), int(len) - LittleShort(MusHeader->SongStart));
+	MusBuffer = MusData.data() + LittleShort(MusHeader.SongStart);
+	MaxMusP = std::min<int>(LittleShort(MusHeader.SongLen), int(len) - LittleShort(MusHeader.SongStart));
 	Division = 140;
 	Tempo = InitialTempo = 1000000;
 }
@@ -173,13 +191,13 @@ bool MUSSong2::CheckDone()
 
 std::vector<uint16_t> MUSSong2::PrecacheData()
 {
-	auto MusHeader = (MUSHeader*)MusData.data();
+	const MUSHeader MusHeader = ReadHeader(MusData.data());
 	std::vector<uint16_t> work;
 	const uint8_t *used = MusData.data() + sizeof(MUSHeader) / sizeof(uint8_t);
 	int i, k;
 
-	int numinstr = LittleShort(MusHeader->NumInstruments);
-	work.reserve(LittleShort(MusHeader->NumInstruments));
+	int numinstr = LittleShort(MusHeader.NumInstruments);
+	work.reserve(LittleShort(MusHeader.NumInstruments));
 	for (i = k = 0; i < numinstr; ++i)
 	{
 		uint8_t instr = used[k++];
@@ -229,7 +247,7 @@ uint32_t *MUSSong2::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_t
 {
 	uint32_t tot_time = 0;
 	uint32_t time = 0;
-	auto MusHeader = (MUSHeader*)MusData.data();
+	const MUSHeader MusHeader = ReadHeader(MusData.data());
 
 	max_time = max_time * Division / Tempo;
 
@@ -285,7 +303,7 @@ uint32_t *MUSSong2::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_t
 		case MUS_SYSEVENT:
 			status |= MIDI_CTRLCHANGE;
 			mid1 = CtrlTranslate[t];
-			mid2 = t == 12 ? LittleShort(MusHeader->NumChans) : 0;
+			mid2 = t == 12 ? LittleShort(MusHeader.NumChans) : 0;
 			break;
 
 		case MUS_CTRLCHANGE:
@@ -0,0 +1,369 @@
+/*
+** midisource_seek.cpp
+** Seeking in MIDI sources
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include "zmsx.hpp"
+#include "midisource.h"
+
+// MACROS ------------------------------------------------------------------
+
+enum
+{
+	CHECKPOINT_EVENTS = 1024,	// Events between two checkpoints.
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// MIDIChannelState :: Reset
+//
+//==========================================================================
+
+void MIDIChannelState::Reset()
+{
+	memset(Controllers, 0xff, sizeof(Controllers));
+	Program = 0xff;
+	Pressure = 0xff;
+	PitchBend = 0x2000;
+	Rpn[0] = Rpn[1] = Rpn[2] = 0xffff;
+	SelectedRpn = 0x3fff;
+}
+
+//==========================================================================
+//
+// MIDIChannelState :: ResetControllers
+//
+// What Reset All Controllers resets according to RP-015.
+//
+//==========================================================================
+
+void MIDIChannelState::ResetControllers()
+{
+	Controllers[1] = 0xff;
+	Controllers[11] = 0xff;
+	for (int i = 64; i <= 67; i++)
+	{
+		Controllers[i] = 0xff;
+	}
+	Pressure = 0xff;
+	PitchBend = 0x2000;
+	SelectedRpn = 0x3fff;
+}
+
+//==========================================================================
+//
+// SetController
+//
+// Data entry only gets tracked for the registered parameters that
+// MakeSeekState restores, everything else that depends on the order of
+// the controllers is left out.
+//
+//==========================================================================
+
+static void SetController(MIDIChannelState &channel, int ctrl, int value)
+{
+	switch (ctrl)
+	{
+	case 6:		// Data entry MSB
+	case 38:	// Data entry LSB
+		if (channel.SelectedRpn < 3)
+		{
+			uint16_t &rpn = channel.Rpn[channel.SelectedRpn];
+			if (rpn == 0xffff) rpn = 0;
+			rpn = ctrl == 6 ? (rpn & 0x7f) | (value << 7) : (rpn & 0x3f80) | value;
+		}
+		break;
+
+	case 96:	// Data increment
+	case 97:	// Data decrement
+		break;
+
+	case 98:	// NRPN LSB
+	case 99:	// NRPN MSB
+		channel.SelectedRpn = 0x3fff;
+		break;
+
+	case 100:	// RPN LSB
+		channel.SelectedRpn = (channel.SelectedRpn & 0x3f80) | value;
+		break;
+
+	case 101:	// RPN MSB
+		channel.SelectedRpn = (channel.SelectedRpn & 0x7f) | (value << 7);
+		break;
+
+	case 121:	// Reset all controllers
+		channel.ResetControllers();
+		break;
+
+	default:
+		if (ctrl < 120)
+		{
+			channel.Controllers[ctrl] = value;
+		}
+		break;
+	}
+}
+
+//==========================================================================
+//
+// ApplyEvent
+//
+// Updates the state with an event. Notes are of no interest here.
+//
+//==========================================================================
+
+static void ApplyEvent(MIDISeekCheckpoint &state, uint32_t message)
+{
+	if (MEVENT_EVENTTYPE(message) == MEVENT_TEMPO)
+	{
+		state.Tempo = MEVENT_EVENTPARM(message);
+	}
+	else if (MEVENT_EVENTTYPE(message) == 0)
+	{
+		MIDIChannelState &channel = state.Channels[message & 0x0f];
+		int data1 = (message >> 8) & 0x7f;
+		int data2 = (message >> 16) & 0x7f;
+
+		switch (message & 0xf0)
+		{
+		case MIDI_CTRLCHANGE:
+			SetController(channel, data1, data2);
+			break;
+
+		case MIDI_PRGMCHANGE:
+			channel.Program = data1;
+			break;
+
+		case MIDI_CHANPRESS:
+			channel.Pressure = data1;
+			break;
+
+		case MIDI_PITCHBEND:
+			channel.PitchBend = data1 | (data2 << 7);
+			break;
+		}
+	}
+}
+
+//==========================================================================
+//
+// MIDISource :: BuildCheckpoints
+//
+// Goes through the timeline and takes a checkpoint every CHECKPOINT_EVENTS
+// events.
+//
+//==========================================================================
+
+void MIDISource::BuildCheckpoints()
+{
+	auto &timeline = *Timeline;
+	MIDISeekCheckpoint state;
+	uint32_t tick = 0;
+
+	state.Time = 0;
+	state.Tempo = InitialTempo;
+	for (auto &channel : state.Channels)
+	{
+		channel.Reset();
+	}
+
+	for (size_t i = 0; i < timeline.Messages.size(); ++i)
+	{
+		if (i % CHECKPOINT_EVENTS == 0)
+		{
+			state.Offset = i;
+			timeline.Checkpoints.push_back(state);
+		}
+		state.Time += double(timeline.Ticks[i] - tick) * state.Tempo / Division;
+		tick = timeline.Ticks[i];
+		ApplyEvent(state, timeline.Messages[i]);
+	}
+	if (timeline.Checkpoints.empty())
+	{
+		state.Offset = 0;
+		timeline.Checkpoints.push_back(state);
+	}
+}
+
+//==========================================================================
+//
+// MIDISource :: Seek
+//
+// Continues playback from the timeline at the given time, counted from the
+// start of the song with every loop played once. Seeking past the end ends
+// the song.
+//
+//==========================================================================
+
+bool MIDISource::Seek(uint32_t ms)
+{
+	if (!isValid())
+	{
+		return false;
+	}
+	auto &timeline = GetTimeline();
+	if (timeline.Checkpoints.empty())
+	{
+		BuildCheckpoints();
+	}
+
+	// Start from the last checkpoint before the target. Events exactly at
+	// the target must still be played, so they cannot be behind it.
+	auto &checkpoints = timeline.Checkpoints;
+	double target = ms * 1000.;
+	auto cp = std::lower_bound(checkpoints.begin(), checkpoints.end(), target,
+		[](const MIDISeekCheckpoint &c, double t) { return c.Time < t; });
+	if (cp != checkpoints.begin()) --cp;
+
+	MIDISeekCheckpoint state = *cp;
+	size_t pos = state.Offset;
+	uint32_t tick = pos > 0 ? timeline.Ticks[pos - 1] : 0;
+	while (pos < timeline.Messages.size())
+	{
+		double time = state.Time + double(timeline.Ticks[pos] - tick) * state.Tempo / Division;
+		if (time >= target)
+		{
+			tick = timeline.Ticks[pos] - uint32_t((time - target) * Division / state.Tempo + 0.5);
+			break;
+		}
+		state.Time = time;
+		tick = timeline.Ticks[pos];
+		ApplyEvent(state, timeline.Messages[pos]);
+		pos++;
+	}
+
+	state.Offset = pos;
+	TimelinePos = pos;
+	TimelineTick = tick;
+	Tempo = state.Tempo;
+	MakeSeekState(state);
+	PlayingTimeline = true;
+	return true;
+}
+
+//==========================================================================
+//
+// MIDISource :: MakeSeekState
+//
+// Creates the events that silence the old position and put all channels
+// into the state the song has at the new one. Long messages are mostly
+// resets and other setup, so all of them up to the new position get sent
+// before the channel state.
+//
+//==========================================================================
+
+void MIDISource::MakeSeekState(const MIDISeekCheckpoint &state)
+{
+	auto add = [&](uint32_t event)
+	{
+		SeekState.push_back(0);		// dwDeltaTime
+		SeekState.push_back(0);		// dwStreamID
+		SeekState.push_back(event);	// dwEvent
+	};
+
+	SeekState.clear();
+	SeekStatePos = 0;
+
+	add((MEVENT_TEMPO << 24) | state.Tempo);
+	for (int i = 0; i < 16; ++i)
+	{
+		add(MIDI_CTRLCHANGE | i | (120 << 8));	// All sound off
+		add(MIDI_CTRLCHANGE | i | (123 << 8));	// All notes off, for devices without the above
+	}
+
+	auto &timeline = *Timeline;
+	for (size_t i = 0; i < state.Offset; ++i)
+	{
+		uint32_t message = timeline.Messages[i];
+		if (MEVENT_EVENTTYPE(message) == MEVENT_LONGMSG)
+		{
+			const uint32_t *data = &timeline.SysexPool[timeline.SysexOffsets[i]];
+			add(message);
+			SeekState.insert(SeekState.end(), data, data + ((MEVENT_EVENTPARM(message) + 3) >> 2));
+		}
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		const MIDIChannelState &channel = state.Channels[i];
+
+		add(MIDI_CTRLCHANGE | i | (121 << 8));	// Reset controllers
+		for (int ctrl = 0; ctrl < 120; ++ctrl)
+		{
+			int value = channel.Controllers[ctrl];
+			if (value != 0xff)
+			{
+				if (ctrl == 7)
+				{
+					value = VolumeControllerChange(i, value);
+				}
+				add(MIDI_CTRLCHANGE | i | (ctrl << 8) | (value << 16));
+			}
+		}
+		// After the bank select controllers above.
+		if (channel.Program != 0xff)
+		{
+			add(MIDI_PRGMCHANGE | i | (channel.Program << 8));
+		}
+		bool rpn = false;
+		for (int n = 0; n < 3; ++n)
+		{
+			if (channel.Rpn[n] != 0xffff)
+			{
+				add(MIDI_CTRLCHANGE | i | (101 << 8));
+				add(MIDI_CTRLCHANGE | i | (100 << 8) | (n << 16));
+				add(MIDI_CTRLCHANGE | i | (6 << 8) | ((channel.Rpn[n] >> 7) << 16));
+				add(MIDI_CTRLCHANGE | i | (38 << 8) | ((channel.Rpn[n] & 0x7f) << 16));
+				rpn = true;
+			}
+		}
+		if (rpn)
+		{
+			add(MIDI_CTRLCHANGE | i | (101 << 8) | (127 << 16));
+			add(MIDI_CTRLCHANGE | i | (100 << 8) | (127 << 16));
+		}
+		if (channel.PitchBend != 0x2000)
+		{
+			add(MIDI_PITCHBEND | i | ((channel.PitchBend & 0x7f) << 8) | ((channel.PitchBend >> 7) << 16));
+		}
+		if (channel.Pressure != 0xff)
+		{
+			add(MIDI_CHANPRESS | i | (channel.Pressure << 8));
+		}
+	}
+}
@@ -46,7 +46,7 @@
 #define CHECK_FINISHED \
 	if (track->TrackP >= track->MaxTrackP) \
 	{ \
-		track->Finished = true; \
+		SetFinished(track, true); \
 		return events; \
 	}
 
@@ -57,8 +57,9 @@ struct MIDISong2::TrackInfo
 	const uint8_t *TrackBegin;
 	size_t TrackP;
 	size_t MaxTrackP;
-	uint32_t Delay;
-	uint32_t PlayedTime;
+	uint32_t Due;			// Song time of the next event
+	uint32_t StartTime;		// Song time it started, not counting the time it was finished
+	uint32_t FinishedTime;
 	bool Finished;
 	uint8_t RunningStatus;
 	bool Designated;
@@ -96,14 +97,13 @@ struct MIDISong2::TrackInfo
 //
 //==========================================================================
 
-MIDISong2::MIDISong2 (const uint8_t* data, size_t len)
-: MusHeader(0), Tracks(0)
+MIDISong2::MIDISong2 (const uint8_t* data, size_t len, std::shared_ptr<void> owner)
+: Tracks(0)
 {
 	unsigned p;
 	int i;
 
-	MusHeader.resize(len);
-	memcpy(MusHeader.data(), data, len);
+	MusHeader.Assign(data, len, std::move(owner));
 
 	// Do some validation of the MIDI file
 	if (MusHeader[4] != 0 || MusHeader[5] != 0 || MusHeader[6] != 0 || MusHeader[7] != 6)
@@ -248,14 +248,16 @@ void MIDISong2 :: DoRestart()
 		Tracks[i].LoopCount = -1;
 		Tracks[i].EProgramChange = false;
 		Tracks[i].EVolume = false;
-		Tracks[i].PlayedTime = 0;
+		Tracks[i].StartTime = 0;
 	}
+	SongTime = 0;
 	ProcessInitialMetaEvents ();
 	for (i = 0; i < NumTracks; ++i)
 	{
-		Tracks[i].Delay = Tracks[i].ReadVarLen();
+		Tracks[i].Due = Tracks[i].ReadVarLen();
 	}
 	TrackDue = Tracks.data();
+	QueueTracks();
 	TrackDue = FindNextDue();
 }
 
@@ -295,11 +297,10 @@ uint32_t *MIDISong2::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_
 		// device.
 		do
 		{
-			delay = TrackDue->Delay;
+			delay = TrackDue->Due - SongTime;
 			time += delay;
-			// Advance time for all tracks by the amount needed for the one up next.
 			tot_time += delay * Tempo / Division;
-			AdvanceTracks(delay);
+			SongTime += delay;
 			// Play all events for this tick.
 			do
 			{
@@ -316,7 +317,7 @@ uint32_t *MIDISong2::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_
 				}
 				events = new_events;
 			}
-			while (TrackDue && TrackDue->Delay == 0 && events < max_event_p);
+			while (TrackDue && TrackDue->Due == SongTime && events < max_event_p);
 		}
 		while (start_events == events && TrackDue);
 		time = 0;
@@ -326,22 +327,37 @@ uint32_t *MIDISong2::MakeEvents(uint32_t *events, uint32_t *max_event_p, uint32_
 
 //==========================================================================
 //
-// MIDISong2 :: AdvanceTracks
+// MIDISong2 :: SetFinished
 //
-// Advances time for all tracks by the specified amount.
+// Loops can bring tracks back after they finished. The time in between
+// does not count as played.
 //
 //==========================================================================
 
-void MIDISong2::AdvanceTracks(uint32_t time)
+void MIDISong2::SetFinished(TrackInfo *track, bool finished)
 {
-	for (int i = 0; i < NumTracks; ++i)
+	if (finished && !track->Finished)
 	{
-		if (!Tracks[i].Finished)
-		{
-			Tracks[i].Delay -= time;
-			Tracks[i].PlayedTime += time;
-		}
+		track->FinishedTime = SongTime;
 	}
+	else if (!finished && track->Finished)
+	{
+		track->StartTime += SongTime - track->FinishedTime;
+	}
+	track->Finished = finished;
+}
+
+//==========================================================================
+//
+// MIDISong2 :: PlayedTime
+//
+// How long an unfinished track has been playing.
+//
+//==========================================================================
+
+uint32_t MIDISong2::PlayedTime(const TrackInfo *track) const
+{
+	return SongTime - track->StartTime;
 }
 
 //==========================================================================
@@ -437,7 +453,7 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 			case 110:	// EMIDI Track Designation - InitBeat only
 				// Instruments 4, 5, 6, and 7 are all FM synth.
 				// The rest are all wavetable.
-				if (track->PlayedTime < (uint32_t)Division)
+				if (PlayedTime(track) < (uint32_t)Division)
 				{
 					if (data2 == 127)
 					{
@@ -454,7 +470,7 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 				break;
 
 			case 111:	// EMIDI Track Exclusion - InitBeat only
-				if (track->PlayedTime < (uint32_t)Division)
+				if (PlayedTime(track) < (uint32_t)Division)
 				{
 					if (!track->Designated)
 					{
@@ -471,7 +487,7 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 
 			case 112:	// EMIDI Program Change
 				// Ignored unless it also appears in the InitBeat
-				if (track->PlayedTime < (uint32_t)Division || track->EProgramChange)
+				if (PlayedTime(track) < (uint32_t)Division || track->EProgramChange)
 				{
 					track->EProgramChange = true;
 					event = 0xC0 | (event & 0x0F);
@@ -482,7 +498,7 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 
 			case 113:	// EMIDI Volume
 				// Ignored unless it also appears in the InitBeat
-				if (track->PlayedTime < (uint32_t)Division || track->EVolume)
+				if (PlayedTime(track) < (uint32_t)Division || track->EVolume)
 				{
 					track->EVolume = true;
 					data1 = 7;
@@ -504,15 +520,23 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 						track->LoopFinished = track->Finished;
 					}
 				}
+				if (data2 == 0)
+				{ // Only endless loops mark where the song loops to.
+					events[2] = (MEVENT_NOP << 24) | MEVENT_NOP_LOOPBEGIN;
+				}
 				event = MIDI_META;
 				break;
 
 			case 117:	// EMIDI Loop End
+				if (data2 == 127)
+				{
+					events[2] = (MEVENT_NOP << 24) | MEVENT_NOP_LOOPEND;
+				}
 				if (track->LoopCount >= 0 && data2 == 127)
 				{
 					if (track->LoopCount == 0 && !isLooping)
 					{
-						track->Finished = true;
+						SetFinished(track, true);
 					}
 					else
 					{
@@ -521,8 +545,8 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 							track->LoopCount = -1;
 						}
 						track->TrackP = track->LoopBegin;
-						track->Delay = track->LoopDelay;
-						track->Finished = track->LoopFinished;
+						track->Due = SongTime + track->LoopDelay;
+						SetFinished(track, track->LoopFinished);
 					}
 				}
 				event = MIDI_META;
@@ -536,25 +560,30 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 						for (i = 0; i < NumTracks; ++i)
 						{
 							Tracks[i].LoopBegin = Tracks[i].TrackP;
-							Tracks[i].LoopDelay = Tracks[i].Delay;
+							Tracks[i].LoopDelay = Tracks[i].Due - SongTime;
 							Tracks[i].LoopCount = loopcount == 0 ? 0 : loopcount - 1;
 							Tracks[i].LoopFinished = Tracks[i].Finished;
 						}
 					}
 				}
+				if (data2 == 0)
+				{ // Only endless loops mark where the song loops to.
+					events[2] = (MEVENT_NOP << 24) | MEVENT_NOP_LOOPBEGIN;
+				}
 				event = MIDI_META;
 				break;
 
 			case 119:	// EMIDI Global Loop End
 				if (data2 == 127)
 				{
+					events[2] = (MEVENT_NOP << 24) | MEVENT_NOP_LOOPEND;
 					for (i = 0; i < NumTracks; ++i)
 					{
 						if (Tracks[i].LoopCount >= 0)
 						{
 							if (Tracks[i].LoopCount == 0 && !isLooping)
 							{
-								Tracks[i].Finished = true;
+								SetFinished(&Tracks[i], true);
 							}
 							else
 							{
@@ -563,11 +592,12 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 									Tracks[i].LoopCount = -1;
 								}
 								Tracks[i].TrackP = Tracks[i].LoopBegin;
-								Tracks[i].Delay = Tracks[i].LoopDelay;
-								Tracks[i].Finished = Tracks[i].LoopFinished;
+								Tracks[i].Due = SongTime + Tracks[i].LoopDelay;
+								SetFinished(&Tracks[i], Tracks[i].LoopFinished);
 							}
 						}
 					}
+					QueueTracks();
 				}
 				event = MIDI_META;
 				break;
@@ -629,7 +659,7 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 				switch (event)
 				{
 				case MIDI_META_EOT:
-					track->Finished = true;
+					SetFinished(track, true);
 					break;
 
 				case MIDI_META_TEMPO:
@@ -645,21 +675,21 @@ uint32_t *MIDISong2::SendCommand (uint32_t *events, TrackInfo *track, uint32_t d
 				track->TrackP += len;
 				if (track->TrackP == track->MaxTrackP)
 				{
-					track->Finished = true;
+					SetFinished(track, true);
 				}
 			}
 			else
 			{
-				track->Finished = true;
+				SetFinished(track, true);
 			}
 		}
 	}
 	if (!track->Finished)
 	{
-		track->Delay = track->ReadVarLen();
+		track->Due = SongTime + track->ReadVarLen();
 	}
-	// Advance events pointer unless this is a non-delaying NOP.
-	if (events[0] != 0 || MEVENT_EVENTTYPE(events[2]) != MEVENT_NOP)
+	// Advance events pointer unless this is a non-delaying NOP without a loop marker.
+	if (events[0] != 0 || events[2] != (MEVENT_NOP << 24))
 	{
 		if (MEVENT_EVENTTYPE(events[2]) == MEVENT_LONGMSG)
 		{
@@ -704,7 +734,7 @@ void MIDISong2::ProcessInitialMetaEvents ()
 				switch (event)
 				{
 				case MIDI_META_EOT:
-					track->Finished = true;
+					SetFinished(track, true);
 					break;
 
 				case MIDI_META_TEMPO:
@@ -720,7 +750,7 @@ void MIDISong2::ProcessInitialMetaEvents ()
 		}
 		if (track->TrackP >= track->MaxTrackP - 4)
 		{
-			track->Finished = true;
+			SetFinished(track, true);
 		}
 	}
 }
@@ -749,7 +779,7 @@ uint32_t MIDISong2::TrackInfo::ReadVarLen ()
 //
 // MIDISong2 :: FindNextDue
 //
-// Scans every track for the next event to play. Returns nullptr if all events
+// Picks the track with the next event to play. Returns nullptr if all events
 // have been consumed.
 //
 //==========================================================================
@@ -757,14 +787,6 @@ uint32_t MIDISong2::TrackInfo::ReadVarLen ()
 MIDISong2::TrackInfo *MIDISong2::FindNextDue ()
 {
 	TrackInfo *track;
-	uint32_t best;
-	int i;
-
-	// Give precedence to whichever track last had events taken from it.
-	if (!TrackDue->Finished && TrackDue->Delay == 0)
-	{
-		return TrackDue;
-	}
 
 	switch (Format)
 	{
@@ -772,20 +794,16 @@ MIDISong2::TrackInfo *MIDISong2::FindNextDue ()
 		return Tracks[0].Finished ? nullptr : Tracks.data();
 
 	case 1:
-		track = nullptr;
-		best = 0xFFFFFFFF;
-		for (i = 0; i < NumTracks; ++i)
+		if (!TrackDue->Finished)
 		{
-			if (!Tracks[i].Finished)
+			// Give precedence to whichever track last had events taken from it.
+			if (TrackDue->Due == SongTime)
 			{
-				if (Tracks[i].Delay < best)
-				{
-					best = Tracks[i].Delay;
-					track = &Tracks[i];
-				}
+				return TrackDue;
 			}
+			TracksDue.Push(TrackDue);
 		}
-		return track;
+		return TracksDue.Empty() ? nullptr : TracksDue.Pop();
 
 	case 2:
 		track = TrackDue;
@@ -798,4 +816,28 @@ MIDISong2::TrackInfo *MIDISong2::FindNextDue ()
 	return nullptr;
 }
 
+//==========================================================================
+//
+// MIDISong2 :: QueueTracks
+//
+// Puts all unfinished tracks but TrackDue in the queue again, after they
+// changed all at once.
+//
+//==========================================================================
+
+void MIDISong2::QueueTracks()
+{
+	TracksDue.Clear();
+	if (Format == 1)
+	{
+		for (int i = 0; i < NumTracks; ++i)
+		{
+			if (&Tracks[i] != TrackDue && !Tracks[i].Finished)
+			{
+				TracksDue.Push(&Tracks[i]);
+			}
+		}
+	}
+}
+
 
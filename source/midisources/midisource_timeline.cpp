@@ -0,0 +1,401 @@
+/*
+** midisource_timeline.cpp
+** Playing MIDI sources from a compiled event timeline
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include "zmsx.hpp"
+#include "midisource.h"
+#include "zmsx/trace.h"
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// EventSize
+//
+// Size of an event as made by MakeEvents, in words.
+//
+//==========================================================================
+
+static size_t EventSize(const uint32_t *event)
+{
+	if (event[2] < 0x80000000)
+	{ // short message
+		return 3;
+	}
+	else
+	{ // long message
+		return 3 + ((MEVENT_EVENTPARM(event[2]) + 3) >> 2);
+	}
+}
+
+//==========================================================================
+//
+// InstrumentScan
+//
+// Looks through the events CompileTimeline keeps for program change events
+// on normal channels and note on events on channel 10, to find out which
+// instruments PrecacheData has to return.
+//
+//==========================================================================
+
+struct InstrumentScan
+{
+	uint8_t found_instruments[256] = { 0, };
+	uint8_t found_banks[256] = { 0, };
+	bool multiple_banks = false;
+
+	InstrumentScan()
+	{
+		found_banks[0] = true;		// Bank 0 is always used.
+		found_banks[128] = true;
+	}
+
+	void Add(uint32_t message)
+	{
+		if (MEVENT_EVENTTYPE(message) == 0)
+		{
+			int command = (message & 0x70);
+			int channel = (message & 0x0f);
+			int data1 = (message >> 8) & 0x7f;
+			int data2 = (message >> 16) & 0x7f;
+
+			if (channel != 9 && command == (MIDI_PRGMCHANGE & 0x70))
+			{
+				found_instruments[data1] = true;
+			}
+			else if (channel == 9 && command == (MIDI_PRGMCHANGE & 0x70) && data1 != 0)
+			{ // On a percussion channel, program change also serves as bank select.
+				multiple_banks = true;
+				found_banks[data1 | 128] = true;
+			}
+			else if (channel == 9 && command == (MIDI_NOTEON & 0x70) && data2 != 0)
+			{
+				found_instruments[data1 | 128] = true;
+			}
+			else if (command == (MIDI_CTRLCHANGE & 0x70) && data1 == 0 && data2 != 0)
+			{
+				multiple_banks = true;
+				if (channel == 9)
+				{
+					found_banks[data2 | 128] = true;
+				}
+				else
+				{
+					found_banks[data2] = true;
+				}
+			}
+		}
+	}
+
+	// Packs everything into a contiguous region for the PrecacheInstruments call().
+	std::vector<uint16_t> Pack() const
+	{
+		std::vector<uint16_t> packed;
+
+		for (int i = 0; i < 256; ++i)
+		{
+			if (found_instruments[i])
+			{
+				uint16_t packnum = (i & 127) | ((i & 128) << 7);
+				if (!multiple_banks)
+				{
+					packed.push_back(packnum);
+				}
+				else
+				{ // In order to avoid having to multiplex tracks in a type 1 file,
+					// precache every used instrument in every used bank, even if not
+					// all combinations are actually used.
+					for (int j = 0; j < 128; ++j)
+					{
+						if (found_banks[j + (i & 128)])
+						{
+							packed.push_back(packnum | (j << 7));
+						}
+					}
+				}
+			}
+		}
+		return packed;
+	}
+};
+
+//==========================================================================
+//
+// MIDISource :: CompileTimeline
+//
+// Goes through the song once without playing it and keeps all the events,
+// along with the instruments they use. Afterward the song is back at its
+// start.
+//
+//==========================================================================
+
+void MIDISource::CompileTimeline()
+{
+	uint32_t Events[2][MAX_MIDI_EVENTS*3];	// MakeEvents may write past the end it is given.
+	auto timeline = std::make_unique<MIDITimeline>();
+	InstrumentScan instruments;
+	uint32_t tick = 0;
+
+	SimulationScope simulation(this);
+	LoopsClamped = false;
+	DoRestart();
+	while (!CheckDone())
+	{
+		uint32_t *event_end = MakeEvents(Events[0], &Events[0][MAX_MIDI_EVENTS*3], 1000000*600);
+		for (uint32_t *event = Events[0]; event < event_end; event += EventSize(event))
+		{
+			tick += event[0];
+			timeline->Ticks.push_back(tick);
+			timeline->Messages.push_back(event[2]);
+			instruments.Add(event[2]);
+			if (MEVENT_EVENTTYPE(event[2]) == MEVENT_LONGMSG)
+			{
+				timeline->SysexOffsets.push_back(uint32_t(timeline->SysexPool.size()));
+				timeline->SysexPool.insert(timeline->SysexPool.end(), event + 3, event + EventSize(event));
+			}
+			else
+			{
+				timeline->SysexOffsets.push_back(0);
+			}
+		}
+	}
+	timeline->Instruments = instruments.Pack();
+	timeline->HasLoops = LoopsClamped;
+	DoRestart();
+	Timeline = std::move(timeline);
+}
+
+//==========================================================================
+//
+// MIDISource :: GetTimeline
+//
+//==========================================================================
+
+const MIDITimeline &MIDISource::GetTimeline()
+{
+	if (Timeline == nullptr)
+	{
+		CompileTimeline();
+	}
+	return *Timeline;
+}
+
+//==========================================================================
+//
+// MIDISource :: InvalidateTimeline
+//
+// For subclasses when they change what they play. This also drops what
+// AnalyzeSong found out.
+//
+//==========================================================================
+
+void MIDISource::InvalidateTimeline()
+{
+	Timeline.reset();
+	SongInfo.reset();
+	PlayingTimeline = false;
+}
+
+//==========================================================================
+//
+// MIDISource :: SetCaps
+//
+// Lets the subclass know which kind of device it plays on. The timeline
+// has to be compiled again if that is a different one than before.
+//
+//==========================================================================
+
+void MIDISource::SetCaps(int tech)
+{
+	CheckCaps(tech);
+	if (tech != Technology)
+	{
+		Technology = tech;
+		InvalidateTimeline();
+	}
+}
+
+//==========================================================================
+//
+// MIDISource :: SkipSysex
+//
+//==========================================================================
+
+void MIDISource::SkipSysex()
+{
+	if (!skipSysex)
+	{
+		skipSysex = true;
+		InvalidateTimeline();
+	}
+}
+
+//==========================================================================
+//
+// MIDISource :: StartPlayback
+//
+// Compiles the timeline right away, so that RestartPlayback does not have
+// to while the song is playing.
+//
+//==========================================================================
+
+void MIDISource::StartPlayback(bool looped, int looplimit)
+{
+	auto &timeline = GetTimeline();
+	Tempo = InitialTempo;
+	LoopLimit = looplimit;
+	isLooping = looped;
+	SeekState.clear();
+	SeekStatePos = 0;
+	TimelinePos = 0;
+	TimelineTick = 0;
+	PlayingTimeline = !timeline.HasLoops || LoopLimit == 1;
+}
+
+//==========================================================================
+//
+// MIDISource :: MakeTimelineEvents
+//
+// MakeEvents for playing from the timeline, after the state a seek has
+// to restore.
+//
+//==========================================================================
+
+uint32_t *MIDISource::MakeTimelineEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time)
+{
+	auto &timeline = *Timeline;
+	size_t numevents = timeline.Messages.size();
+	uint32_t tot_time = 0;
+
+	while (SeekStatePos < SeekState.size())
+	{
+		size_t len = EventSize(&SeekState[SeekStatePos]);
+		if (events + len > max_event_p)
+		{
+			return events;
+		}
+		memcpy(events, &SeekState[SeekStatePos], len * sizeof(uint32_t));
+		events += len;
+		SeekStatePos += len;
+	}
+
+	// Like the subclasses, play everything at the same tick before stopping.
+	while (TimelinePos < numevents && (tot_time <= max_time || timeline.Ticks[TimelinePos] == TimelineTick))
+	{
+		uint32_t message = timeline.Messages[TimelinePos];
+		uint32_t delay = timeline.Ticks[TimelinePos] - TimelineTick;
+		size_t len = message < 0x80000000 ? 3 : 3 + ((MEVENT_EVENTPARM(message) + 3) >> 2);
+		if (events + len > max_event_p)
+		{
+			break;
+		}
+		events[0] = delay;		// dwDeltaTime
+		events[1] = 0;			// dwStreamID
+		events[2] = message;	// dwEvent
+		tot_time += uint32_t(uint64_t(delay) * Tempo / Division);
+
+		if (MEVENT_EVENTTYPE(message) == MEVENT_LONGMSG)
+		{
+			memcpy(&events[3], &timeline.SysexPool[timeline.SysexOffsets[TimelinePos]], (len - 3) * sizeof(uint32_t));
+		}
+		else if (MEVENT_EVENTTYPE(message) == MEVENT_TEMPO)
+		{
+			Tempo = MEVENT_EVENTPARM(message);
+		}
+		else if (MEVENT_EVENTTYPE(message) == 0 && (message & 0xf0) == MIDI_CTRLCHANGE && ((message >> 8) & 0x7f) == 7)
+		{ // The timeline has the volumes as they are in the song.
+			events[2] = (message & 0xffff) | (VolumeControllerChange(message & 0x0f, (message >> 16) & 0x7f) << 16);
+		}
+
+		events += len;
+		TimelineTick = timeline.Ticks[TimelinePos];
+		TimelinePos++;
+	}
+	return events;
+}
+
+//==========================================================================
+//
+// MIDISource :: CheckPlaybackDone
+//
+//==========================================================================
+
+bool MIDISource::CheckPlaybackDone()
+{
+	if (PlayingTimeline)
+	{
+		return SeekStatePos >= SeekState.size() && TimelinePos >= Timeline->Messages.size();
+	}
+	return CheckDone();
+}
+
+//==========================================================================
+//
+// MIDISource :: RestartPlayback
+//
+// The timeline plays every loop just once, so songs that may need to
+// repeat any of them are left to the subclass.
+//
+//==========================================================================
+
+void MIDISource::RestartPlayback()
+{
+	auto &timeline = GetTimeline();
+	DoRestart();
+	SeekState.clear();
+	SeekStatePos = 0;
+	TimelinePos = 0;
+	TimelineTick = 0;
+	PlayingTimeline = !timeline.HasLoops || LoopLimit == 1;
+}
+
+//==========================================================================
+//
+// MIDISource :: MakePlaybackEvents
+//
+//==========================================================================
+
+uint32_t *MIDISource::MakePlaybackEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time)
+{
+	if (PlayingTimeline)
+	{
+		ZMSX_TRACE_ZONE("MIDISource::MakeTimelineEvents");
+		return MakeTimelineEvents(events, max_event_p, max_time);
+	}
+	ZMSX_TRACE_ZONE("MIDISource::MakeEvents");
+	return MakeEvents(events, max_event_p, max_time);
+}
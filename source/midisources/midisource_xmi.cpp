@@ -103,11 +103,10 @@ struct XMISong::TrackInfo
 //
 //==========================================================================
 
-XMISong::XMISong (const uint8_t* data, size_t len)
-: MusHeader(0), Songs(0)
+XMISong::XMISong (const uint8_t* data, size_t len, std::shared_ptr<void> owner)
+: Songs(0)
 {
-	MusHeader.resize(len);
-	memcpy(MusHeader.data(), data, len);
+	MusHeader.Assign(data, len, std::move(owner));
 
 	// Find all the songs in this file.
 	NumSongs = FindXMIDforms(&MusHeader[0], (int)MusHeader.size(), nullptr);
@@ -220,7 +219,11 @@ bool XMISong::SetMIDISubsong(int subsong)
 	{
 		return false;
 	}
-	CurrSong = &Songs[subsong];
+	if (CurrSong != &Songs[subsong])
+	{
+		CurrSong = &Songs[subsong];
+		InvalidateTimeline();
+	}
 	return true;
 }
 
@@ -444,10 +447,18 @@ uint32_t *XMISong::SendCommand (uint32_t *events, EventSource due, uint32_t dela
 					track->ForLoops[track->ForDepth].LoopFinished = track->Finished;
 				}
 				track->ForDepth++;
+				if (data2 == 0)
+				{ // Only endless loops mark where the song loops to.
+					events[2] = (MEVENT_NOP << 24) | MEVENT_NOP_LOOPBEGIN;
+				}
 				event = MIDI_META;
 				break;
 
 			case 117:	// XMI next loop controller
+				if (data2 >= 64)
+				{
+					events[2] = (MEVENT_NOP << 24) | MEVENT_NOP_LOOPEND;
+				}
 				if (track->ForDepth > 0)
 				{
 					int depth = track->ForDepth - 1;
@@ -558,8 +569,8 @@ uint32_t *XMISong::SendCommand (uint32_t *events, EventSource due, uint32_t dela
 	{
 		track->Delay = track->ReadDelay();
 	}
-	// Advance events pointer unless this is a non-delaying NOP.
-	if (events[0] != 0 || MEVENT_EVENTTYPE(events[2]) != MEVENT_NOP)
+	// Advance events pointer unless this is a non-delaying NOP without a loop marker.
+	if (events[0] != 0 || events[2] != (MEVENT_NOP << 24))
 	{
 		if (MEVENT_EVENTTYPE(events[2]) == MEVENT_LONGMSG)
 		{
@@ -40,6 +40,7 @@
 #include <assert.h>
 #include "zmsx/zmsx.hpp"
 #include "zmsx/musinfo.h"
+#include "zmsx/resampler.h"
 #include "mididevices/mididevice.h"
 #include "midisources/midisource.h"
 #include "critsec.h"
@@ -65,13 +66,13 @@ enum
 
 // Base class for streaming MUS and MIDI files ------------------------------
 
-class MIDIStreamer : public MusInfo
+class MIDIStreamer : public MusInfo, protected MIDISequencer
 {
 public:
 	MIDIStreamer(ZMSXMidiDevice type, const char* args);
 	~MIDIStreamer();
 
-	void MusicVolumeChanged() override;
+	void MusicVolumeChanged(float volume) override;
 	void Play(bool looping, int subsong) override;
 	void Pause() override;
 	void Resume() override;
@@ -79,6 +80,8 @@ public:
 	bool IsPlaying() override;
 	bool IsMIDI() const override;
 	bool IsValid() const override;
+	bool SetPosition(unsigned int ms) override;
+	bool GetSongInfo(ZMSXSongInfo &info) override;
 	bool SetSubsong(int subsong) override;
 	void Update() override;
 	std::string GetStats() override;
@@ -88,7 +91,9 @@ public:
 	int ServiceEvent();
 	void SetMIDISource(MIDISource* _source);
 	bool ServiceStream(void* buff, int len) override;
+	void PrepareRealtime() override;
 	ZMSXSoundStreamInfoEx GetStreamInfoEx() const override;
+	size_t GetBufferBytes() const override { return MusInfo::GetBufferBytes() + Resampler.GetBufferBytes(); }
 
 	int GetDeviceType() const override;
 
@@ -101,6 +106,8 @@ protected:
 	void OutputVolume(uint32_t volume);
 	int FillBuffer(int buffer_num, int max_events, uint32_t max_time);
 	int FillStopBuffer(int buffer_num);
+	uint32_t *WriteEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time);
+	uint32_t *PullEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time) override;
 	uint32_t* WriteStopNotes(uint32_t* events);
 	int VolumeControllerChange(int channel, int volume);
 	void SetTempo(int new_tempo);
@@ -111,7 +118,6 @@ protected:
 	//void SetMidiSynth(MIDIDevice *synth);
 
 
-	static ZMSXMidiDevice SelectMIDIDevice(ZMSXMidiDevice devtype);
 	MIDIDevice* CreatZMSXMidiDevice(ZMSXMidiDevice devtype, int samplerate);
 
 	static void Callback(void* userdata);
@@ -124,6 +130,7 @@ protected:
 	};
 
 	std::unique_ptr<MIDIDevice> MIDI;
+	MIDIDeviceKey DeviceKey;
 	uint32_t Events[2][MAX_MIDI_EVENTS * 3];
 	MidiHeader Buffer[2];
 	int BufferNum;
@@ -131,6 +138,7 @@ protected:
 	bool VolumeChanged;
 	bool Restarting;
 	bool InitialPlayback;
+	bool Pulling = false;	// The device takes its events from PullEvents instead of the buffers.
 	uint32_t NewVolume;
 	uint32_t Volume;
 	ZMSXMidiDevice DeviceType;
@@ -138,6 +146,7 @@ protected:
 	int LoopLimit;
 	std::string Args;
 	std::unique_ptr<MIDISource> source;
+	StreamResampler Resampler;
 };
 
 
@@ -156,6 +165,8 @@ MIDIStreamer::MIDIStreamer(ZMSXMidiDevice type, const char *args)
   DeviceType(type), Args(args)
 {
 	memset(Buffer, 0, sizeof(Buffer));
+	auto config = GetConfig();
+	Resampler.SetTarget(config->misc.snd_outputrate, config->misc.snd_resampler);
 }
 
 //==========================================================================
@@ -196,13 +207,14 @@ bool MIDIStreamer::IsValid() const
 
 //==========================================================================
 //
-// MIDIStreamer :: SelectMIDIDevice									static
+// SelectMIDIDevice
 //
-// Select the MIDI device to play on
+// Select the MIDI device to play on. zmsx_render_batch uses this as well
+// to find out what songs opened with the default device will play on.
 //
 //==========================================================================
 
-ZMSXMidiDevice MIDIStreamer::SelectMIDIDevice(ZMSXMidiDevice device)
+ZMSXMidiDevice SelectMIDIDevice(ZMSXMidiDevice device)
 {
 	/* MIDI are played as:
 		- OPL:
@@ -224,7 +236,7 @@ ZMSXMidiDevice MIDIStreamer::SelectMIDIDevice(ZMSXMidiDevice device)
 	{
 		return device;
 	}
-	switch (miscConfig.snd_mididevice)
+	switch (GetConfig()->misc.snd_mididevice)
 	{
 	case -1:		return zmsx_mdev_sndsys;
 	case -2:		return zmsx_mdev_timidity;
@@ -281,9 +293,9 @@ MIDIDevice *MIDIStreamer::CreatZMSXMidiDevice(ZMSXMidiDevice devtype, int sample
 
 #ifdef HAVE_SYSTEM_MIDI
 #ifdef _WIN32
-				dev = CreateWinMIDIDevice(std::max(0, miscConfig.snd_mididevice));
+				dev = CreateWinMIDIDevice(std::max(0, GetConfig()->misc.snd_mididevice));
 #elif __linux__
-                dev = CreateAlsaMIDIDevice(std::max(0, miscConfig.snd_mididevice));
+                dev = CreateAlsaMIDIDevice(std::max(0, GetConfig()->misc.snd_mididevice));
 #endif
 				break;
 #endif
@@ -370,8 +382,21 @@ void MIDIStreamer::Play(bool looping, int subsong)
 	m_Looping = looping;
 	source->SetMIDISubsong(subsong);
 	devtype = SelectMIDIDevice(DeviceType);
-	MIDI.reset(CreatZMSXMidiDevice(devtype, miscConfig.snd_outputrate));
-	InitPlayback();
+	DeviceKey.DeviceType = devtype;
+	DeviceKey.Args = Args;
+	DeviceKey.SampleRate = GetConfig()->misc.snd_outputrate;
+	DeviceKey.Realtime = GetConfig()->misc.snd_realtime != 0;
+	MIDI.reset(MIDIDevicePool::Take(DeviceKey));
+	if (MIDI == nullptr)
+	{
+		MIDI.reset(CreatZMSXMidiDevice(devtype, DeviceKey.SampleRate));
+	}
+	Resampler.Stop();
+	if (InitPlayback())
+	{
+		// Some devices have a fixed rate of their own.
+		Resampler.Start(MIDI->GetStreamInfoEx());
+	}
 }
 
 //==========================================================================
@@ -393,7 +418,16 @@ bool MIDIStreamer::DumpWave(const char *filename, int subsong, int samplerate)
 		throw std::runtime_error("System MIDI device is not supported");
 	}
 	auto iMIDI = CreatZMSXMidiDevice(devtype, samplerate);
-	auto writer = new MIDIWaveWriter(filename, static_cast<SoftSynthMIDIDevice*>(iMIDI));
+	MIDIWaveWriter *writer;
+	try
+	{
+		writer = new MIDIWaveWriter(filename, static_cast<SoftSynthMIDIDevice*>(iMIDI));
+	}
+	catch (...)
+	{
+		delete iMIDI;
+		throw;
+	}
 	MIDI.reset(writer);
 	bool res = InitPlayback();
 	if (!writer->CloseFile())
@@ -425,8 +459,9 @@ bool MIDIStreamer::InitPlayback()
 		throw std::runtime_error("Could not open MIDI out device");
 	}
 
-	source->CheckCaps(MIDI->GetTechnology());
+	source->SetCaps(MIDI->GetTechnology());
 	if (!MIDI->CanHandleSysex()) source->SkipSysex();
+	Pulling = MIDI->SetSequencer(this);
 
 	StartPlayback();
 	if (MIDI == nullptr)
@@ -449,6 +484,7 @@ bool MIDIStreamer::InitPlayback()
 
 ZMSXSoundStreamInfoEx MIDIStreamer::GetStreamInfoEx() const
 {
+	if (MIDI && Resampler.IsActive()) return Resampler.GetFormat();
 	if (MIDI) return MIDI->GetStreamInfoEx();
 	else return {};
 }
@@ -461,6 +497,8 @@ ZMSXSoundStreamInfoEx MIDIStreamer::GetStreamInfoEx() const
 
 void MIDIStreamer::StartPlayback()
 {
+	// zmsx_get_song_info cannot go through the song anymore once it plays.
+	source->AnalyzeSong();
 	auto data = source->PrecacheData();
 	MIDI->PrecacheInstruments(data.data(), (int)data.size());
 	source->StartPlayback(m_Looping);
@@ -472,10 +510,14 @@ void MIDIStreamer::StartPlayback()
 		throw std::runtime_error("Setting MIDI stream speed failed");
 	}
 
-	MusicVolumeChanged();	// set volume to current music's properties
+	MusicVolumeChanged(GetConfig()->misc.MusicVolume());	// set volume to current music's properties
 	OutputVolume(Volume);
 
 	MIDI->InitPlayback();
+	if (Pulling)
+	{ // The device gets everything once it starts rendering.
+		return;
+	}
 
 	// Fill the initial buffers for the song.
 	BufferNum = 0;
@@ -563,13 +605,19 @@ void MIDIStreamer::Stop()
 	if (MIDI != NULL && MIDI->IsOpen())
 	{
 		MIDI->Stop();
+		if (Pulling)
+		{
+			MIDI->SetSequencer(nullptr);
+			Pulling = false;
+		}
 		MIDI->UnprepareHeader(&Buffer[0]);
 		MIDI->UnprepareHeader(&Buffer[1]);
 		MIDI->Close();
 	}
 	if (MIDI != nullptr)
 	{
-		MIDI.reset();
+		// The next song on the same device can pick it up again.
+		MIDIDevicePool::Put(DeviceKey, MIDI.release());
 	}
 	m_Status = STATE_Stopped;
 }
@@ -582,15 +630,16 @@ void MIDIStreamer::Stop()
 
 bool MIDIStreamer::IsPlaying()
 {
-	if (m_Status != STATE_Stopped && (MIDI == NULL || (EndQueued != 0 && EndQueued < 4)))
+	// Once a stop has been requested the device is gone or about to be,
+	// so it must not be looked at anymore.
+	if (IsStopPending())
 	{
-		std::lock_guard<FCriticalSection> lock(CritSec);
-		Stop();
+		return false;
 	}
-	if (m_Status != STATE_Stopped && !MIDI->IsOpen())
+	if (m_Status != STATE_Stopped && (MIDI == NULL || (EndQueued != 0 && EndQueued < 4) || !MIDI->IsOpen()))
 	{
-		std::lock_guard<FCriticalSection> lock(CritSec);
-		Stop();
+		RequestStop();
+		return false;
 	}
 	return m_Status != STATE_Stopped;
 }
@@ -604,11 +653,10 @@ bool MIDIStreamer::IsPlaying()
 //
 //==========================================================================
 
-void MIDIStreamer::MusicVolumeChanged()
+void MIDIStreamer::MusicVolumeChanged(float realvolume)
 {
 	if (MIDI != NULL && MIDI->FakeVolume())
 	{
-		float realvolume = miscConfig.snd_musicvolume * miscConfig.relative_volume * miscConfig.snd_mastervolume;
 		if (realvolume < 0 || realvolume > 1) realvolume = 1;
 		Volume = (uint32_t)(realvolume * 65535.f);
 	}
@@ -711,10 +759,9 @@ void MIDIStreamer::Callback(void *userdata)
 
 void MIDIStreamer::Update()
 {
-	if (MIDI != nullptr && !MIDI->Update())
+	if (!IsStopPending() && MIDI != nullptr && !MIDI->Update())
 	{
-		std::lock_guard<FCriticalSection> lock(CritSec);
-		Stop();
+		RequestStop();
 	}
 }
 
@@ -800,17 +847,46 @@ fill:
 
 int MIDIStreamer::FillBuffer(int buffer_num, int max_events, uint32_t max_time)
 {
-	if (!Restarting && source->CheckDone())
+	int i;
+	uint32_t *events = Events[buffer_num], *max_event_p;
+
+	// The final event is for a NOP to hold the delay from the last event.
+	max_event_p = events + (max_events - 1) * 3;
+
+	events = WriteEvents(events, max_event_p, max_time);
+	if (events == nullptr)
 	{
 		return SONG_DONE;
 	}
+	memset(&Buffer[buffer_num], 0, sizeof(MidiHeader));
+	Buffer[buffer_num].lpData = (uint8_t *)Events[buffer_num];
+	Buffer[buffer_num].dwBufferLength = uint32_t((uint8_t *)events - Buffer[buffer_num].lpData);
+	Buffer[buffer_num].dwBytesRecorded = Buffer[buffer_num].dwBufferLength;
+	if (0 != (i = MIDI->PrepareHeader(&Buffer[buffer_num])))
+	{
+		return SONG_ERROR | (i << 2);
+	}
+	return SONG_MORE;
+}
 
-	int i;
-	uint32_t *events = Events[buffer_num], *max_event_p;
+//==========================================================================
+//
+// MIDIStreamer :: WriteEvents
+//
+// Writes the next events for the device to events, up to max_event_p or
+// until max_time is used up: Those of the song, and whatever the streamer
+// itself needs to send. Returns nullptr if the song's end was reached.
+//
+//==========================================================================
 
+uint32_t *MIDIStreamer::WriteEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time)
+{
+	if (!Restarting && source->CheckPlaybackDone())
+	{
+		return nullptr;
+	}
 
-	// The final event is for a NOP to hold the delay from the last event.
-	max_event_p = events + (max_events - 1) * 3;
+	int i;
 
 	if (InitialPlayback)
 	{
@@ -869,19 +945,46 @@ int MIDIStreamer::FillBuffer(int buffer_num, int max_events, uint32_t max_time)
 			events += 3;
 			// Stop all notes in case any were left hanging.
 			events = WriteStopNotes(events);
-			source->DoRestart();
+			source->RestartPlayback();
 		}
-		events = source->MakeEvents(events, max_event_p, max_time);
+		events = source->MakePlaybackEvents(events, max_event_p, max_time);
 	}
-	memset(&Buffer[buffer_num], 0, sizeof(MidiHeader));
-	Buffer[buffer_num].lpData = (uint8_t *)Events[buffer_num];
-	Buffer[buffer_num].dwBufferLength = uint32_t((uint8_t *)events - Buffer[buffer_num].lpData);
-	Buffer[buffer_num].dwBytesRecorded = Buffer[buffer_num].dwBufferLength;
-	if (0 != (i = MIDI->PrepareHeader(&Buffer[buffer_num])))
+	return events;
+}
+
+//==========================================================================
+//
+// MIDIStreamer :: PullEvents
+//
+// Called by the device on the rendering thread when it wants more events,
+// instead of the buffers going back and forth through ServiceEvent. So
+// max_time is only as much as the device has yet to render.
+//
+//==========================================================================
+
+uint32_t *MIDIStreamer::PullEvents(uint32_t *events, uint32_t *max_event_p, uint32_t max_time)
+{
+	if (EndQueued != 0)
 	{
-		return SONG_ERROR | (i << 2);
+		return events;
 	}
-	return SONG_MORE;
+	uint32_t *end = WriteEvents(events, max_event_p, max_time);
+	if (end == nullptr && m_Looping)
+	{
+		Restarting = true;
+		end = WriteEvents(events, max_event_p, max_time);
+	}
+	if (end == nullptr)
+	{
+		// Same as FillStopBuffer. The next call ends the song.
+		end = WriteStopNotes(events);
+		end[0] = 500;
+		end[1] = 0;
+		end[2] = MEVENT_NOP << 24;
+		end += 3;
+		EndQueued = 2;
+	}
+	return end;
 }
 
 //==========================================================================
@@ -974,6 +1077,89 @@ std::string MIDIStreamer::GetStats()
 	return MIDI->GetStats();
 }
 
+//==========================================================================
+//
+// MIDIStreamer :: SetPosition
+//
+// Drops the events already queued on the device and refills its buffers
+// from the new position. Devices that cannot drop them play them first.
+//
+//==========================================================================
+
+bool MIDIStreamer::SetPosition(unsigned int ms)
+{
+	if (MIDI == nullptr || m_Status == STATE_Stopped || EndQueued != 0)
+	{
+		return false;
+	}
+	if (!source->Seek(ms))
+	{
+		return false;
+	}
+	if (!MIDI->FlushStream())
+	{
+		return true;
+	}
+	Restarting = false;
+	if (Pulling)
+	{ // The device asks for the events from the new position itself.
+		return true;
+	}
+	MIDI->UnprepareHeader(&Buffer[0]);
+	MIDI->UnprepareHeader(&Buffer[1]);
+
+	BufferNum = 0;
+	do
+	{
+		int res = FillBuffer(BufferNum, MAX_MIDI_EVENTS, MAX_TIME);
+		if ((res & 3) == SONG_MORE)
+		{
+			if (0 != MIDI->StreamOutSync(&Buffer[BufferNum]))
+			{
+				throw std::runtime_error("midiStreamOut failed");
+			}
+			BufferNum ^= 1;
+		}
+		else if ((res & 3) == SONG_DONE && m_Looping)
+		{
+			Restarting = true;
+		}
+		else
+		{
+			// Sent when the device is done with what it has got.
+			EndQueued = 1;
+			break;
+		}
+	}
+	while (BufferNum != 0);
+	return true;
+}
+
+//==========================================================================
+//
+// MIDIStreamer :: GetSongInfo
+//
+//==========================================================================
+
+bool MIDIStreamer::GetSongInfo(ZMSXSongInfo &info)
+{
+	if (source == nullptr || !source->isValid())
+	{
+		return false;
+	}
+	if (m_Status != STATE_Stopped && !source->HasSongInfo())
+	{
+		return false;
+	}
+	auto &songinfo = source->AnalyzeSong();
+	info.duration_ms = songinfo.Duration;
+	info.loop_start_ms = songinfo.LoopStart;
+	info.loop_end_ms = songinfo.LoopEnd;
+	info.num_tempo_changes = (int)songinfo.TempoChanges.size();
+	info.tempo_changes = songinfo.TempoChanges.data();
+	return true;
+}
+
 //==========================================================================
 //
 // MIDIStreamer :: SetSubsong
@@ -1002,7 +1188,29 @@ bool MIDIStreamer::SetSubsong(int subsong)
 bool MIDIStreamer::ServiceStream(void* buff, int len)
 {
 	if (!MIDI) return false;
-	return static_cast<SoftSynthMIDIDevice*>(MIDI.get())->ServiceStream(buff, len);
+	auto device = static_cast<SoftSynthMIDIDevice*>(MIDI.get());
+	bool res;
+	if (Resampler.IsActive())
+	{
+		res = Resampler.Read(buff, len, [](void *ctx, void *b, int l) { return static_cast<SoftSynthMIDIDevice*>(ctx)->ServiceStream(b, l); }, device);
+	}
+	else
+	{
+		res = device->ServiceStream(buff, len);
+	}
+	m_Perf.AddWork(device->TakeWork(), device->GetActiveVoices());
+	return res;
+}
+
+//==========================================================================
+//
+// MIDIStreamer :: PrepareRealtime
+//
+//==========================================================================
+
+void MIDIStreamer::PrepareRealtime()
+{
+	if (MIDI) MIDI->PrepareRealtime();
 }
 
 //==========================================================================
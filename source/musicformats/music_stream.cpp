@@ -34,6 +34,9 @@
 
 #include "zmsx/musinfo.h"
 #include "zmsx/zmsx.hpp"
+#include "zmsx/midiconfig.h"
+#include "zmsx/resampler.h"
+#include "zmsx/trace.h"
 #include "streamsources/streamsource.h"
 
 class StreamSong : public MusInfo
@@ -50,16 +53,21 @@ public:
 	bool SetPosition (unsigned int pos) override;
 	bool SetSubsong (int subsong) override;
 	std::string GetStats() override;
+	bool GetSongInfo(ZMSXSongInfo &info) override { return m_Source != nullptr && m_Source->GetSongInfo(info); }
 	void ChangeSettingInt(const char *name, int value) override { if (m_Source) m_Source->ChangeSettingInt(name, value); }
 	void ChangeSettingNum(const char *name, double value) override { if (m_Source) m_Source->ChangeSettingNum(name, value); }
 	void ChangeSettingString(const char *name, const char *value) override { if(m_Source) m_Source->ChangeSettingString(name, value); }
 	bool ServiceStream(void* buff, int len) override;
-	ZMSXSoundStreamInfoEx GetStreamInfoEx() const override { return m_Source->GetFormatEx(); }
+	void PrepareRealtime() override { if (m_Source) m_Source->PrepareRealtime(); }
+	ZMSXSoundStreamInfoEx GetStreamInfoEx() const override { return m_Resampler.IsActive() ? m_Resampler.GetFormat() : m_Source->GetFormatEx(); }
+	size_t GetBufferBytes() const override { return MusInfo::GetBufferBytes() + m_Resampler.GetBufferBytes(); }
 
 
 protected:
+	bool ReadSource(void *buff, int len);
 
 	StreamSource *m_Source = nullptr;
+	StreamResampler m_Resampler;
 };
 
 
@@ -76,6 +84,7 @@ void StreamSong::Play (bool looping, int subsong)
 		if (m_Source->Start())
 		{
 			m_Status = STATE_Playing;
+			m_Resampler.Start(m_Source->GetFormatEx());
 		}
 	}
 }
@@ -108,6 +117,8 @@ StreamSong::~StreamSong ()
 StreamSong::StreamSong (StreamSource *source)
 {
 	m_Source = source;
+	auto config = GetConfig();
+	m_Resampler.SetTarget(config->misc.snd_outputrate, config->misc.snd_resampler);
 }
 
 bool StreamSong::IsPlaying ()
@@ -155,8 +166,9 @@ std::string StreamSong::GetStats()
 	return s1 + "\n" + s2;
 }
 
-bool StreamSong::ServiceStream (void *buff, int len)
+bool StreamSong::ReadSource (void *buff, int len)
 {
+	ZMSX_TRACE_ZONE("StreamSource::GetData");
 	bool written = m_Source->GetData(buff, len);
 	if (!written)
 	{
@@ -167,6 +179,15 @@ bool StreamSong::ServiceStream (void *buff, int len)
 	return true;
 }
 
+bool StreamSong::ServiceStream (void *buff, int len)
+{
+	if (m_Resampler.IsActive())
+	{
+		return m_Resampler.Read(buff, len, [](void *ctx, void *b, int l) { return static_cast<StreamSong*>(ctx)->ReadSource(b, l); }, this);
+	}
+	return ReadSource(buff, len);
+}
+
 MusInfo *OpenStreamSong(StreamSource *source)
 {
 	auto song = new StreamSong(source);
@@ -54,19 +54,19 @@
 
 // TYPES -------------------------------------------------------------------
 
-DumbConfig dumbConfig;
-
 class DumbSong : public StreamSource
 {
 public:
-	DumbSong(DUH *myduh, int samplerate);
+	DumbSong(DUH *myduh, int samplerate, const DumbConfig &dumbConfig);
 	~DumbSong();
 	//bool SetPosition(int ms);
 	bool SetSubsong(int subsong) override;
 	bool Start() override;
 	ZMSXSoundStreamInfoEx GetFormatEx() override;
 	void ChangeSettingNum(const char* setting, double val) override;
+	void PrepareRealtime() override;
 	std::string GetStats() override;
+	bool GetSongInfo(ZMSXSongInfo &info) override;
 
 	std::string Codec;
 	std::string TrackerVersion;
@@ -549,6 +549,11 @@ DUMBFILE *dumb_read_allfile(dumbfile_mem_status *filestate, uint8_t *start, Musi
 	filestate->offset = 0;
 	if (lenhave >= lenfull)
 		filestate->ptr = (uint8_t *)start;
+	else if (auto contents = reader->contents())
+	{
+		// The file is already in memory so it can be read in place.
+		filestate->ptr = contents + reader->tell() - lenhave;
+	}
     else
     {
         uint8_t *mem = new uint8_t[lenfull];
@@ -572,7 +577,7 @@ DUMBFILE *dumb_read_allfile(dumbfile_mem_status *filestate, uint8_t *start, Musi
 //
 //==========================================================================
 
-static void MOD_SetAutoChip(DUH *duh)
+static void MOD_SetAutoChip(DUH *duh, const DumbConfig &dumbConfig)
 {
 	int size_force = dumbConfig.mod_autochip_size_force;
 	int size_scan = dumbConfig.mod_autochip_size_scan;
@@ -760,6 +765,7 @@ static void MOD_SetAutoChip(DUH *duh)
 
 StreamSource* MOD_OpenSong(MusicIO::FileInterface *reader, int samplerate)
 {
+	auto config = GetConfig();
 	DUH *duh = 0;
 	int headsize;
 	union
@@ -927,11 +933,11 @@ StreamSource* MOD_OpenSong(MusicIO::FileInterface *reader, int samplerate)
 	}
 	if ( duh )
 	{
-		if (dumbConfig.mod_autochip)
+		if (config->dumb.mod_autochip)
 		{
-			MOD_SetAutoChip(duh);
+			MOD_SetAutoChip(duh, config->dumb);
 		}
-		state = new DumbSong(duh, samplerate);
+		state = new DumbSong(duh, samplerate, config->dumb);
 
 		if (is_it) ReadIT(filestate.ptr, size, state, false);
 		else ReadDUH(duh, state, false, is_dos);
@@ -941,7 +947,7 @@ StreamSource* MOD_OpenSong(MusicIO::FileInterface *reader, int samplerate)
 		// Reposition file pointer for other codecs to do their checks.
         reader->seek(fpos, SEEK_SET);
 	}
-	if (filestate.ptr != (uint8_t *)start)
+	if (filestate.ptr != (uint8_t *)start && reader->contents() == nullptr)
 	{
 		delete[] const_cast<uint8_t *>(filestate.ptr);
 	}
@@ -1006,7 +1012,7 @@ void DumbSong::ChangeSettingNum(const char* setting, double val)
 //
 //==========================================================================
 
-DumbSong::DumbSong(DUH* myduh, int samplerate)
+DumbSong::DumbSong(DUH* myduh, int samplerate, const DumbConfig &dumbConfig)
 {
 	duh = myduh;
 	sr = NULL;
@@ -1063,6 +1069,21 @@ bool DumbSong::Start()
 	return started;
 }
 
+//==========================================================================
+//
+// DumbSong :: PrepareRealtime
+//
+// Songs that end by setting speed or global volume to zero still get a new
+// renderer when they loop, which allocates.
+//
+//==========================================================================
+
+void DumbSong::PrepareRealtime()
+{
+	// Clients rarely ask for more than the stream buffer at once.
+	dumb_it_sr_preallocate(duh_get_it_sigrenderer(sr), GetFormatEx().buffer_size / 8);
+}
+
 //==========================================================================
 //
 // DumbSong :: SetSubsong
@@ -1187,6 +1208,36 @@ retry:
 	return written;
 }
 
+//==========================================================================
+//
+// DumbSong :: GetSongInfo
+//
+// The modules are loaded without going through them, so the length is
+// only known after doing that here. The checkpoints this builds are shared
+// with the renderer, so it can only be done before the song starts. The
+// length is for playing from the first order.
+//
+//==========================================================================
+
+bool DumbSong::GetSongInfo(ZMSXSongInfo &info)
+{
+	if (start_order != 0)
+	{
+		return false;
+	}
+	if (duh_get_length(duh) <= 0 && !started)
+	{
+		dumb_it_do_initial_runthrough(duh);
+	}
+	int32_t length = duh_get_length(duh);
+	if (length <= 0)
+	{
+		return false;
+	}
+	info.duration_ms = int(length * 1000. / 65536);
+	return true;
+}
+
 //==========================================================================
 //
 // DumbSong :: GetStats
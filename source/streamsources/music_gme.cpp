@@ -58,6 +58,7 @@ public:
 	bool Start() override;
 	void ChangeSettingNum(const char *name, double val) override;
 	std::string GetStats() override;
+	bool GetSongInfo(ZMSXSongInfo &info) override;
 	bool GetData(void *buffer, size_t len) override;
 	ZMSXSoundStreamInfoEx GetFormatEx() override;
 
@@ -127,24 +128,32 @@ StreamSource *GME_OpenSong(MusicIO::FileInterface *reader, const char *fmt, int
     auto fpos = reader->tell();
 	auto len = reader->filelength();
 
-	song = new uint8_t[len];
-    if (reader->read(song, len) != len)
-    {
-        delete[] song;
-        gme_delete(emu);
-        reader->seek(fpos, SEEK_SET);
-        return nullptr;
-    }
+	if (auto mem = reader->contents())
+	{
+		// No need for an intermediate copy if the file is already in memory.
+		err = gme_load_data(emu, mem, (long)len);
+	}
+	else
+	{
+		song = new uint8_t[len];
+		if (reader->read(song, len) != len)
+		{
+			delete[] song;
+			gme_delete(emu);
+			reader->seek(fpos, SEEK_SET);
+			return nullptr;
+		}
 
-	err = gme_load_data(emu, song, (long)len);
-    delete[] song;
+		err = gme_load_data(emu, song, (long)len);
+		delete[] song;
+	}
 
 	if (err != nullptr)
 	{
 		gme_delete(emu);
 		throw std::runtime_error(err);
 	}
-	gme_set_stereo_depth(emu, std::min(std::max(miscConfig.gme_stereodepth, 0.f), 1.f));
+	gme_set_stereo_depth(emu, std::min(std::max(GetConfig()->misc.gme_stereodepth, 0.f), 1.f));
 	gme_set_fade(emu, -1); // Enable infinite loop
 
 #if GME_VERSION >= 0x602
@@ -298,6 +307,38 @@ std::string GMESong::GetStats()
 	return out;
 }
 
+//==========================================================================
+//
+// GMESong :: GetSongInfo
+//
+// This gets its own copy of the track info, since the rendering thread
+// replaces TrackInfo when it restarts the track.
+//
+//==========================================================================
+
+bool GMESong::GetSongInfo(ZMSXSongInfo &info)
+{
+	gme_info_t *trackinfo;
+
+	if (gme_track_info(Emu, &trackinfo, CurrTrack) != NULL)
+	{
+		return false;
+	}
+	int intro = trackinfo->intro_length > 0 ? trackinfo->intro_length : 0;
+	if (trackinfo->loop_length > 0)
+	{
+		info.loop_start_ms = intro;
+		info.loop_end_ms = intro + trackinfo->loop_length;
+		info.duration_ms = info.loop_end_ms;
+	}
+	if (trackinfo->length > 0)
+	{
+		info.duration_ms = trackinfo->length;
+	}
+	gme_free_info(trackinfo);
+	return info.duration_ms >= 0;
+}
+
 //==========================================================================
 //
 // GMESong :: GetTrackInfo
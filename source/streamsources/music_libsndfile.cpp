@@ -50,12 +50,15 @@ public:
 	SndFileSong(SoundDecoder *decoder, uint32_t loop_start, uint32_t loop_end, bool startass, bool endass);
 	~SndFileSong();
 	std::string GetStats() override;
+	bool GetSongInfo(ZMSXSongInfo &info) override;
 	ZMSXSoundStreamInfoEx GetFormatEx() override;
 	bool GetData(void *buffer, size_t len) override;
 
 protected:
 	SoundDecoder *Decoder;
 	unsigned int FrameSize;
+	int SampleRate;
+	uint32_t SampleLength;	// 0 if the decoder does not know.
 
 	uint32_t Loop_Start;
 	uint32_t Loop_End;
@@ -442,9 +445,10 @@ SndFileSong::SndFileSong(SoundDecoder *decoder, uint32_t loop_start, uint32_t lo
 	if (!startass) loop_start = Scale(loop_start, srate, 1000);
 	if (!endass) loop_end = Scale(loop_end, srate, 1000);
 
-	const uint32_t sampleLength = (uint32_t)decoder->getSampleLength();
+	SampleRate = srate;
+	SampleLength = (uint32_t)decoder->getSampleLength();
 	Loop_Start = loop_start;
-	Loop_End = sampleLength == 0 ? loop_end : std::min<uint32_t>(loop_end, sampleLength);
+	Loop_End = SampleLength == 0 ? loop_end : std::min<uint32_t>(loop_end, SampleLength);
 	Decoder = decoder;
 	FrameSize = ZMusic_ChannelCount(chanconf) * ZMusic_SampleTypeSize(stype);
 }
@@ -499,6 +503,24 @@ std::string SndFileSong::GetStats()
 	return out;
 }
 
+//==========================================================================
+//
+// SndFileSong :: GetSongInfo
+//
+//==========================================================================
+
+bool SndFileSong::GetSongInfo(ZMSXSongInfo &info)
+{
+	if (SampleRate <= 0 || SampleLength == 0)
+	{
+		return false;
+	}
+	info.duration_ms = Scale(SampleLength, 1000, SampleRate);
+	info.loop_start_ms = Scale(std::min(Loop_Start, SampleLength), 1000, SampleRate);
+	info.loop_end_ms = Scale(Loop_End, 1000, SampleRate);
+	return true;
+}
+
 //==========================================================================
 //
 // SndFileSong :: Read													STATIC
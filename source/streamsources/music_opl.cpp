@@ -52,7 +52,7 @@
 class OPLMUSSong : public StreamSource
 {
 public:
-	OPLMUSSong (MusicIO::FileInterface *reader, OPLConfig *config);
+	OPLMUSSong (MusicIO::FileInterface *reader, const OPLConfig *config);
 	~OPLMUSSong ();
 	bool Start() override;
 	void ChangeSettingInt(const char *name, int value) override;
@@ -72,7 +72,7 @@ protected:
 //
 //==========================================================================
 
-OPLMUSSong::OPLMUSSong(MusicIO::FileInterface* reader, OPLConfig* config)
+OPLMUSSong::OPLMUSSong(MusicIO::FileInterface* reader, const OPLConfig* config)
 {
 	const char* error = nullptr;
 	reader->seek(0, SEEK_END);
@@ -152,7 +152,7 @@ bool OPLMUSSong::GetData(void *buffer, size_t len)
 	return Music->ServiceStream(buffer, int(len)) ? len : 0;
 }
 
-StreamSource *OPL_OpenSong(MusicIO::FileInterface* reader, OPLConfig *config)
+StreamSource *OPL_OpenSong(MusicIO::FileInterface* reader, const OPLConfig *config)
 {
 	return new OPLMUSSong(reader, config);
 }
@@ -23,9 +23,11 @@ public:
 	virtual bool GetData(void *buffer, size_t len) = 0;
 	virtual ZMSXSoundStreamInfoEx GetFormatEx() = 0;
 	virtual std::string GetStats() { return ""; }
+	virtual bool GetSongInfo(ZMSXSongInfo &info) { return false; }
 	virtual void ChangeSettingInt(const char *name, int value) {  }
 	virtual void ChangeSettingNum(const char *name, double value) {  }
 	virtual void ChangeSettingString(const char *name, const char *value) {  }
+	virtual void PrepareRealtime() {}	// Allocate everything GetData would allocate on first use.
 
 protected:
 	StreamSource() = default;
@@ -36,4 +38,4 @@ StreamSource *MOD_OpenSong(MusicIO::FileInterface* reader, int samplerate);
 StreamSource* GME_OpenSong(MusicIO::FileInterface* reader, const char* fmt, int sample_rate);
 StreamSource *SndFile_OpenSong(MusicIO::FileInterface* fr);
 StreamSource* XA_OpenSong(MusicIO::FileInterface* reader);
-StreamSource* OPL_OpenSong(MusicIO::FileInterface* reader, OPLConfig *config);
+StreamSource* OPL_OpenSong(MusicIO::FileInterface* reader, const OPLConfig *config);
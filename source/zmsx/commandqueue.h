@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bounded multiple producer / single consumer queue.
+// Any number of threads may push, only one thread at a time may pop. Neither
+// side ever blocks, a push into a full queue simply fails.
+//
+// Each cell carries a sequence number that tells whether it is free for the
+// producer that claimed its position or holds data for the consumer, so
+// producers only need to agree on the enqueue position.
+
+template<class T, size_t N>
+class MPSCQueue
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "Queue size must be a power of 2");
+
+public:
+	MPSCQueue()
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			Cells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	// Producer side. Returns false if the queue is full.
+	bool Push(const T &data)
+	{
+		Cell *cell;
+		size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &Cells[pos & (N - 1)];
+			size_t seq = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		cell->Data = data;
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Returns false if the queue is empty.
+	bool Pop(T &data)
+	{
+		Cell &cell = Cells[DequeuePos & (N - 1)];
+		size_t seq = cell.Sequence.load(std::memory_order_acquire);
+		if ((intptr_t)seq - (intptr_t)(DequeuePos + 1) < 0)
+		{
+			return false;
+		}
+		data = cell.Data;
+		cell.Sequence.store(DequeuePos + N, std::memory_order_release);
+		DequeuePos++;
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Data;
+	};
+
+	Cell Cells[N];
+	alignas(64) std::atomic<size_t> EnqueuePos{ 0 };
+	alignas(64) size_t DequeuePos = 0;
+};
+
+// A control request for a song that gets carried out by the thread that is
+// rendering it. Strings are stored inline so that posting a command does
+// not need to allocate and executing it does not need to free anything.
+
+struct MusCommand
+{
+	enum EType
+	{
+		Pause,
+		Resume,
+		VolumeChanged,
+		SettingInt,
+		SettingNum,
+		SettingString,
+	};
+
+	EType Type = Pause;
+	int IntValue = 0;
+	double NumValue = 0;
+	char Setting[64] = {};
+	char StrValue[256] = {};
+
+	MusCommand() = default;
+	explicit MusCommand(EType type) : Type(type) {}
+
+	MusCommand(EType type, const char *setting) : Type(type)
+	{
+		strncpy(Setting, setting, sizeof(Setting) - 1);
+	}
+};
+
+typedef MPSCQueue<MusCommand, 64> MusCommandQueue;
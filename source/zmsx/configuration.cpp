@@ -37,12 +37,14 @@
 #include <mmsystem.h>
 #endif
 #include <algorithm>
+#include <mutex>
 #include "critsec.h"
 #include "dumb.h"
 
 #include "zmsx.hpp"
 #include "musinfo.h"
 #include "midiconfig.h"
+#include "mididevices/mididevice.h"
 #include "mididevices/music_alsa_state.h"
 
 #ifdef HAVE_TIMIDITY
@@ -63,9 +65,95 @@ struct Dummy
 #define devType() ((currSong)? (currSong)->GetDeviceType() : zmsx_mdev_default)
 
 
-MiscConfig miscConfig;
 ZMSXCallbacks musicCallbacks;
 
+//==========================================================================
+//
+// The settings as the client has set them so far. Only the zmsx_config_set_*
+// functions touch this, with ConfigMutex held, and everybody else sees it
+// through the snapshots that get published after each change.
+//
+//==========================================================================
+
+static std::mutex ConfigMutex;
+static ConfigSnapshot Staging;
+static ADLConfig &adlConfig = Staging.adl;
+static FluidConfig &fluidConfig = Staging.fluid;
+static OPLConfig &oplConfig = Staging.opl;
+static OpnConfig &opnConfig = Staging.opn;
+static GUSConfig &gusConfig = Staging.gus;
+static TimidityConfig &timidityConfig = Staging.timidity;
+static WildMidiConfig &wildMidiConfig = Staging.wildMidi;
+static DumbConfig &dumbConfig = Staging.dumb;
+static MiscConfig &miscConfig = Staging.misc;
+
+static ConfigPtr &CurrentConfig()
+{
+	static ConfigPtr current = std::make_shared<const ConfigSnapshot>();
+	return current;
+}
+
+ConfigPtr GetConfig()
+{
+	return std::atomic_load(&CurrentConfig());
+}
+
+// Must be called with ConfigMutex held. The banks are shared between the
+// snapshots, so this only copies the scalar settings and a few strings.
+static void PublishConfig()
+{
+	Staging.Version++;
+	std::atomic_store(&CurrentConfig(), ConfigPtr(std::make_shared<const ConfigSnapshot>(Staging)));
+}
+
+//==========================================================================
+//
+// Collects the live changes for the playing song while a setting gets
+// changed. They get posted once the new snapshot is out, so that a device
+// which reads the snapshot when it handles them sees the new values.
+//
+//==========================================================================
+
+class LiveSettings
+{
+public:
+	LiveSettings(MusInfo *song) : Song(song) {}
+
+	int GetDeviceType() const { return Song->GetDeviceType(); }
+
+	void PostSettingInt(const char *setting, int value)
+	{
+		MusCommand cmd(MusCommand::SettingInt, setting);
+		cmd.IntValue = value;
+		Add(cmd);
+	}
+
+	void PostSettingNum(const char *setting, double value)
+	{
+		MusCommand cmd(MusCommand::SettingNum, setting);
+		cmd.NumValue = value;
+		Add(cmd);
+	}
+
+	void Post()
+	{
+		for (int i = 0; i < NumCommands; i++)
+		{
+			Song->PostCommand(Commands[i]);
+		}
+	}
+
+private:
+	void Add(const MusCommand &cmd)
+	{
+		if (NumCommands < 2) Commands[NumCommands++] = cmd;
+	}
+
+	MusInfo *Song;
+	MusCommand Commands[2];
+	int NumCommands = 0;
+};
+
 class SoundFontWrapperInterface : public MusicIO::SoundFontReaderInterface
 {
 	void* handle;
@@ -140,24 +228,37 @@ DLL_EXPORT void zmsx_set_callbacks(const ZMSXCallbacks* cb)
 DLL_EXPORT void zmsx_set_genmidi(const uint8_t* data)
 {
 #ifdef HAVE_OPL
-	memcpy(oplConfig.OPLinstruments, data, 175 * 36);
-	oplConfig.genmidiset = true;
+	{
+		std::lock_guard<std::mutex> lock(ConfigMutex);
+		oplConfig.OPLinstruments = std::make_shared<const std::vector<uint8_t>>(data, data + 175 * 36);
+		oplConfig.genmidiset = true;
+		PublishConfig();
+	}
+	MIDIDevicePool::Invalidate();
 #endif
 }
 
 DLL_EXPORT void zmsx_set_wgopn(const void* data, unsigned len)
 {
 #ifdef HAVE_OPN
-	opnConfig.default_bank.resize(len);
-	memcpy(opnConfig.default_bank.data(), data, len);
+	{
+		std::lock_guard<std::mutex> lock(ConfigMutex);
+		opnConfig.default_bank = std::make_shared<const std::vector<uint8_t>>((const uint8_t*)data, (const uint8_t*)data + len);
+		PublishConfig();
+	}
+	MIDIDevicePool::Invalidate();
 #endif
 }
 
 DLL_EXPORT void zmsx_set_dmxgus(const void* data, unsigned len)
 {
 #ifdef HAVE_GUS
-	gusConfig.dmxgus.resize(len);
-	memcpy(gusConfig.dmxgus.data(), data, len);
+	{
+		std::lock_guard<std::mutex> lock(ConfigMutex);
+		gusConfig.dmxgus = std::make_shared<const std::vector<uint8_t>>((const uint8_t*)data, (const uint8_t*)data + len);
+		PublishConfig();
+	}
+	MIDIDevicePool::Invalidate();
 #endif
 }
 
@@ -326,7 +427,7 @@ static void TimidityPlus_SetReverb()
 //
 //==========================================================================
 
-DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int value, int *pRealValue)
+static bool SetInt(ZMSXIntConfigKey key, LiveSettings *currSong, int value, int *pRealValue)
 {
 	switch (key)
 	{
@@ -335,12 +436,21 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 
 #ifdef HAVE_ADL
 		case zmusic_adl_chips_count:
+			if (value < 1)
+				value = 1;
+			else if (value > 100)
+				value = 100;
+
+			if (currSong != NULL)
+				currSong->PostSettingInt("adl.numchips", value);
 			ChangeAndReturn(adlConfig.adl_chips_count, value, pRealValue);
-			return devType() == zmsx_mdev_adl;
+			return false;
 
 		case zmusic_adl_emulator_id:
+			if (currSong != NULL)
+				currSong->PostSettingInt("adl.emulator", value);
 			ChangeAndReturn(adlConfig.adl_emulator_id, value, pRealValue);
-			return devType() == zmsx_mdev_adl;
+			return false;
 
 		case zmusic_adl_run_at_pcm_rate:
 			ChangeAndReturn(adlConfig.adl_run_at_pcm_rate, value, pRealValue);
@@ -365,14 +475,14 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 
 		case zmusic_fluid_reverb:
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("fluidsynth.synth.reverb.active", value);
+				currSong->PostSettingInt("fluidsynth.synth.reverb.active", value);
 
 			ChangeAndReturn(fluidConfig.fluid_reverb, value, pRealValue);
 			return false;
 
 		case zmusic_fluid_chorus:
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("fluidsynth.synth.chorus.active", value);
+				currSong->PostSettingInt("fluidsynth.synth.chorus.active", value);
 
 			ChangeAndReturn(fluidConfig.fluid_chorus, value, pRealValue);
 			return false;
@@ -384,7 +494,7 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 				value = 4096;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("fluidsynth.synth.polyphony", value);
+				currSong->PostSettingInt("fluidsynth.synth.polyphony", value);
 
 			ChangeAndReturn(fluidConfig.fluid_voices, value, pRealValue);
 			return false;
@@ -406,7 +516,7 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 				value = 7;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("fluidsynth.synth.interpolation", value);
+				currSong->PostSettingInt("fluidsynth.synth.interpolation", value);
 
 			ChangeAndReturn(fluidConfig.fluid_interp, value, pRealValue);
 			return false;
@@ -434,7 +544,7 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 				value = 99;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.chorus", value);
+				currSong->PostSettingNum("fluidsynth.z.chorus.nr", value);
 
 			ChangeAndReturn(fluidConfig.fluid_chorus_voices, value, pRealValue);
 			return false;
@@ -444,7 +554,7 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 				value = FLUID_CHORUS_DEFAULT_TYPE;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.chorus", value); // Uses float to simplify the checking code in the renderer.
+				currSong->PostSettingNum("fluidsynth.z.chorus.type", value);
 
 			ChangeAndReturn(fluidConfig.fluid_chorus_type, value, pRealValue);
 			return false;
@@ -457,7 +567,7 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 				value = MAXOPL2CHIPS;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("opl.numchips", value);
+				currSong->PostSettingInt("opl.numchips", value);
 
 			ChangeAndReturn(oplConfig.numchips, value, pRealValue);
 			return false;
@@ -474,12 +584,21 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 #endif
 #ifdef HAVE_OPN
 		case zmusic_opn_chips_count:
+			if (value < 1)
+				value = 1;
+			else if (value > 100)
+				value = 100;
+
+			if (currSong != NULL)
+				currSong->PostSettingInt("opn.numchips", value);
 			ChangeAndReturn(opnConfig.opn_chips_count, value, pRealValue);
-			return devType() == zmsx_mdev_opn;
+			return false;
 
 		case zmusic_opn_emulator_id:
+			if (currSong != NULL)
+				currSong->PostSettingInt("opn.emulator", value);
 			ChangeAndReturn(opnConfig.opn_emulator_id, value, pRealValue);
-			return devType() == zmsx_mdev_opn;
+			return false;
 
 		case zmusic_opn_run_at_pcm_rate:
 			ChangeAndReturn(opnConfig.opn_run_at_pcm_rate, value, pRealValue);
@@ -586,14 +705,14 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 #ifdef HAVE_WILDMIDI
 		case zmusic_wildmidi_reverb:
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("wildmidi.reverb", value);
+				currSong->PostSettingInt("wildmidi.reverb", value);
 			wildMidiConfig.reverb = value;
 			if (pRealValue) *pRealValue = value;
 			return false;
 
 		case zmusic_wildmidi_enhanced_resampling:
 			if (currSong != NULL)
-				currSong->ChangeSettingInt("wildmidi.resampling", value);
+				currSong->PostSettingInt("wildmidi.resampling", value);
 			wildMidiConfig.enhanced_resampling = value;
 			if (pRealValue) *pRealValue = value;
 			return false;
@@ -653,11 +772,68 @@ DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int
 			miscConfig.snd_outputrate = value;
 			return false;
 
+		case zmsx_snd_renderahead:
+			if (value < 0)
+			{
+				value = 0;
+			}
+			else if (value > 2000)
+			{
+				value = 2000;
+			}
+			ChangeAndReturn(miscConfig.snd_renderahead, value, pRealValue);
+			return false;
+
+		case zmsx_snd_realtime:
+			ChangeAndReturn(miscConfig.snd_realtime, value, pRealValue);
+			return false;
+
+		case zmsx_snd_resampler:
+			if (value < 0)
+				value = 0;
+			else if (value > 3)
+				value = 3;
+
+			ChangeAndReturn(miscConfig.snd_resampler, value, pRealValue);
+			return false;
+
+		case zmsx_snd_mididevicepool:
+			if (value < 0)
+				value = 0;
+			else if (value > 16)
+				value = 16;
+
+			ChangeAndReturn(miscConfig.snd_mididevicepool, value, pRealValue);
+			return false;
+
+		case zmsx_fluid_sfcache:
+			if (value < 0)
+				value = 0;
+
+			ChangeAndReturn(miscConfig.fluid_sfcache, value, pRealValue);
+			Fluid_SetSoundFontCacheSize(value);
+			return false;
+
+		case zmsx_snd_midiblocksize:
+			if (value < 0)
+				value = 0;
+			else if (value > 1024)
+				value = 1024;
+
+			ChangeAndReturn(miscConfig.snd_midiblocksize, value, pRealValue);
+			return false;
+
 	}
 	return false;
 }
 
-DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong, float value, float *pRealValue)
+//==========================================================================
+//
+// change a float value
+//
+//==========================================================================
+
+static bool SetFloat(ZMSXFloatConfigKey key, LiveSettings* currSong, float value, float *pRealValue)
 {
 	switch (key)
 	{
@@ -671,7 +847,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 10;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.synth.gain", value);
+				currSong->PostSettingNum("fluidsynth.synth.gain", value);
 
 			ChangeAndReturn(fluidConfig.fluid_gain, value, pRealValue);
 			return false;
@@ -683,7 +859,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 1.2f;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.reverb", value);
+				currSong->PostSettingNum("fluidsynth.z.reverb.roomsize", value);
 
 			ChangeAndReturn(fluidConfig.fluid_reverb_roomsize, value, pRealValue);
 			return false;
@@ -695,7 +871,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 1;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.reverb", value);
+				currSong->PostSettingNum("fluidsynth.z.reverb.damp", value);
 
 			ChangeAndReturn(fluidConfig.fluid_reverb_damping, value, pRealValue);
 			return false;
@@ -707,7 +883,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 100;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.reverb", value);
+				currSong->PostSettingNum("fluidsynth.z.reverb.width", value);
 
 			ChangeAndReturn(fluidConfig.fluid_reverb_width, value, pRealValue);
 			return false;
@@ -719,7 +895,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 1;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.reverb", value);
+				currSong->PostSettingNum("fluidsynth.z.reverb.level", value);
 
 			ChangeAndReturn(fluidConfig.fluid_reverb_level, value, pRealValue);
 			return false;
@@ -731,7 +907,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 1;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.chorus", value);
+				currSong->PostSettingNum("fluidsynth.z.chorus.level", value);
 
 			ChangeAndReturn(fluidConfig.fluid_chorus_level, value, pRealValue);
 			return false;
@@ -743,7 +919,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 5;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.chorus", value);
+				currSong->PostSettingNum("fluidsynth.z.chorus.speed", value);
 
 			ChangeAndReturn(fluidConfig.fluid_chorus_speed, value, pRealValue);
 			return false;
@@ -756,7 +932,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 				value = 21;
 
 			if (currSong != NULL)
-				currSong->ChangeSettingNum("fluidsynth.z.chorus", value);
+				currSong->PostSettingNum("fluidsynth.z.chorus.depth", value);
 
 			ChangeAndReturn(fluidConfig.fluid_chorus_depth, value, pRealValue);
 			return false;
@@ -786,7 +962,7 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 
 		case zmusic_gme_stereodepth:
 			if (currSong != nullptr)
-				currSong->ChangeSettingNum("GME.stereodepth", value);
+				currSong->PostSettingNum("GME.stereodepth", value);
 			ChangeAndReturn(miscConfig.gme_stereodepth, value, pRealValue);
 			return false;
 
@@ -811,7 +987,13 @@ DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong,
 	return false;
 }
 
-DLL_EXPORT bool zmsx_config_set_string(ZMSXStringConfigKey key, MusInfo* currSong, const char *value)
+//==========================================================================
+//
+// change a string value
+//
+//==========================================================================
+
+static bool SetString(ZMSXStringConfigKey key, LiveSettings* currSong, const char *value)
 {
 	switch (key)
 	{
@@ -863,6 +1045,63 @@ DLL_EXPORT bool zmsx_config_set_string(ZMSXStringConfigKey key, MusInfo* currSon
 	return false;
 }
 
+//==========================================================================
+//
+// zmsx_config_set_*
+//
+// The device pool only gets cleared once the new values are out, or a
+// device created in between might end up in it with the old ones.
+//
+//==========================================================================
+
+DLL_EXPORT bool zmsx_config_set_int(ZMSXIntConfigKey key, MusInfo *currSong, int value, int *pRealValue)
+{
+	LiveSettings live(currSong);
+	bool res;
+	{
+		std::lock_guard<std::mutex> lock(ConfigMutex);
+		res = SetInt(key, currSong ? &live : nullptr, value, pRealValue);
+		PublishConfig();
+	}
+	if (currSong) live.Post();
+
+	// The MIDI device settings all come first.
+	if (key <= zmusic_wildmidi_enhanced_resampling)
+		MIDIDevicePool::Invalidate();
+	else if (key == zmsx_snd_mididevicepool)
+		MIDIDevicePool::Trim();
+	return res;
+}
+
+DLL_EXPORT bool zmsx_config_set_float(ZMSXFloatConfigKey key, MusInfo* currSong, float value, float *pRealValue)
+{
+	LiveSettings live(currSong);
+	bool res;
+	{
+		std::lock_guard<std::mutex> lock(ConfigMutex);
+		res = SetFloat(key, currSong ? &live : nullptr, value, pRealValue);
+		PublishConfig();
+	}
+	if (currSong) live.Post();
+
+	if (key <= zmusic_timidity_min_sustain_time)
+		MIDIDevicePool::Invalidate();
+	return res;
+}
+
+DLL_EXPORT bool zmsx_config_set_string(ZMSXStringConfigKey key, MusInfo* currSong, const char *value)
+{
+	LiveSettings live(currSong);
+	bool res;
+	{
+		std::lock_guard<std::mutex> lock(ConfigMutex);
+		res = SetString(key, currSong ? &live : nullptr, value);
+		PublishConfig();
+	}
+	MIDIDevicePool::Invalidate();
+	return res;
+}
+
 static zmsx_Setting config[] = {
 #ifdef HAVE_ADL
 	{"zmusic_adl_chips_count", zmusic_adl_chips_count, zmsx_var_int, 5},
@@ -951,6 +1190,12 @@ static zmsx_Setting config[] = {
 	{"zmusic_snd_streambuffersize", zmusic_snd_streambuffersize, zmsx_var_int, 64},
 	{"zmusic_snd_mididevice", zmusic_snd_mididevice, zmsx_var_int, 0},
 	{"zmusic_snd_outputrate", zmusic_snd_outputrate, zmsx_var_int, 44100},
+	{"zmsx_snd_renderahead", zmsx_snd_renderahead, zmsx_var_int, 0},
+	{"zmsx_snd_realtime", zmsx_snd_realtime, zmsx_var_bool, 0},
+	{"zmsx_snd_resampler", zmsx_snd_resampler, zmsx_var_int, 0},
+	{"zmsx_snd_mididevicepool", zmsx_snd_mididevicepool, zmsx_var_int, 2},
+	{"zmsx_fluid_sfcache", zmsx_fluid_sfcache, zmsx_var_int, 128},
+	{"zmsx_snd_midiblocksize", zmsx_snd_midiblocksize, zmsx_var_int, 0},
 	{"zmusic_snd_musicvolume", zmusic_snd_musicvolume, zmsx_var_float, 1},
 	{"zmusic_relative_volume", zmusic_relative_volume, zmsx_var_float, 1},
 	{"zmusic_snd_mastervolume", zmusic_snd_mastervolume, zmsx_var_float, 1},
@@ -68,6 +68,11 @@ public:
 	{
 		delete this;
 	}
+	// If the entire file is in memory, returns a pointer to it so that it can be parsed in place.
+	virtual const uint8_t* contents()
+	{
+		return nullptr;
+	}
 
 	long filelength()
 	{
@@ -195,6 +200,10 @@ struct MemoryReader : public FileInterface
 	{
 		return mPos;
 	}
+	const uint8_t* contents() override
+	{
+		return mData;
+	}
 protected:
 	MemoryReader() {}
 };
@@ -227,6 +236,28 @@ struct VectorReader : public MemoryReader
 	}
 };
 
+//==========================================================================
+//
+// Implementation of the FileInterface for a block of memory that belongs
+// to the client. The release callback is invoked once it is no longer needed.
+//
+//==========================================================================
+
+struct BorrowedMemoryReader : public MemoryReader
+{
+	void (*mRelease)(void* userdata);
+	void* mUserData;
+
+	BorrowedMemoryReader(const uint8_t* data, long length, void (*release)(void*), void* userdata)
+		: MemoryReader(data, length), mRelease(release), mUserData(userdata)
+	{
+	}
+	~BorrowedMemoryReader()
+	{
+		if (mRelease) mRelease(mUserData);
+	}
+};
+
 
 //==========================================================================
 //
@@ -385,5 +416,12 @@ public:
 
 MusicIO::SoundFontReaderInterface* ClientOpenSoundFont(const char* name, int type);
 
+// Maps a file into memory for reading. Returns nullptr if that is not possible.
+FileInterface* OpenMappedFile(const char* filename);
+
+// Wraps a reader for a gzip file into one that returns the decompressed content.
+// Takes over the reader. Returns nullptr if it does not contain valid gzip data.
+FileInterface* OpenGzipReader(FileInterface* reader);
+
 } 
 
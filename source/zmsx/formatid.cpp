@@ -0,0 +1,230 @@
+/*
+** formatid.cpp
+** Identifies song formats by their header signatures
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <string.h>
+#include "formatid.h"
+
+// TYPES -------------------------------------------------------------------
+
+struct FormatMagic
+{
+	ZMSXSongFormat Format;
+	uint16_t Offset;
+	uint8_t Length;
+	const char *Magic;
+	bool Weak;
+	// Container formats name their contents at offset 8, e.g. RIFF....WAVE
+	const char *FormType = nullptr;
+};
+
+// EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
+
+const char *GME_CheckFormat(uint32_t header);
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+// Everything that can be told apart by a fixed string. MIDI formats and game
+// music are left to their own identification functions, MOD files get their
+// channel tag checked separately.
+static const FormatMagic Signatures[] =
+{
+	{ zmsx_format_gzip,		0,	3,	"\x1f\x8b\x08",				false },
+	{ zmsx_format_cdda,		0,	4,	"RIFF",						false,	"CDDA" },
+	{ zmsx_format_xa,		0,	4,	"RIFF",						false,	"CDXA" },
+
+	{ zmsx_format_opl,		0,	8,	"RAWADATA",					false },
+	{ zmsx_format_opl,		0,	8,	"DBRAWOPL",					false },
+	{ zmsx_format_opl,		0,	5,	"ADLIB",					false },
+
+	{ zmsx_format_module,	0,	4,	"IMPM",						false },
+	{ zmsx_format_module,	0,	17,	"Extended Module: ",		false },
+	{ zmsx_format_module,	44,	4,	"SCRM",						false },
+	{ zmsx_format_module,	20,	8,	"!Scream!",					false },
+	{ zmsx_format_module,	20,	8,	"BMOD2STM",					false },
+	{ zmsx_format_module,	20,	8,	"WUZAMOD!",					false },
+	{ zmsx_format_module,	44,	4,	"PTMF",						false },
+	{ zmsx_format_module,	0,	4,	"PSM ",						false },
+	{ zmsx_format_module,	0,	4,	"PSM\xfe",					false },
+	{ zmsx_format_module,	0,	3,	"MTM",						false },
+	{ zmsx_format_module,	0,	4,	"RIFF",						false,	"DSMF" },
+	{ zmsx_format_module,	0,	4,	"RIFF",						false,	"AM  " },
+	{ zmsx_format_module,	0,	4,	"RIFF",						false,	"AMFF" },
+	{ zmsx_format_module,	0,	24,	"ASYLUM Music Format V1.0",	false },
+	{ zmsx_format_module,	0,	8,	"OKTASONG",					false },
+	{ zmsx_format_module,	0,	4,	"AMF\x0a",					false },
+	{ zmsx_format_module,	0,	4,	"AMF\x0b",					false },
+	{ zmsx_format_module,	0,	4,	"AMF\x0c",					false },
+	{ zmsx_format_module,	0,	4,	"AMF\x0d",					false },
+	{ zmsx_format_module,	0,	4,	"AMF\x0e",					false },
+	{ zmsx_format_module,	0,	2,	"if",						true },		// 669
+	{ zmsx_format_module,	0,	2,	"JN",						true },		// Extended 669
+
+	// mpg123 also plays MP3 data wrapped in a RIFF header.
+	{ zmsx_format_sndfile,	0,	4,	"RIFF",						true,	"WAVE" },
+	{ zmsx_format_sndfile,	0,	4,	"RIFX",						false,	"WAVE" },
+	{ zmsx_format_sndfile,	0,	4,	"RF64",						false },
+	{ zmsx_format_sndfile,	0,	4,	"riff",						false },	// Sony Wave64
+	{ zmsx_format_sndfile,	0,	4,	"FORM",						false,	"AIFF" },
+	{ zmsx_format_sndfile,	0,	4,	"FORM",						false,	"AIFC" },
+	{ zmsx_format_sndfile,	0,	4,	"FORM",						false,	"8SVX" },
+	{ zmsx_format_sndfile,	0,	4,	"FORM",						false,	"16SV" },
+	{ zmsx_format_sndfile,	0,	4,	".snd",						false },
+	{ zmsx_format_sndfile,	0,	4,	"dns.",						false },
+	{ zmsx_format_sndfile,	0,	4,	"caff",						false },
+	{ zmsx_format_sndfile,	0,	4,	"OggS",						false },
+	{ zmsx_format_sndfile,	0,	4,	"fLaC",						false },
+	{ zmsx_format_sndfile,	0,	7,	"NIST_1A",					false },
+	{ zmsx_format_sndfile,	0,	19,	"Creative Voice File",		false },
+
+	// ID3 tags are also found in front of other formats.
+	{ zmsx_format_mp3,		0,	3,	"ID3",						true },
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// IsModTag
+//
+// The channel tags DUMB accepts for 31 instrument MODs. Old 15 instrument
+// ones have no tag at all and are not played.
+//
+//==========================================================================
+
+static bool IsModTag(const uint8_t *tag)
+{
+	static const char *const tags[] =
+	{
+		"M.K.", "M!K!", "M&K!", "N.T.", "NSMS", "FLT4", "FLT8", "CD81", "OCTA", "OKTA", "16CN", "32CN"
+	};
+	for (auto t : tags)
+	{
+		if (!memcmp(tag, t, 4)) return true;
+	}
+	if ((tag[0] == 'M' || tag[0] == '8') && tag[1] == 0 && tag[2] == 0 && tag[3] == 0)
+	{
+		return true;
+	}
+	auto isdigit = [](uint8_t c) { return c >= '0' && c <= '9'; };
+	// xCHN, xxCH and TDZx with a sensible channel count
+	if (tag[1] == 'C' && tag[2] == 'H' && tag[3] == 'N')
+	{
+		return tag[0] >= '1' && tag[0] <= '9';
+	}
+	if (tag[2] == 'C' && tag[3] == 'H')
+	{
+		return tag[0] >= '1' && tag[0] <= '3' && isdigit(tag[1]) && (tag[0] - '0') * 10 + (tag[1] - '0') <= 64;
+	}
+	if (tag[0] == 'T' && tag[1] == 'D' && tag[2] == 'Z')
+	{
+		return tag[3] >= '1' && tag[3] <= '9';
+	}
+	return false;
+}
+
+//==========================================================================
+//
+// IsMPEGFrame
+//
+// Checks for an MPEG audio frame header, for MP3 files without ID3 tag.
+//
+//==========================================================================
+
+static bool IsMPEGFrame(const uint8_t *head)
+{
+	return head[0] == 0xff && (head[1] & 0xe0) == 0xe0 &&
+		((head[1] >> 3) & 3) != 1 &&	// version
+		((head[1] >> 1) & 3) != 0 &&	// layer
+		(head[2] >> 4) != 15 &&			// bit rate
+		((head[2] >> 2) & 3) != 3;		// sample rate
+}
+
+//==========================================================================
+//
+// IdentifySongFormat
+//
+//==========================================================================
+
+SongSignature IdentifySongFormat(const uint8_t *header, size_t length)
+{
+	// The MIDI check wants 32 bytes, short files get padded with zeros.
+	uint32_t id[32 / 4] = {};
+	memcpy(id, header, length < sizeof(id) ? length : sizeof(id));
+
+	if (length >= 4 && zmsx_identify_midi_type(id, sizeof(id)) != zmsx_midi_notmidi)
+	{
+		return { zmsx_format_midi, false };
+	}
+
+	for (auto &sig : Signatures)
+	{
+		if (length >= (size_t)sig.Offset + sig.Length && !memcmp(header + sig.Offset, sig.Magic, sig.Length))
+		{
+			if (sig.FormType == nullptr || (length >= 12 && !memcmp(header + 8, sig.FormType, 4)))
+			{
+				return { sig.Format, sig.Weak };
+			}
+		}
+	}
+
+	if (length >= 4)
+	{
+		const char *fmt = GME_CheckFormat(id[0]);
+		if (fmt != nullptr && fmt[0] != '\0')
+		{
+			return { zmsx_format_gme, false };
+		}
+	}
+	if (length >= 1084 && IsModTag(header + 1080))
+	{
+		return { zmsx_format_module, false };
+	}
+	if (length >= 4 && IsMPEGFrame(header))
+	{
+		return { zmsx_format_mp3, true };
+	}
+	return { zmsx_format_unknown, true };
+}
+
+//==========================================================================
+//
+// zmsx_identify_song_format
+//
+//==========================================================================
+
+DLL_EXPORT ZMSXSongFormat zmsx_identify_song_format(const void *header, size_t size)
+{
+	if (header == nullptr) return zmsx_format_unknown;
+	return IdentifySongFormat((const uint8_t *)header, size).Format;
+}
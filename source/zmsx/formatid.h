@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "zmsx.hpp"
+
+// How many bytes of a file IdentifySongFormat wants to see. The furthest
+// signature is the MOD tag at offset 1080.
+enum { FORMAT_PROBE_SIZE = 1084 };
+
+struct SongSignature
+{
+	ZMSXSongFormat Format;
+
+	// The signature is short enough to turn up in other files by chance, so
+	// if its loader rejects the file the others still get a try.
+	bool Weak;
+};
+
+// Classifies a file by its header alone. This never touches a loader, so it
+// is cheap enough to run on every file of a large collection.
+SongSignature IdentifySongFormat(const uint8_t *header, size_t length);
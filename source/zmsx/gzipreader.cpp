@@ -0,0 +1,263 @@
+/*
+** gzipreader.cpp
+** Incremental gzip decompression for song files
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <stdint.h>
+#include <miniz.h>
+
+#include "m_swap.h"
+#include "fileio.h"
+
+// MACROS ------------------------------------------------------------------
+
+#define GZIP_FTEXT		1
+#define GZIP_FHCRC		2
+#define GZIP_FEXTRA		4
+#define GZIP_FNAME		8
+#define GZIP_FCOMMENT	16
+
+namespace MusicIO
+{
+
+// TYPES -------------------------------------------------------------------
+
+//==========================================================================
+//
+// Decompresses a gzip file as it gets read, so only the current input
+// block and inflate's window need to be kept in memory. Seeking forward
+// decompresses up to the new position, seeking backward starts over.
+//
+//==========================================================================
+
+struct GzipFileReader : public FileInterface
+{
+	FileInterface *Source;
+	long DataStart;		// position of the deflate stream in Source
+	long DataEnd;		// end of the deflate stream, the trailer is not part of it
+	long InPos;
+	long Pos = 0;
+	bool Eof = false;
+	z_stream Stream = {};
+	uint8_t InBuffer[16384];
+
+	GzipFileReader(FileInterface *source, long start, long end, long uncompressed)
+		: Source(source), DataStart(start), DataEnd(end), InPos(start)
+	{
+		length = uncompressed;
+	}
+
+	~GzipFileReader()
+	{
+		inflateEnd(&Stream);
+		Source->close();
+	}
+
+	bool Init()
+	{
+		return inflateInit2(&Stream, -MAX_WBITS) == Z_OK;
+	}
+
+	void Restart()
+	{
+		inflateReset(&Stream);
+		Stream.avail_in = 0;
+		Source->seek(DataStart, SEEK_SET);
+		InPos = DataStart;
+		Pos = 0;
+		Eof = false;
+	}
+
+	long read(void* buff, int32_t size) override
+	{
+		if (size <= 0) return 0;
+		Stream.next_out = (Bytef *)buff;
+		Stream.avail_out = size;
+		while (Stream.avail_out > 0 && !Eof)
+		{
+			if (Stream.avail_in == 0 && InPos < DataEnd)
+			{
+				long want = std::min<long>(sizeof(InBuffer), DataEnd - InPos);
+				long got = Source->read(InBuffer, (int32_t)want);
+				if (got > 0)
+				{
+					InPos += got;
+					Stream.next_in = InBuffer;
+					Stream.avail_in = (uInt)got;
+				}
+				else
+				{
+					// Truncated file, deliver what we have.
+					DataEnd = InPos;
+				}
+			}
+			// inflate may still hold output after all input has been consumed.
+			uInt inbefore = Stream.avail_in, outbefore = Stream.avail_out;
+			int err = inflate(&Stream, Z_NO_FLUSH);
+			if (err != Z_OK && err != Z_BUF_ERROR)
+			{
+				// Either the end of the stream or broken data.
+				Eof = true;
+			}
+			else if (Stream.avail_in == inbefore && Stream.avail_out == outbefore && (Stream.avail_in > 0 || InPos >= DataEnd))
+			{
+				Eof = true;
+			}
+		}
+		long done = size - (long)Stream.avail_out;
+		Pos += done;
+		return done;
+	}
+
+	long seek(long offset, int whence) override
+	{
+		switch (whence)
+		{
+		case SEEK_CUR:
+			offset += Pos;
+			break;
+
+		case SEEK_END:
+			offset += length;
+			break;
+		}
+		if (offset < 0 || offset > length) return -1;
+		if (offset < Pos) Restart();
+
+		uint8_t skip[4096];
+		while (Pos < offset)
+		{
+			long want = std::min<long>(sizeof(skip), offset - Pos);
+			if (read(skip, (int32_t)want) != want) return -1;
+		}
+		return 0;
+	}
+
+	long tell() override
+	{
+		return Pos;
+	}
+
+	char* gets(char* buff, int n) override
+	{
+		int i = 0;
+		while (i < n - 1)
+		{
+			char c;
+			if (read(&c, 1) != 1) break;
+			buff[i++] = c;
+			if (c == '\n') break;
+		}
+		if (i == 0) return nullptr;
+		buff[i] = 0;
+		return buff;
+	}
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// SkipString
+//
+//==========================================================================
+
+static bool SkipString(FileInterface *reader)
+{
+	uint8_t c;
+	do
+	{
+		if (reader->read(&c, 1) != 1) return false;
+	} while (c != 0);
+	return true;
+}
+
+//==========================================================================
+//
+// OpenGzipReader
+//
+// Takes over the reader, which must be positioned at the start of the gzip
+// header. Returns nullptr and closes the reader if the header is invalid.
+//
+//==========================================================================
+
+FileInterface *OpenGzipReader(FileInterface *reader)
+{
+	uint8_t header[10];
+	uint8_t trailer[4];
+	long start = reader->tell();
+	long complen = reader->filelength();
+
+	// The uncompressed size (modulo 4 GB) is the last thing in the file.
+	if (complen - start < 18 ||
+		reader->seek(-4, SEEK_END) != 0 || reader->read(trailer, 4) != 4 ||
+		reader->seek(start, SEEK_SET) != 0 || reader->read(header, 10) != 10)
+	{
+		reader->close();
+		return nullptr;
+	}
+
+	uint8_t flags = header[3];
+	bool ok = true;
+	if (flags & GZIP_FEXTRA)
+	{
+		uint16_t extralen;
+		ok = reader->read(&extralen, 2) == 2 && reader->seek(LittleShort(extralen), SEEK_CUR) == 0;
+	}
+	if (ok && (flags & GZIP_FNAME)) ok = SkipString(reader);
+	if (ok && (flags & GZIP_FCOMMENT)) ok = SkipString(reader);
+	if (ok && (flags & GZIP_FHCRC)) ok = reader->seek(2, SEEK_CUR) == 0;
+
+	long datastart = reader->tell();
+	long dataend = complen - 8;
+	if (!ok || datastart >= dataend)
+	{
+		reader->close();
+		return nullptr;
+	}
+
+	uint32_t isize = LittleLong(*(uint32_t *)trailer);
+	auto gz = new GzipFileReader(reader, datastart, dataend, (long)isize);
+	if (!gz->Init())
+	{
+		gz->close();
+		return nullptr;
+	}
+	gz->filename = reader->filename;
+	return gz;
+}
+
+}
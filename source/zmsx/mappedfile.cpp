@@ -0,0 +1,143 @@
+/*
+** mappedfile.cpp
+** Memory mapped file reader
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <limits.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "fileio.h"
+
+namespace MusicIO
+{
+
+// TYPES -------------------------------------------------------------------
+
+struct MappedFileReader : public MemoryReader
+{
+	MappedFileReader(const uint8_t *data, long length)
+		: MemoryReader(data, length)
+	{
+	}
+
+	~MappedFileReader()
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mData);
+#else
+		munmap((void *)mData, mLength);
+#endif
+	}
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// OpenMappedFile
+//
+// Songs get parsed straight out of the mapping, so nothing needs to be
+// copied. Empty files and anything that is not a regular file are left
+// to the regular file reader.
+//
+//==========================================================================
+
+FileInterface *OpenMappedFile(const char *filename)
+{
+	const void *view;
+	long length;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(wideString(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > LONG_MAX)
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)
+	{
+		return nullptr;
+	}
+	// The view keeps the mapping alive.
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == nullptr)
+	{
+		return nullptr;
+	}
+	length = (long)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || st.st_size > LONG_MAX)
+	{
+		::close(fd);
+		return nullptr;
+	}
+	view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	length = (long)st.st_size;
+#endif
+
+	auto reader = new MappedFileReader((const uint8_t *)view, length);
+	reader->filename = filename;
+	return reader;
+}
+
+}
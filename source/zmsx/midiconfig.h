@@ -8,6 +8,10 @@
 
 // Note: Bools here are stored as ints to allow having a simpler interface.
 
+// Data the client sets as a whole, like instrument banks. It is never changed
+// in place, so all the snapshots that have the same one can share it.
+typedef std::shared_ptr<const std::vector<uint8_t>> SharedBytes;
+
 struct ADLConfig
 {
 	int adl_chips_count = 6;
@@ -48,7 +52,7 @@ struct OPLConfig
 	int core = 0;
 	int fullpan = true;
 	int genmidiset = false;
-	uint8_t OPLinstruments[36 * 175]; // it really is 'struct GenMidiInstrument OPLinstruments[GENMIDI_NUM_TOTAL]'; but since this is a public header it cannot pull in a dependency from oplsynth.
+	SharedBytes OPLinstruments; // 36 * 175 bytes. It really is 'struct GenMidiInstrument OPLinstruments[GENMIDI_NUM_TOTAL]'; but since this is a public header it cannot pull in a dependency from oplsynth.
 };
 
 struct OpnConfig
@@ -59,7 +63,7 @@ struct OpnConfig
 	int opn_fullpan = 1;
 	int opn_use_custom_bank = false;
 	std::string opn_custom_bank;
-	std::vector<uint8_t> default_bank;
+	SharedBytes default_bank;
 };
 
 namespace Timidity
@@ -75,13 +79,16 @@ struct GUSConfig
 	int gus_dmxgus = false;
 	std::string gus_patchdir;
 	std::string gus_config;
-	std::vector<uint8_t> dmxgus;				// can contain the contents of a DMXGUS lump that may be used as the instrument set. In this case gus_patchdir must point to the location of the GUS data and gus_dmxgus must be true.
+	SharedBytes dmxgus;				// can contain the contents of a DMXGUS lump that may be used as the instrument set. In this case gus_patchdir must point to the location of the GUS data and gus_dmxgus must be true.
+};
 
-	// This is the instrument cache for the GUS synth.
+// This is the instrument cache for the GUS synth.
+struct GUSInstrumentCache
+{
 	MusicIO::SoundFontReaderInterface *reader;
 	std::string readerName;
 	std::string loadedConfig;
-	std::unique_ptr<Timidity::Instruments> instruments;
+	std::shared_ptr<Timidity::Instruments> instruments;	// this is held both by the cache and the device
 };
 
 namespace TimidityPlus
@@ -93,12 +100,14 @@ namespace TimidityPlus
 struct TimidityConfig
 {
 	std::string timidity_config;
+};
 
+struct TimidityInstrumentCache
+{
 	MusicIO::SoundFontReaderInterface* reader;
 	std::string readerName;
 	std::string loadedConfig;
-	std::shared_ptr<TimidityPlus::Instruments> instruments;	// this is held both by the config and the device
-
+	std::shared_ptr<TimidityPlus::Instruments> instruments;	// this is held both by the cache and the device
 };
 
 namespace WildMidi
@@ -112,12 +121,14 @@ struct WildMidiConfig
 	bool reverb = false;
 	bool enhanced_resampling = true;
 	std::string config;
+};
 
+struct WildMidiInstrumentCache
+{
 	MusicIO::SoundFontReaderInterface* reader;
 	std::string readerName;
 	std::string loadedConfig;
-	std::shared_ptr<WildMidi::Instruments> instruments;	// this is held both by the config and the device
-
+	std::shared_ptr<WildMidi::Instruments> instruments;	// this is held both by the cache and the device
 };
 
 struct DumbConfig
@@ -139,19 +150,46 @@ struct MiscConfig
 	int snd_streambuffersize = 64;
 	int snd_mididevice;
 	int snd_outputrate = 44100;
+	int snd_renderahead = 0;
+	int snd_realtime = 0;
+	int snd_resampler = 0;
+	int snd_mididevicepool = 2;
+	int fluid_sfcache = 128;
+	int snd_midiblocksize = 0;
 	float snd_musicvolume = 1.f;
 	float relative_volume = 1.f;
 	float snd_mastervolume = 1.f;
+
+	float MusicVolume() const { return snd_musicvolume * relative_volume * snd_mastervolume; }
+};
+
+// All the settings at one point in time. A published snapshot never changes:
+// zmsx_config_set_* works on a private copy and then publishes a new snapshot
+// with the next version number in its place. So any thread may hold on to one
+// and read it without locking, and a device that takes one when it gets
+// opened sees a consistent set of values even if the client changes them in
+// the meantime.
+
+struct ConfigSnapshot
+{
+	unsigned Version = 0;
+	ADLConfig adl;
+	FluidConfig fluid;
+	OPLConfig opl;
+	OpnConfig opn;
+	GUSConfig gus;
+	TimidityConfig timidity;
+	WildMidiConfig wildMidi;
+	DumbConfig dumb;
+	MiscConfig misc;
 };
 
-extern ADLConfig adlConfig;
-extern FluidConfig fluidConfig;
-extern OPLConfig oplConfig;
-extern OpnConfig opnConfig;
-extern GUSConfig gusConfig;
-extern TimidityConfig timidityConfig;
-extern WildMidiConfig wildMidiConfig;
-extern DumbConfig dumbConfig;
-extern MiscConfig miscConfig;
+typedef std::shared_ptr<const ConfigSnapshot> ConfigPtr;
+
+ConfigPtr GetConfig();	// The latest snapshot.
+
+extern GUSInstrumentCache gusCache;
+extern TimidityInstrumentCache timidityCache;
+extern WildMidiInstrumentCache wildMidiCache;
 extern ZMSXCallbacks musicCallbacks;
 
@@ -17,6 +17,15 @@ enum EMidiEvent : uint8_t
 	MEVENT_LONGMSG = 128,
 };
 
+// Parameters of the MEVENT_NOP events that sources emit for loop controllers.
+// Devices ignore them like any other NOP; the song analysis pass uses them
+// to find the loop points without interpreting each format again.
+enum
+{
+	MEVENT_NOP_LOOPBEGIN = 1,
+	MEVENT_NOP_LOOPEND = 2,
+};
+
 #ifndef MAKE_ID
 #ifndef __BIG_ENDIAN__
 #define MAKE_ID(a,b,c,d)	((uint32_t)((a)|((b)<<8)|((c)<<16)|((d)<<24)))
@@ -0,0 +1,486 @@
+/*
+** mixer.cpp
+** Renders multiple songs in parallel and mixes them into one output
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <string.h>
+
+#include "mixer.h"
+#include "musinfo.h"
+#include "sampleconv.h"
+#include "resampler.h"
+#include "midiconfig.h"
+#include "trace.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIXER_SSE2
+#endif
+
+// TYPES -------------------------------------------------------------------
+
+struct MusicMixer::Channel
+{
+	int Handle;
+	MusInfo *Song;
+	float Gain;
+	float TargetGain;
+	int RampLeft = 0;
+	int ResamplerQuality;	// Taken from the config by AddStream.
+	bool Ended = false;
+
+	ZMSXSoundStreamInfoEx Format = {};
+
+	StreamResampler Resampler;
+
+	std::vector<uint8_t> Raw;
+	std::vector<float> Input;
+	std::vector<float> Output;
+
+	void Render(int frames, int outrate);
+	void ReadSource(float *dest, int frames);
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// ConvertToStereoFloat
+//
+//==========================================================================
+
+static void ConvertToStereoFloat(float *dest, const uint8_t *src, const ZMSXSoundStreamInfoEx &fmt, int frames)
+{
+	int channels = ZMusic_ChannelCount(fmt.channel_config);
+	int samples = frames * channels;
+	float *out = channels == 1 ? dest + frames : dest;	// mono gets converted in the upper half and expanded afterward.
+
+	ConvertToFloat(out, src, fmt.sample_type, samples);
+
+	if (channels == 1)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			dest[i * 2] = dest[i * 2 + 1] = out[i];
+		}
+	}
+}
+
+//==========================================================================
+//
+// MixStereo
+//
+// Adds src to dest, scaled by a gain that changes by 'step' each frame.
+//
+//==========================================================================
+
+static void MixStereo(float *dest, const float *src, int frames, float gain, float step)
+{
+	int i = 0;
+#ifdef MIXER_SSE2
+	// Two frames per iteration, the gain vector holds both frames' gains.
+	__m128 g = _mm_setr_ps(gain, gain, gain + step, gain + step);
+	__m128 gstep = _mm_set1_ps(step * 2);
+	for (; i + 2 <= frames; i += 2)
+	{
+		__m128 d = _mm_loadu_ps(dest + i * 2);
+		__m128 s = _mm_loadu_ps(src + i * 2);
+		_mm_storeu_ps(dest + i * 2, _mm_add_ps(d, _mm_mul_ps(s, g)));
+		g = _mm_add_ps(g, gstep);
+	}
+	gain += step * i;
+#endif
+	for (; i < frames; i++)
+	{
+		dest[i * 2] += src[i * 2] * gain;
+		dest[i * 2 + 1] += src[i * 2 + 1] * gain;
+		gain += step;
+	}
+}
+
+//==========================================================================
+//
+// MusicMixer :: Channel :: ReadSource
+//
+// Gets the requested amount of frames from the song as stereo floats.
+// Once the song has ended only silence is returned.
+//
+//==========================================================================
+
+void MusicMixer::Channel::ReadSource(float *dest, int frames)
+{
+	if (frames <= 0) return;
+	if (Ended)
+	{
+		memset(dest, 0, frames * 2 * sizeof(float));
+		return;
+	}
+
+	int framesize = ZMusic_ChannelCount(Format.channel_config) * ZMusic_SampleTypeSize(Format.sample_type);
+	Raw.resize((size_t)frames * framesize);
+	if (!zmsx_fill_stream(Song, Raw.data(), frames * framesize))
+	{
+		Ended = true;
+	}
+	ConvertToStereoFloat(dest, Raw.data(), Format, frames);
+}
+
+//==========================================================================
+//
+// ReadSong
+//
+// Input for a channel's resampler.
+//
+//==========================================================================
+
+static bool ReadSong(void *ctx, void *buff, int len)
+{
+	return zmsx_fill_stream((MusInfo*)ctx, buff, len);
+}
+
+//==========================================================================
+//
+// MusicMixer :: Channel :: Render
+//
+// Renders one block at the mixer's rate into Output. Songs at a different
+// rate go through a resampler, at least at the fast setting.
+//
+//==========================================================================
+
+void MusicMixer::Channel::Render(int frames, int outrate)
+{
+	Output.resize(frames * 2);
+
+	// Like zmsx_fill_stream_ex, this reads the format without locking, since
+	// it only changes while the song's audio thread is suspended.
+	const ZMSXSoundStreamInfoEx &fmt = Song->m_NativeFormat;
+	if (fmt.sample_rate <= 0 || fmt.buffer_size <= 0)
+	{
+		// Not a streaming song, or not started yet.
+		memset(Output.data(), 0, Output.size() * sizeof(float));
+		return;
+	}
+	if (fmt.sample_rate != Format.sample_rate || fmt.sample_type != Format.sample_type || fmt.channel_config != Format.channel_config)
+	{
+		Format = fmt;
+		Resampler.SetTarget(outrate, ResamplerQuality);
+		Resampler.Start(fmt);
+	}
+
+	if (!Resampler.IsActive())
+	{
+		ReadSource(Output.data(), frames);
+		return;
+	}
+	if (Ended)
+	{
+		memset(Output.data(), 0, Output.size() * sizeof(float));
+		return;
+	}
+
+	int channels = ZMusic_ChannelCount(Format.channel_config);
+	Input.resize(frames * channels);
+	if (!Resampler.Read(Input.data(), frames * channels * sizeof(float), ReadSong, Song))
+	{
+		Ended = true;
+	}
+	if (channels == 1)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			Output[i * 2] = Output[i * 2 + 1] = Input[i];
+		}
+	}
+	else
+	{
+		memcpy(Output.data(), Input.data(), frames * 2 * sizeof(float));
+	}
+}
+
+//==========================================================================
+//
+// MusicMixer :: MusicMixer
+//
+//==========================================================================
+
+MusicMixer::MusicMixer(int samplerate, int numthreads)
+	: Pool(numthreads), SampleRate(samplerate)
+{
+}
+
+//==========================================================================
+//
+// MusicMixer :: ~MusicMixer
+//
+// All songs still owned by the mixer get closed.
+//
+//==========================================================================
+
+MusicMixer::~MusicMixer()
+{
+	for (auto &chan : Channels)
+	{
+		zmsx_close(chan->Song);
+	}
+}
+
+//==========================================================================
+//
+// MusicMixer :: FindChannel
+//
+//==========================================================================
+
+MusicMixer::Channel *MusicMixer::FindChannel(int handle)
+{
+	for (auto &chan : Channels)
+	{
+		if (chan->Handle == handle) return chan.get();
+	}
+	return nullptr;
+}
+
+//==========================================================================
+//
+// MusicMixer :: AddStream
+//
+//==========================================================================
+
+int MusicMixer::AddStream(MusInfo *song, float gain)
+{
+	std::lock_guard<FCriticalSection> lock(CritSec);
+	for (auto &chan : Channels)
+	{
+		if (chan->Song == song) throw std::runtime_error("Stream is already part of this mixer");
+	}
+
+	auto chan = new Channel;
+	chan->Handle = NextHandle++;
+	chan->Song = song;
+	chan->Gain = chan->TargetGain = gain;
+	chan->ResamplerQuality = std::max<int>(GetConfig()->misc.snd_resampler, StreamResampler::QUALITY_Fast);
+	Channels.emplace_back(chan);
+	Parallel.reserve(Channels.size());
+	Serial.reserve(Channels.size());
+	return chan->Handle;
+}
+
+//==========================================================================
+//
+// MusicMixer :: RemoveStream
+//
+// Returns the song so that the caller can close it outside the lock.
+//
+//==========================================================================
+
+MusInfo *MusicMixer::RemoveStream(int handle)
+{
+	std::lock_guard<FCriticalSection> lock(CritSec);
+	for (auto it = Channels.begin(); it != Channels.end(); ++it)
+	{
+		if ((*it)->Handle == handle)
+		{
+			MusInfo *song = (*it)->Song;
+			Channels.erase(it);
+			return song;
+		}
+	}
+	return nullptr;
+}
+
+//==========================================================================
+//
+// MusicMixer :: SetGain
+//
+//==========================================================================
+
+bool MusicMixer::SetGain(int handle, float gain, int rampms)
+{
+	std::lock_guard<FCriticalSection> lock(CritSec);
+	auto chan = FindChannel(handle);
+	if (chan == nullptr) return false;
+
+	chan->TargetGain = gain;
+	chan->RampLeft = std::max(0, (int)((int64_t)rampms * SampleRate / 1000));
+	if (chan->RampLeft == 0) chan->Gain = gain;
+	return true;
+}
+
+//==========================================================================
+//
+// MusicMixer :: RenderChannel
+//
+//==========================================================================
+
+void MusicMixer::RenderChannel(Channel *chan, int frames)
+{
+	try
+	{
+		chan->Render(frames, SampleRate);
+	}
+	catch (const std::exception &ex)
+	{
+		ZMusic_Printf(zmsx_msg_error, "Mixer stream %d stopped: %s\n", chan->Handle, ex.what());
+		chan->Ended = true;
+		chan->Output.assign(frames * 2, 0.f);
+	}
+}
+
+//==========================================================================
+//
+// MusicMixer :: Fill
+//
+// Renders all songs in parallel, then sums them up. Returns false if none
+// of them is still producing output. The Timidity++ songs share one job,
+// which goes first because it is likely to take the longest.
+//
+//==========================================================================
+
+bool MusicMixer::Fill(float *buffer, int frames)
+{
+	ZMSX_TRACE_ZONE("MusicMixer::Fill");
+	memset(buffer, 0, frames * 2 * sizeof(float));
+
+	std::lock_guard<FCriticalSection> lock(CritSec);
+	Parallel.clear();
+	Serial.clear();
+	for (auto &chan : Channels)
+	{
+		(chan->Song->GetDeviceType() == zmsx_mdev_timidity ? Serial : Parallel).push_back(chan.get());
+	}
+	int serial = Serial.empty() ? 0 : 1;
+	Pool.ParallelFor((int)Parallel.size() + serial, [&](int i)
+	{
+		if (i < serial)
+		{
+			for (auto chan : Serial) RenderChannel(chan, frames);
+		}
+		else
+		{
+			RenderChannel(Parallel[i - serial], frames);
+		}
+	});
+
+	bool active = false;
+	for (auto &chan : Channels)
+	{
+		const float *src = chan->Output.data();
+		int done = 0;
+		if (chan->RampLeft > 0)
+		{
+			int count = std::min(chan->RampLeft, frames);
+			float step = (chan->TargetGain - chan->Gain) / chan->RampLeft;
+			MixStereo(buffer, src, count, chan->Gain, step);
+			chan->RampLeft -= count;
+			chan->Gain = chan->RampLeft == 0 ? chan->TargetGain : chan->Gain + step * count;
+			done = count;
+		}
+		if (done < frames)
+		{
+			MixStereo(buffer + done * 2, src + done * 2, frames - done, chan->Gain, 0);
+		}
+		active |= !chan->Ended;
+	}
+	return active;
+}
+
+//==========================================================================
+//
+// C interface
+//
+//==========================================================================
+
+DLL_EXPORT MusicMixer *zmsx_mixer_create(int samplerate, int threads)
+{
+	if (samplerate <= 0)
+	{
+		SetError("Invalid sample rate");
+		return nullptr;
+	}
+	try
+	{
+		return new MusicMixer(samplerate, threads);
+	}
+	catch (const std::exception &ex)
+	{
+		SetError(ex.what());
+		return nullptr;
+	}
+}
+
+DLL_EXPORT void zmsx_mixer_destroy(MusicMixer *mixer)
+{
+	if (!mixer) return;
+	delete mixer;
+}
+
+DLL_EXPORT int zmsx_mixer_add_stream(MusicMixer *mixer, MusInfo *song, float gain)
+{
+	if (!mixer || !song)
+	{
+		SetError("Invalid mixer or stream");
+		return -1;
+	}
+	try
+	{
+		return mixer->AddStream(song, gain);
+	}
+	catch (const std::exception &ex)
+	{
+		SetError(ex.what());
+		return -1;
+	}
+}
+
+DLL_EXPORT void zmsx_mixer_remove_stream(MusicMixer *mixer, int handle)
+{
+	if (!mixer) return;
+	zmsx_close(mixer->RemoveStream(handle));
+}
+
+DLL_EXPORT bool zmsx_mixer_set_gain(MusicMixer *mixer, int handle, float gain, int ramp_ms)
+{
+	if (!mixer) return false;
+	return mixer->SetGain(handle, gain, ramp_ms);
+}
+
+DLL_EXPORT bool zmsx_mixer_fill(MusicMixer *mixer, void *buff, int len)
+{
+	if (!mixer || len < 0) return false;
+	int frames = len / (2 * sizeof(float));
+	memset((uint8_t*)buff + frames * 2 * sizeof(float), 0, len - frames * 2 * sizeof(float));
+	return mixer->Fill((float*)buff, frames);
+}
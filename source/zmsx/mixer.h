@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "zmsx.hpp"
+#include "critsec.h"
+#include "threadpool.h"
+
+class MusInfo;
+
+// Renders several songs at once and sums them into a single stereo float
+// output at a common sample rate. Each song is rendered by its own
+// ServiceStream on the mixer's thread pool, except for Timidity++ songs.
+// Its players share global state and cannot run at the same time, so all
+// of them get rendered one after another by a single job.
+
+class MusicMixer
+{
+public:
+	MusicMixer(int samplerate, int numthreads);
+	~MusicMixer();
+
+	int AddStream(MusInfo *song, float gain);
+	MusInfo *RemoveStream(int handle);
+	bool SetGain(int handle, float gain, int rampms);
+	bool Fill(float *buffer, int frames);
+	int GetSampleRate() const { return SampleRate; }
+
+private:
+	struct Channel;
+
+	Channel *FindChannel(int handle);
+	void RenderChannel(Channel *chan, int frames);
+
+	FCriticalSection CritSec;
+	std::vector<std::unique_ptr<Channel>> Channels;
+	std::vector<Channel *> Parallel;	// What Fill renders, reserved by AddStream.
+	std::vector<Channel *> Serial;
+	ThreadPool Pool;
+	int SampleRate;
+	int NextHandle = 1;
+};
@@ -0,0 +1,232 @@
+/*
+** musinfo.cpp
+** Control command handling for songs
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <stdexcept>
+
+#include "musinfo.h"
+#include "trace.h"
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// ExecuteCommand
+//
+//==========================================================================
+
+static void ExecuteCommand(MusInfo *song, const MusCommand &cmd)
+{
+	try
+	{
+		switch (cmd.Type)
+		{
+		case MusCommand::Pause:
+			song->Pause();
+			break;
+
+		case MusCommand::Resume:
+			song->Resume();
+			break;
+
+		case MusCommand::VolumeChanged:
+			song->MusicVolumeChanged((float)cmd.NumValue);
+			break;
+
+		case MusCommand::SettingInt:
+			song->ChangeSettingInt(cmd.Setting, cmd.IntValue);
+			break;
+
+		case MusCommand::SettingNum:
+			song->ChangeSettingNum(cmd.Setting, cmd.NumValue);
+			break;
+
+		case MusCommand::SettingString:
+			song->ChangeSettingString(cmd.Setting, cmd.StrValue);
+			break;
+		}
+	}
+	catch (const std::exception &ex)
+	{
+		ZMusic_Printf(zmsx_msg_error, "%s\n", ex.what());
+	}
+}
+
+//==========================================================================
+//
+// MusInfo :: PostCommand
+//
+// The queue can only fill up if the client stopped pulling the stream.
+// Waiting for room would not help then, so the command gets dropped.
+//
+// In realtime mode the audio thread gets a block of silence if it asks
+// for one while a command is being carried out.
+//
+//==========================================================================
+
+bool MusInfo::PostCommand(const MusCommand &cmd)
+{
+	if (!m_Streaming)
+	{
+		std::lock_guard<FCriticalSection> lock(CritSec);
+		ProcessCommands();
+		ExecuteCommand(this, cmd);
+		return true;
+	}
+
+	if (m_Realtime)
+	{
+		m_RenderAhead.Suspend();
+		{
+			std::lock_guard<FCriticalSection> lock(CritSec);
+			ProcessCommands();
+			ExecuteCommand(this, cmd);
+		}
+		m_RenderAhead.Unsuspend();
+		return true;
+	}
+
+	if (!m_Commands.Push(cmd))
+	{
+		ZMusic_Printf(zmsx_msg_warning, "Song command queue is full, dropping command\n");
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// MusInfo :: PostSetting*
+//
+//==========================================================================
+
+bool MusInfo::PostSettingInt(const char *setting, int value)
+{
+	MusCommand cmd(MusCommand::SettingInt, setting);
+	cmd.IntValue = value;
+	return PostCommand(cmd);
+}
+
+bool MusInfo::PostSettingNum(const char *setting, double value)
+{
+	MusCommand cmd(MusCommand::SettingNum, setting);
+	cmd.NumValue = value;
+	return PostCommand(cmd);
+}
+
+bool MusInfo::PostSettingString(const char *setting, const char *value)
+{
+	MusCommand cmd(MusCommand::SettingString, setting);
+	strncpy(cmd.StrValue, value, sizeof(cmd.StrValue) - 1);
+	return PostCommand(cmd);
+}
+
+//==========================================================================
+//
+// MusInfo :: RequestStop
+//
+// Stopping closes the device and frees its buffers, which must not happen
+// on the rendering thread. So the song first counts as stopped, then the
+// rendering threads get locked out of it, and once they have left it, it
+// gets stopped right here.
+//
+//==========================================================================
+
+void MusInfo::RequestStop()
+{
+	if (m_StopPending.exchange(true)) return;
+	m_RenderAhead.Suspend();
+	m_RenderAhead.Reset(nullptr);	// Its thread renders the song, too.
+	try
+	{
+		std::lock_guard<FCriticalSection> lock(CritSec);
+		ProcessCommands();
+		Stop();
+	}
+	catch (const std::exception &ex)
+	{
+		ZMusic_Printf(zmsx_msg_error, "%s\n", ex.what());
+	}
+	m_RenderAhead.Unsuspend();
+}
+
+//==========================================================================
+//
+// MusInfo :: ProcessCommands
+//
+//==========================================================================
+
+void MusInfo::ProcessCommands()
+{
+	ZMSX_TRACE_ZONE("MusInfo::ProcessCommands");
+	MusCommand cmd;
+	while (m_Commands.Pop(cmd))
+	{
+		ExecuteCommand(this, cmd);
+	}
+}
+
+//==========================================================================
+//
+// MusInfo :: RenderStream
+//
+//==========================================================================
+
+bool MusInfo::RenderStream(void *buff, int len)
+{
+	ZMSX_TRACE_ZONE("MusInfo::RenderStream");
+	ProcessCommands();
+	auto start = PerfCounters::Clock::now();
+	bool res = ServiceStream(buff, len);
+	m_Perf.AddBlock(PerfCounters::Clock::now() - start, len);
+	return res;
+}
+
+//==========================================================================
+//
+// MusInfo :: GetBufferBytes
+//
+//==========================================================================
+
+size_t MusInfo::GetBufferBytes() const
+{
+	size_t bytes = sizeof(m_Converter);
+	if (auto ra = m_RenderAhead.Get())
+	{
+		bytes += ra->GetBufferBytes();
+	}
+	return bytes;
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <mutex>
 #include "mididefs.h"
 #include "zmsx/zmsx.hpp"
 #include "critsec.h"
+#include "renderahead.h"
+#include "commandqueue.h"
+#include "sampleconv.h"
+#include "perfcounters.h"
 
 // The base music class. Everything is derived from this --------------------
 
@@ -13,7 +18,7 @@ class MusInfo
 public:
 	MusInfo() = default;
 	virtual ~MusInfo() {}
-	virtual void MusicVolumeChanged() {}		// snd_musicvolume changed
+	virtual void MusicVolumeChanged(float volume) {}		// snd_musicvolume changed, volume is the config's MusicVolume.
 	virtual void Play (bool looping, int subsong) = 0;
 	virtual void Pause () = 0;
 	virtual void Resume () = 0;
@@ -22,6 +27,7 @@ public:
 	virtual bool IsMIDI() const { return false; }
 	virtual bool IsValid () const = 0;
 	virtual bool SetPosition(unsigned int ms) { return false;  }
+	virtual bool GetSongInfo(ZMSXSongInfo &info) { return false; }	// info arrives with everything unknown.
 	virtual bool SetSubsong (int subsong) { return false; }
 	virtual void Update() {}
 	virtual int GetDeviceType() const { return zmsx_mdev_default; }	// zmsx_mdev_default stands in for anything that cannot change playback parameters which needs a restart.
@@ -31,7 +37,29 @@ public:
 	virtual void ChangeSettingNum(const char* setting, double value) {}		// "
 	virtual void ChangeSettingString(const char* setting, const char* value) {}	// "
 	virtual bool ServiceStream(void *buff, int len) { return false;  }
+	virtual void PrepareRealtime() {}	// Allocate everything ServiceStream would allocate on first use.
 	virtual ZMSXSoundStreamInfoEx GetStreamInfoEx() const = 0;
+	virtual size_t GetBufferBytes() const;	// Memory held for streaming the song, for the perf counters.
+
+	// Control requests from the client. While the song is being streamed they
+	// get queued and are carried out by the rendering thread before it renders
+	// the next block, so that it never has to wait for the controlling thread.
+	// In realtime mode the rendering thread must not do that work either, so
+	// they are carried out on the calling thread while the rendering threads
+	// are locked out. Songs that are not streamed carry them out right away.
+	// Posting fails if the queue is full. Stopping is no command, RequestStop
+	// does it on the calling thread once the rendering threads have let go of
+	// the song.
+	bool PostCommand(const MusCommand &cmd);
+	bool PostSettingInt(const char *setting, int value);
+	bool PostSettingNum(const char *setting, double value);
+	bool PostSettingString(const char *setting, const char *value);
+	void RequestStop();
+	bool IsStopPending() const { return m_StopPending; }
+
+	// Only for the thread that renders the song.
+	void ProcessCommands();
+	bool RenderStream(void *buff, int len);
 
 	enum EState
 	{
@@ -40,5 +68,13 @@ public:
 		STATE_Paused
 	} m_Status = STATE_Stopped;
 	bool m_Looping = false;
-	FCriticalSection CritSec;
+	FCriticalSection CritSec;	// Serializes control functions. The rendering thread never takes it.
+	RenderAheadSlot m_RenderAhead;	// Gate for the audio thread, also holds the render-ahead buffer if enabled.
+	MusCommandQueue m_Commands;
+	std::atomic<bool> m_Streaming{ false };	// Set by zmsx_start if the song's output gets pulled by zmsx_fill_stream.
+	std::atomic<bool> m_StopPending{ false };
+	std::atomic<bool> m_Realtime{ false };	// Set by zmsx_start from zmsx_snd_realtime.
+	ZMSXSoundStreamInfoEx m_NativeFormat = {};	// Stream format at the time the song was started.
+	SampleConverter m_Converter;	// Only for the audio thread, used by zmsx_fill_stream_ex.
+	PerfCounters m_Perf;	// Written by the rendering thread in RenderStream.
 };
@@ -0,0 +1,159 @@
+/*
+** perfcounters.cpp
+** Rendering statistics for songs
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <math.h>
+
+#include "perfcounters.h"
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// PerfCounters :: Reset
+//
+//==========================================================================
+
+void PerfCounters::Reset(const ZMSXSoundStreamInfoEx &format)
+{
+	size_t framesize = ZMusic_ChannelCount(format.channel_config) * ZMusic_SampleTypeSize(format.sample_type);
+	NsPerByte = format.sample_rate > 0 ? 1e9 / ((double)format.sample_rate * framesize) : 0;
+
+	Blocks = 0;
+	TotalNs = 0;
+	MinNs = UINT64_MAX;
+	AudioNs = 0;
+	SynthNs = 0;
+	Events = 0;
+	UnderrunRisk = 0;
+	Voices = -1;
+	for (auto &bucket : Histogram)
+	{
+		bucket = 0;
+	}
+}
+
+//==========================================================================
+//
+// PerfCounters :: AddBlock
+//
+// Bucket 0 holds everything below 1 µs, bucket i the times from
+// 2^((i-1)/8) µs up to 2^(i/8) µs.
+//
+//==========================================================================
+
+void PerfCounters::AddBlock(Clock::duration elapsed, int len)
+{
+	uint64_t ns = (uint64_t)std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), 0);
+	uint64_t audions = (uint64_t)(len * NsPerByte);
+
+	Add(Blocks, 1);
+	Add(TotalNs, ns);
+	Add(AudioNs, audions);
+	if (ns < MinNs.load(std::memory_order_relaxed))
+	{
+		MinNs.store(ns, std::memory_order_relaxed);
+	}
+	if (ns > audions / 2)
+	{
+		Add(UnderrunRisk, 1);
+	}
+
+	int bucket = 0;
+	if (ns >= 1000)
+	{
+		bucket = std::min(int(log2(ns / 1000.) * BUCKETS_PER_OCTAVE) + 1, NUM_BUCKETS - 1);
+	}
+	Histogram[bucket].store(Histogram[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+//==========================================================================
+//
+// PerfCounters :: AddWork
+//
+//==========================================================================
+
+void PerfCounters::AddWork(const PerfWork &work, int voices)
+{
+	Add(Events, work.Events);
+	Add(SynthNs, (uint64_t)std::max<int64_t>(work.SynthNs, 0));
+	Voices.store(voices, std::memory_order_relaxed);
+}
+
+//==========================================================================
+//
+// PerfCounters :: Get
+//
+//==========================================================================
+
+void PerfCounters::Get(ZMSXPerfCounters &out) const
+{
+	uint64_t blocks = Blocks.load(std::memory_order_relaxed);
+	uint64_t totalns = TotalNs.load(std::memory_order_relaxed);
+
+	out = {};
+	out.blocks = blocks;
+	out.active_voices = Voices.load(std::memory_order_relaxed);
+	out.events_processed = Events.load(std::memory_order_relaxed);
+	out.underrun_risk = UnderrunRisk.load(std::memory_order_relaxed);
+	if (blocks == 0)
+	{
+		return;
+	}
+
+	out.block_min_us = MinNs.load(std::memory_order_relaxed) / 1000.;
+	out.block_avg_us = totalns / 1000. / blocks;
+	if (totalns > 0)
+	{
+		out.realtime_factor = (double)AudioNs.load(std::memory_order_relaxed) / totalns;
+		out.synth_fraction = std::min((double)SynthNs.load(std::memory_order_relaxed) / totalns, 1.);
+	}
+
+	// Walk down from the slowest bucket until 1% of all blocks are covered.
+	uint64_t limit = blocks / 100;
+	uint64_t count = 0;
+	int bucket;
+	for (bucket = NUM_BUCKETS - 1; bucket > 0; --bucket)
+	{
+		count += Histogram[bucket].load(std::memory_order_relaxed);
+		if (count > limit)
+		{
+			break;
+		}
+	}
+	out.block_p99_us = std::max(exp2((double)bucket / BUCKETS_PER_OCTAVE), out.block_min_us);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "zmsx.hpp"
+
+// Work a synthesizer reports for the blocks it rendered. It is only touched
+// by the rendering thread, which collects it after every block.
+struct PerfWork
+{
+	uint64_t Events = 0;
+	int64_t SynthNs = 0;
+};
+
+// Rendering statistics of one song, for zmsx_get_perf_counters.
+//
+// Only the rendering thread writes them, once per block, so the counters
+// are plain relaxed atomics without any read-modify-write. Other threads may
+// read them at any time. A snapshot taken while the song plays may mix two
+// consecutive blocks, which does not matter for statistics.
+//
+// Render times go into a histogram with 8 buckets per octave, which puts the
+// 99th percentile within 9% of the real value.
+
+class PerfCounters
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// Only while the song is not being rendered.
+	void Reset(const ZMSXSoundStreamInfoEx &format);
+
+	// Only for the rendering thread.
+	void AddBlock(Clock::duration elapsed, int len);
+	void AddWork(const PerfWork &work, int voices);
+
+	void Get(ZMSXPerfCounters &out) const;
+
+private:
+	enum
+	{
+		BUCKETS_PER_OCTAVE = 8,
+		NUM_BUCKETS = 24 * BUCKETS_PER_OCTAVE,	// 1 µs up to 16 s
+	};
+
+	static void Add(std::atomic<uint64_t> &counter, uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	double NsPerByte = 0;
+
+	std::atomic<uint64_t> Blocks{ 0 };
+	std::atomic<uint64_t> TotalNs{ 0 };
+	std::atomic<uint64_t> MinNs{ 0 };
+	std::atomic<uint64_t> AudioNs{ 0 };
+	std::atomic<uint64_t> SynthNs{ 0 };
+	std::atomic<uint64_t> Events{ 0 };
+	std::atomic<uint64_t> UnderrunRisk{ 0 };
+	std::atomic<int> Voices{ -1 };
+	std::atomic<uint32_t> Histogram[NUM_BUCKETS] = {};
+};
@@ -0,0 +1,449 @@
+/*
+** renderahead.cpp
+** Renders streamed songs ahead of time on a worker thread
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string.h>
+
+#include "renderahead.h"
+#include "songqueue.h"
+#include "musinfo.h"
+#include "midiconfig.h"
+#include "trace.h"
+
+// MACROS ------------------------------------------------------------------
+
+// Each render call produces about this many milliseconds of audio.
+#define BLOCK_MS	5
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// CreateRenderAhead
+//
+// Returns a render-ahead buffer for the song if the client enabled it and
+// the song produces streamed output, nullptr otherwise.
+//
+//==========================================================================
+
+RenderAhead *CreateRenderAhead(MusInfo *song)
+{
+	int ms = GetConfig()->misc.snd_renderahead;
+	if (ms <= 0 || song->m_Status == MusInfo::STATE_Stopped) return nullptr;
+
+	ZMSXSoundStreamInfoEx format;
+	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		format = song->GetStreamInfoEx();
+	}
+	if (format.buffer_size <= 0 || format.sample_rate <= 0) return nullptr;
+	return new RenderAhead(song, format, ms);
+}
+
+//==========================================================================
+//
+// RenderAhead :: RenderAhead
+//
+//==========================================================================
+
+RenderAhead::RenderAhead(MusInfo *song, const ZMSXSoundStreamInfoEx &format, int milliseconds)
+	: Song(song), Format(format)
+{
+	FrameSize = ZMusic_ChannelCount(format.channel_config) * ZMusic_SampleTypeSize(format.sample_type);
+
+	size_t blockframes = std::max<size_t>(format.sample_rate * BLOCK_MS / 1000, 64);
+	size_t totalframes = std::max<size_t>((size_t)format.sample_rate * milliseconds / 1000, blockframes * 2);
+
+	BlockSize = blockframes * FrameSize;
+	SleepTime = std::max(BLOCK_MS / 2, 1);
+	Block.resize(BlockSize);
+	Ring.Resize(totalframes * FrameSize);
+}
+
+//==========================================================================
+//
+// RenderAhead :: ~RenderAhead
+//
+//==========================================================================
+
+RenderAhead::~RenderAhead()
+{
+	Stop();
+}
+
+//==========================================================================
+//
+// RenderAhead :: Start
+//
+//==========================================================================
+
+void RenderAhead::Start()
+{
+	Stop();
+	Running = true;
+	Thread = std::thread([this]() { Worker(); });
+}
+
+//==========================================================================
+//
+// RenderAhead :: Stop
+//
+// Waits for the worker to finish its current block. Must be called before
+// the song is changed in ways that invalidate already rendered data, and
+// before the song gets destroyed.
+//
+//==========================================================================
+
+void RenderAhead::Stop()
+{
+	Running = false;
+	if (Thread.joinable())
+	{
+		Thread.join();
+	}
+}
+
+//==========================================================================
+//
+// RenderAhead :: Prime
+//
+// Renders the first client buffer's worth of data on the calling thread so
+// that the first call to Read can be served without waiting for the worker.
+//
+//==========================================================================
+
+void RenderAhead::Prime()
+{
+	if (Running) return;
+
+	size_t want = std::min<size_t>(Format.buffer_size, Ring.GetCapacity() - BlockSize);
+	while (!Finished && Ring.ReadAvailable() < want)
+	{
+		if (!RenderBlock()) break;
+	}
+}
+
+//==========================================================================
+//
+// RenderAhead :: SetPaused
+//
+//==========================================================================
+
+void RenderAhead::SetPaused(bool on)
+{
+	Paused = on;
+}
+
+//==========================================================================
+//
+// RenderAhead :: IsDrained
+//
+// True when the song has ended and all its output has been played.
+//
+//==========================================================================
+
+bool RenderAhead::IsDrained() const
+{
+	return Finished && Ring.ReadAvailable() == 0;
+}
+
+//==========================================================================
+//
+// RenderAhead :: Read
+//
+// Called from the client's audio thread. This never waits for the worker,
+// if not enough data is available the rest is filled with silence.
+// Returns false once the song has ended and its output is used up.
+//
+//==========================================================================
+
+bool RenderAhead::Read(void *buff, int len)
+{
+	if (len <= 0) return true;
+	if (Paused)
+	{
+		FillSilence(buff, len);
+		return true;
+	}
+
+	size_t got = Ring.Read(buff, len);
+	if (got < (size_t)len)
+	{
+		FillSilence((uint8_t*)buff + got, len - got);
+		if (Finished && Ring.ReadAvailable() == 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// RenderAhead :: FillSilence
+//
+//==========================================================================
+
+void RenderAhead::FillSilence(void *buff, size_t len) const
+{
+	memset(buff, Format.sample_type == zmsx_sample_uint8 ? 0x80 : 0, len);
+}
+
+//==========================================================================
+//
+// RenderAhead :: RenderBlock
+//
+// Renders one block into the ring. Returns false if there was no room.
+//
+//==========================================================================
+
+bool RenderAhead::RenderBlock()
+{
+	ZMSX_TRACE_ZONE("RenderAhead::RenderBlock");
+	if (Ring.WriteAvailable() < BlockSize)
+	{
+		return false;
+	}
+
+	bool more;
+	try
+	{
+		more = Song->RenderStream(Block.data(), (int)BlockSize);
+	}
+	catch (const std::exception &ex)
+	{
+		ZMusic_Printf(zmsx_msg_error, "Render-ahead stopped: %s\n", ex.what());
+		more = false;
+	}
+
+	Ring.Write(Block.data(), BlockSize);
+	if (!more)
+	{
+		Finished = true;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// RenderAhead :: Worker
+//
+// Keeps the ring filled until stopped or the song ends.
+//
+//==========================================================================
+
+void RenderAhead::Worker()
+{
+	while (Running && !Finished)
+	{
+		bool rendered = false;
+		if (!Paused && Song->m_RenderAhead.Enter())
+		{
+			rendered = RenderBlock();
+			Song->m_RenderAhead.Leave();
+		}
+		if (!rendered)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(SleepTime));
+		}
+	}
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: WaitForUsers
+//
+// Waits until the audio thread and the render-ahead worker have left the
+// song.
+//
+//==========================================================================
+
+void RenderAheadSlot::WaitForUsers()
+{
+	while (Users.load() != 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: Reset
+//
+// Replaces the song's render-ahead buffer. The old one is only destroyed
+// once the audio thread is no longer reading from it.
+//
+//==========================================================================
+
+void RenderAheadSlot::Reset(RenderAhead *ra)
+{
+	RenderAhead *old = Ptr.exchange(ra);
+	if (old != nullptr)
+	{
+		old->Stop();
+		WaitForUsers();
+		delete old;
+	}
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: SetNext
+//
+// Replaces the song queued to follow. The old one is only destroyed once
+// the audio thread is no longer reading through it.
+//
+//==========================================================================
+
+void RenderAheadSlot::SetNext(QueuedSong *next)
+{
+	QueuedSong *old = Next.exchange(next);
+	if (old != nullptr)
+	{
+		WaitForUsers();
+		delete old;
+	}
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: Suspend
+//
+// Once this returns neither the audio thread nor the render-ahead worker
+// will touch the song until Unsuspend gets called.
+//
+//==========================================================================
+
+void RenderAheadSlot::Suspend()
+{
+	Suspended.fetch_add(1);
+	WaitForUsers();
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: Enter
+//
+// Lets the render-ahead worker into the song unless the slot is suspended.
+// Each successful call needs its own Leave.
+//
+//==========================================================================
+
+bool RenderAheadSlot::Enter()
+{
+	Users.fetch_add(1);
+	if (Suspended != 0)
+	{
+		Users.fetch_sub(1);
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: Read
+//
+// Called from the client's audio thread.
+//
+//==========================================================================
+
+bool RenderAheadSlot::Read(MusInfo *song, void *buff, int len)
+{
+	bool res = true;
+	Users.fetch_add(1);
+	try
+	{
+		if (Suspended != 0)
+		{
+			if (len > 0) memset(buff, Silence, len);
+		}
+		else if (QueuedSong *next = Next.load())
+		{
+			res = next->Read(buff, len);
+		}
+		else
+		{
+			res = ReadSong(song, buff, len);
+		}
+	}
+	catch (...)
+	{
+		Users.fetch_sub(1);
+		throw;
+	}
+	Users.fetch_sub(1);
+	return res;
+}
+
+//==========================================================================
+//
+// RenderAheadSlot :: ReadSong
+//
+// Reads the song's own output, ignoring a queued song. A song queue reads
+// its current song through here, so this keeps out of a suspended song too.
+//
+//==========================================================================
+
+bool RenderAheadSlot::ReadSong(MusInfo *song, void *buff, int len)
+{
+	bool res = true;
+	Users.fetch_add(1);
+	try
+	{
+		if (Suspended != 0)
+		{
+			if (len > 0) memset(buff, Silence, len);
+		}
+		else if (RenderAhead *ra = Ptr.load())
+		{
+			res = ra->Read(buff, len);
+		}
+		else
+		{
+			res = song->RenderStream(buff, len);
+		}
+	}
+	catch (...)
+	{
+		Users.fetch_sub(1);
+		throw;
+	}
+	Users.fetch_sub(1);
+	return res;
+}
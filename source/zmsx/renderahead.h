@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "zmsx.hpp"
+#include "ringbuffer.h"
+
+class MusInfo;
+class QueuedSong;
+
+// Renders a song's output on a worker thread ahead of time so that the
+// client's audio callback only needs to copy already finished data.
+//
+// While it runs the worker is the song's rendering thread, so it is the one
+// that carries out queued control commands. Everything they change only
+// becomes audible once the data already in the ring has been played. It
+// enters the song through the slot like the audio thread does, so
+// suspending the slot holds it back as well.
+
+class RenderAhead
+{
+public:
+	RenderAhead(MusInfo *song, const ZMSXSoundStreamInfoEx &format, int milliseconds);
+	~RenderAhead();
+
+	void Start();
+	void Stop();
+	void Prime();
+	void SetPaused(bool on);
+
+	bool Read(void *buff, int len);
+	bool IsDrained() const;
+	size_t GetBufferBytes() const { return Ring.GetCapacity() + Block.size(); }
+
+private:
+	void Worker();
+	bool RenderBlock();
+	void FillSilence(void *buff, size_t len) const;
+
+	MusInfo *Song;
+	ZMSXSoundStreamInfoEx Format;
+	size_t FrameSize;
+	size_t BlockSize;
+	int SleepTime;
+
+	SPSCRingBuffer Ring;
+	std::vector<uint8_t> Block;
+	std::thread Thread;
+
+	std::atomic<bool> Running{ false };
+	std::atomic<bool> Paused{ false };
+	std::atomic<bool> Finished{ false };
+};
+
+// The audio thread's way into a song. Reads come out of the render-ahead
+// buffer if there is one and get rendered directly otherwise.
+//
+// The controlling thread can suspend the audio thread's access for changes
+// that cannot be done through the command queue, like restarting the song.
+// While suspended, reads return silence instead of waiting. The slot also
+// guards the render-ahead buffer against being destroyed while in use, and
+// the same for a song queued to follow this one, which reads go through
+// while it exists.
+//
+// Only Read may be called from the audio thread and only Enter and Leave
+// from the render-ahead worker, everything else belongs to the controlling
+// thread.
+
+class RenderAheadSlot
+{
+public:
+	~RenderAheadSlot() { SetNext(nullptr); Reset(nullptr); }
+
+	void Reset(RenderAhead *ra);
+	RenderAhead *Get() const { return Ptr.load(); }
+	void SetNext(QueuedSong *next);
+	QueuedSong *GetNext() const { return Next.load(); }
+	bool Read(MusInfo *song, void *buff, int len);
+	bool ReadSong(MusInfo *song, void *buff, int len);	// Only for the queued song, while it is being read.
+	bool Enter();	// For the render-ahead worker, fails while suspended.
+	void Leave() { Users.fetch_sub(1); }
+
+	void Suspend();	// Nests, each call needs its own Unsuspend.
+	void Unsuspend() { Suspended.fetch_sub(1); }
+	void SetSilence(uint8_t value) { Silence = value; }
+
+private:
+	void WaitForUsers();
+
+	std::atomic<RenderAhead*> Ptr{ nullptr };
+	std::atomic<QueuedSong*> Next{ nullptr };
+	std::atomic<int> Users{ 0 };
+	std::atomic<int> Suspended{ 0 };
+	std::atomic<uint8_t> Silence{ 0 };
+};
+
+RenderAhead *CreateRenderAhead(MusInfo *song);
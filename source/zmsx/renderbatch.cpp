@@ -0,0 +1,264 @@
+/*
+** renderbatch.cpp
+** Offline rendering of many songs at once
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <mutex>
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+
+#include "zmsx.hpp"
+#include "musinfo.h"
+#include "threadpool.h"
+#include "wavefile.h"
+
+// MACROS ------------------------------------------------------------------
+
+// Frames rendered per ServiceStream call.
+#define RENDER_FRAMES	4096
+
+// EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
+
+ZMSXMidiDevice SelectMIDIDevice(ZMSXMidiDevice device);
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+// Serializes opening songs whose devices load their instruments into global state.
+static std::mutex OpenMutex;
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// CanOpenConcurrently
+//
+// Timidity, GUS and WildMidi set up shared configuration when a device gets
+// created, so those may only be opened one at a time. Their rendering is
+// safe to run in parallel.
+//
+//==========================================================================
+
+static bool CanOpenConcurrently(ZMSXMidiDevice device)
+{
+	switch (SelectMIDIDevice(device))
+	{
+	case zmsx_mdev_fluidsynth:
+	case zmsx_mdev_adl:
+	case zmsx_mdev_opn:
+	case zmsx_mdev_opl:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+//==========================================================================
+//
+// FileSize
+//
+//==========================================================================
+
+static int64_t FileSize(const char *filename)
+{
+	if (filename == nullptr) return 0;
+	FILE *f = MusicIO::utf8_fopen(filename, "rb");
+	if (f == nullptr) return 0;
+	fseek(f, 0, SEEK_END);
+	int64_t size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+//==========================================================================
+//
+// RenderJob
+//
+// Renders one song to a wave file in the song's native output format.
+//
+//==========================================================================
+
+static void RenderJob(const ZMSXRenderJob &job, ZMSXRenderResult &result, std::atomic<bool> &firstopen)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	MusInfo *song;
+	{
+		// The first open is always done alone so that the backends' one-time
+		// setup does not race.
+		std::unique_lock<std::mutex> lock(OpenMutex, std::defer_lock);
+		if (!firstopen || !CanOpenConcurrently(job.device)) lock.lock();
+		song = zmsx_open_song_file(job.input_path, job.device, job.device_args);
+		firstopen = true;
+	}
+	if (song == nullptr)
+	{
+		throw std::runtime_error(zmsx_get_last_error());
+	}
+
+	try
+	{
+		// This bypasses zmsx_start so that no render-ahead thread gets involved.
+		song->Play(false, job.subsong);
+
+		ZMSXSoundStreamInfoEx fmt = song->GetStreamInfoEx();
+		if (fmt.sample_rate <= 0 || fmt.buffer_size <= 0)
+		{
+			throw std::runtime_error("Song does not produce streamed output");
+		}
+
+		WaveFileWriter writer;
+		if (!writer.Open(job.output_path, fmt.sample_rate, fmt.channel_config, fmt.sample_type))
+		{
+			throw std::runtime_error(std::string("Failed to write ") + job.output_path + ": " + strerror(errno));
+		}
+
+		size_t framesize = ZMusic_ChannelCount(fmt.channel_config) * ZMusic_SampleTypeSize(fmt.sample_type);
+		std::vector<uint8_t> buffer(RENDER_FRAMES * framesize);
+		int64_t maxframes = job.max_seconds > 0 ? int64_t(job.max_seconds * fmt.sample_rate) : INT64_MAX;
+		int64_t frames = 0;
+
+		while (frames < maxframes)
+		{
+			int count = (int)std::min<int64_t>(RENDER_FRAMES, maxframes - frames);
+			bool more;
+			{
+				std::lock_guard<FCriticalSection> lock(song->CritSec);
+				more = song->ServiceStream(buffer.data(), int(count * framesize));
+			}
+			// Same as the MIDI wave writer, the block that reports the end is not written.
+			if (!more) break;
+			if (!writer.Write(buffer.data(), count * framesize))
+			{
+				throw std::runtime_error(std::string("Could not write entire wave file: ") + strerror(errno));
+			}
+			frames += count;
+		}
+		if (!writer.Close())
+		{
+			throw std::runtime_error(std::string("Could not finish writing wave file: ") + strerror(errno));
+		}
+
+		result.audio_seconds = double(frames) / fmt.sample_rate;
+	}
+	catch (...)
+	{
+		zmsx_close(song);
+		throw;
+	}
+	zmsx_close(song);
+
+	result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.realtime_factor = result.wall_seconds > 0 ? result.audio_seconds / result.wall_seconds : 0;
+	result.success = true;
+}
+
+//==========================================================================
+//
+// zmsx_render_batch
+//
+// Renders all jobs on a work stealing pool. Larger files get scheduled first
+// because they tend to take longest, which evens out the threads' load.
+//
+// Timidity++ players share global state and cannot render at the same time,
+// so all Timidity++ jobs are one work item that runs them one after another,
+// instead of holding up a thread each while they wait for each other.
+//
+//==========================================================================
+
+DLL_EXPORT int zmsx_render_batch(const ZMSXRenderJob *jobs, ZMSXRenderResult *results, int count, int threads)
+{
+	if (jobs == nullptr || results == nullptr || count <= 0) return 0;
+
+	std::vector<int> order(count);
+	std::vector<int64_t> sizes(count);
+	for (int i = 0; i < count; i++)
+	{
+		order[i] = i;
+		sizes[i] = FileSize(jobs[i].input_path);
+		results[i] = {};
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a] > sizes[b]; });
+
+	std::vector<int> serial;
+	order.erase(std::remove_if(order.begin(), order.end(), [&](int i)
+	{
+		bool timidity = SelectMIDIDevice(jobs[i].device) == zmsx_mdev_timidity;
+		if (timidity) serial.push_back(i);
+		return timidity;
+	}), order.end());
+	int serialitems = serial.empty() ? 0 : 1;
+
+	std::atomic<bool> firstopen{ false };
+	std::atomic<int> succeeded{ 0 };
+	auto render = [&](int i)
+	{
+		auto &result = results[i];
+		try
+		{
+			if (jobs[i].input_path == nullptr || jobs[i].output_path == nullptr)
+			{
+				throw std::runtime_error("Missing file name");
+			}
+			if (jobs[i].device == zmsx_mdev_standard)
+			{
+				throw std::runtime_error("System MIDI device is not supported");
+			}
+			RenderJob(jobs[i], result, firstopen);
+			succeeded++;
+		}
+		catch (const std::exception &ex)
+		{
+			result.success = false;
+			snprintf(result.error, sizeof(result.error), "%s", ex.what());
+		}
+	};
+	RunWorkStealing((int)order.size() + serialitems, threads, [&](int index)
+	{
+		if (index < serialitems)
+		{
+			for (int i : serial) render(i);
+		}
+		else
+		{
+			render(order[index - serialitems]);
+		}
+	});
+	return succeeded;
+}
@@ -0,0 +1,330 @@
+/*
+** resampler.cpp
+** Polyphase sample rate conversion for song output
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "resampler.h"
+#include "sampleconv.h"
+#include "trace.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RESAMPLER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLER_NEON
+#endif
+
+// MACROS ------------------------------------------------------------------
+
+static const double PI = 3.14159265358979323846;
+
+// TYPES -------------------------------------------------------------------
+
+struct ResamplerPreset
+{
+	int Taps;		// must be a multiple of 8
+	int Phases;
+	double Beta;	// Kaiser window shape
+	double Cutoff;	// relative to the lower Nyquist frequency
+};
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+static const ResamplerPreset Presets[] =
+{
+	{ 8, 64, 5.0, 0.85 },		// QUALITY_Fast
+	{ 16, 128, 7.0, 0.91 },		// QUALITY_Balanced
+	{ 32, 256, 9.5, 0.95 },		// QUALITY_Best
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// BesselI0
+//
+//==========================================================================
+
+static double BesselI0(double x)
+{
+	double sum = 1, term = 1;
+	for (int k = 1; k < 50; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12) break;
+	}
+	return sum;
+}
+
+//==========================================================================
+//
+// Dot
+//
+//==========================================================================
+
+static inline float Dot(const float *a, const float *b, int n)
+{
+	int i = 0;
+	float sum = 0;
+#if defined(RESAMPLER_AVX)
+	__m256 acc = _mm256_setzero_ps();
+	for (; i + 8 <= n; i += 8)
+	{
+		acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+	}
+	__m128 v = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	sum = _mm_cvtss_f32(v);
+#elif defined(RESAMPLER_SSE2)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for (; i + 8 <= n; i += 8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	__m128 v = _mm_add_ps(acc0, acc1);
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	sum = _mm_cvtss_f32(v);
+#elif defined(RESAMPLER_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0);
+	float32x4_t acc1 = vdupq_n_f32(0);
+	for (; i + 8 <= n; i += 8)
+	{
+		acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+	}
+	float32x4_t v = vaddq_f32(acc0, acc1);
+	float32x2_t h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	sum = vget_lane_f32(vpadd_f32(h, h), 0);
+#endif
+	for (; i < n; i++) sum += a[i] * b[i];
+	return sum;
+}
+
+//==========================================================================
+//
+// StreamResampler :: SetTarget
+//
+//==========================================================================
+
+void StreamResampler::SetTarget(int samplerate, int quality)
+{
+	TargetRate = samplerate;
+	Quality = std::min<int>(quality, QUALITY_Best);
+}
+
+//==========================================================================
+//
+// StreamResampler :: Start
+//
+//==========================================================================
+
+void StreamResampler::Start(const ZMSXSoundStreamInfoEx &native)
+{
+	Active = false;
+	Channels = ZMusic_ChannelCount(native.channel_config);
+	if (Quality <= QUALITY_Off || TargetRate <= 0 || native.sample_rate <= 0 || native.buffer_size <= 0 ||
+		native.sample_rate == TargetRate || Channels == 0)
+	{
+		return;
+	}
+
+	auto &preset = Presets[Quality - 1];
+	double cutoff = preset.Cutoff * std::min(1., (double)TargetRate / native.sample_rate);
+
+	// The table only depends on the rate ratio, so it can be kept across restarts.
+	if (In.sample_rate != native.sample_rate || Taps != preset.Taps || Phases != preset.Phases || Filter.empty())
+	{
+		Taps = preset.Taps;
+		Phases = preset.Phases;
+		Filter.resize((Phases + 1) * Taps);
+		double center = Taps / 2 - 1;
+		double i0beta = BesselI0(preset.Beta);
+		for (int p = 0; p <= Phases; p++)
+		{
+			float *row = &Filter[p * Taps];
+			double sum = 0;
+			for (int k = 0; k < Taps; k++)
+			{
+				// Distance of tap k from the output position, in input samples.
+				double x = k - center - (double)p / Phases;
+				double w = x / (Taps / 2);
+				double window = fabs(w) < 1 ? BesselI0(preset.Beta * sqrt(1 - w * w)) / i0beta : 0;
+				double sinc = x == 0 ? 1 : sin(PI * cutoff * x) / (PI * cutoff * x);
+				row[k] = float(sinc * window);
+				sum += row[k];
+			}
+			// Normalize each phase for unity gain at DC.
+			for (int k = 0; k < Taps; k++) row[k] = float(row[k] / sum);
+		}
+	}
+
+	In = native;
+	Out = { native.buffer_size, TargetRate, zmsx_sample_float32, native.channel_config };
+	Step = ((uint64_t)native.sample_rate << 32) / TargetRate;
+	for (int c = 0; c < Channels; c++)
+	{
+		Input[c].assign(Taps + BLOCK_FRAMES, 0.f);
+	}
+	Raw.resize(BLOCK_FRAMES * Channels * ZMusic_SampleTypeSize(native.sample_type));
+	Scratch.resize(BLOCK_FRAMES * Channels);
+
+	// Start with zeros in front, so the first output frame lines up with the first input frame.
+	Avail = Taps / 2 - 1;
+	EndFrame = -1;
+	Pos = 0;
+	Ended = false;
+	Active = true;
+}
+
+//==========================================================================
+//
+// StreamResampler :: GetBufferBytes
+//
+//==========================================================================
+
+size_t StreamResampler::GetBufferBytes() const
+{
+	return (Filter.capacity() + Input[0].capacity() + Input[1].capacity() + Scratch.capacity()) * sizeof(float) + Raw.capacity();
+}
+
+//==========================================================================
+//
+// StreamResampler :: Refill
+//
+// Drops everything before the first tap and reads another block of input.
+//
+//==========================================================================
+
+void StreamResampler::Refill(SourceFunc source, void *ctx)
+{
+	ZMSX_TRACE_ZONE("StreamResampler::Refill");
+	int drop = std::min((int)(Pos >> 32), Avail);
+	if (drop > 0)
+	{
+		for (int c = 0; c < Channels; c++)
+		{
+			memmove(Input[c].data(), Input[c].data() + drop, (Avail - drop) * sizeof(float));
+		}
+		Avail -= drop;
+		if (EndFrame >= 0) EndFrame -= drop;
+		Pos -= (uint64_t)drop << 32;
+	}
+
+	if (Ended)
+	{
+		memset(Raw.data(), In.sample_type == zmsx_sample_uint8 ? 0x80 : 0, Raw.size());
+	}
+	else if (!source(ctx, Raw.data(), (int)Raw.size()))
+	{
+		Ended = true;
+	}
+	ConvertToFloat(Scratch.data(), Raw.data(), In.sample_type, BLOCK_FRAMES * Channels);
+
+	if (Channels == 1)
+	{
+		memcpy(Input[0].data() + Avail, Scratch.data(), BLOCK_FRAMES * sizeof(float));
+	}
+	else
+	{
+		float *left = Input[0].data() + Avail;
+		float *right = Input[1].data() + Avail;
+		for (int i = 0; i < BLOCK_FRAMES; i++)
+		{
+			left[i] = Scratch[i * 2];
+			right[i] = Scratch[i * 2 + 1];
+		}
+	}
+	Avail += BLOCK_FRAMES;
+	if (Ended && EndFrame < 0)
+	{
+		EndFrame = Avail;
+	}
+}
+
+//==========================================================================
+//
+// StreamResampler :: Read
+//
+// The source only reports its end after the block it ended in, and the
+// filter still has output for that block's last frames, so reading goes
+// on until the first tap has passed them.
+//
+//==========================================================================
+
+bool StreamResampler::Read(void *buff, int len, SourceFunc source, void *ctx)
+{
+	auto out = (float*)buff;
+	int framesize = Channels * (int)sizeof(float);
+	int frames = len / framesize;
+
+	memset((uint8_t*)buff + frames * framesize, 0, len - frames * framesize);
+
+	for (int i = 0; i < frames; )
+	{
+		if ((int)(Pos >> 32) + Taps > Avail)
+		{
+			Refill(source, ctx);
+			continue;
+		}
+		for (; i < frames && (int)(Pos >> 32) + Taps <= Avail; i++)
+		{
+			int index = (int)(Pos >> 32);
+			uint64_t phasepos = (Pos & 0xffffffffu) * Phases;
+			int phase = (int)(phasepos >> 32);
+			float frac = (uint32_t)phasepos * (1.f / 4294967296.f);
+			const float *c0 = &Filter[phase * Taps];
+			const float *c1 = c0 + Taps;
+			for (int c = 0; c < Channels; c++)
+			{
+				const float *in = Input[c].data() + index;
+				float s0 = Dot(in, c0, Taps);
+				float s1 = Dot(in, c1, Taps);
+				out[i * Channels + c] = s0 + (s1 - s0) * frac;
+			}
+			Pos += Step;
+		}
+	}
+	return !Ended || (int)(Pos >> 32) < EndFrame;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "zmsx.hpp"
+
+// Polyphase windowed sinc resampler for a song's output.
+//
+// The filter is a Kaiser windowed sinc tabulated at a fixed number of
+// phases, with linear interpolation between neighboring phases for the
+// exact position. Any rate ratio works. When downsampling, the cutoff
+// moves down to the output's Nyquist frequency.
+//
+// Output is always float32 with the input's channel count. Input gets
+// pulled from a source function in blocks, in the song's native format.
+
+class StreamResampler
+{
+public:
+	typedef bool (*SourceFunc)(void *ctx, void *buff, int len);
+
+	enum EQuality
+	{
+		QUALITY_Off,
+		QUALITY_Fast,
+		QUALITY_Balanced,
+		QUALITY_Best,
+	};
+
+	// The output the song should have. Songs remember the settings from
+	// the time they were opened.
+	void SetTarget(int samplerate, int quality);
+
+	// Sets up conversion from the song's native format, which is only
+	// known once it has started. Does nothing if the rates already match.
+	// May allocate, so this must not be called on the audio thread.
+	void Start(const ZMSXSoundStreamInfoEx &native);
+	void Stop() { Active = false; }
+
+	bool IsActive() const { return Active; }
+	ZMSXSoundStreamInfoEx GetFormat() const { return Out; }
+	size_t GetBufferBytes() const;
+
+	// Fills len bytes of output. Returns false once the source has ended and
+	// the output of its last input frames has been read. A partial frame at
+	// the end gets filled with silence.
+	bool Read(void *buff, int len, SourceFunc source, void *ctx);
+
+private:
+	enum { BLOCK_FRAMES = 1024 };
+
+	void Refill(SourceFunc source, void *ctx);
+
+	ZMSXSoundStreamInfoEx In = {};
+	ZMSXSoundStreamInfoEx Out = {};
+	int TargetRate = 0;
+	int Quality = QUALITY_Off;
+	bool Active = false;
+	bool Ended = false;
+
+	int Channels = 0;
+	int Taps = 0;
+	int Phases = 0;
+	std::vector<float> Filter;		// (Phases + 1) rows of Taps coefficients
+
+	// Input in planar float. Pos is the 32.32 fixed point position of the
+	// first tap for the next output frame.
+	std::vector<float> Input[2];
+	int Avail = 0;
+	int EndFrame = -1;		// Where the source's input ends once it has.
+	uint64_t Pos = 0;
+	uint64_t Step = 0;
+
+	std::vector<uint8_t> Raw;
+	std::vector<float> Scratch;
+};
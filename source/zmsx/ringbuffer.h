@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+
+// Single producer / single consumer byte ring.
+// One thread may only write, another may only read. Neither side ever blocks,
+// so the read side is safe to use from inside an audio callback.
+//
+// The positions are free running counters, the buffer index is obtained by
+// taking them modulo the capacity, so the full capacity is usable.
+
+class SPSCRingBuffer
+{
+public:
+	SPSCRingBuffer() = default;
+	SPSCRingBuffer(const SPSCRingBuffer&) = delete;
+	SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+	explicit SPSCRingBuffer(size_t capacity)
+	{
+		Resize(capacity);
+	}
+
+	// Not thread safe. Only call while neither side is active.
+	void Resize(size_t capacity)
+	{
+		Data.reset(capacity > 0 ? new uint8_t[capacity] : nullptr);
+		Capacity = capacity;
+		Clear();
+	}
+
+	// Not thread safe. Only call while neither side is active.
+	void Clear()
+	{
+		WritePos.store(0, std::memory_order_relaxed);
+		ReadPos.store(0, std::memory_order_relaxed);
+	}
+
+	size_t GetCapacity() const
+	{
+		return Capacity;
+	}
+
+	// Amount of data the consumer can currently read.
+	size_t ReadAvailable() const
+	{
+		return WritePos.load(std::memory_order_acquire) - ReadPos.load(std::memory_order_relaxed);
+	}
+
+	// Amount of space the producer can currently fill.
+	size_t WriteAvailable() const
+	{
+		return Capacity - (WritePos.load(std::memory_order_relaxed) - ReadPos.load(std::memory_order_acquire));
+	}
+
+	// Producer side. Returns the amount actually written.
+	size_t Write(const void *src, size_t len)
+	{
+		size_t wpos = WritePos.load(std::memory_order_relaxed);
+		size_t space = Capacity - (wpos - ReadPos.load(std::memory_order_acquire));
+		if (len > space) len = space;
+		if (len == 0) return 0;
+
+		size_t index = wpos % Capacity;
+		size_t first = std::min(len, Capacity - index);
+		memcpy(Data.get() + index, src, first);
+		if (first < len) memcpy(Data.get(), (const uint8_t*)src + first, len - first);
+
+		WritePos.store(wpos + len, std::memory_order_release);
+		return len;
+	}
+
+	// Consumer side. Returns the amount actually read.
+	size_t Read(void *dest, size_t len)
+	{
+		size_t rpos = ReadPos.load(std::memory_order_relaxed);
+		size_t avail = WritePos.load(std::memory_order_acquire) - rpos;
+		if (len > avail) len = avail;
+		if (len == 0) return 0;
+
+		size_t index = rpos % Capacity;
+		size_t first = std::min(len, Capacity - index);
+		memcpy(dest, Data.get() + index, first);
+		if (first < len) memcpy((uint8_t*)dest + first, Data.get(), len - first);
+
+		ReadPos.store(rpos + len, std::memory_order_release);
+		return len;
+	}
+
+private:
+	std::unique_ptr<uint8_t[]> Data;
+	size_t Capacity = 0;
+
+	// Kept on separate cache lines so that producer and consumer do not fight over them.
+	alignas(64) std::atomic<size_t> WritePos{ 0 };
+	alignas(64) std::atomic<size_t> ReadPos{ 0 };
+};
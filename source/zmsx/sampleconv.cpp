@@ -0,0 +1,360 @@
+/*
+** sampleconv.cpp
+** Sample format conversion for client output
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "sampleconv.h"
+#include "musinfo.h"
+#include "trace.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CONV_AVX2
+#define CONV_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONV_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CONV_NEON
+#endif
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// NextNoise
+//
+// One TPDF dither value in LSBs, the difference of two uniform values
+// taken from both halves of a xorshift32 result.
+//
+//==========================================================================
+
+static inline float NextNoise(uint32_t &s)
+{
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return ((int)(s & 0xffff) - (int)(s >> 16)) * (1.f / 65536.f);
+}
+
+//==========================================================================
+//
+// ConvertToFloat
+//
+//==========================================================================
+
+void ConvertToFloat(float *dest, const void *src, ZMSXSampleType type, int samples)
+{
+	int i = 0;
+	switch (type)
+	{
+	case zmsx_sample_uint8:
+	{
+		auto in = (const uint8_t*)src;
+		for (; i < samples; i++) dest[i] = (in[i] - 128) * (1.f / 128.f);
+		break;
+	}
+
+	case zmsx_sample_int16:
+	{
+		auto in = (const int16_t*)src;
+#if defined(CONV_AVX2)
+		const __m256 scale = _mm256_set1_ps(1.f / 32768.f);
+		for (; i + 8 <= samples; i += 8)
+		{
+			__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+			_mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+		}
+#elif defined(CONV_SSE2)
+		const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+		for (; i + 8 <= samples; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+			// Sign extend by moving each value into the upper half and shifting back.
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+#elif defined(CONV_NEON)
+		for (; i + 8 <= samples; i += 8)
+		{
+			int16x8_t v = vld1q_s16(in + i);
+			vst1q_f32(dest + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.f / 32768.f));
+			vst1q_f32(dest + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.f / 32768.f));
+		}
+#endif
+		for (; i < samples; i++) dest[i] = in[i] * (1.f / 32768.f);
+		break;
+	}
+
+	case zmsx_sample_float32:
+		if (dest != src) memcpy(dest, src, samples * sizeof(float));
+		break;
+	}
+}
+
+//==========================================================================
+//
+// ConvertToInt16
+//
+// Each SIMD lane has a random generator of its own. The scalar code for
+// the remaining samples uses the first one.
+//
+//==========================================================================
+
+void ConvertToInt16(int16_t *dest, const float *src, int samples, DitherState *dither)
+{
+	int i = 0;
+#if defined(CONV_AVX2)
+	const __m256 scale = _mm256_set1_ps(32768.f);
+	const __m256 maxval = _mm256_set1_ps(32767.f);
+	const __m256 minval = _mm256_set1_ps(-32768.f);
+	const __m256 noisescale = _mm256_set1_ps(1.f / 65536.f);
+	const __m256i lowmask = _mm256_set1_epi32(0xffff);
+	__m256i seed = dither ? _mm256_loadu_si256((const __m256i*)dither->Seed) : _mm256_setzero_si256();
+
+	auto convert = [&](__m256 v)
+	{
+		v = _mm256_mul_ps(v, scale);
+		if (dither)
+		{
+			seed = _mm256_xor_si256(seed, _mm256_slli_epi32(seed, 13));
+			seed = _mm256_xor_si256(seed, _mm256_srli_epi32(seed, 17));
+			seed = _mm256_xor_si256(seed, _mm256_slli_epi32(seed, 5));
+			__m256i diff = _mm256_sub_epi32(_mm256_and_si256(seed, lowmask), _mm256_srli_epi32(seed, 16));
+			v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_cvtepi32_ps(diff), noisescale));
+		}
+		return _mm256_cvtps_epi32(_mm256_max_ps(_mm256_min_ps(v, maxval), minval));
+	};
+	for (; i + 16 <= samples; i += 16)
+	{
+		__m256i a = convert(_mm256_loadu_ps(src + i));
+		__m256i b = convert(_mm256_loadu_ps(src + i + 8));
+		// The pack works within 128 bit lanes, so the halves need to be put back in order.
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+		_mm256_storeu_si256((__m256i*)(dest + i), packed);
+	}
+	if (dither) _mm256_storeu_si256((__m256i*)dither->Seed, seed);
+#elif defined(CONV_SSE2)
+	const __m128 scale = _mm_set1_ps(32768.f);
+	const __m128 maxval = _mm_set1_ps(32767.f);
+	const __m128 minval = _mm_set1_ps(-32768.f);
+	const __m128 noisescale = _mm_set1_ps(1.f / 65536.f);
+	const __m128i lowmask = _mm_set1_epi32(0xffff);
+	__m128i seed = dither ? _mm_loadu_si128((const __m128i*)dither->Seed) : _mm_setzero_si128();
+
+	auto convert = [&](__m128 v)
+	{
+		v = _mm_mul_ps(v, scale);
+		if (dither)
+		{
+			seed = _mm_xor_si128(seed, _mm_slli_epi32(seed, 13));
+			seed = _mm_xor_si128(seed, _mm_srli_epi32(seed, 17));
+			seed = _mm_xor_si128(seed, _mm_slli_epi32(seed, 5));
+			__m128i diff = _mm_sub_epi32(_mm_and_si128(seed, lowmask), _mm_srli_epi32(seed, 16));
+			v = _mm_add_ps(v, _mm_mul_ps(_mm_cvtepi32_ps(diff), noisescale));
+		}
+		return _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(v, maxval), minval));
+	};
+	for (; i + 8 <= samples; i += 8)
+	{
+		__m128i a = convert(_mm_loadu_ps(src + i));
+		__m128i b = convert(_mm_loadu_ps(src + i + 4));
+		_mm_storeu_si128((__m128i*)(dest + i), _mm_packs_epi32(a, b));
+	}
+	if (dither) _mm_storeu_si128((__m128i*)dither->Seed, seed);
+#elif defined(CONV_NEON)
+	uint32x4_t seed = dither ? vld1q_u32(dither->Seed) : vdupq_n_u32(0);
+
+	auto convert = [&](float32x4_t v)
+	{
+		v = vmulq_n_f32(v, 32768.f);
+		if (dither)
+		{
+			seed = veorq_u32(seed, vshlq_n_u32(seed, 13));
+			seed = veorq_u32(seed, vshrq_n_u32(seed, 17));
+			seed = veorq_u32(seed, vshlq_n_u32(seed, 5));
+			int32x4_t diff = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(seed, vdupq_n_u32(0xffff))), vreinterpretq_s32_u32(vshrq_n_u32(seed, 16)));
+			v = vmlaq_n_f32(v, vcvtq_f32_s32(diff), 1.f / 65536.f);
+		}
+		return vqmovn_s32(vcvtnq_s32_f32(v));
+	};
+	for (; i + 8 <= samples; i += 8)
+	{
+		int16x4_t a = convert(vld1q_f32(src + i));
+		int16x4_t b = convert(vld1q_f32(src + i + 4));
+		vst1q_s16(dest + i, vcombine_s16(a, b));
+	}
+	if (dither) vst1q_u32(dither->Seed, seed);
+#endif
+	for (; i < samples; i++)
+	{
+		float v = src[i] * 32768.f;
+		if (dither) v += NextNoise(dither->Seed[0]);
+		dest[i] = (int16_t)lrintf(std::min(std::max(v, -32768.f), 32767.f));
+	}
+}
+
+//==========================================================================
+//
+// Deinterleave
+//
+// Splits stereo frames into the left and right planes of the output,
+// 'stride' samples apart.
+//
+//==========================================================================
+
+template<class T>
+static void Deinterleave(T *dest, const T *src, int frames, int stride)
+{
+	T *left = dest;
+	T *right = dest + stride;
+	for (int i = 0; i < frames; i++)
+	{
+		left[i] = src[i * 2];
+		right[i] = src[i * 2 + 1];
+	}
+}
+
+//==========================================================================
+//
+// SampleConverter :: ConvertBlock
+//
+// Converts one block from Raw to the output. Temp holds the intermediate
+// float samples, Raw gets reused for interleaved int16 before it gets
+// split into planes.
+//
+//==========================================================================
+
+void SampleConverter::ConvertBlock(const ZMSXSoundStreamInfoEx &native, const ZMSXOutputFormat &format, uint8_t *dest, int frames, int stride)
+{
+	int inchannels = ZMusic_ChannelCount(native.channel_config);
+	int outchannels = ZMusic_ChannelCount(format.channel_config);
+	bool planar = format.layout == zmsx_layout_planar && outchannels == 2;
+
+	// Only the layout differs, this needs no conversion to float.
+	if (native.sample_type == format.sample_type && inchannels == outchannels)
+	{
+		if (format.sample_type == zmsx_sample_int16) Deinterleave((int16_t*)dest, (const int16_t*)Raw, frames, stride);
+		else Deinterleave((float*)dest, (const float*)Raw, frames, stride);
+		return;
+	}
+
+	ConvertToFloat(Temp, Raw, native.sample_type, frames * inchannels);
+	if (inchannels == 1 && outchannels == 2)
+	{
+		for (int i = frames - 1; i >= 0; i--)
+		{
+			Temp[i * 2] = Temp[i * 2 + 1] = Temp[i];
+		}
+	}
+	else if (inchannels == 2 && outchannels == 1)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			Temp[i] = (Temp[i * 2] + Temp[i * 2 + 1]) * 0.5f;
+		}
+	}
+
+	int samples = frames * outchannels;
+	if (format.sample_type == zmsx_sample_float32)
+	{
+		if (planar) Deinterleave((float*)dest, Temp, frames, stride);
+		else memcpy(dest, Temp, samples * sizeof(float));
+	}
+	else
+	{
+		// Dither only if there is more precision than int16 to lose.
+		bool dither = format.dither && (native.sample_type == zmsx_sample_float32 || outchannels < inchannels);
+		auto out = planar ? (int16_t*)Raw : (int16_t*)dest;
+		ConvertToInt16(out, Temp, samples, dither ? &Dither : nullptr);
+		if (planar) Deinterleave((int16_t*)dest, (const int16_t*)Raw, frames, stride);
+	}
+}
+
+//==========================================================================
+//
+// SampleConverter :: Fill
+//
+// Returns false once the song has ended, like zmsx_fill_stream. What is
+// left of the buffer gets filled with silence then.
+//
+//==========================================================================
+
+bool SampleConverter::Fill(MusInfo *song, const ZMSXSoundStreamInfoEx &native, const ZMSXOutputFormat &format, void *buff, int frames)
+{
+	ZMSX_TRACE_ZONE("SampleConverter::Fill");
+	int inchannels = ZMusic_ChannelCount(native.channel_config);
+	int outchannels = ZMusic_ChannelCount(format.channel_config);
+	int framesize = inchannels * ZMusic_SampleTypeSize(native.sample_type);
+	int samplesize = ZMusic_SampleTypeSize(format.sample_type);
+	auto out = (uint8_t*)buff;
+
+	if (frames <= 0) return true;
+	if (framesize == 0)
+	{
+		// Not started or not a streaming song.
+		memset(buff, 0, (size_t)frames * outchannels * samplesize);
+		return false;
+	}
+
+	// The song's own format, nothing to convert.
+	if (native.sample_type == format.sample_type && inchannels == outchannels && (outchannels == 1 || format.layout == zmsx_layout_interleaved))
+	{
+		return song->m_RenderAhead.Read(song, buff, frames * framesize);
+	}
+
+	bool playing = true;
+	for (int done = 0; done < frames; )
+	{
+		int count = std::min<int>(frames - done, BLOCK_FRAMES);
+		if (!playing)
+		{
+			memset(Raw, native.sample_type == zmsx_sample_uint8 ? 0x80 : 0, count * framesize);
+		}
+		else if (!song->m_RenderAhead.Read(song, Raw, count * framesize))
+		{
+			playing = false;
+		}
+		// Planes are 'frames' samples apart, interleaved output advances by whole frames.
+		uint8_t *dest = out + (size_t)done * samplesize * (format.layout == zmsx_layout_planar ? 1 : outchannels);
+		ConvertBlock(native, format, dest, count, frames);
+		done += count;
+	}
+	return playing;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "zmsx.hpp"
+
+class MusInfo;
+
+// Sample format conversion. The loops are vectorized with SSE2, AVX2 or NEON,
+// depending on what the compiler targets.
+
+// Converts samples of any type to float in [-1, 1).
+void ConvertToFloat(float *dest, const void *src, ZMSXSampleType type, int samples);
+
+// Converts float samples to int16 with clipping. With a dither state, TPDF
+// dither of one LSB gets added before rounding.
+struct DitherState
+{
+	uint32_t Seed[8] = { 0x12345678, 0x9abcdef1, 0x2468ace1, 0x13579bdf, 0xfedcba98, 0x76543211, 0x0f1e2d3c, 0x4b5a6978 };
+};
+void ConvertToInt16(int16_t *dest, const float *src, int samples, DitherState *dither);
+
+// Delivers a song's output in the format the client asks for with
+// zmsx_fill_stream_ex. It works through the request in blocks of a fixed
+// size, so it never allocates on the audio thread.
+
+class SampleConverter
+{
+public:
+	bool Fill(MusInfo *song, const ZMSXSoundStreamInfoEx &native, const ZMSXOutputFormat &format, void *buff, int frames);
+
+private:
+	enum { BLOCK_FRAMES = 1024 };
+
+	void ConvertBlock(const ZMSXSoundStreamInfoEx &native, const ZMSXOutputFormat &format, uint8_t *dest, int frames, int stride);
+
+	DitherState Dither;
+	alignas(32) float Temp[BLOCK_FRAMES * 2];
+	alignas(32) uint8_t Raw[BLOCK_FRAMES * 2 * sizeof(float)];
+};
@@ -0,0 +1,327 @@
+/*
+** songqueue.cpp
+** Gapless transitions to a queued song.
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "songqueue.h"
+#include "musinfo.h"
+#include "sampleconv.h"
+#include "trace.h"
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// QueuedSong :: QueuedSong
+//
+//==========================================================================
+
+QueuedSong::QueuedSong(MusInfo *current, const ZMSXSoundStreamInfoEx &format, MusInfo *next, int subsong, bool loop, int at_ms, int crossfade_ms)
+	: Current(current), Next(next), Format(format)
+{
+	FrameSize = ZMusic_ChannelCount(format.channel_config) * ZMusic_SampleTypeSize(format.sample_type);
+	FramesLeft = at_ms < 0 ? -1 : (int64_t)at_ms * format.sample_rate / 1000;
+	FadeFrames = std::max(0, (int)((int64_t)crossfade_ms * format.sample_rate / 1000));
+	Thread = std::thread([=]() { Prepare(subsong, loop); });
+}
+
+//==========================================================================
+//
+// QueuedSong :: ~QueuedSong
+//
+// Unless it has taken over already, the next song gets stopped again.
+//
+//==========================================================================
+
+QueuedSong::~QueuedSong()
+{
+	if (Thread.joinable())
+	{
+		Thread.join();
+	}
+	if (State != zmsx_queue_done)
+	{
+		zmsx_stop(Next);
+	}
+}
+
+//==========================================================================
+//
+// QueuedSong :: Prepare
+//
+// Runs on the worker thread. Starts the next song like zmsx_start would
+// and renders its first buffer if it does not render ahead by itself.
+//
+//==========================================================================
+
+void QueuedSong::Prepare(int subsong, bool loop)
+{
+	if (!zmsx_start(Next, subsong, loop))
+	{
+		ZMusic_Printf(zmsx_msg_error, "Queued song could not be started: %s\n", zmsx_get_last_error());
+		State = zmsx_queue_failed;
+		return;
+	}
+	NextFormat = Next->m_NativeFormat;
+	if (NextFormat.buffer_size <= 0 || NextFormat.sample_rate != Format.sample_rate)
+	{
+		ZMusic_Printf(zmsx_msg_error, "Queued song does not stream at the current song's sample rate\n");
+		State = zmsx_queue_failed;
+		return;
+	}
+	NextFrameSize = ZMusic_ChannelCount(NextFormat.channel_config) * ZMusic_SampleTypeSize(NextFormat.sample_type);
+	if (Next->m_RenderAhead.Get() == nullptr)
+	{
+		Preroll.resize(NextFormat.buffer_size - NextFormat.buffer_size % NextFrameSize);
+		NextEnded = !Next->m_RenderAhead.Read(Next, Preroll.data(), (int)Preroll.size());
+	}
+	State = zmsx_queue_ready;
+}
+
+//==========================================================================
+//
+// QueuedSong :: ReadCurrent
+//
+//==========================================================================
+
+bool QueuedSong::ReadCurrent(uint8_t *buff, int frames)
+{
+	return Current->m_RenderAhead.ReadSong(Current, buff, frames * FrameSize);
+}
+
+//==========================================================================
+//
+// QueuedSong :: ReadNext
+//
+// Reads the next song's output in its own format, starting with what
+// Prepare rendered.
+//
+//==========================================================================
+
+bool QueuedSong::ReadNext(uint8_t *buff, int len)
+{
+	size_t got = 0;
+	if (PrerollPos < Preroll.size())
+	{
+		got = std::min<size_t>(len, Preroll.size() - PrerollPos);
+		memcpy(buff, &Preroll[PrerollPos], got);
+		PrerollPos += got;
+	}
+	if (got < (size_t)len)
+	{
+		if (NextEnded)
+		{
+			memset(buff + got, NextFormat.sample_type == zmsx_sample_uint8 ? 0x80 : 0, len - got);
+		}
+		else if (!Next->m_RenderAhead.Read(Next, buff + got, len - (int)got))
+		{
+			NextEnded = true;
+		}
+	}
+	return !NextEnded || PrerollPos < Preroll.size();
+}
+
+//==========================================================================
+//
+// QueuedSong :: ReadNextFloat
+//
+// Reads the next song's output as floats with the current song's number
+// of channels.
+//
+//==========================================================================
+
+bool QueuedSong::ReadNextFloat(float *dest, int frames)
+{
+	int inchannels = ZMusic_ChannelCount(NextFormat.channel_config);
+	int outchannels = ZMusic_ChannelCount(Format.channel_config);
+
+	bool res = ReadNext(Raw, frames * NextFrameSize);
+	ConvertToFloat(dest, Raw, NextFormat.sample_type, frames * inchannels);
+	if (inchannels == 1 && outchannels == 2)
+	{
+		for (int i = frames - 1; i >= 0; i--)
+		{
+			dest[i * 2] = dest[i * 2 + 1] = dest[i];
+		}
+	}
+	else if (inchannels == 2 && outchannels == 1)
+	{
+		for (int i = 0; i < frames; i++)
+		{
+			dest[i] = (dest[i * 2] + dest[i * 2 + 1]) * 0.5f;
+		}
+	}
+	return res;
+}
+
+//==========================================================================
+//
+// QueuedSong :: WriteFloat
+//
+// Converts float samples to the current song's sample type.
+//
+//==========================================================================
+
+void QueuedSong::WriteFloat(uint8_t *dest, const float *src, int samples)
+{
+	switch (Format.sample_type)
+	{
+	case zmsx_sample_float32:
+		memcpy(dest, src, samples * sizeof(float));
+		break;
+
+	case zmsx_sample_int16:
+		ConvertToInt16((int16_t*)dest, src, samples, nullptr);
+		break;
+
+	case zmsx_sample_uint8:
+		for (int i = 0; i < samples; i++)
+		{
+			dest[i] = (uint8_t)std::clamp((int)lrintf(src[i] * 128.f) + 128, 0, 255);
+		}
+		break;
+	}
+}
+
+//==========================================================================
+//
+// QueuedSong :: FillSilence
+//
+//==========================================================================
+
+void QueuedSong::FillSilence(uint8_t *buff, int frames)
+{
+	memset(buff, Format.sample_type == zmsx_sample_uint8 ? 0x80 : 0, (size_t)frames * FrameSize);
+}
+
+//==========================================================================
+//
+// QueuedSong :: Read
+//
+// Called from the audio thread instead of reading the current song. Works
+// in blocks, so that the transition can start anywhere in the buffer and
+// the mixing needs no allocations. Returns false once neither song has
+// anything left to play.
+//
+//==========================================================================
+
+bool QueuedSong::Read(void *buff, int len)
+{
+	ZMSX_TRACE_ZONE("QueuedSong::Read");
+	auto out = (uint8_t*)buff;
+	int frames = len / FrameSize;
+	int channels = ZMusic_ChannelCount(Format.channel_config);
+	bool res = true;
+
+	while (frames > 0)
+	{
+		int count = std::min<int>(frames, BLOCK_FRAMES);
+		ZMSXQueueState state = State;
+
+		if (state == zmsx_queue_ready && (CurrentEnded || FramesLeft == 0))
+		{
+			// A song that has ended cannot be faded out anymore.
+			if (CurrentEnded) FadePos = FadeFrames;
+			State = zmsx_queue_transition;
+			continue;
+		}
+		else if (state != zmsx_queue_transition && state != zmsx_queue_done)
+		{
+			// The current song plays until it is time to go over. If the next
+			// one is not ready by then, it keeps playing until it is.
+			if (FramesLeft > 0) count = (int)std::min<int64_t>(count, FramesLeft);
+			if (CurrentEnded)
+			{
+				FillSilence(out, count);
+				if (state == zmsx_queue_failed) res = false;
+			}
+			else
+			{
+				if (!ReadCurrent(out, count)) CurrentEnded = true;
+				if (FramesLeft > 0) FramesLeft -= count;
+			}
+		}
+		else if (FadePos < FadeFrames)
+		{
+			count = std::min(count, FadeFrames - FadePos);
+			float *cur = Temp[0];
+			float *next = Temp[1];
+			if (CurrentEnded)
+			{
+				memset(cur, 0, count * channels * sizeof(float));
+			}
+			else
+			{
+				if (!ReadCurrent(Raw, count)) CurrentEnded = true;
+				ConvertToFloat(cur, Raw, Format.sample_type, count * channels);
+			}
+			ReadNextFloat(next, count);
+			for (int i = 0; i < count; i++)
+			{
+				float gain = float(FadePos + i) / FadeFrames;
+				for (int c = 0; c < channels; c++)
+				{
+					int s = i * channels + c;
+					cur[s] += (next[s] - cur[s]) * gain;
+				}
+			}
+			WriteFloat(out, cur, count * channels);
+			FadePos += count;
+		}
+		else if (NextFormat.sample_type == Format.sample_type && NextFormat.channel_config == Format.channel_config)
+		{
+			// Once the preroll is used up, the rest can go in one piece.
+			if (state == zmsx_queue_done) count = frames;
+			if (!ReadNext(out, count * FrameSize)) res = false;
+		}
+		else
+		{
+			if (!ReadNextFloat(Temp[0], count)) res = false;
+			WriteFloat(out, Temp[0], count * channels);
+		}
+
+		if (state == zmsx_queue_transition && FadePos >= FadeFrames && PrerollPos >= Preroll.size())
+		{
+			State = zmsx_queue_done;
+		}
+		out += (size_t)count * FrameSize;
+		frames -= count;
+	}
+	return res;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "zmsx.hpp"
+
+class MusInfo;
+
+// A song queued with zmsx_queue_next to follow the one that is playing. It
+// gets started on a worker thread right away, so that the device setup,
+// precaching and the first block of output are done long before the audio
+// thread needs them. While it is queued the audio thread reads through it
+// instead of the current song, and it fades from one to the other.
+//
+// The output keeps the current song's format throughout. The next song's
+// output gets converted to it if necessary, but it needs the same rate.
+//
+// Only Read may be called from the audio thread. The current song's
+// RenderAheadSlot keeps this from being destroyed while it is in use.
+
+class QueuedSong
+{
+public:
+	QueuedSong(MusInfo *current, const ZMSXSoundStreamInfoEx &format, MusInfo *next, int subsong, bool loop, int at_ms, int crossfade_ms);
+	~QueuedSong();
+
+	ZMSXQueueState GetState() const { return State; }
+	MusInfo *GetNext() const { return Next; }
+	bool Read(void *buff, int len);
+
+private:
+	enum { BLOCK_FRAMES = 256 };
+
+	void Prepare(int subsong, bool loop);
+	bool ReadCurrent(uint8_t *buff, int frames);
+	bool ReadNext(uint8_t *buff, int len);
+	bool ReadNextFloat(float *dest, int frames);
+	void WriteFloat(uint8_t *dest, const float *src, int samples);
+	void FillSilence(uint8_t *buff, int frames);
+
+	MusInfo *Current;
+	MusInfo *Next;
+	ZMSXSoundStreamInfoEx Format;		// Current's, which Read delivers throughout.
+	ZMSXSoundStreamInfoEx NextFormat = {};	// Set by Prepare.
+	int FrameSize;
+	int NextFrameSize = 0;
+	int64_t FramesLeft;		// Until the transition, -1 to wait for the current song to end.
+	int FadeFrames;
+	int FadePos = 0;
+	bool CurrentEnded = false;
+	bool NextEnded = false;
+
+	// The next song's first output if it does not render ahead itself.
+	std::vector<uint8_t> Preroll;
+	size_t PrerollPos = 0;
+
+	std::thread Thread;
+	std::atomic<ZMSXQueueState> State{ zmsx_queue_preparing };
+
+	alignas(32) float Temp[2][BLOCK_FRAMES * 2];
+	alignas(32) uint8_t Raw[BLOCK_FRAMES * 2 * sizeof(float)];
+};
@@ -0,0 +1,235 @@
+/*
+** threadpool.cpp
+** Worker threads for rendering several things at once
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#include <algorithm>
+#include <deque>
+#include "threadpool.h"
+
+// TYPES -------------------------------------------------------------------
+
+struct StealQueue
+{
+	std::mutex Mutex;
+	std::deque<int> Items;
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// ThreadPool :: DefaultThreadCount
+//
+// One worker per core, leaving one for the thread that submits the work.
+//
+//==========================================================================
+
+int ThreadPool::DefaultThreadCount()
+{
+	int cores = (int)std::thread::hardware_concurrency();
+	return std::max(cores - 1, 0);
+}
+
+//==========================================================================
+//
+// ThreadPool :: ThreadPool
+//
+//==========================================================================
+
+ThreadPool::ThreadPool(int numthreads)
+{
+	if (numthreads < 0) numthreads = DefaultThreadCount();
+	for (int i = 0; i < numthreads; i++)
+	{
+		Workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+//==========================================================================
+//
+// ThreadPool :: ~ThreadPool
+//
+//==========================================================================
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	WakeCV.notify_all();
+	for (auto &thread : Workers)
+	{
+		thread.join();
+	}
+}
+
+//==========================================================================
+//
+// ThreadPool :: RunBatch
+//
+// Takes indices off the batch until none are left.
+//
+//==========================================================================
+
+void ThreadPool::RunBatch(Batch *batch)
+{
+	int index;
+	while ((index = batch->Next.fetch_add(1)) < batch->Count)
+	{
+		(*batch->Func)(index);
+		if (batch->Remaining.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			DoneCV.notify_all();
+		}
+	}
+}
+
+//==========================================================================
+//
+// ThreadPool :: WorkerLoop
+//
+//==========================================================================
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t seen = 0;
+	for (;;)
+	{
+		std::shared_ptr<Batch> batch;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			WakeCV.wait(lock, [&]() { return Quit || Generation != seen; });
+			if (Quit) return;
+			seen = Generation;
+			batch = Current;
+		}
+		// Holding a reference keeps a batch valid for workers that wake up
+		// late, they will just find that there is nothing left to do.
+		if (batch) RunBatch(batch.get());
+	}
+}
+
+//==========================================================================
+//
+// ThreadPool :: ParallelFor
+//
+//==========================================================================
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)> &func)
+{
+	if (count <= 0) return;
+	if (Workers.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++) func(i);
+		return;
+	}
+
+	auto batch = std::make_shared<Batch>();
+	batch->Func = &func;
+	batch->Count = count;
+	batch->Remaining = count;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Current = batch;
+		Generation++;
+	}
+	WakeCV.notify_all();
+
+	RunBatch(batch.get());
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	DoneCV.wait(lock, [&]() { return batch->Remaining.load() == 0; });
+	Current.reset();
+}
+
+//==========================================================================
+//
+// RunWorkStealing
+//
+//==========================================================================
+
+void RunWorkStealing(int count, int numthreads, const std::function<void(int)> &func)
+{
+	if (count <= 0) return;
+	if (numthreads <= 0) numthreads = ThreadPool::DefaultThreadCount() + 1;
+	numthreads = std::min(numthreads, count);
+
+	std::vector<StealQueue> queues(numthreads);
+	for (int i = 0; i < count; i++)
+	{
+		queues[i % numthreads].Items.push_back(i);
+	}
+
+	auto worker = [&](int self)
+	{
+		for (;;)
+		{
+			int item = -1;
+			{
+				auto &own = queues[self];
+				std::lock_guard<std::mutex> lock(own.Mutex);
+				if (!own.Items.empty())
+				{
+					item = own.Items.front();
+					own.Items.pop_front();
+				}
+			}
+			for (int i = 1; item < 0 && i < numthreads; i++)
+			{
+				auto &victim = queues[(self + i) % numthreads];
+				std::lock_guard<std::mutex> lock(victim.Mutex);
+				if (!victim.Items.empty())
+				{
+					item = victim.Items.back();
+					victim.Items.pop_back();
+				}
+			}
+			// Nothing gets added once started, so if all queues are empty we are done.
+			if (item < 0) return;
+			func(item);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numthreads; i++)
+	{
+		threads.emplace_back(worker, i);
+	}
+	worker(0);
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed size pool of worker threads for splitting up rendering work.
+//
+// ParallelFor runs a function for every index in [0, count) and returns once
+// all of them are done. The calling thread takes part in the work, so a pool
+// with zero workers simply runs everything in place.
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int numthreads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int GetNumThreads() const { return (int)Workers.size(); }
+	void ParallelFor(int count, const std::function<void(int)> &func);
+
+	static int DefaultThreadCount();
+
+private:
+	struct Batch
+	{
+		const std::function<void(int)> *Func;
+		int Count;
+		std::atomic<int> Next{ 0 };
+		std::atomic<int> Remaining{ 0 };
+	};
+
+	void WorkerLoop();
+	void RunBatch(Batch *batch);
+
+	std::vector<std::thread> Workers;
+	std::mutex Mutex;
+	std::condition_variable WakeCV;
+	std::condition_variable DoneCV;
+	std::shared_ptr<Batch> Current;
+	uint64_t Generation = 0;
+	bool Quit = false;
+};
+
+// Runs func for every index in [0, count) on a set of threads of its own.
+// Each thread starts out with an equal share of the indices, taking them in
+// order, and steals from the back of the others' queues once it runs out.
+// This keeps all threads busy when the work items vary a lot in length.
+
+void RunWorkStealing(int count, int numthreads, const std::function<void(int)> &func);
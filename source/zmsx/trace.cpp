@@ -0,0 +1,227 @@
+/*
+** trace.cpp
+** Ring buffered trace recorder with Chrome trace JSON export
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "zmsx.hpp"
+#include "trace.h"
+
+#ifdef ZMSX_TRACE
+
+// MACROS ------------------------------------------------------------------
+
+// Must be a power of 2.
+#define TRACE_RING_SIZE		32768
+
+// TYPES -------------------------------------------------------------------
+
+// Each slot works like a seqlock. The writer clears Seq, fills in the zone
+// and then publishes it with the zone's number. A reader only takes the slot
+// if it saw the same nonzero Seq before and after copying it.
+struct TraceSlot
+{
+	std::atomic<uint64_t> Seq{ 0 };
+	std::atomic<const char*> Name{ nullptr };
+	std::atomic<uint64_t> Start{ 0 };
+	std::atomic<uint64_t> End{ 0 };
+	std::atomic<uint32_t> Thread{ 0 };
+};
+
+struct TraceEvent
+{
+	uint64_t Seq;
+	const char *Name;
+	uint64_t Start;
+	uint64_t End;
+	uint32_t Thread;
+};
+
+// PUBLIC DATA DEFINITIONS -------------------------------------------------
+
+std::atomic<bool> Trace::Enabled{ true };
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+static TraceSlot Ring[TRACE_RING_SIZE];
+static std::atomic<uint64_t> Head{ 0 };
+static std::atomic<uint64_t> Floor{ 0 };	// zmsx_trace_clear drops everything up to here.
+static std::atomic<uint32_t> NextThread{ 0 };
+static thread_local uint32_t ThreadNum;
+static std::string TraceJson;
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// Trace :: Now
+//
+//==========================================================================
+
+uint64_t Trace::Now()
+{
+	static const auto epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+//==========================================================================
+//
+// Trace :: Record
+//
+//==========================================================================
+
+void Trace::Record(const char *name, uint64_t start, uint64_t end)
+{
+	if (ThreadNum == 0)
+	{
+		ThreadNum = NextThread.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+	uint64_t seq = Head.fetch_add(1, std::memory_order_relaxed) + 1;
+	TraceSlot &slot = Ring[seq & (TRACE_RING_SIZE - 1)];
+
+	slot.Seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.Name.store(name, std::memory_order_relaxed);
+	slot.Start.store(start, std::memory_order_relaxed);
+	slot.End.store(end, std::memory_order_relaxed);
+	slot.Thread.store(ThreadNum, std::memory_order_relaxed);
+	slot.Seq.store(seq, std::memory_order_release);
+}
+
+//==========================================================================
+//
+// Snapshot
+//
+// Copies all completely written zones out of the ring, oldest first.
+//
+//==========================================================================
+
+static std::vector<TraceEvent> Snapshot()
+{
+	std::vector<TraceEvent> events;
+	uint64_t floor = Floor.load(std::memory_order_relaxed);
+	events.reserve(TRACE_RING_SIZE);
+
+	for (auto &slot : Ring)
+	{
+		TraceEvent ev;
+		ev.Seq = slot.Seq.load(std::memory_order_acquire);
+		if (ev.Seq <= floor) continue;
+		ev.Name = slot.Name.load(std::memory_order_relaxed);
+		ev.Start = slot.Start.load(std::memory_order_relaxed);
+		ev.End = slot.End.load(std::memory_order_relaxed);
+		ev.Thread = slot.Thread.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.Seq.load(std::memory_order_relaxed) == ev.Seq)
+		{
+			events.push_back(ev);
+		}
+	}
+	std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.Start < b.Start; });
+	return events;
+}
+
+//==========================================================================
+//
+// Zone names are literals from our own source, but escape them anyway so
+// the output is always valid JSON.
+//
+//==========================================================================
+
+static void AppendName(std::string &out, const char *name)
+{
+	for (; *name; name++)
+	{
+		if (*name == '"' || *name == '\\') out += '\\';
+		if ((unsigned char)*name >= 0x20) out += *name;
+	}
+}
+
+//==========================================================================
+//
+// C API
+//
+//==========================================================================
+
+DLL_EXPORT void zmsx_trace_enable(bool on)
+{
+	Trace::Enabled = on;
+}
+
+DLL_EXPORT void zmsx_trace_clear()
+{
+	Floor = Head.load();
+}
+
+DLL_EXPORT const char *zmsx_trace_dump()
+{
+	auto events = Snapshot();
+	char buffer[128];
+
+	TraceJson = "{\"traceEvents\":[";
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		auto &ev = events[i];
+		TraceJson += i == 0 ? "{\"name\":\"" : ",\n{\"name\":\"";
+		AppendName(TraceJson, ev.Name);
+		snprintf(buffer, sizeof(buffer), "\",\"cat\":\"zmsx\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			ev.Start / 1000., (ev.End - ev.Start) / 1000., ev.Thread);
+		TraceJson += buffer;
+	}
+	TraceJson += "],\"displayTimeUnit\":\"ms\"}";
+	return TraceJson.c_str();
+}
+
+#else
+
+DLL_EXPORT void zmsx_trace_enable(bool on)
+{
+}
+
+DLL_EXPORT void zmsx_trace_clear()
+{
+}
+
+DLL_EXPORT const char *zmsx_trace_dump()
+{
+	return "{\"traceEvents\":[]}";
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+// Trace zones for finding out where the rendering time goes. They only exist
+// in builds with ZMSX_TRACE, otherwise ZMSX_TRACE_ZONE expands to nothing.
+//
+// A zone covers the rest of the scope it is declared in. Finished zones go
+// into a fixed size ring that all threads share, so the most recent ones are
+// kept and older ones get overwritten. zmsx_trace_dump exports the ring as
+// Chrome trace JSON, which chrome://tracing and Perfetto both load.
+//
+// Zone names must be string literals, only the pointer gets recorded.
+
+#ifdef ZMSX_TRACE
+
+#include <atomic>
+#include <stdint.h>
+
+namespace Trace
+{
+	extern std::atomic<bool> Enabled;
+
+	// Nanoseconds since the first call, never 0.
+	uint64_t Now();
+	void Record(const char *name, uint64_t start, uint64_t end);
+}
+
+class TraceZone
+{
+public:
+	explicit TraceZone(const char *name)
+		: Name(name), Start(Trace::Enabled.load(std::memory_order_relaxed) ? Trace::Now() : 0)
+	{
+	}
+	~TraceZone()
+	{
+		if (Start != 0) Trace::Record(Name, Start, Trace::Now());
+	}
+	TraceZone(const TraceZone &) = delete;
+	TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+	const char *Name;
+	uint64_t Start;
+};
+
+#define ZMSX_TRACE_CONCAT2(a, b) a##b
+#define ZMSX_TRACE_CONCAT(a, b) ZMSX_TRACE_CONCAT2(a, b)
+#define ZMSX_TRACE_ZONE(name) TraceZone ZMSX_TRACE_CONCAT(traceZone_, __LINE__)(name)
+
+#else
+
+#define ZMSX_TRACE_ZONE(name) ((void)0)
+
+#endif
@@ -0,0 +1,196 @@
+/*
+** wavefile.cpp
+** Writes rendered audio to wave files
+**
+**---------------------------------------------------------------------------
+** Copyright 2008 Randy Heit
+** Copyright 2018 Christoph Oelckers
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <errno.h>
+#include <string.h>
+#include "wavefile.h"
+#include "m_swap.h"
+
+// TYPES -------------------------------------------------------------------
+
+struct FmtChunk
+{
+	//uint32_t ChunkID;
+	uint32_t ChunkLen;
+	uint16_t  FormatTag;
+	uint16_t  Channels;
+	uint32_t SamplesPerSec;
+	uint32_t AvgBytesPerSec;
+	uint16_t  BlockAlign;
+	uint16_t  BitsPerSample;
+	uint16_t  ExtensionSize;
+	uint16_t  ValidBitsPerSample;
+	uint32_t ChannelMask;
+	uint32_t SubFormatA;
+	uint16_t  SubFormatB;
+	uint16_t  SubFormatC;
+	uint8_t  SubFormatD[8];
+};
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// WaveFileWriter :: ~WaveFileWriter
+//
+// A file that never got closed properly is left with an incomplete header.
+//
+//==========================================================================
+
+WaveFileWriter::~WaveFileWriter()
+{
+	if (File != nullptr)
+	{
+		fclose(File);
+	}
+}
+
+//==========================================================================
+//
+// WaveFileWriter :: Open
+//
+// Creates the file and writes the header. Returns false with errno set
+// if that fails.
+//
+//==========================================================================
+
+bool WaveFileWriter::Open(const char *filename, int samplerate, ZMSXChannelConfig chans, ZMSXSampleType type)
+{
+	File = MusicIO::utf8_fopen(filename, "wb");
+	if (File == nullptr) return false;
+
+	FmtChunk fmt;
+	uint16_t channels = ZMusic_ChannelCount(chans);
+	uint16_t bits = ZMusic_SampleTypeSize(type) * 8;
+	uint16_t align = channels * bits / 8;
+
+	if (fwrite("RIFF\0\0\0\0WAVEfmt ", 1, 16, File) != 16) goto fail;
+
+	fmt.ChunkLen = LittleLong(uint32_t(sizeof(fmt) - 4));
+	fmt.FormatTag = LittleShort((uint16_t)0xFFFE);		// WAVE_FORMAT_EXTENSIBLE
+	fmt.Channels = LittleShort(channels);
+	fmt.SamplesPerSec = LittleLong(samplerate);
+	fmt.AvgBytesPerSec = LittleLong(samplerate * align);
+	fmt.BlockAlign = LittleShort(align);
+	fmt.BitsPerSample = LittleShort(bits);
+	fmt.ExtensionSize = LittleShort((uint16_t)(2 + 4 + 16));
+	fmt.ValidBitsPerSample = LittleShort(bits);
+	fmt.ChannelMask = LittleLong(channels == 1 ? 4 : 3);
+	// Set subformat to KSDATAFORMAT_SUBTYPE_IEEE_FLOAT or KSDATAFORMAT_SUBTYPE_PCM
+	fmt.SubFormatA = LittleLong(type == zmsx_sample_float32 ? 0x00000003 : 0x00000001);
+	fmt.SubFormatB = 0x0000;
+	fmt.SubFormatC = LittleShort((uint16_t)0x0010);
+	fmt.SubFormatD[0] = 0x80;
+	fmt.SubFormatD[1] = 0x00;
+	fmt.SubFormatD[2] = 0x00;
+	fmt.SubFormatD[3] = 0xaa;
+	fmt.SubFormatD[4] = 0x00;
+	fmt.SubFormatD[5] = 0x38;
+	fmt.SubFormatD[6] = 0x9b;
+	fmt.SubFormatD[7] = 0x71;
+	if (sizeof(fmt) != fwrite(&fmt, 1, sizeof(fmt), File)) goto fail;
+
+	if (fwrite("data\0\0\0\0", 1, 8, File) != 8) goto fail;
+	return true;
+
+fail:
+	int err = errno;
+	fclose(File);
+	File = nullptr;
+	errno = err;
+	return false;
+}
+
+//==========================================================================
+//
+// WaveFileWriter :: Write
+//
+//==========================================================================
+
+bool WaveFileWriter::Write(const void *data, size_t bytes)
+{
+	if (File == nullptr) return false;
+	if (fwrite(data, 1, bytes, File) != bytes)
+	{
+		int err = errno;
+		fclose(File);
+		File = nullptr;
+		errno = err;
+		return false;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// WaveFileWriter :: Close
+//
+// Fills in the chunk sizes and closes the file.
+//
+//==========================================================================
+
+bool WaveFileWriter::Close()
+{
+	if (File != nullptr)
+	{
+		auto pos = ftell(File);
+		uint32_t size;
+
+		// data chunk size
+		size = LittleLong(uint32_t(pos - 8));
+		if (0 == fseek(File, 4, SEEK_SET))
+		{
+			if (4 == fwrite(&size, 1, 4, File))
+			{
+				size = LittleLong(uint32_t(pos - 12 - sizeof(FmtChunk) - 8));
+				if (0 == fseek(File, 4 + sizeof(FmtChunk) + 8, SEEK_CUR))
+				{
+					if (4 == fwrite(&size, 1, 4, File))
+					{
+						fclose(File);
+						File = nullptr;
+						return true;
+					}
+				}
+			}
+		}
+		fclose(File);
+		File = nullptr;
+	}
+	return false;
+}
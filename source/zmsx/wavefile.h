@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+#include "zmsx.hpp"
+
+// Writes a WAVE_FORMAT_EXTENSIBLE file. The size fields in the header are
+// only filled in when the file gets closed.
+
+class WaveFileWriter
+{
+public:
+	WaveFileWriter() = default;
+	~WaveFileWriter();
+
+	WaveFileWriter(const WaveFileWriter&) = delete;
+	WaveFileWriter& operator=(const WaveFileWriter&) = delete;
+
+	bool Open(const char *filename, int samplerate, ZMSXChannelConfig chans, ZMSXSampleType type);
+	bool Write(const void *data, size_t bytes);
+	bool Close();
+	bool IsOpen() const { return File != nullptr; }
+
+private:
+	FILE *File = nullptr;
+};
@@ -32,10 +32,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <limits.h>
 #include <stdint.h>
 #include <vector>
 #include <string>
-#include <miniz.h>
+#include <mutex>
 
 #include "m_swap.h"
 #include "zmsx.hpp"
@@ -44,20 +45,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "streamsources/streamsource.h"
 #include "midisources/midisource.h"
 #include "critsec.h"
+#include "formatid.h"
+#include "songqueue.h"
 
 static_assert(sizeof(unsigned char) == sizeof(bool));
 
-#define GZIP_ID1		31
-#define GZIP_ID2		139
-#define GZIP_CM			8
-#define GZIP_ID			MAKE_ID(GZIP_ID1,GZIP_ID2,GZIP_CM,0)
-
-#define GZIP_FTEXT		1
-#define GZIP_FHCRC		2
-#define GZIP_FEXTRA		4
-#define GZIP_FNAME		8
-#define GZIP_FCOMMENT	16
-
 class MIDIDevice;
 class OPLmusicFile;
 class StreamSource;
@@ -71,94 +63,40 @@ MusInfo* CreateMIDIStreamer(MIDISource *source, ZMSXMidiDevice devtype, const ch
 
 //==========================================================================
 //
-// ungzip
+// ReadProbe
 //
-// VGZ files are compressed with gzip, so we need to uncompress them before
-// handing them to GME.
+// Reads the start of a file for identification and seeks back to where it was.
 //
 //==========================================================================
 
-static bool ungzip(uint8_t *data, int complen, std::vector<uint8_t> &newdata)
+static long ReadProbe(MusicIO::FileInterface *reader, uint8_t *probe)
 {
-	const uint8_t *max = data + complen - 8;
-	const uint8_t *compstart = data + 10;
-	uint8_t flags = data[3];
-	unsigned isize;
-	z_stream stream;
-	int err;
-
-	// Find start of compressed data stream
-	if (flags & GZIP_FEXTRA)
-	{
-		compstart += 2 + LittleShort(*(uint16_t *)(data + 10));
-	}
-	if (flags & GZIP_FNAME)
-	{
-		while (compstart < max && *compstart != 0)
-		{
-			compstart++;
-		}
-	}
-	if (flags & GZIP_FCOMMENT)
-	{
-		while (compstart < max && *compstart != 0)
-		{
-			compstart++;
-		}
-	}
-	if (flags & GZIP_FHCRC)
-	{
-		compstart += 2;
-	}
-	if (compstart >= max - 1)
-	{
-		return false;
-	}
-
-	// Decompress
-	isize = LittleLong(*(uint32_t *)(data + complen - 4));
-	newdata.resize(isize);
-
-	stream.next_in = (Bytef *)compstart;
-	stream.avail_in = (uInt)(max - compstart);
-	stream.next_out = &newdata[0];
-	stream.avail_out = isize;
-	stream.zalloc = (alloc_func)0;
-	stream.zfree = (free_func)0;
-
-	err = inflateInit2(&stream, -MAX_WBITS);
-	if (err != Z_OK)
+	long len = reader->read(probe, FORMAT_PROBE_SIZE);
+	if (len < 32 || reader->seek(-len, SEEK_CUR) != 0)
 	{
-		return false;
+		return -1;
 	}
-	err = inflate(&stream, Z_FINISH);
-	if (err != Z_STREAM_END)
-	{
-		inflateEnd(&stream);
-		return false;
-	}
-	err = inflateEnd(&stream);
-	if (err != Z_OK)
-	{
-		return false;
-	}
-	return true;
+	return len;
 }
 
 //==========================================================================
 //
 // identify a music lump's type and set up a player for it
 //
+// The header decides which loader gets the file. Only if there is no
+// signature, or one that may be a coincidence, do the sound decoders get
+// to try their luck.
+//
 //==========================================================================
 
 static  MusInfo *zmsx_open_songInternal (MusicIO::FileInterface *reader, ZMSXMidiDevice device, const char *Args)
 {
 	MusInfo *info = nullptr;
 	StreamSource *streamsource = nullptr;
-	const char *fmt;
-	uint32_t id[32/4];
+	uint32_t id[FORMAT_PROBE_SIZE/4];
+	long probelen;
 
-	if(reader->read(id, 32) != 32 || reader->seek(-32, SEEK_CUR) != 0)
+	if((probelen = ReadProbe(reader, (uint8_t*)id)) < 0)
 	{
 		SetError("Unable to read header");
 		reader->close();
@@ -166,48 +104,55 @@ static  MusInfo *zmsx_open_songInternal (MusicIO::FileInterface *reader, ZMSXMid
 	}
 	try
 	{
+		SongSignature sig = IdentifySongFormat((uint8_t*)id, probelen);
+
 		// Check for gzip compression. Some formats are expected to have players
 		// that can handle it, so it simplifies things if we make all songs
 		// gzippable.
-		if ((id[0] & MAKE_ID(255, 255, 255, 0)) == GZIP_ID)
+		if (sig.Format == zmsx_format_gzip)
 		{
-			// swap out the reader with one that reads the decompressed content.
-			auto zreader = new MusicIO::VectorReader([reader](std::vector<uint8_t>& array)
-													 {
-														 bool res = false;
-														 auto len = reader->filelength();
-														 uint8_t* gzipped = new uint8_t[len];
-														 if (reader->read(gzipped, len) == len)
-														 {
-															 res = ungzip(gzipped, (int)len, array);
-														 }
-														 delete[] gzipped;
-													 });
-			reader->close();
-			reader = zreader;
-
-
-			if (reader->read(id, 32) != 32 || reader->seek(-32, SEEK_CUR) != 0)
+			// swap out the reader with one that decompresses the content as it gets read.
+			reader = MusicIO::OpenGzipReader(reader);
+			if (reader == nullptr)
+			{
+				SetError("Invalid gzip data");
+				return nullptr;
+			}
+
+			if ((probelen = ReadProbe(reader, (uint8_t*)id)) < 0)
 			{
 				reader->close();
 				return nullptr;
 			}
+			sig = IdentifySongFormat((uint8_t*)id, probelen);
 		}
 
-		ZMSXMidiType miditype = zmsx_identify_midi_type(id, sizeof(id));
-		if (miditype != zmsx_midi_notmidi)
+		if (sig.Format == zmsx_format_midi)
 		{
-			std::vector<uint8_t> data(reader->filelength());
-			if (reader->read(data.data(), (long)data.size()) != (long)data.size())
+			ZMSXMidiType miditype = zmsx_identify_midi_type(id, 32);
+			MIDISource *source;
+			if (auto mem = reader->contents())
 			{
-				SetError("Failed to read MIDI data");
-				reader->close();
-				return nullptr;
+				// Parse the data in place. The source takes over the reader to keep it alive.
+				size_t len = reader->filelength();
+				std::shared_ptr<void> owner(reader, [](MusicIO::FileInterface *r) { r->close(); });
+				reader = nullptr;
+				source = CreateMIDISource(mem, len, miditype, std::move(owner));
+			}
+			else
+			{
+				std::vector<uint8_t> data(reader->filelength());
+				if (reader->read(data.data(), (long)data.size()) != (long)data.size())
+				{
+					SetError("Failed to read MIDI data");
+					reader->close();
+					return nullptr;
+				}
+				source = CreateMIDISource(data.data(), data.size(), miditype, nullptr);
 			}
-			auto source = zmsx_create_midi_source(data.data(), data.size(), miditype);
 			if (source == nullptr)
 			{
-				reader->close();
+				if (reader) reader->close();
 				return nullptr;
 			}
 			if (!source->isValid())
@@ -225,44 +170,39 @@ static  MusInfo *zmsx_open_songInternal (MusicIO::FileInterface *reader, ZMSXMid
 
 			info = CreateMIDIStreamer(source, device, Args? Args : "");
 		}
-
-		// Check for CDDA "format"
-		else if ((id[0] == MAKE_ID('R', 'I', 'F', 'F') && id[2] == MAKE_ID('C', 'D', 'D', 'A')))
+		else if (sig.Format == zmsx_format_cdda)
 		{
-			// This is a CDDA file
 			info = CDDA_OpenSong(reader);
 		}
-
-		// Check for various raw OPL formats
 		else
 		{
-#ifdef HAVE_OPL
-			if (
-				(id[0] == MAKE_ID('R', 'A', 'W', 'A') && id[1] == MAKE_ID('D', 'A', 'T', 'A')) ||		// Rdos Raw OPL
-				(id[0] == MAKE_ID('D', 'B', 'R', 'A') && id[1] == MAKE_ID('W', 'O', 'P', 'L')) ||		// DosBox Raw OPL
-				(id[0] == MAKE_ID('A', 'D', 'L', 'I') && *((uint8_t*)id + 4) == 'B'))		// Martin Fernandez's modified IMF
+			switch (sig.Format)
 			{
-				streamsource = OPL_OpenSong(reader, &oplConfig);
-
-			}
-			else
+#ifdef HAVE_OPL
+			case zmsx_format_opl:
+				streamsource = OPL_OpenSong(reader, &GetConfig()->opl);
+				break;
 #endif
-				if ((id[0] == MAKE_ID('R', 'I', 'F', 'F') && id[2] == MAKE_ID('C', 'D', 'X', 'A')))
-			{
+
+			case zmsx_format_xa:
 				streamsource = XA_OpenSong(reader);	// this takes over the reader.
 				reader = nullptr;					// We do not own this anymore.
+				break;
+
+			case zmsx_format_gme:
+				streamsource = GME_OpenSong(reader, GME_CheckFormat(id[0]), GetConfig()->misc.snd_outputrate);
+				break;
+
+			case zmsx_format_module:
+				streamsource = MOD_OpenSong(reader, GetConfig()->misc.snd_outputrate);
+				break;
+
+			default:
+				// Sound files are left to the decoders, which check the header again to pick the right one.
+				break;
 			}
-			// Check for game music
-			else if ((fmt = GME_CheckFormat(id[0])) != nullptr && fmt[0] != '\0')
-			{
-				streamsource = GME_OpenSong(reader, fmt, miscConfig.snd_outputrate);
-			}
-			// Check for module formats
-			else
-			{
-				streamsource = MOD_OpenSong(reader, miscConfig.snd_outputrate);
-			}
-			if (streamsource == nullptr)
+			if (streamsource == nullptr && reader != nullptr &&
+				(sig.Weak || sig.Format == zmsx_format_sndfile || sig.Format == zmsx_format_mp3))
 			{
 				streamsource = SndFile_OpenSong(reader);		// this only takes over the reader if it succeeds. We need to look out for this.
 				if (streamsource != nullptr) reader = nullptr;
@@ -302,6 +242,10 @@ static  MusInfo *zmsx_open_songInternal (MusicIO::FileInterface *reader, ZMSXMid
 
 DLL_EXPORT ZMSXMusicStream* zmsx_open_song_file(const char* filename, ZMSXMidiDevice device, const char* Args)
 {
+	if (auto mr = MusicIO::OpenMappedFile(filename))
+	{
+		return zmsx_open_songInternal(mr, device, Args);
+	}
 	auto f = MusicIO::utf8_fopen(filename, "rb");
 	if (!f)
 	{
@@ -325,6 +269,18 @@ DLL_EXPORT ZMSXMusicStream* zmsx_open_song_mem(const void* mem, size_t size, ZMS
 	return zmsx_open_songInternal(mr, device, Args);
 }
 
+DLL_EXPORT ZMSXMusicStream* zmsx_open_song_mem_borrowed(const void* mem, size_t size, void (*release)(void* userdata), void* userdata, ZMSXMidiDevice device, const char* Args)
+{
+	if (!mem || !size || size > LONG_MAX)
+	{
+		SetError("Invalid data");
+		if (release) release(userdata);
+		return nullptr;
+	}
+	auto mr = new MusicIO::BorrowedMemoryReader((const uint8_t*)mem, (long)size, release, userdata);
+	return zmsx_open_songInternal(mr, device, Args);
+}
+
 DLL_EXPORT ZMSXMusicStream* zmsx_open_song(ZMSXCustomReader* reader, ZMSXMidiDevice device, const char* Args)
 {
 	if (!reader)
@@ -365,8 +321,62 @@ DLL_EXPORT MusInfo *zmsx_open_song_cd (int track, int id)
 DLL_EXPORT bool zmsx_fill_stream(MusInfo* song, void* buff, int len)
 {
 	if (song == nullptr) return false;
-	std::lock_guard<FCriticalSection> lock(song->CritSec);
-	return song->ServiceStream(buff, len);
+
+	// This never waits for the controlling thread. Control requests are
+	// picked up from the song's command queue before rendering, and with
+	// render-ahead active this is only a copy out of the ring buffer.
+	return song->m_RenderAhead.Read(song, buff, len);
+}
+
+DLL_EXPORT bool zmsx_fill_stream_ex(MusInfo* song, const ZMSXOutputFormat* format, void* buff, int frames)
+{
+	if (song == nullptr || format == nullptr) return false;
+	if ((format->sample_type != zmsx_sample_int16 && format->sample_type != zmsx_sample_float32) || ZMusic_ChannelCount(format->channel_config) == 0)
+	{
+		SetError("Unsupported output format");
+		return false;
+	}
+	// The format only changes while the audio thread is suspended, so it
+	// can be read here without locking.
+	return song->m_Converter.Fill(song, song->m_NativeFormat, *format, buff, frames);
+}
+
+//==========================================================================
+//
+// sets up the render-ahead thread if enabled. The first block gets rendered
+// right away so that the first fill_stream call does not have to wait.
+// The audio thread must be suspended.
+//
+//==========================================================================
+
+static void StartRenderAhead(MusInfo *song)
+{
+	RenderAhead *ra = CreateRenderAhead(song);
+	if (ra != nullptr)
+	{
+		ra->Prime();
+	}
+	song->m_RenderAhead.Reset(ra);
+	if (ra != nullptr)
+	{
+		ra->Start();
+	}
+}
+
+//==========================================================================
+//
+// checks whether the song's output will get pulled by zmsx_fill_stream and
+// thus needs its control requests to go through the command queue.
+//
+//==========================================================================
+
+static void UpdateStreaming(MusInfo *song)
+{
+	auto fmt = song->GetStreamInfoEx();
+	song->m_NativeFormat = fmt;
+	song->m_RenderAhead.SetSilence(fmt.sample_type == zmsx_sample_uint8 ? 0x80 : 0);
+	song->m_Streaming = fmt.buffer_size > 0;
+	song->m_Perf.Reset(fmt);
 }
 
 //==========================================================================
@@ -378,16 +388,28 @@ DLL_EXPORT bool zmsx_fill_stream(MusInfo* song, void* buff, int len)
 DLL_EXPORT bool zmsx_start(MusInfo *song, int subsong, bool loop)
 {
 	if (!song) return true;	// Starting a null song is not an error! It just won't play anything.
+	song->m_RenderAhead.SetNext(nullptr);
+	song->m_RenderAhead.Suspend();
+	song->m_RenderAhead.Reset(nullptr);
+	bool res = true;
 	try
 	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		song->ProcessCommands();
+		song->m_StopPending = false;
 		song->Play(loop, subsong);
-		return true;
+		song->m_Realtime = GetConfig()->misc.snd_realtime != 0;
+		if (song->m_Realtime) song->PrepareRealtime();
+		UpdateStreaming(song);
+		StartRenderAhead(song);
 	}
 	catch (const std::exception & ex)
 	{
 		SetError(ex.what());
-		return false;
+		res = false;
 	}
+	song->m_RenderAhead.Unsuspend();
+	return res;
 }
 
 //==========================================================================
@@ -399,13 +421,16 @@ DLL_EXPORT bool zmsx_start(MusInfo *song, int subsong, bool loop)
 DLL_EXPORT void zmsx_pause(MusInfo *song)
 {
 	if (!song) return;
-	song->Pause();
+	auto ra = song->m_RenderAhead.Get();
+	if (ra) ra->SetPaused(true);
+	if (!song->PostCommand(MusCommand(MusCommand::Pause)) && ra) ra->SetPaused(false);
 }
 
 DLL_EXPORT void zmsx_resume(MusInfo *song)
 {
 	if (!song) return;
-	song->Resume();
+	if (!song->PostCommand(MusCommand(MusCommand::Resume))) return;
+	if (auto ra = song->m_RenderAhead.Get()) ra->SetPaused(false);
 }
 
 DLL_EXPORT void zmsx_update(MusInfo *song)
@@ -416,22 +441,130 @@ DLL_EXPORT void zmsx_update(MusInfo *song)
 
 DLL_EXPORT bool zmsx_is_playing(MusInfo *song)
 {
-	if (!song) return false;
+	if (!song || song->IsStopPending()) return false;
+	// Playback goes on with the queued song, if there is one.
+	if (auto next = song->m_RenderAhead.GetNext())
+	{
+		auto state = next->GetState();
+		if (state == zmsx_queue_done) return zmsx_is_playing(next->GetNext());
+		if (state != zmsx_queue_failed) return true;
+	}
+	// The song may already have ended while its last rendered data is still waiting to be played.
+	auto ra = song->m_RenderAhead.Get();
+	if (ra && !ra->IsDrained()) return true;
 	return song->IsPlaying();
 }
 
 DLL_EXPORT void zmsx_stop(MusInfo *song)
 {
 	if (!song) return;
-	std::lock_guard<FCriticalSection> lock(song->CritSec);
-	song->Stop();
+	song->m_RenderAhead.SetNext(nullptr);
+	song->m_RenderAhead.Reset(nullptr);
+	song->RequestStop();
 }
 
 DLL_EXPORT bool zmsx_set_subsong(MusInfo *song, int subsong)
 {
 	if (!song) return false;
-	std::lock_guard<FCriticalSection> lock(song->CritSec);
-	return song->SetSubsong(subsong);
+	// Switching may restart the song, which is too much work to leave to the
+	// audio thread, so it gets locked out for the duration. Anything rendered
+	// ahead belongs to the old subsong.
+	song->m_RenderAhead.Suspend();
+	bool renderahead = song->m_RenderAhead.Get() != nullptr;
+	song->m_RenderAhead.Reset(nullptr);
+	bool res = false;
+	try
+	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		song->ProcessCommands();
+		song->m_StopPending = false;
+		res = song->SetSubsong(subsong);
+		if (song->m_Realtime) song->PrepareRealtime();
+		if (renderahead) StartRenderAhead(song);
+	}
+	catch (const std::exception & ex)
+	{
+		SetError(ex.what());
+	}
+	song->m_RenderAhead.Unsuspend();
+	return res;
+}
+
+DLL_EXPORT bool zmsx_set_position(MusInfo *song, unsigned int ms)
+{
+	if (!song) return false;
+	// Like switching subsongs, except that nothing has to be restarted.
+	song->m_RenderAhead.Suspend();
+	bool renderahead = song->m_RenderAhead.Get() != nullptr;
+	song->m_RenderAhead.Reset(nullptr);
+	bool res = false;
+	try
+	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		song->ProcessCommands();
+		res = song->SetPosition(ms);
+		if (renderahead) StartRenderAhead(song);
+	}
+	catch (const std::exception & ex)
+	{
+		SetError(ex.what());
+	}
+	song->m_RenderAhead.Unsuspend();
+	return res;
+}
+
+DLL_EXPORT bool zmsx_queue_next(MusInfo *song, MusInfo *next, int subsong, bool loop, int at_ms, int crossfade_ms)
+{
+	if (!song) return false;
+	if (!next)
+	{
+		song->m_RenderAhead.SetNext(nullptr);
+		return true;
+	}
+	if (!song->m_Streaming)
+	{
+		SetError("Only streamed songs can be followed by a queued song");
+		return false;
+	}
+	if (auto queued = song->m_RenderAhead.GetNext())
+	{
+		auto state = queued->GetState();
+		if (state == zmsx_queue_transition || state == zmsx_queue_done)
+		{
+			SetError("The queued song has already taken over");
+			return false;
+		}
+	}
+	// A song queued before gets stopped first, it may be the same one.
+	song->m_RenderAhead.SetNext(nullptr);
+	if (next == song || next->m_Status != MusInfo::STATE_Stopped)
+	{
+		SetError("The next song must be a different one that is not playing");
+		return false;
+	}
+
+	ZMSXSoundStreamInfoEx format;
+	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		format = song->m_NativeFormat;
+	}
+	try
+	{
+		song->m_RenderAhead.SetNext(new QueuedSong(song, format, next, subsong, loop, at_ms, crossfade_ms));
+	}
+	catch (const std::exception & ex)
+	{
+		SetError(ex.what());
+		return false;
+	}
+	return true;
+}
+
+DLL_EXPORT ZMSXQueueState zmsx_get_queue_state(MusInfo *song)
+{
+	if (!song) return zmsx_queue_none;
+	auto next = song->m_RenderAhead.GetNext();
+	return next ? next->GetState() : zmsx_queue_none;
 }
 
 DLL_EXPORT bool zmsx_is_looping(const MusInfo *song)
@@ -486,34 +619,88 @@ DLL_EXPORT void zmsx_get_stream_info_ex(MusInfo *song, ZMSXSoundStreamInfoEx *fm
 DLL_EXPORT void zmsx_close(MusInfo *song)
 {
 	if (!song) return;
+	song->m_RenderAhead.SetNext(nullptr);
+	song->m_RenderAhead.Reset(nullptr);	// must be gone before the song starts getting destroyed.
 	delete song;
 }
 
 DLL_EXPORT void zmsx_volume_changed(MusInfo *song)
 {
 	if (!song) return;
-	std::lock_guard<FCriticalSection> lock(song->CritSec);
-	song->MusicVolumeChanged();
+	// The rendering thread does not read the config, so the volume comes with the command.
+	MusCommand cmd(MusCommand::VolumeChanged);
+	cmd.NumValue = GetConfig()->misc.MusicVolume();
+	song->PostCommand(cmd);
 }
 
-static std::string staticErrorMessage;
+// Thread local so that songs can be opened and rendered on several threads at once.
+// The last error of any thread is kept as well, for clients that ask from
+// another thread than the one where the call failed.
+static thread_local std::string staticErrorMessage;
+static thread_local std::string sharedErrorCopy;
+static std::mutex sharedErrorMutex;
+static std::string sharedErrorMessage;
 
 DLL_EXPORT const char *zmsx_get_stats(MusInfo *song)
 {
 	if (!song) return "";
-	std::lock_guard<FCriticalSection> lock(song->CritSec);
-	staticErrorMessage = song->GetStats();
+	// The stats come straight from the synth, which the rendering threads
+	// do not lock, so they are kept out of the song while they get collected.
+	song->m_RenderAhead.Suspend();
+	try
+	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		staticErrorMessage = song->GetStats();
+	}
+	catch (const std::exception & ex)
+	{
+		SetError(ex.what());
+	}
+	song->m_RenderAhead.Unsuspend();
 	return staticErrorMessage.c_str();
 }
 
+DLL_EXPORT bool zmsx_get_perf_counters(MusInfo *song, ZMSXPerfCounters *counters)
+{
+	if (!song || !counters) return false;
+	std::lock_guard<FCriticalSection> lock(song->CritSec);
+	song->m_Perf.Get(*counters);
+	counters->bytes_allocated = song->GetBufferBytes();
+	return true;
+}
+
+DLL_EXPORT bool zmsx_get_song_info(MusInfo *song, ZMSXSongInfo *info)
+{
+	if (!song || !info) return false;
+	*info = { -1, -1, -1, 0, nullptr };
+	try
+	{
+		std::lock_guard<FCriticalSection> lock(song->CritSec);
+		return song->GetSongInfo(*info);
+	}
+	catch (const std::exception & ex)
+	{
+		SetError(ex.what());
+		return false;
+	}
+}
+
 void SetError(const char* msg)
 {
 	staticErrorMessage = msg;
+	std::lock_guard<std::mutex> lock(sharedErrorMutex);
+	sharedErrorMessage = msg;
 }
 
 DLL_EXPORT const char* zmsx_get_last_error()
 {
-	return staticErrorMessage.c_str();
+	if (!staticErrorMessage.empty())
+	{
+		return staticErrorMessage.c_str();
+	}
+	std::lock_guard<std::mutex> lock(sharedErrorMutex);
+	sharedErrorCopy = sharedErrorMessage;
+	return sharedErrorCopy.c_str();
 }
 
 DLL_EXPORT bool zmsx_write_smf(MIDISource* source, const char *fn, int looplimit)
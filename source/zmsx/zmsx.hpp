@@ -14,6 +14,7 @@
 
 typedef class MIDISource ZMSXMidiSource;
 typedef class MusInfo ZMSXMusicStream;
+typedef class MusicMixer ZMSXMixer;
 
 // Build two configurations - lite and full.
 // Lite only uses FluidSynth for MIDI playback and is licensed under the LGPL v2.1
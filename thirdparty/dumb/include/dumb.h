@@ -525,6 +525,9 @@ void DUMBEXPORT dumb_it_sr_set_speed(DUMB_IT_SIGRENDERER *sr, int speed);
 #define DUMB_IT_N_NNA_CHANNELS 192
 #define DUMB_IT_TOTAL_CHANNELS (DUMB_IT_N_CHANNELS + DUMB_IT_N_NNA_CHANNELS)
 
+/* Allocates up front what rendering blocks of up to max_samples would allocate */
+void DUMBEXPORT dumb_it_sr_preallocate(DUMB_IT_SIGRENDERER *sr, int32 max_samples);
+
 /* Channels passed to any of these functions are 0-based */
 int DUMBEXPORT dumb_it_sr_get_channel_volume(DUMB_IT_SIGRENDERER *sr, int channel);
 void DUMBEXPORT dumb_it_sr_set_channel_volume(DUMB_IT_SIGRENDERER *sr, int channel, int volume);
@@ -667,6 +670,7 @@ void DUMBEXPORT dumb_silence(sample_t *samples, int32 length);
 typedef struct DUMB_CLICK_REMOVER DUMB_CLICK_REMOVER;
 
 DUMB_CLICK_REMOVER *DUMBEXPORT dumb_create_click_remover(void);
+void DUMBEXPORT dumb_reserve_clicks(DUMB_CLICK_REMOVER *cr, int n_clicks);
 void DUMBEXPORT dumb_record_click(DUMB_CLICK_REMOVER *cr, int32 pos, sample_t step);
 void DUMBEXPORT dumb_remove_clicks(DUMB_CLICK_REMOVER *cr, sample_t *samples, int32 length, int step, double halflife);
 sample_t DUMBEXPORT dumb_click_remover_get_offset(DUMB_CLICK_REMOVER *cr);
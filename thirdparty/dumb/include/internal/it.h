@@ -733,6 +733,10 @@ struct DUMB_IT_SIGRENDERER
 	//int max_output;
 
 	IT_PLAYING *free_playing;
+
+	/* Filtered voices get rendered here first. It only grows. */
+	sample_t **filter_samples;
+	int32 filter_samples_size;
 };
 
 
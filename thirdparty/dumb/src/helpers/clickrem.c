@@ -78,6 +78,27 @@ DUMB_CLICK_REMOVER *DUMBEXPORT dumb_create_click_remover(void)
 
 
 
+/* Fills the free list up to n_clicks, so recording that many does not allocate. */
+void DUMBEXPORT dumb_reserve_clicks(DUMB_CLICK_REMOVER *cr, int n_clicks)
+{
+	DUMB_CLICK *click;
+	int n;
+
+	if (!cr) return;
+
+	n = cr->n_clicks;
+	for (click = cr->free_clicks; click; click = click->next)
+		n++;
+
+	for (; n < n_clicks; n++) {
+		click = malloc(sizeof(DUMB_CLICK));
+		if (!click) return;
+		free_click(cr, click);
+	}
+}
+
+
+
 void DUMBEXPORT dumb_record_click(DUMB_CLICK_REMOVER *cr, int32 pos, sample_t step)
 {
 	DUMB_CLICK *click;
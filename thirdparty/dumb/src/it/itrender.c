@@ -31,17 +31,9 @@
 
 // #define BIT_ARRAY_BULLSHIT
 
-static IT_PLAYING *new_playing(DUMB_IT_SIGRENDERER *itsr)
+static IT_PLAYING *alloc_playing(void)
 {
-	IT_PLAYING *r;
-
-	if (itsr->free_playing != NULL)
-	{
-		r = itsr->free_playing;
-		itsr->free_playing = r->next;
-		return r;
-	}
-	r = (IT_PLAYING *)malloc(sizeof(IT_PLAYING));
+	IT_PLAYING *r = (IT_PLAYING *)malloc(sizeof(IT_PLAYING));
 	if (r)
 	{
 		r->resampler.fir_resampler_ratio = 0.0;
@@ -60,6 +52,19 @@ static IT_PLAYING *new_playing(DUMB_IT_SIGRENDERER *itsr)
 	return r;
 }
 
+static IT_PLAYING *new_playing(DUMB_IT_SIGRENDERER *itsr)
+{
+	IT_PLAYING *r;
+
+	if (itsr->free_playing != NULL)
+	{
+		r = itsr->free_playing;
+		itsr->free_playing = r->next;
+		return r;
+	}
+	return alloc_playing();
+}
+
 static void free_playing(DUMB_IT_SIGRENDERER *itsr, IT_PLAYING *playing)
 {
 	playing->next = itsr->free_playing;
@@ -178,6 +183,29 @@ static IT_PLAYING *dup_playing(IT_PLAYING *src, IT_CHANNEL *dstchannel, IT_CHANN
 	return dst;
 }
 
+/* Like dup_playing within one renderer, but takes the copy from the free
+ * list if it has one, so that it does not need to allocate.
+ */
+static IT_PLAYING *dup_playing_pooled(DUMB_IT_SIGRENDERER *itsr, IT_PLAYING *src)
+{
+	IT_PLAYING *dst;
+	void *fir_resampler[2];
+
+	if (!src) return NULL;
+	if (!itsr->free_playing) return dup_playing(src, itsr->channel, itsr->channel);
+
+	dst = new_playing(itsr);
+	fir_resampler[0] = dst->resampler.fir_resampler[0];
+	fir_resampler[1] = dst->resampler.fir_resampler[1];
+	*dst = *src;
+	dst->resampler.pickup_data = dst;
+	dst->resampler.fir_resampler[0] = fir_resampler[0];
+	dst->resampler.fir_resampler[1] = fir_resampler[1];
+	resampler_dup_inplace(fir_resampler[0], src->resampler.fir_resampler[0]);
+	resampler_dup_inplace(fir_resampler[1], src->resampler.fir_resampler[1]);
+	return dst;
+}
+
 
 
 static void dup_channel(IT_CHANNEL *dst, IT_CHANNEL *src)
@@ -305,6 +333,8 @@ static DUMB_IT_SIGRENDERER *dup_sigrenderer(DUMB_IT_SIGRENDERER *src, int n_chan
 	}
 
 	dst->free_playing = NULL;
+	dst->filter_samples = NULL;
+	dst->filter_samples_size = 0;
 	dst->sigdata = src->sigdata;
 
 	dst->n_channels = n_channels;
@@ -3341,7 +3371,7 @@ static void process_xm_note_data(DUMB_IT_SIGRENDERER *sigrenderer, IT_ENTRY *ent
 		if (channel->playing &&
 			!((entry->mask & IT_ENTRY_NOTE) && entry->note >= 120) &&
 			!((entry->mask & IT_ENTRY_EFFECT) && entry->effect == IT_XM_KEY_OFF && entry->effectvalue == 0)) {
-			playing = dup_playing(channel->playing, channel, channel);
+			playing = dup_playing_pooled(sigrenderer, channel->playing);
 			if (!playing) return;
 			if (!(sigdata->flags & IT_WAS_A_MOD)) {
 				/* Retrigger vol/pan envelopes if enabled, and cancel fadeout.
@@ -4861,6 +4891,19 @@ static void apply_pitch_modifications(DUMB_IT_SIGDATA *sigdata, IT_PLAYING *play
 
 
 
+static sample_t **get_filter_samples(DUMB_IT_SIGRENDERER *sigrenderer, int32 size)
+{
+	if (sigrenderer->filter_samples && sigrenderer->filter_samples_size >= size)
+		return sigrenderer->filter_samples;
+
+	destroy_sample_buffer(sigrenderer->filter_samples);
+	sigrenderer->filter_samples = allocate_sample_buffer(sigrenderer->n_channels, size);
+	sigrenderer->filter_samples_size = sigrenderer->filter_samples ? size : 0;
+	return sigrenderer->filter_samples;
+}
+
+
+
 static void render_normal(DUMB_IT_SIGRENDERER *sigrenderer, double volume, double delta, int32 pos, int32 size, sample_t **samples)
 {
 	int i;
@@ -4907,7 +4950,7 @@ static void render_normal(DUMB_IT_SIGRENDERER *sigrenderer, double volume, doubl
 
 		if (volume && (playing->true_filter_cutoff != 127 << IT_ENVELOPE_SHIFT || playing->true_filter_resonance != 0)) {
 			if (!samples_to_filter) {
-				samples_to_filter = allocate_sample_buffer(sigrenderer->n_channels, size + 1);
+				samples_to_filter = get_filter_samples(sigrenderer, size + 1);
 				if (!samples_to_filter) {
 					render_playing(sigrenderer, playing, 0, delta, note_delta, pos, size, NULL, 0, &left_to_mix);
 					continue;
@@ -4939,7 +4982,6 @@ static void render_normal(DUMB_IT_SIGRENDERER *sigrenderer, double volume, doubl
 		}
 	}
 
-	destroy_sample_buffer(samples_to_filter);
 
 	for (i = 0; i < DUMB_IT_N_CHANNELS; i++) {
 		if (sigrenderer->channel[i].playing) {
@@ -5021,7 +5063,7 @@ static void render_surround(DUMB_IT_SIGRENDERER *sigrenderer, double volume, dou
 
 		if (volume && (playing->true_filter_cutoff != 127 << IT_ENVELOPE_SHIFT || playing->true_filter_resonance != 0)) {
 			if (!samples_to_filter) {
-				samples_to_filter = allocate_sample_buffer(sigrenderer->n_channels, size + 1);
+				samples_to_filter = get_filter_samples(sigrenderer, size + 1);
 				if (!samples_to_filter) {
 					render_playing(sigrenderer, playing, 0, delta, note_delta, pos, size, NULL, 0, &left_to_mix);
 					continue;
@@ -5064,7 +5106,7 @@ static void render_surround(DUMB_IT_SIGRENDERER *sigrenderer, double volume, dou
 
 		if (volume && (playing->true_filter_cutoff != 127 << IT_ENVELOPE_SHIFT || playing->true_filter_resonance != 0)) {
 			if (!samples_to_filter) {
-				samples_to_filter = allocate_sample_buffer(sigrenderer->n_channels, size + 1);
+				samples_to_filter = get_filter_samples(sigrenderer, size + 1);
 				if (!samples_to_filter) {
 					render_playing(sigrenderer, playing, 0, delta, note_delta, pos, size, NULL, 0, &left_to_mix);
 					continue;
@@ -5092,7 +5134,6 @@ static void render_surround(DUMB_IT_SIGRENDERER *sigrenderer, double volume, dou
 	sigrenderer->n_channels = saved_channels;
 	sigrenderer->click_remover = saved_cr;
 
-	destroy_sample_buffer(samples_to_filter);
 
 	for (i = 0; i < DUMB_IT_N_CHANNELS; i++) {
 		if (sigrenderer->channel[i].playing) {
@@ -5152,6 +5193,8 @@ static DUMB_IT_SIGRENDERER *init_sigrenderer(DUMB_IT_SIGDATA *sigdata, int n_cha
 	}
 
 	sigrenderer->free_playing = NULL;
+	sigrenderer->filter_samples = NULL;
+	sigrenderer->filter_samples_size = 0;
 	sigrenderer->callbacks = callbacks;
 	sigrenderer->click_remover = cr;
 
@@ -5344,6 +5387,39 @@ void DUMBEXPORT dumb_it_set_resampling_quality(DUMB_IT_SIGRENDERER * sigrenderer
 }
 
 
+/* Allocates what rendering would otherwise allocate as it goes: a voice for
+ * every channel plus the copy a retriggered XM note needs, room for two
+ * clicks per voice, and the buffer for filtered voices, for blocks of up to
+ * max_samples. Larger blocks still grow that buffer once.
+ */
+void DUMBEXPORT dumb_it_sr_preallocate(DUMB_IT_SIGRENDERER *sigrenderer, int32 max_samples)
+{
+	IT_PLAYING *playing;
+	int i, n = 0;
+
+	if (!sigrenderer) return;
+
+	if (sigrenderer->click_remover)
+		for (i = 0; i < sigrenderer->n_channels; i++)
+			dumb_reserve_clicks(sigrenderer->click_remover[i], 2 * DUMB_IT_TOTAL_CHANNELS);
+
+	get_filter_samples(sigrenderer, max_samples + 1);
+
+	for (i = 0; i < DUMB_IT_N_CHANNELS; i++)
+		if (sigrenderer->channel[i].playing) n++;
+	for (i = 0; i < DUMB_IT_N_NNA_CHANNELS; i++)
+		if (sigrenderer->playing[i]) n++;
+	for (playing = sigrenderer->free_playing; playing; playing = playing->next)
+		n++;
+
+	for (; n < DUMB_IT_TOTAL_CHANNELS + 1; n++) {
+		playing = alloc_playing();
+		if (!playing) return;
+		free_playing(sigrenderer, playing);
+	}
+}
+
+
 void DUMBEXPORT dumb_it_set_ramp_style(DUMB_IT_SIGRENDERER * sigrenderer, int ramp_style) {
 	if (sigrenderer && ramp_style >= 0 && ramp_style <= 2) {
 		sigrenderer->ramp_style = ramp_style;
@@ -5573,6 +5649,8 @@ void _dumb_it_end_sigrenderer(sigrenderer_t *vsigrenderer)
 
 		dumb_destroy_click_remover_array(sigrenderer->n_channels, sigrenderer->click_remover);
 
+		destroy_sample_buffer(sigrenderer->filter_samples);
+
 		if (sigrenderer->callbacks)
 			free(sigrenderer->callbacks);
 
@@ -132,8 +132,11 @@ FLUIDSYNTH_API fluid_sfloader_t *new_fluid_sfloader(fluid_sfloader_load_t load,
 FLUIDSYNTH_API void delete_fluid_sfloader(fluid_sfloader_t *loader);
 
 FLUIDSYNTH_API fluid_sfloader_t *new_fluid_defsfloader(fluid_settings_t *settings);
+FLUIDSYNTH_API fluid_sfloader_t *new_fluid_shared_sfloader(fluid_settings_t *settings);
 /** @endlifecycle */
 
+FLUIDSYNTH_API void fluid_shared_sfloader_set_cache_size(int megabytes);
+
 /**
  * Opens the file or memory indicated by \c filename in binary read mode.
  *
@@ -936,7 +936,8 @@ fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int c
                    the key and velocity range of this  instrument zone.
                    An instrument zone must be ignored when its voice is already running
                    played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
-                if(fluid_zone_inside_range(&voice_zone->range, tuned_key, vel))
+                if(fluid_zone_inside_range(&voice_zone->range, tuned_key, vel) &&
+                        !fluid_synth_is_legato_zone(synth, chan, &voice_zone->range))
                 {
 
                     inst_zone = voice_zone->inst_zone;
@@ -1209,7 +1210,6 @@ new_fluid_preset_zone(char *name)
     zone->range.keyhi = 128;
     zone->range.vello = 0;
     zone->range.velhi = 128;
-    zone->range.ignore = FALSE;
 
     /* Flag all generators as unused (default, they will be set when they are found
      * in the sound font).
@@ -1298,7 +1298,6 @@ static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone
         voice_zone->range.keyhi = (prange->keyhi < irange->keyhi) ? prange->keyhi : irange->keyhi;
         voice_zone->range.vello = (prange->vello > irange->vello) ? prange->vello : irange->vello;
         voice_zone->range.velhi = (prange->velhi < irange->velhi) ? prange->velhi : irange->velhi;
-        voice_zone->range.ignore = FALSE;
 
         preset_zone->voice_zone = fluid_list_append(preset_zone->voice_zone, voice_zone);
 
@@ -1947,7 +1946,6 @@ new_fluid_inst_zone(char *name)
     zone->range.keyhi = 128;
     zone->range.vello = 0;
     zone->range.velhi = 128;
-    zone->range.ignore = FALSE;
     /* Flag the generators as unused.
      * This also sets the generator values to default, but they will be overwritten anyway, if used.*/
     fluid_gen_init(&zone->gen[0], NULL);
@@ -2038,16 +2036,13 @@ fluid_inst_zone_get_sample(fluid_inst_zone_t *zone)
 int
 fluid_zone_inside_range(fluid_zone_range_t *range, int key, int vel)
 {
-    /* ignoreInstrumentZone is set in mono legato playing */
-    int ignore_zone = range->ignore;
-
-    /* Reset the 'ignore' request */
-    range->ignore = FALSE;
-
-    return !ignore_zone && ((range->keylo <= key) &&
-                            (range->keyhi >= key) &&
-                            (range->vello <= vel) &&
-                            (range->velhi >= vel));
+    /* The zones are shared between synths by the shared SoundFont loader, so
+     * this must not change them. Zones played legato are skipped by the
+     * caller, see fluid_synth_is_legato_zone(). */
+    return ((range->keylo <= key) &&
+            (range->keyhi >= key) &&
+            (range->vello <= vel) &&
+            (range->velhi >= vel));
 }
 
 /***************************************************************
@@ -62,7 +62,6 @@ struct _fluid_zone_range_t
     int keyhi;
     int vello;
     int velhi;
-    unsigned char ignore;	/* set to TRUE for legato playing to ignore this range zone */
 };
 
 /* Stored on a preset zone to keep track of the inst zones that could start a voice
@@ -48,11 +48,11 @@ int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
   ( ((_preset) && (_preset)->notify) ? (*(_preset)->notify)(_preset,_reason,_chan) : FLUID_OK )
 
 
-#define fluid_sample_incr_ref(_sample) { (_sample)->refcount++; }
+/* Atomic because samples of shared SoundFonts are used by the voices of several synths. */
+#define fluid_sample_incr_ref(_sample) { fluid_atomic_int_inc((int *)&(_sample)->refcount); }
 
 #define fluid_sample_decr_ref(_sample) \
-  (_sample)->refcount--; \
-  if (((_sample)->refcount == 0) && ((_sample)->notify)) \
+  if (fluid_atomic_int_dec_and_test((int *)&(_sample)->refcount) && ((_sample)->notify)) \
     (*(_sample)->notify)(_sample, FLUID_SAMPLE_DONE);
 
 
@@ -0,0 +1,600 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/* SHARED SOUNDFONT LOADER
+ *
+ * The sample cache already shares the sample data of a SoundFont between all
+ * FluidSynth instances, but every instance still parses the presets,
+ * instruments and zones of the file again. This loader parses each file only
+ * once per process with the default loader and hands out a thin SoundFont to
+ * each synth that forwards to the shared one.
+ *
+ * The synth keeps its own reference counts on the SoundFont it was given, so
+ * that part needs to be per synth, and so do the presets that point back to
+ * it. Everything else of the shared SoundFont is only read while playing,
+ * except for the sample reference counts, which are atomic. The zones played
+ * legato are marked on the voices of the synth, not on the zones, so note-ons
+ * of different synths need no locking.
+ *
+ * A file is only shared with synths that load it with the same settings, and
+ * only if its modification time is known, so that a changed file is not
+ * mistaken for the cached one.
+ *
+ * SoundFonts no synth uses anymore stay loaded as long as they fit into the
+ * cache size, least recently used ones get unloaded first.
+ */
+
+#include "fluid_sfont.h"
+#include "fluid_defsfont.h"
+#include "fluid_sys.h"
+#include "fluid_list.h"
+
+
+typedef struct _fluid_sfontcache_entry_t fluid_sfontcache_entry_t;
+typedef struct _fluid_shared_sfont_t fluid_shared_sfont_t;
+
+struct _fluid_sfontcache_entry_t
+{
+    /* The following members form the cache key */
+    char *filename;
+    time_t modification_time;
+    int mlock;                  /* synth.lock-memory, the only setting the default loader reads */
+    /* End of cache key members */
+
+    fluid_sfont_t *sfont;       /* as loaded by the default loader, not known to any synth */
+    fluid_preset_t **presets;   /* all presets of sfont, in iteration order */
+    int num_presets;
+    unsigned int size;          /* approximate memory use in bytes */
+
+    int num_references;
+    unsigned int last_use;
+};
+
+/* The SoundFont a single synth gets */
+struct _fluid_shared_sfont_t
+{
+    fluid_sfontcache_entry_t *entry;
+    fluid_preset_t **presets;   /* one per preset of the entry, same order */
+    int iter_cur;
+};
+
+static fluid_list_t *sfontcache_list = NULL;
+static fluid_mutex_t sfontcache_mutex = FLUID_MUTEX_INIT;
+static unsigned int sfontcache_size = 0;
+static unsigned int sfontcache_use_count = 0;
+
+static fluid_sfont_t *fluid_shared_sfloader_load(fluid_sfloader_t *loader, const char *filename);
+static fluid_sfontcache_entry_t *new_sfontcache_entry(fluid_sfloader_t *loader, const char *filename, time_t mtime, int mlock);
+static fluid_sfontcache_entry_t *get_sfontcache_entry(const char *filename, time_t mtime, int mlock);
+static int delete_sfontcache_entry(fluid_sfontcache_entry_t *entry);
+static void release_sfontcache_entry(fluid_sfontcache_entry_t *entry);
+static void evict_sfontcache_entries(void);
+
+static fluid_sfont_t *new_fluid_shared_sfont(fluid_sfontcache_entry_t *entry);
+static int fluid_shared_sfont_delete(fluid_sfont_t *sfont);
+static const char *fluid_shared_sfont_get_name(fluid_sfont_t *sfont);
+static fluid_preset_t *fluid_shared_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum);
+static void fluid_shared_sfont_iteration_start(fluid_sfont_t *sfont);
+static fluid_preset_t *fluid_shared_sfont_iteration_next(fluid_sfont_t *sfont);
+
+static const char *fluid_shared_preset_get_name(fluid_preset_t *preset);
+static int fluid_shared_preset_get_banknum(fluid_preset_t *preset);
+static int fluid_shared_preset_get_num(fluid_preset_t *preset);
+static int fluid_shared_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key, int vel);
+static void fluid_shared_preset_delete(fluid_preset_t *preset);
+
+static int fluid_get_file_modification_time(const char *filename, time_t *modification_time);
+
+
+/* PUBLIC INTERFACE */
+
+/**
+ * Creates a SoundFont loader that parses each SoundFont file only once per
+ * process and shares it between all synths that load it.
+ *
+ * @param settings Settings the shared SoundFonts get loaded with. Synths
+ *   whose settings differ in what affects loading get a copy of their own.
+ * @return A new SoundFont loader or NULL on error.
+ *
+ * The loader declines to load anything while dynamic sample loading is
+ * enabled in \c settings, because that keeps track of the samples per synth,
+ * and files whose modification time cannot be determined. Add it in front of
+ * the default loader with fluid_synth_add_sfloader(), so that the default
+ * loader takes over in those cases.
+ */
+fluid_sfloader_t *new_fluid_shared_sfloader(fluid_settings_t *settings)
+{
+    fluid_sfloader_t *loader;
+    fluid_return_val_if_fail(settings != NULL, NULL);
+
+    loader = new_fluid_sfloader(fluid_shared_sfloader_load, delete_fluid_sfloader);
+
+    if(loader == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    fluid_sfloader_set_data(loader, settings);
+
+    return loader;
+}
+
+/**
+ * Sets how much memory SoundFonts that no synth uses anymore may keep
+ * occupied, so that loading them again costs nothing.
+ *
+ * @param megabytes Cache size, 0 unloads SoundFonts as soon as they are unused.
+ */
+void fluid_shared_sfloader_set_cache_size(int megabytes)
+{
+    fluid_mutex_lock(sfontcache_mutex);
+    sfontcache_size = megabytes > 0 ? (unsigned int)megabytes : 0;
+    evict_sfontcache_entries();
+    fluid_mutex_unlock(sfontcache_mutex);
+}
+
+
+/* Private functions */
+
+static fluid_sfont_t *fluid_shared_sfloader_load(fluid_sfloader_t *loader, const char *filename)
+{
+    fluid_settings_t *settings = fluid_sfloader_get_data(loader);
+    fluid_sfontcache_entry_t *entry, *loaded;
+    fluid_sfont_t *sfont;
+    int dynamic_samples = FALSE;
+    int mlock = FALSE;
+    time_t mtime;
+
+    fluid_settings_getint(settings, "synth.dynamic-sample-loading", &dynamic_samples);
+    fluid_settings_getint(settings, "synth.lock-memory", &mlock);
+
+    if(dynamic_samples)
+    {
+        return NULL;
+    }
+
+    /* Without it a changed file would look like the cached one. */
+    if(fluid_get_file_modification_time(filename, &mtime) == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_DBG, "Not sharing SoundFont '%s', unable to get its modification time", filename);
+        return NULL;
+    }
+
+    fluid_mutex_lock(sfontcache_mutex);
+    entry = get_sfontcache_entry(filename, mtime, mlock);
+
+    if(entry != NULL)
+    {
+        entry->num_references++;
+    }
+
+    fluid_mutex_unlock(sfontcache_mutex);
+
+    if(entry == NULL)
+    {
+        /* Parsing may take a while, so do not hold up other synths meanwhile. */
+        loaded = new_sfontcache_entry(loader, filename, mtime, mlock);
+
+        if(loaded == NULL)
+        {
+            return NULL;
+        }
+
+        fluid_mutex_lock(sfontcache_mutex);
+        entry = get_sfontcache_entry(filename, mtime, mlock);
+
+        if(entry == NULL)
+        {
+            entry = loaded;
+            loaded = NULL;
+            sfontcache_list = fluid_list_prepend(sfontcache_list, entry);
+        }
+
+        entry->num_references++;
+        fluid_mutex_unlock(sfontcache_mutex);
+
+        /* Some other synth has been faster. */
+        delete_sfontcache_entry(loaded);
+    }
+
+    sfont = new_fluid_shared_sfont(entry);
+
+    if(sfont == NULL)
+    {
+        release_sfontcache_entry(entry);
+    }
+
+    return sfont;
+}
+
+static fluid_sfontcache_entry_t *new_sfontcache_entry(fluid_sfloader_t *loader, const char *filename, time_t mtime, int mlock)
+{
+    fluid_sfloader_t *defloader;
+    fluid_sfontcache_entry_t *entry;
+    fluid_defsfont_t *defsfont;
+    fluid_preset_t *preset;
+    fluid_sample_t *sample;
+    fluid_list_t *list;
+    int i;
+
+    entry = FLUID_NEW(fluid_sfontcache_entry_t);
+
+    if(entry == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(entry, 0, sizeof(*entry));
+
+    entry->filename = FLUID_STRDUP(filename);
+    entry->modification_time = mtime;
+    entry->mlock = mlock;
+
+    if(entry->filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_exit;
+    }
+
+    defloader = new_fluid_defsfloader(fluid_sfloader_get_data(loader));
+
+    if(defloader == NULL)
+    {
+        goto error_exit;
+    }
+
+    defloader->file_callbacks = loader->file_callbacks;
+    entry->sfont = fluid_sfloader_load(defloader, filename);
+    fluid_sfloader_delete(defloader);
+
+    if(entry->sfont == NULL)
+    {
+        goto error_exit;
+    }
+
+    fluid_sfont_iteration_start(entry->sfont);
+
+    while(fluid_sfont_iteration_next(entry->sfont) != NULL)
+    {
+        entry->num_presets++;
+    }
+
+    entry->presets = FLUID_ARRAY(fluid_preset_t *, entry->num_presets + 1);
+
+    if(entry->presets == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_exit;
+    }
+
+    fluid_sfont_iteration_start(entry->sfont);
+
+    for(i = 0; (preset = fluid_sfont_iteration_next(entry->sfont)) != NULL && i < entry->num_presets; i++)
+    {
+        entry->presets[i] = preset;
+    }
+
+    /* The sample data makes up nearly all of it. Samples that do not point
+     * into the common sample chunk were decompressed on their own. */
+    defsfont = fluid_sfont_get_data(entry->sfont);
+    entry->size = defsfont->samplesize + defsfont->sample24size;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        sample = (fluid_sample_t *) fluid_list_get(list);
+
+        if(sample->data != NULL && sample->data != defsfont->sampledata)
+        {
+            entry->size += (sample->end + 1) * sizeof(short);
+        }
+    }
+
+    return entry;
+
+error_exit:
+    delete_sfontcache_entry(entry);
+    return NULL;
+}
+
+/* Returns FLUID_FAILED if a voice still plays one of the samples. */
+static int delete_sfontcache_entry(fluid_sfontcache_entry_t *entry)
+{
+    fluid_return_val_if_fail(entry != NULL, FLUID_OK);
+
+    if(entry->sfont != NULL && fluid_sfont_delete_internal(entry->sfont) != 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_FREE(entry->filename);
+    FLUID_FREE(entry->presets);
+    FLUID_FREE(entry);
+    return FLUID_OK;
+}
+
+static fluid_sfontcache_entry_t *get_sfontcache_entry(const char *filename, time_t mtime, int mlock)
+{
+    fluid_list_t *entry_list;
+    fluid_sfontcache_entry_t *entry;
+
+    for(entry_list = sfontcache_list; entry_list; entry_list = fluid_list_next(entry_list))
+    {
+        entry = (fluid_sfontcache_entry_t *)fluid_list_get(entry_list);
+
+        if((FLUID_STRCMP(filename, entry->filename) == 0) &&
+                (mtime == entry->modification_time) &&
+                (mlock == entry->mlock))
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void release_sfontcache_entry(fluid_sfontcache_entry_t *entry)
+{
+    fluid_mutex_lock(sfontcache_mutex);
+    entry->num_references--;
+    entry->last_use = ++sfontcache_use_count;
+    evict_sfontcache_entries();
+    fluid_mutex_unlock(sfontcache_mutex);
+}
+
+/* Must be called with the cache locked. */
+static void evict_sfontcache_entries(void)
+{
+    fluid_list_t *entry_list;
+    fluid_sfontcache_entry_t *entry, *oldest;
+    double unused_size;
+
+    for(;;)
+    {
+        unused_size = 0;
+        oldest = NULL;
+
+        for(entry_list = sfontcache_list; entry_list; entry_list = fluid_list_next(entry_list))
+        {
+            entry = (fluid_sfontcache_entry_t *)fluid_list_get(entry_list);
+
+            if(entry->num_references == 0)
+            {
+                unused_size += entry->size;
+
+                if(oldest == NULL || entry->last_use < oldest->last_use)
+                {
+                    oldest = entry;
+                }
+            }
+        }
+
+        if(oldest == NULL || unused_size <= sfontcache_size * 1048576.0)
+        {
+            return;
+        }
+
+        sfontcache_list = fluid_list_remove(sfontcache_list, oldest);
+
+        if(delete_sfontcache_entry(oldest) != FLUID_OK)
+        {
+            /* No voice should be left playing it, try again next time. */
+            FLUID_LOG(FLUID_WARN, "Unable to unload shared SoundFont, samples still in use.");
+            sfontcache_list = fluid_list_prepend(sfontcache_list, oldest);
+            return;
+        }
+    }
+}
+
+static fluid_sfont_t *new_fluid_shared_sfont(fluid_sfontcache_entry_t *entry)
+{
+    fluid_shared_sfont_t *shared;
+    fluid_sfont_t *sfont;
+    int i;
+
+    shared = FLUID_NEW(fluid_shared_sfont_t);
+
+    if(shared == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(shared, 0, sizeof(*shared));
+    shared->entry = entry;
+
+    sfont = new_fluid_sfont(fluid_shared_sfont_get_name,
+                            fluid_shared_sfont_get_preset,
+                            fluid_shared_sfont_iteration_start,
+                            fluid_shared_sfont_iteration_next,
+                            fluid_shared_sfont_delete);
+
+    if(sfont == NULL)
+    {
+        FLUID_FREE(shared);
+        return NULL;
+    }
+
+    fluid_sfont_set_data(sfont, shared);
+
+    shared->presets = FLUID_ARRAY(fluid_preset_t *, entry->num_presets + 1);
+
+    if(shared->presets == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_exit;
+    }
+
+    FLUID_MEMSET(shared->presets, 0, (entry->num_presets + 1) * sizeof(fluid_preset_t *));
+
+    for(i = 0; i < entry->num_presets; i++)
+    {
+        shared->presets[i] = new_fluid_preset(sfont,
+                                              fluid_shared_preset_get_name,
+                                              fluid_shared_preset_get_banknum,
+                                              fluid_shared_preset_get_num,
+                                              fluid_shared_preset_noteon,
+                                              fluid_shared_preset_delete);
+
+        if(shared->presets[i] == NULL)
+        {
+            goto error_exit;
+        }
+
+        fluid_preset_set_data(shared->presets[i], entry->presets[i]);
+    }
+
+    return sfont;
+
+error_exit:
+    /* Does not release the entry, that is up to the caller here. */
+    for(i = 0; shared->presets != NULL && i < entry->num_presets; i++)
+    {
+        fluid_preset_delete_internal(shared->presets[i]);
+    }
+
+    FLUID_FREE(shared->presets);
+    FLUID_FREE(shared);
+    delete_fluid_sfont(sfont);
+    return NULL;
+}
+
+static int fluid_shared_sfont_delete(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    fluid_sfontcache_entry_t *entry = shared->entry;
+    fluid_defsfont_t *defsfont;
+    fluid_list_t *list;
+    int i;
+
+    /* Like the default loader, wait for the voices of this synth to finish.
+     * Only the last synth using the SoundFont can tell, though. */
+    fluid_mutex_lock(sfontcache_mutex);
+
+    if(entry->num_references == 1)
+    {
+        defsfont = fluid_sfont_get_data(entry->sfont);
+
+        for(list = defsfont->sample; list; list = fluid_list_next(list))
+        {
+            if(fluid_atomic_int_get((int *) & ((fluid_sample_t *)fluid_list_get(list))->refcount) != 0)
+            {
+                fluid_mutex_unlock(sfontcache_mutex);
+                return -1;
+            }
+        }
+    }
+
+    fluid_mutex_unlock(sfontcache_mutex);
+
+    for(i = 0; i < entry->num_presets; i++)
+    {
+        fluid_preset_delete_internal(shared->presets[i]);
+    }
+
+    FLUID_FREE(shared->presets);
+    FLUID_FREE(shared);
+    delete_fluid_sfont(sfont);
+
+    release_sfontcache_entry(entry);
+    return 0;
+}
+
+static const char *fluid_shared_sfont_get_name(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    return fluid_sfont_get_name(shared->entry->sfont);
+}
+
+static fluid_preset_t *fluid_shared_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    fluid_sfontcache_entry_t *entry = shared->entry;
+    int i;
+
+    for(i = 0; i < entry->num_presets; i++)
+    {
+        if(fluid_preset_get_banknum(entry->presets[i]) == bank &&
+                fluid_preset_get_num(entry->presets[i]) == prenum)
+        {
+            return shared->presets[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void fluid_shared_sfont_iteration_start(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    shared->iter_cur = 0;
+}
+
+static fluid_preset_t *fluid_shared_sfont_iteration_next(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+
+    if(shared->iter_cur >= shared->entry->num_presets)
+    {
+        return NULL;
+    }
+
+    return shared->presets[shared->iter_cur++];
+}
+
+static const char *fluid_shared_preset_get_name(fluid_preset_t *preset)
+{
+    return fluid_preset_get_name(fluid_preset_get_data(preset));
+}
+
+static int fluid_shared_preset_get_banknum(fluid_preset_t *preset)
+{
+    return fluid_preset_get_banknum(fluid_preset_get_data(preset));
+}
+
+static int fluid_shared_preset_get_num(fluid_preset_t *preset)
+{
+    return fluid_preset_get_num(fluid_preset_get_data(preset));
+}
+
+static int fluid_shared_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key, int vel)
+{
+    fluid_preset_t *shared_preset = fluid_preset_get_data(preset);
+    return fluid_preset_noteon(shared_preset, synth, chan, key, vel);
+}
+
+static void fluid_shared_preset_delete(fluid_preset_t *preset)
+{
+    delete_fluid_preset(preset);
+}
+
+static int fluid_get_file_modification_time(const char *filename, time_t *modification_time)
+{
+    fluid_stat_buf_t buf;
+
+    if(fluid_stat(filename, &buf))
+    {
+        return FLUID_FAILED;
+    }
+
+    *modification_time = buf.st_mtime;
+    return FLUID_OK;
+}
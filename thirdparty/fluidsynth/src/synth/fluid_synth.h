@@ -137,6 +137,7 @@ struct _fluid_synth_t
     unsigned int noteid;               /**< the id is incremented for every new note. it's used for noteoff's  */
     unsigned int storeid;
     int fromkey_portamento;			 /**< fromkey portamento */
+    int legato_zones;                  /**< Number of voices with legato_zone set */
     fluid_rvoice_eventhandler_t *eventhandler;
 
     /**< Shadow of reverb parameter: roomsize, damping, width, level */
@@ -258,6 +259,7 @@ int fluid_synth_noteon_mono_staccato(fluid_synth_t *synth, int chan, int key, in
 int fluid_synth_noteon_mono_LOCAL(fluid_synth_t *synth, int chan, int key, int vel);
 int fluid_synth_noteoff_mono_LOCAL(fluid_synth_t *synth, int chan, int key);
 int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan, int fromkey, int tokey, int vel);
+int fluid_synth_is_legato_zone(fluid_synth_t *synth, int chan, fluid_zone_range_t *zone_range);
 int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key, char Mono);
 
 fluid_voice_t *
@@ -655,7 +655,7 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
     fluid_channel_t *channel = synth->channel[chan];
     enum fluid_channel_legato_mode legatomode = channel->legatomode;
     fluid_voice_t *voice;
-    int i ;
+    int i, result;
     /* Gets possible 'fromkey portamento' and possible 'fromkey legato' note  */
     fromkey = fluid_synth_get_fromkey_portamento_legato(channel, fromkey);
 
@@ -673,8 +673,10 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
                 fluid_zone_range_t *zone_range = voice->zone_range;
 
                 /* Ignores voice when there is no instrument zone (i.e no zone_range). Otherwise
-                   checks if tokey is inside the range of the running voice */
-                if(zone_range && fluid_zone_inside_range(zone_range, tokey, vel))
+                   checks if tokey is inside the range of the running voice, which
+                   another voice may already be playing legato */
+                if(zone_range && !fluid_synth_is_legato_zone(synth, chan, zone_range) &&
+                        fluid_zone_inside_range(zone_range, tokey, vel))
                 {
                     switch(legatomode)
                     {
@@ -697,8 +699,10 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
 
                         /* The voice is now used to play tokey in legato manner */
                         /* Marks this Instrument Zone to be ignored during next
-                        fluid_preset_noteon() */
-                        zone_range->ignore = TRUE;
+                        fluid_preset_noteon(). The mark is kept on the voice, since
+                        the zone may belong to a SoundFont other synths play as well */
+                        voice->legato_zone = TRUE;
+                        synth->legato_zones++;
                         break;
 
                     default: /* Invalid mode: this should never happen */
@@ -718,5 +722,52 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
 
     /* May be,tokey will enter in new others Insrument Zone(s),Preset Zone(s), in
        this case it needs to be played by voices allocation  */
-    return fluid_preset_noteon(channel->preset, synth, chan, tokey, vel);
+    result = fluid_preset_noteon(channel->preset, synth, chan, tokey, vel);
+
+    /* The marks only apply to this note */
+    if(synth->legato_zones)
+    {
+        for(i = 0; i < synth->polyphony; i++)
+        {
+            synth->voice[i]->legato_zone = FALSE;
+        }
+
+        synth->legato_zones = 0;
+    }
+
+    return result;
+}
+
+/**
+ * Tells if an Instrument Zone is already played legato by a voice of the
+ * channel and so must not start another voice for the current note-on.
+ * @param synth instance.
+ * @param chan MIDI channel number (0 to MIDI channel count - 1).
+ * @param zone_range the range of the Instrument Zone.
+ * @return TRUE if the zone is to be ignored.
+ */
+int fluid_synth_is_legato_zone(fluid_synth_t *synth, int chan,
+                               fluid_zone_range_t *zone_range)
+{
+    fluid_voice_t *voice;
+    int i;
+
+    /* Nothing is played legato most of the time */
+    if(!synth->legato_zones)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        voice = synth->voice[i];
+
+        if(voice->legato_zone && voice->zone_range == zone_range &&
+                fluid_voice_get_channel(voice) == chan)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
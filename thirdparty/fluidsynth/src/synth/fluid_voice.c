@@ -313,6 +313,7 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     }
 
     voice->zone_range = inst_zone_range; /* Instrument zone range for legato */
+    voice->legato_zone = FALSE;
     voice->id = id;
     voice->chan = fluid_channel_get_num(channel);
     voice->key = (unsigned char) key;
@@ -172,6 +172,10 @@ Player::~Player()
 {
 	reuse_mblock(&playmidi_pool);
 	if (reverb_buffer != nullptr) free(reverb_buffer);
+#ifdef ENABLE_PAN_DELAY
+	for (int i = 0; i < max_voices; i++) free_voice_pan_delay(i);
+	if (pan_delay_pool != nullptr) free(pan_delay_pool);
+#endif
 	for (int i = 0; i < MAX_CHANNELS; i++) free_drum_effect(i);
 	delete mixer;
 	delete recache;
@@ -1236,10 +1240,7 @@ void Player::free_voice(int v1)
     int v2;
 
 #ifdef ENABLE_PAN_DELAY
-	if (voice[v1].pan_delay_buf != NULL) {
-		free(voice[v1].pan_delay_buf);
-		voice[v1].pan_delay_buf = NULL;
-	}
+	free_voice_pan_delay(v1);
 #endif /* ENABLE_PAN_DELAY */
 
     v2 = voice[v1].chorus_link;
@@ -1645,10 +1646,7 @@ void Player::init_voice_pan_delay(int v)
 	int ch = vp->channel;
 	double pan_delay_diff; 
 
-	if (vp->pan_delay_buf != NULL) {
-		free(vp->pan_delay_buf);
-		vp->pan_delay_buf = NULL;
-	}
+	free_voice_pan_delay(v);
 	vp->pan_delay_rpt = 0;
 	if (timidity_pan_delay && channel[ch].insertion_effect == 0 && !timidity_surround_chorus) {
 		if (vp->panning == 64) {vp->delay += pan_delay_table[64] * playback_rate / 1000;}
@@ -1666,12 +1664,32 @@ void Player::init_voice_pan_delay(int v)
 		vp->pan_delay_wpt = 0;
 		vp->pan_delay_spt = vp->pan_delay_wpt - vp->pan_delay_rpt;
 		if (vp->pan_delay_spt < 0) {vp->pan_delay_spt += PAN_DELAY_BUF_MAX;}
-		vp->pan_delay_buf = (int32_t *)safe_malloc(sizeof(int32_t) * PAN_DELAY_BUF_MAX);
+		if (pan_delay_pool != NULL) {
+			vp->pan_delay_buf = pan_delay_pool + v * PAN_DELAY_BUF_MAX;
+		} else {
+			vp->pan_delay_buf = (int32_t *)safe_malloc(sizeof(int32_t) * PAN_DELAY_BUF_MAX);
+		}
 		memset(vp->pan_delay_buf, 0, sizeof(int32_t) * PAN_DELAY_BUF_MAX);
 	}
 #endif	/* ENABLE_PAN_DELAY */
 }
 
+/*! release a voice's panning-delay buffer unless it belongs to the pool. */
+void Player::free_voice_pan_delay(int v)
+{
+#ifdef ENABLE_PAN_DELAY
+	Voice *vp = &(voice[v]);
+
+	if (vp->pan_delay_buf != NULL) {
+		if (pan_delay_pool == NULL || vp->pan_delay_buf < pan_delay_pool
+				|| vp->pan_delay_buf >= pan_delay_pool + max_voices * PAN_DELAY_BUF_MAX) {
+			free(vp->pan_delay_buf);
+		}
+		vp->pan_delay_buf = NULL;
+	}
+#endif	/* ENABLE_PAN_DELAY */
+}
+
 /*! initialize portamento or legato for a voice. */
 void Player::init_voice_portamento(int v)
 {
@@ -5027,6 +5045,28 @@ int Player::compute_data(float *buffer, int32_t count)
 	return RC_OK;
 }
 
+/*! allocate the buffers that do_compute_data would otherwise allocate the
+    first time they get used, so that rendering does not need to allocate. */
+void Player::preallocate_buffers(void)
+{
+	std::lock_guard<FCriticalSection> lock(ConfigMutex);
+
+	if (last_reverb_setting != timidity_reverb)
+	{
+		reverb->free_effect_buffers();
+		reverb->init_reverb();
+		last_reverb_setting = timidity_reverb;
+	}
+	if (reverb_buffer == NULL) {
+		reverb_buffer = (char *)safe_malloc(MAX_CHANNELS * AUDIO_BUFFER_SIZE * 8);
+	}
+#ifdef ENABLE_PAN_DELAY
+	if (pan_delay_pool == NULL) {
+		pan_delay_pool = (int32_t *)safe_malloc(sizeof(int32_t) * max_voices * PAN_DELAY_BUF_MAX);
+	}
+#endif	/* ENABLE_PAN_DELAY */
+}
+
 void Player::update_modulation_wheel(int ch)
 {
     int i, uv = upper_voices;
@@ -565,6 +565,9 @@ private:
 	MBlockList playmidi_pool;
 	int32_t freq_table_user[4][48][128];
 	char *reverb_buffer; /* MAX_CHANNELS*AUDIO_BUFFER_SIZE*8 */
+#ifdef ENABLE_PAN_DELAY
+	int32_t *pan_delay_pool; /* max_voices*PAN_DELAY_BUF_MAX, only set by preallocate_buffers */
+#endif	/* ENABLE_PAN_DELAY */
 
 	int32_t lost_notes, cut_notes;
 	int32_t common_buffer[AUDIO_BUFFER_SIZE * 2], *buffer_pointer; /* stereo samples */
@@ -612,6 +615,7 @@ private:
 	int get_panning(int ch, int note, int v);
 	void init_voice_vibrato(int v);
 	void init_voice_pan_delay(int v);
+	void free_voice_pan_delay(int v);
 	void init_voice_portamento(int v);
 	void init_voice_tremolo(int v);
 	void start_note(MidiEvent *e, int i, int vid, int cnt);
@@ -723,6 +727,7 @@ public:
 	int get_default_mapID(int ch);
 	void init_channel_layer(int ch);
 	int compute_data(float *buffer, int32_t count);
+	void preallocate_buffers(void);
 	int send_event(int status, int parm1, int parm2);
 	void send_long_event(const uint8_t *sysexbuffer, int exlen);
 };
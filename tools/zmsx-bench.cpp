@@ -0,0 +1,1208 @@
+/*
+** zmsx-bench.cpp
+** Renders a synthetic corpus through every MIDI device and stream source
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Usage: zmsx-bench [options]
+**
+** Every song of the corpus gets generated on the fly, so the numbers only
+** depend on the library and the machine. MIDI songs are rendered through
+** each MIDI device, the others through their own stream source. One result
+** per line is written to stdout, as JSON or CSV.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "zmsx.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+struct DeviceName
+{
+	const char *name;
+	ZMSXMidiDevice device;
+};
+
+static const DeviceName DeviceNames[] =
+{
+	{ "opl", zmsx_mdev_opl },
+	{ "timidity", zmsx_mdev_timidity },
+	{ "fluidsynth", zmsx_mdev_fluidsynth },
+	{ "gus", zmsx_mdev_gus },
+	{ "wildmidi", zmsx_mdev_wildmidi },
+	{ "adl", zmsx_mdev_adl },
+	{ "opn", zmsx_mdev_opn },
+};
+
+enum { NUM_DEVICES = sizeof(DeviceNames) / sizeof(DeviceNames[0]) };
+
+static void Usage()
+{
+	fprintf(stderr,
+		"Usage: zmsx-bench [options]\n"
+		"  -t <seconds>      audio to render per song, default 20\n"
+		"  -b <frames>       frames per block, default 512\n"
+		"  -s <songs>        comma separated songs to run, default all\n"
+		"  -d <devices>      comma separated MIDI devices to use, default all\n"
+		"  -a <device=args>  arguments for a MIDI device, e.g. a sound font\n"
+		"  -g <file>         GENMIDI lump for the opl device\n"
+		"  -r <rate>         output rate for MIDI and module songs\n"
+		"  -q <frames>       frames soft synths render at once between MIDI events\n"
+		"  -f <json|csv>     output format, default json\n"
+		"  -w <dir>          write the corpus to this directory and exit\n"
+		"  -l                list the songs of the corpus and exit\n");
+}
+
+//==========================================================================
+//
+// Byte writing helpers
+//
+//==========================================================================
+
+static void Put8(Bytes &b, int v)
+{
+	b.push_back(uint8_t(v));
+}
+
+static void Put16LE(Bytes &b, int v)
+{
+	Put8(b, v);
+	Put8(b, v >> 8);
+}
+
+static void Put32LE(Bytes &b, uint32_t v)
+{
+	Put16LE(b, v & 0xffff);
+	Put16LE(b, v >> 16);
+}
+
+static void Put16BE(Bytes &b, int v)
+{
+	Put8(b, v >> 8);
+	Put8(b, v);
+}
+
+static void Put32BE(Bytes &b, uint32_t v)
+{
+	Put16BE(b, v >> 16);
+	Put16BE(b, v & 0xffff);
+}
+
+static void PutString(Bytes &b, const char *s, size_t len)
+{
+	for (size_t i = 0; i < len; i++) Put8(b, *s ? *s++ : 0);
+}
+
+static void PutVarLen(Bytes &b, uint32_t v)
+{
+	uint8_t buf[5];
+	int n = 0;
+	do
+	{
+		buf[n++] = v & 0x7f;
+		v >>= 7;
+	}
+	while (v != 0);
+	while (n > 1) Put8(b, buf[--n] | 0x80);
+	Put8(b, buf[0]);
+}
+
+static void Set32LE(Bytes &b, size_t pos, uint32_t v)
+{
+	for (int i = 0; i < 4; i++) b[pos + i] = uint8_t(v >> (i * 8));
+}
+
+// A fixed pseudo random sequence, so the corpus is the same every run.
+struct Random
+{
+	uint32_t Seed;
+	explicit Random(uint32_t seed) : Seed(seed) {}
+	int operator()(int range)
+	{
+		Seed = Seed * 1664525 + 1013904223;
+		return int((Seed >> 8) % (uint32_t)range);
+	}
+};
+
+static const int Scale[] = { 0, 2, 4, 5, 7, 9, 11, 12 };
+
+//==========================================================================
+//
+// MIDI event list, shared by the SMF, MUS and XMI generators
+//
+//==========================================================================
+
+struct MidiEvent
+{
+	uint32_t Tick;
+	uint8_t Status, Data1, Data2;
+};
+
+static void SortEvents(std::vector<MidiEvent> &events)
+{
+	std::stable_sort(events.begin(), events.end(), [](const MidiEvent &a, const MidiEvent &b) { return a.Tick < b.Tick; });
+}
+
+// Note-ons get Data2 > 0, note-offs are note-ons with a velocity of 0.
+static void AddNote(std::vector<MidiEvent> &events, uint32_t tick, uint32_t length, int channel, int key, int velocity)
+{
+	events.push_back({ tick, uint8_t(0x90 | channel), uint8_t(key), uint8_t(velocity) });
+	events.push_back({ tick + length, uint8_t(0x90 | channel), uint8_t(key), 0 });
+}
+
+// Fast chords on all 16 channels with controller and pitch bend sweeps.
+// Stresses event handling more than the synth.
+static std::vector<MidiEvent> DenseEvents(int seconds, int ticksPerSecond)
+{
+	std::vector<MidiEvent> events;
+	Random rnd(1);
+	int step = ticksPerSecond / 8;
+	int steps = seconds * 8;
+
+	for (int ch = 0; ch < 16; ch++)
+	{
+		events.push_back({ 0, uint8_t(0xC0 | ch), uint8_t(ch * 8), 0 });
+		events.push_back({ 0, uint8_t(0xB0 | ch), 7, 100 });
+	}
+	for (int s = 0; s < steps; s++)
+	{
+		uint32_t tick = s * step;
+		for (int ch = 0; ch < 16; ch++)
+		{
+			int root = ch == 9 ? 35 + rnd(12) : 36 + (ch % 4) * 12 + Scale[rnd(8)];
+			for (int n = 0; n < (ch == 9 ? 1 : 3); n++)
+			{
+				AddNote(events, tick, step - 1, ch, root + n * 4, 64 + rnd(64));
+			}
+			events.push_back({ tick, uint8_t(0xB0 | ch), 1, uint8_t((s * 8 + ch) & 127) });
+			events.push_back({ tick + step / 2, uint8_t(0xE0 | ch), 0, uint8_t(64 + ((s & 7) - 4) * 4) });
+		}
+	}
+	SortEvents(events);
+	return events;
+}
+
+// Slow notes with long releases under a held sustain pedal, so the voice
+// count climbs to the synth's limit. Stresses the synth more than the events.
+static std::vector<MidiEvent> PolyEvents(int seconds, int ticksPerSecond)
+{
+	std::vector<MidiEvent> events;
+	Random rnd(2);
+	int step = ticksPerSecond / 32;
+	int steps = seconds * 32;
+
+	for (int ch = 0; ch < 16; ch++)
+	{
+		events.push_back({ 0, uint8_t(0xC0 | ch), uint8_t(48 + ch), 0 });
+		events.push_back({ 0, uint8_t(0xB0 | ch), 64, 127 });
+		events.push_back({ 0, uint8_t(0xB0 | ch), 91, 100 });
+		events.push_back({ 0, uint8_t(0xB0 | ch), 93, 100 });
+	}
+	for (int s = 0; s < steps; s++)
+	{
+		int ch = s % 16;
+		if (ch == 9) ch = 15 - (s / 16) % 6;
+		AddNote(events, s * step, ticksPerSecond * 4, ch, 36 + rnd(60), 40 + rnd(80));
+	}
+	SortEvents(events);
+	return events;
+}
+
+// Held chords under continuous expression, modulation and pitch bend
+// automation, with one channel changing on every tick. Makes soft synths
+// render between the events in very small pieces.
+static std::vector<MidiEvent> ControllerEvents(int seconds, int ticksPerSecond)
+{
+	std::vector<MidiEvent> events;
+	Random rnd(7);
+	uint32_t ticks = seconds * ticksPerSecond;
+
+	for (int ch = 0; ch < 16; ch++)
+	{
+		events.push_back({ 0, uint8_t(0xC0 | ch), uint8_t(ch * 8), 0 });
+		events.push_back({ 0, uint8_t(0xB0 | ch), 7, 100 });
+	}
+	for (uint32_t tick = 0; tick < ticks; tick += ticksPerSecond)
+	{
+		for (int ch = 0; ch < 16; ch++)
+		{
+			if (ch == 9) continue;
+			int root = 36 + (ch % 4) * 12 + Scale[rnd(8)];
+			AddNote(events, tick, ticksPerSecond - 1, ch, root, 80);
+			AddNote(events, tick, ticksPerSecond - 1, ch, root + 7, 80);
+		}
+	}
+	for (uint32_t tick = 0; tick < ticks; tick++)
+	{
+		int ch = tick % 16;
+		double phase = 2 * 3.14159265358979323846 * tick / ticksPerSecond;
+		int bend = 8192 + int(sin(phase + ch) * 2048);
+		events.push_back({ tick, uint8_t(0xE0 | ch), uint8_t(bend & 127), uint8_t(bend >> 7) });
+		events.push_back({ tick, uint8_t(0xB0 | ch), 11, uint8_t(96 + int(cos(phase * 2 + ch) * 31)) });
+		events.push_back({ tick, uint8_t(0xB0 | ch), 1, uint8_t((tick / 4) & 127) });
+	}
+	SortEvents(events);
+	return events;
+}
+
+// Spreads the events over several tracks per channel, like converted
+// orchestral songs have them. Notes go by key, everything else to the
+// channel's first track.
+static std::vector<std::vector<MidiEvent>> SplitTracks(const std::vector<MidiEvent> &events, int perchannel)
+{
+	std::vector<std::vector<MidiEvent>> tracks(16 * perchannel);
+
+	for (auto &ev : events)
+	{
+		int track = (ev.Status & 15) * perchannel;
+		if ((ev.Status & 0xF0) == 0x90) track += ev.Data1 % perchannel;
+		tracks[track].push_back(ev);
+	}
+	return tracks;
+}
+
+static bool HasData2(const MidiEvent &ev)
+{
+	return (ev.Status & 0xF0) != 0xC0 && (ev.Status & 0xF0) != 0xD0;
+}
+
+//==========================================================================
+//
+// Standard MIDI file, format 0 or 1
+//
+//==========================================================================
+
+static void PutSMFTrack(Bytes &b, const std::vector<MidiEvent> &events, bool tempo)
+{
+	Bytes track;
+	uint32_t last = 0;
+
+	// 500000 µs per quarter note, so the division is the tick rate times 2.
+	if (tempo)
+	{
+		PutVarLen(track, 0);
+		Put8(track, 0xFF); Put8(track, 0x51); Put8(track, 3);
+		Put8(track, 0x07); Put8(track, 0xA1); Put8(track, 0x20);
+	}
+
+	for (auto &ev : events)
+	{
+		PutVarLen(track, ev.Tick - last);
+		last = ev.Tick;
+		Put8(track, ev.Status);
+		Put8(track, ev.Data1);
+		if (HasData2(ev)) Put8(track, ev.Data2);
+	}
+	PutVarLen(track, 0);
+	Put8(track, 0xFF); Put8(track, 0x2F); Put8(track, 0);
+
+	PutString(b, "MTrk", 4);
+	Put32BE(b, (uint32_t)track.size());
+	b.insert(b.end(), track.begin(), track.end());
+}
+
+static Bytes MakeSMF(const std::vector<std::vector<MidiEvent>> &tracks, int division)
+{
+	Bytes b;
+	PutString(b, "MThd", 4);
+	Put32BE(b, 6);
+	Put16BE(b, tracks.size() > 1 ? 1 : 0);
+	Put16BE(b, (int)tracks.size());
+	Put16BE(b, division);
+	for (size_t i = 0; i < tracks.size(); i++)
+	{
+		PutSMFTrack(b, tracks[i], i == 0);
+	}
+	return b;
+}
+
+static Bytes MakeSMF(const std::vector<MidiEvent> &events, int division)
+{
+	return MakeSMF(std::vector<std::vector<MidiEvent>>{ events }, division);
+}
+
+static Bytes MakeDenseSMF(int seconds)
+{
+	return MakeSMF(DenseEvents(seconds, 960), 480);
+}
+
+static Bytes MakePolySMF(int seconds)
+{
+	return MakeSMF(PolyEvents(seconds, 960), 480);
+}
+
+static Bytes MakeControllerSMF(int seconds)
+{
+	return MakeSMF(ControllerEvents(seconds, 1920), 960);
+}
+
+// The dense song in 96 tracks, so that merging them costs more than
+// reading them.
+static Bytes MakeTracksSMF(int seconds)
+{
+	return MakeSMF(SplitTracks(DenseEvents(seconds, 960), 6), 480);
+}
+
+//==========================================================================
+//
+// DMX MUS, played at 140 Hz
+//
+//==========================================================================
+
+static Bytes MakeMUS(int seconds)
+{
+	auto events = DenseEvents(seconds, 140);
+	Bytes score;
+	uint8_t velocity[16] = {};
+	uint32_t last = 0;
+	size_t prevevent = 0;
+	bool haveprev = false;
+
+	for (auto &ev : events)
+	{
+		// MUS puts percussion last, so the channels above it move down.
+		int ch = ev.Status & 15;
+		int muschan = ch == 9 ? 15 : ch < 9 ? ch : ch - 1;
+
+		if (haveprev && ev.Tick != last)
+		{
+			score[prevevent] |= 0x80;
+			PutVarLen(score, ev.Tick - last);
+			last = ev.Tick;
+		}
+		prevevent = score.size();
+		haveprev = true;
+
+		switch (ev.Status & 0xF0)
+		{
+		case 0x90:
+			if (ev.Data2 == 0)
+			{
+				Put8(score, 0x00 | muschan);
+				Put8(score, ev.Data1);
+			}
+			else if (ev.Data2 != velocity[ch])
+			{
+				velocity[ch] = ev.Data2;
+				Put8(score, 0x10 | muschan);
+				Put8(score, ev.Data1 | 0x80);
+				Put8(score, ev.Data2);
+			}
+			else
+			{
+				Put8(score, 0x10 | muschan);
+				Put8(score, ev.Data1);
+			}
+			break;
+
+		case 0xE0:
+			Put8(score, 0x20 | muschan);
+			Put8(score, (ev.Data2 << 1) | (ev.Data1 >> 6));
+			break;
+
+		case 0xC0:
+			Put8(score, 0x40 | muschan);
+			Put8(score, 0);
+			Put8(score, ev.Data1);
+			break;
+
+		case 0xB0:
+			Put8(score, 0x40 | muschan);
+			Put8(score, ev.Data1 == 1 ? 2 : 3);	// modulation or volume
+			Put8(score, ev.Data2);
+			break;
+		}
+	}
+	Put8(score, 0x60);
+
+	Bytes b;
+	PutString(b, "MUS\x1a", 4);
+	Put16LE(b, (int)score.size());
+	Put16LE(b, 16 + 2 * 15);
+	Put16LE(b, 15);
+	Put16LE(b, 0);
+	Put16LE(b, 15);
+	Put16LE(b, 0);
+	for (int i = 0; i < 15; i++) Put16LE(b, i * 8);
+	b.insert(b.end(), score.begin(), score.end());
+	return b;
+}
+
+//==========================================================================
+//
+// XMIDI, played at 120 Hz. Notes carry their duration, there are no
+// note-offs.
+//
+//==========================================================================
+
+static Bytes MakeXMI(int seconds)
+{
+	Bytes evnt;
+	Random rnd(3);
+	uint32_t last = 0;
+	int step = 120 / 8;
+
+	for (int ch = 0; ch < 16; ch++)
+	{
+		Put8(evnt, 0xC0 | ch);
+		Put8(evnt, ch * 8);
+		Put8(evnt, 0xB0 | ch);
+		Put8(evnt, 7);
+		Put8(evnt, 100);
+	}
+	for (int s = 0; s < seconds * 8; s++)
+	{
+		uint32_t tick = s * step;
+		for (uint32_t delay = tick - last; delay > 0; )
+		{
+			uint32_t d = std::min<uint32_t>(delay, 0x7f);
+			Put8(evnt, d);
+			delay -= d;
+		}
+		last = tick;
+		for (int ch = 0; ch < 16; ch++)
+		{
+			int root = ch == 9 ? 35 + rnd(12) : 36 + (ch % 4) * 12 + Scale[rnd(8)];
+			for (int n = 0; n < (ch == 9 ? 1 : 3); n++)
+			{
+				Put8(evnt, 0x90 | ch);
+				Put8(evnt, root + n * 4);
+				Put8(evnt, 64 + rnd(64));
+				PutVarLen(evnt, step - 1);
+			}
+		}
+	}
+	Put8(evnt, step);
+	Put8(evnt, 0xFF); Put8(evnt, 0x2F); Put8(evnt, 0);
+
+	Bytes form;
+	PutString(form, "XMID", 4);
+	PutString(form, "EVNT", 4);
+	Put32BE(form, (uint32_t)evnt.size());
+	form.insert(form.end(), evnt.begin(), evnt.end());
+	if (evnt.size() & 1) Put8(form, 0);
+
+	Bytes b;
+	PutString(b, "CAT ", 4);
+	Put32BE(b, (uint32_t)(4 + 8 + form.size()));
+	PutString(b, "XMID", 4);
+	PutString(b, "FORM", 4);
+	Put32BE(b, (uint32_t)form.size());
+	b.insert(b.end(), form.begin(), form.end());
+	return b;
+}
+
+//==========================================================================
+//
+// HMP, in as many tracks as smf-tracks. One quarter note per second, so
+// the division is the tick rate.
+//
+//==========================================================================
+
+// Little endian groups of 7 bits, with the high bit set in the last one.
+static void PutHMPVarLen(Bytes &b, uint32_t v)
+{
+	while (v >= 0x80)
+	{
+		Put8(b, v & 0x7f);
+		v >>= 7;
+	}
+	Put8(b, v | 0x80);
+}
+
+static Bytes MakeHMP(int seconds)
+{
+	auto tracks = SplitTracks(DenseEvents(seconds, 120), 6);
+	Bytes b;
+
+	PutString(b, "HMIMIDIP", 8);
+	b.resize(0x308);			// The original format, without a date
+	Set32LE(b, 0x30, (uint32_t)tracks.size());
+	Set32LE(b, 0x38, 120);
+
+	for (size_t i = 0; i < tracks.size(); i++)
+	{
+		size_t start = b.size();
+		uint32_t last = 0;
+
+		Put32LE(b, (uint32_t)i);
+		Put32LE(b, 0);			// Length, filled in below
+		Put32LE(b, 0);
+		for (auto &ev : tracks[i])
+		{
+			PutHMPVarLen(b, ev.Tick - last);
+			last = ev.Tick;
+			Put8(b, ev.Status);
+			Put8(b, ev.Data1);
+			if (HasData2(ev)) Put8(b, ev.Data2);
+		}
+		PutHMPVarLen(b, 0);
+		Put8(b, 0xFF); Put8(b, 0x2F); PutHMPVarLen(b, 0);
+		Set32LE(b, start + 4, uint32_t(b.size() - start));
+	}
+	return b;
+}
+
+//==========================================================================
+//
+// ProTracker module with two synthesized samples
+//
+//==========================================================================
+
+static void PutModCell(Bytes &b, int sample, int period, int effect, int param)
+{
+	Put8(b, (sample & 0xF0) | (period >> 8));
+	Put8(b, period & 0xFF);
+	Put8(b, ((sample & 0x0F) << 4) | effect);
+	Put8(b, param);
+}
+
+static Bytes MakeMOD(int seconds)
+{
+	static const int Periods[] = { 856, 808, 762, 720, 678, 640, 604, 570, 538, 508, 480, 453 };
+	enum { NUM_PATTERNS = 4, LEAD_LEN = 64, DRUM_LEN = 4000 };
+
+	// Speed 6 at 125 BPM makes a pattern last 7.68 seconds.
+	int orders = std::min(seconds * 100 / 768 + 1, 128);
+	Random rnd(4);
+	Bytes b;
+
+	PutString(b, "zmsx-bench", 20);
+	for (int i = 0; i < 31; i++)
+	{
+		PutString(b, "", 22);
+		if (i == 0)
+		{
+			Put16BE(b, LEAD_LEN / 2);
+			Put8(b, 0);
+			Put8(b, 48);
+			Put16BE(b, 0);
+			Put16BE(b, LEAD_LEN / 2);
+		}
+		else if (i == 1)
+		{
+			Put16BE(b, DRUM_LEN / 2);
+			Put8(b, 0);
+			Put8(b, 64);
+			Put16BE(b, 0);
+			Put16BE(b, 1);
+		}
+		else
+		{
+			Put16BE(b, 0);
+			Put8(b, 0);
+			Put8(b, 0);
+			Put16BE(b, 0);
+			Put16BE(b, 1);
+		}
+	}
+	Put8(b, orders);
+	Put8(b, 127);
+	for (int i = 0; i < 128; i++) Put8(b, i < orders ? i % NUM_PATTERNS : 0);
+	PutString(b, "M.K.", 4);
+
+	for (int p = 0; p < NUM_PATTERNS; p++)
+	{
+		for (int row = 0; row < 64; row++)
+		{
+			for (int ch = 0; ch < 4; ch++)
+			{
+				if (ch == 3)
+				{
+					if (row % 4 == 0) PutModCell(b, 2, Periods[0] / 2, 0, 0);
+					else PutModCell(b, 0, 0, 0, 0);
+				}
+				else if ((row + ch) % 2 == 0)
+				{
+					int note = Scale[rnd(8)] + ch * 5;
+					int period = Periods[note % 12] >> (note / 12 + 1);
+					PutModCell(b, 1, period, 4, 0x46);	// with vibrato
+				}
+				else
+				{
+					PutModCell(b, 0, 0, 0xA, 0x02);	// volume slide down
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < LEAD_LEN; i++) Put8(b, i < LEAD_LEN / 2 ? 96 - i * 6 : -96 + (i - LEAD_LEN / 2) * 6);
+	for (int i = 0; i < DRUM_LEN; i++) Put8(b, (int)((rnd(200) - 100) * (1. - double(i) / DRUM_LEN)));
+	return b;
+}
+
+//==========================================================================
+//
+// VGM with an SN76489 and a YM2612
+//
+//==========================================================================
+
+static Bytes MakeVGM(int seconds)
+{
+	const int psgclock = 3579545, fmclock = 7670453;
+	Random rnd(5);
+	Bytes b(0x40, 0);
+
+	memcpy(b.data(), "Vgm ", 4);
+	Set32LE(b, 0x08, 0x150);
+	Set32LE(b, 0x0C, psgclock);
+	Set32LE(b, 0x24, 60);
+	b[0x28] = 0x09;		// SN76489 noise feedback
+	b[0x2A] = 16;		// and shift register width
+	Set32LE(b, 0x2C, fmclock);
+	Set32LE(b, 0x34, 0x40 - 0x34);
+
+	auto fm = [&](int port, int reg, int val)
+	{
+		Put8(b, 0x52 + port);
+		Put8(b, reg);
+		Put8(b, val);
+	};
+
+	// One plain two operator patch on the first three FM channels.
+	for (int ch = 0; ch < 3; ch++)
+	{
+		for (int op = 0; op < 4; op++)
+		{
+			int off = ch + op * 4;
+			fm(0, 0x30 + off, 0x01);
+			fm(0, 0x40 + off, op == 3 ? 0x00 : 0x22);
+			fm(0, 0x50 + off, 0x1F);
+			fm(0, 0x60 + off, 0x08);
+			fm(0, 0x70 + off, 0x04);
+			fm(0, 0x80 + off, 0x27);
+		}
+		fm(0, 0xB0 + ch, 0x32);
+		fm(0, 0xB4 + ch, 0xC0);
+	}
+
+	uint32_t samples = 0;
+	for (int s = 0; s < seconds * 8; s++)
+	{
+		for (int ch = 0; ch < 3; ch++)
+		{
+			int note = 48 + ch * 7 + Scale[rnd(8)];
+			double freq = 440. * pow(2., (note - 69) / 12.);
+
+			int divider = std::min(int(psgclock / (32 * freq)), 1023);
+			Put8(b, 0x50); Put8(b, 0x80 | (ch << 5) | (divider & 15));
+			Put8(b, 0x50); Put8(b, divider >> 4);
+			Put8(b, 0x50); Put8(b, 0x90 | (ch << 5) | 2);
+
+			int block = 4;
+			int fnum = std::min(int(freq * (1 << 20) / (fmclock / 144.) / (1 << (block - 1))), 2047);
+			fm(0, 0x28, ch);
+			fm(0, 0xA4 + ch, (block << 3) | (fnum >> 8));
+			fm(0, 0xA0 + ch, fnum & 0xFF);
+			fm(0, 0x28, 0xF0 | ch);
+		}
+		Put8(b, 0x50); Put8(b, 0xE4);
+		Put8(b, 0x50); Put8(b, 0xF0 | (s & 3) * 3);
+
+		// An eighth of a second at 44100 Hz.
+		Put8(b, 0x61);
+		Put16LE(b, 5512);
+		samples += 5512;
+	}
+	Put8(b, 0x66);
+
+	Set32LE(b, 0x04, (uint32_t)b.size() - 4);
+	Set32LE(b, 0x18, samples);
+	return b;
+}
+
+//==========================================================================
+//
+// Raw OPL capture (RdosPlay), ticks of one millisecond
+//
+//==========================================================================
+
+static Bytes MakeRawOPL(int seconds)
+{
+	static const int OpOffset[9] = { 0, 1, 2, 8, 9, 10, 16, 17, 18 };
+	Random rnd(6);
+	Bytes b;
+
+	PutString(b, "RAWADATA", 8);
+	Put16LE(b, 1193);
+
+	auto reg = [&](int r, int v)
+	{
+		Put8(b, v);
+		Put8(b, r);
+	};
+
+	reg(0x01, 0x20);
+	for (int ch = 0; ch < 9; ch++)
+	{
+		int mod = OpOffset[ch], car = mod + 3;
+		reg(0x20 + mod, 0x01); reg(0x20 + car, 0x01);
+		reg(0x40 + mod, 0x10); reg(0x40 + car, 0x00);
+		reg(0x60 + mod, 0xF4); reg(0x60 + car, 0xF4);
+		reg(0x80 + mod, 0x55); reg(0x80 + car, 0x55);
+		reg(0xE0 + mod, ch % 4); reg(0xE0 + car, 0);
+		reg(0xC0 + ch, 0x0E);
+	}
+	for (int s = 0; s < seconds * 8; s++)
+	{
+		for (int ch = 0; ch < 9; ch++)
+		{
+			int note = 48 + ch * 3 + Scale[rnd(8)];
+			double freq = 440. * pow(2., (note - 69) / 12.);
+			int block = 4;
+			int fnum = std::min(int(freq * (1 << (20 - block)) / 49716.), 1023);
+			reg(0xB0 + ch, 0);
+			reg(0xA0 + ch, fnum & 0xFF);
+			reg(0xB0 + ch, 0x20 | (block << 2) | (fnum >> 8));
+		}
+		reg(0x00, 125);
+	}
+	reg(0xFF, 0xFF);
+	return b;
+}
+
+//==========================================================================
+//
+// 16 bit stereo wave file with a sine sweep
+//
+//==========================================================================
+
+static Bytes MakeWAV(int seconds)
+{
+	const int rate = 44100;
+	uint32_t frames = seconds * rate;
+	Bytes b;
+
+	PutString(b, "RIFF", 4);
+	Put32LE(b, 36 + frames * 4);
+	PutString(b, "WAVE", 4);
+	PutString(b, "fmt ", 4);
+	Put32LE(b, 16);
+	Put16LE(b, 1);
+	Put16LE(b, 2);
+	Put32LE(b, rate);
+	Put32LE(b, rate * 4);
+	Put16LE(b, 4);
+	Put16LE(b, 16);
+	PutString(b, "data", 4);
+	Put32LE(b, frames * 4);
+
+	double phase = 0;
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		double freq = 50. * pow(2., 8. * (i % (rate * 4)) / (rate * 4));
+		phase += 2 * 3.14159265358979323846 * freq / rate;
+		int v = int(sin(phase) * 16000);
+		Put16LE(b, v);
+		Put16LE(b, -v);
+	}
+	return b;
+}
+
+//==========================================================================
+//
+// The corpus
+//
+//==========================================================================
+
+struct CorpusSong
+{
+	const char *name;
+	const char *extension;
+	bool midi;
+	Bytes (*generate)(int seconds);
+};
+
+static const CorpusSong Corpus[] =
+{
+	{ "smf-dense", "mid", true, MakeDenseSMF },
+	{ "smf-poly", "mid", true, MakePolySMF },
+	{ "smf-cc", "mid", true, MakeControllerSMF },
+	{ "smf-tracks", "mid", true, MakeTracksSMF },
+	{ "mus", "mus", true, MakeMUS },
+	{ "xmi", "xmi", true, MakeXMI },
+	{ "hmp", "hmp", true, MakeHMP },
+	{ "mod", "mod", false, MakeMOD },
+	{ "vgm", "vgm", false, MakeVGM },
+	{ "rawopl", "raw", false, MakeRawOPL },
+	{ "wav", "wav", false, MakeWAV },
+};
+
+//==========================================================================
+//
+// Running and reporting
+//
+//==========================================================================
+
+struct Result
+{
+	std::string song;
+	std::string device;
+	std::string error;
+	int rate = 0;
+	int channels = 0;
+	double audioSeconds = 0;
+	double wallSeconds = 0;
+	double start = 0;		// Opening and starting the song, in microseconds
+	double firstBlock = 0;
+	double p50 = 0, p90 = 0, p99 = 0, max = 0;
+	ZMSXPerfCounters perf = {};
+};
+
+static int SampleSize(ZMSXSampleType type)
+{
+	return type == zmsx_sample_uint8 ? 1 : type == zmsx_sample_int16 ? 2 : 4;
+}
+
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty()) return 0;
+	size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+	return sorted[i];
+}
+
+static Result RunSong(const CorpusSong &song, const Bytes &data, const char *device, ZMSXMidiDevice mdev, const char *args, double seconds, int blockframes)
+{
+	Result res;
+	res.song = song.name;
+	res.device = device;
+
+	auto open = std::chrono::steady_clock::now();
+	ZMSXMusicStream *stream = zmsx_open_song_mem(data.data(), data.size(), mdev, args);
+	if (stream == nullptr)
+	{
+		res.error = *zmsx_get_last_error() ? zmsx_get_last_error() : "Could not open song";
+		return res;
+	}
+	if (!zmsx_start(stream, 0, false))
+	{
+		res.error = *zmsx_get_last_error() ? zmsx_get_last_error() : "Could not start song";
+		zmsx_close(stream);
+		return res;
+	}
+	// Includes going through the whole song once for MIDI.
+	res.start = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - open).count();
+
+	ZMSXSoundStreamInfoEx info;
+	zmsx_get_stream_info_ex(stream, &info);
+	if (info.buffer_size <= 0 || info.sample_rate <= 0)
+	{
+		res.error = "Song does not stream";
+		zmsx_close(stream);
+		return res;
+	}
+	res.rate = info.sample_rate;
+	res.channels = info.channel_config == zmsx_chancfg_mono ? 1 : 2;
+
+	int blockbytes = blockframes * res.channels * SampleSize(info.sample_type);
+	std::vector<uint8_t> buffer(blockbytes);
+	std::vector<double> latency;
+	uint64_t maxframes = uint64_t(seconds * info.sample_rate);
+	uint64_t frames = 0;
+	latency.reserve(size_t(maxframes / blockframes + 1));
+
+	auto begin = std::chrono::steady_clock::now();
+	bool more = true;
+	while (more && frames < maxframes)
+	{
+		auto start = std::chrono::steady_clock::now();
+		more = zmsx_fill_stream(stream, buffer.data(), blockbytes);
+		latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		frames += blockframes;
+	}
+	res.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	res.audioSeconds = double(frames) / info.sample_rate;
+	zmsx_get_perf_counters(stream, &res.perf);
+	zmsx_close(stream);
+
+	// The first block pays for everything the song sets up lazily, so it is
+	// reported on its own.
+	res.firstBlock = latency.empty() ? 0 : latency[0];
+	if (latency.size() > 1) latency.erase(latency.begin());
+	std::sort(latency.begin(), latency.end());
+	res.p50 = Percentile(latency, 0.50);
+	res.p90 = Percentile(latency, 0.90);
+	res.p99 = Percentile(latency, 0.99);
+	res.max = latency.empty() ? 0 : latency.back();
+	return res;
+}
+
+static std::string JsonString(const std::string &s)
+{
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		}
+		else out += c;
+	}
+	return out + "\"";
+}
+
+static std::string CsvString(const std::string &s)
+{
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"') out += '"';
+		out += c == '\n' || c == '\r' ? ' ' : c;
+	}
+	return out + "\"";
+}
+
+static void PrintResult(const Result &r, int blockframes, bool csv)
+{
+	bool ok = r.error.empty();
+	double rtf = r.wallSeconds > 0 ? r.audioSeconds / r.wallSeconds : 0;
+	double sps = r.wallSeconds > 0 ? r.audioSeconds * r.rate * r.channels / r.wallSeconds : 0;
+
+	if (csv)
+	{
+		printf("%s,%s,%s,%d,%d,%d,%.3f,%.4f,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%d,%llu,%llu,%s\n",
+			CsvString(r.song).c_str(), CsvString(r.device).c_str(), ok ? "ok" : "error",
+			r.rate, r.channels, blockframes, r.audioSeconds, r.wallSeconds, sps, rtf,
+			r.start, r.firstBlock, r.p50, r.p90, r.p99, r.max, r.perf.active_voices,
+			(unsigned long long)r.perf.events_processed, (unsigned long long)r.perf.bytes_allocated,
+			CsvString(r.error).c_str());
+	}
+	else if (!ok)
+	{
+		printf("{\"song\":%s,\"device\":%s,\"status\":\"error\",\"error\":%s}\n",
+			JsonString(r.song).c_str(), JsonString(r.device).c_str(), JsonString(r.error).c_str());
+	}
+	else
+	{
+		printf("{\"song\":%s,\"device\":%s,\"status\":\"ok\",\"sample_rate\":%d,\"channels\":%d,\"block_frames\":%d,"
+			"\"audio_seconds\":%.3f,\"wall_seconds\":%.4f,\"samples_per_second\":%.0f,\"realtime_factor\":%.2f,"
+			"\"start_us\":%.2f,\"block_us\":{\"first\":%.2f,\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f,\"max\":%.2f},"
+			"\"active_voices\":%d,\"events_processed\":%llu,\"underrun_risk\":%llu,\"bytes_allocated\":%llu}\n",
+			JsonString(r.song).c_str(), JsonString(r.device).c_str(), r.rate, r.channels, blockframes,
+			r.audioSeconds, r.wallSeconds, sps, rtf, r.start, r.firstBlock, r.p50, r.p90, r.p99, r.max,
+			r.perf.active_voices, (unsigned long long)r.perf.events_processed,
+			(unsigned long long)r.perf.underrun_risk, (unsigned long long)r.perf.bytes_allocated);
+	}
+	fflush(stdout);
+}
+
+static bool InList(const char *list, const char *name)
+{
+	if (list == nullptr) return true;
+	size_t len = strlen(name);
+	for (const char *p = list; *p; )
+	{
+		const char *end = strchr(p, ',');
+		size_t n = end ? size_t(end - p) : strlen(p);
+		if (n == len && !strncmp(p, name, len)) return true;
+		if (!end) break;
+		p = end + 1;
+	}
+	return false;
+}
+
+static bool LoadGenMidi(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (f == nullptr) return false;
+	Bytes data(8 + 175 * 36);
+	size_t len = fread(data.data(), 1, data.size(), f);
+	fclose(f);
+
+	size_t offset = len >= 8 && !memcmp(data.data(), "#OPL_II#", 8) ? 8 : 0;
+	if (len < offset + 175 * 36) return false;
+	zmsx_set_genmidi(data.data() + offset);
+	return true;
+}
+
+static bool WriteCorpus(const char *dir, const char *songs, int seconds)
+{
+	for (auto &song : Corpus)
+	{
+		if (!InList(songs, song.name)) continue;
+		std::string name = std::string(dir) + "/" + song.name + "." + song.extension;
+		Bytes data = song.generate(seconds);
+		FILE *f = fopen(name.c_str(), "wb");
+		if (f == nullptr || fwrite(data.data(), 1, data.size(), f) != data.size())
+		{
+			fprintf(stderr, "Could not write %s\n", name.c_str());
+			if (f != nullptr) fclose(f);
+			return false;
+		}
+		fclose(f);
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::string args[NUM_DEVICES];
+	const char *songs = nullptr;
+	const char *devices = nullptr;
+	const char *writedir = nullptr;
+	double seconds = 20;
+	int blockframes = 512;
+	bool csv = false;
+	bool list = false;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++)
+	{
+		const char *opt = argv[i];
+		if (!strcmp(opt, "-l"))
+		{
+			list = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			Usage();
+			return 1;
+		}
+		const char *val = argv[++i];
+		if (!strcmp(opt, "-t")) seconds = atof(val);
+		else if (!strcmp(opt, "-b")) blockframes = atoi(val);
+		else if (!strcmp(opt, "-s")) songs = val;
+		else if (!strcmp(opt, "-d")) devices = val;
+		else if (!strcmp(opt, "-w")) writedir = val;
+		else if (!strcmp(opt, "-f"))
+		{
+			if (!strcmp(val, "csv")) csv = true;
+			else if (strcmp(val, "json"))
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-a"))
+		{
+			const char *eq = strchr(val, '=');
+			int j;
+			for (j = 0; j < NUM_DEVICES; j++)
+			{
+				if (eq != nullptr && strlen(DeviceNames[j].name) == size_t(eq - val) && !strncmp(DeviceNames[j].name, val, eq - val)) break;
+			}
+			if (j == NUM_DEVICES)
+			{
+				fprintf(stderr, "Expected <device>=<args> instead of '%s'\n", val);
+				return 1;
+			}
+			args[j] = eq + 1;
+		}
+		else if (!strcmp(opt, "-g"))
+		{
+			if (!LoadGenMidi(val))
+			{
+				fprintf(stderr, "Could not load GENMIDI lump %s\n", val);
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-r"))
+		{
+			zmsx_config_set_int(zmusic_snd_outputrate, nullptr, atoi(val), nullptr);
+			zmsx_config_set_int(zmusic_mod_samplerate, nullptr, atoi(val), nullptr);
+		}
+		else if (!strcmp(opt, "-q"))
+		{
+			zmsx_config_set_int(zmsx_snd_midiblocksize, nullptr, atoi(val), nullptr);
+		}
+		else
+		{
+			Usage();
+			return 1;
+		}
+	}
+	if (i != argc || seconds <= 0 || blockframes < 1)
+	{
+		Usage();
+		return 1;
+	}
+
+	if (list)
+	{
+		for (auto &song : Corpus) printf("%-10s %s\n", song.name, song.midi ? "midi" : "stream");
+		return 0;
+	}
+
+	// Songs are a little longer than what gets rendered, so none ends early.
+	int songseconds = int(ceil(seconds)) + 1;
+	if (writedir != nullptr)
+	{
+		return WriteCorpus(writedir, songs, songseconds) ? 0 : 1;
+	}
+
+	// Measure the rendering itself, not copies out of a render-ahead buffer.
+	zmsx_config_set_int(zmsx_snd_renderahead, nullptr, 0, nullptr);
+
+	if (csv)
+	{
+		printf("song,device,status,sample_rate,channels,block_frames,audio_seconds,wall_seconds,samples_per_second,"
+			"realtime_factor,start_us,first_block_us,p50_block_us,p90_block_us,p99_block_us,max_block_us,active_voices,"
+			"events_processed,bytes_allocated,error\n");
+	}
+
+	int failures = 0;
+	for (auto &song : Corpus)
+	{
+		if (!InList(songs, song.name)) continue;
+		Bytes data = song.generate(songseconds);
+
+		if (!song.midi)
+		{
+			Result r = RunSong(song, data, "-", zmsx_mdev_default, "", seconds, blockframes);
+			PrintResult(r, blockframes, csv);
+			if (!r.error.empty()) failures++;
+			continue;
+		}
+		for (int j = 0; j < NUM_DEVICES; j++)
+		{
+			if (!InList(devices, DeviceNames[j].name)) continue;
+			Result r = RunSong(song, data, DeviceNames[j].name, DeviceNames[j].device, args[j].c_str(), seconds, blockframes);
+			PrintResult(r, blockframes, csv);
+			if (!r.error.empty()) failures++;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/*
+** zmsx-render.cpp
+** Renders lists of songs to wave files using all CPU cores
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Usage: zmsx-render [options] <jobfile | ->
+**
+** Each line of the job file names one input file, optionally followed by a
+** tab and the output file name. Without one, ".wav" gets appended to the
+** input's name. Empty lines and lines starting with '#' are ignored.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "zmsx.h"
+
+struct DeviceName
+{
+	const char *name;
+	ZMSXMidiDevice device;
+};
+
+static const DeviceName DeviceNames[] =
+{
+	{ "default", zmsx_mdev_default },
+	{ "opl", zmsx_mdev_opl },
+	{ "sndsys", zmsx_mdev_sndsys },
+	{ "timidity", zmsx_mdev_timidity },
+	{ "fluidsynth", zmsx_mdev_fluidsynth },
+	{ "gus", zmsx_mdev_gus },
+	{ "wildmidi", zmsx_mdev_wildmidi },
+	{ "adl", zmsx_mdev_adl },
+	{ "opn", zmsx_mdev_opn },
+};
+
+static void Usage()
+{
+	fprintf(stderr,
+		"Usage: zmsx-render [options] <jobfile | ->\n"
+		"  -d <device>   MIDI device: default, opl, sndsys, timidity, fluidsynth,\n"
+		"                gus, wildmidi, adl, opn\n"
+		"  -a <args>     device arguments, e.g. a sound font\n"
+		"  -s <subsong>  subsong to render\n"
+		"  -t <seconds>  stop each song after this many seconds\n"
+		"  -j <threads>  number of threads, default is one per core\n"
+		"  -r <rate>     output rate for MIDI and module songs\n");
+}
+
+static bool ParseDevice(const char *name, ZMSXMidiDevice &device)
+{
+	for (auto &dev : DeviceNames)
+	{
+		if (!strcmp(dev.name, name))
+		{
+			device = dev.device;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ReadJobs(FILE *f, std::vector<std::string> &inputs, std::vector<std::string> &outputs)
+{
+	char line[4096];
+	while (fgets(line, sizeof(line), f))
+	{
+		size_t len = strlen(line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = 0;
+		if (len == 0 || line[0] == '#') continue;
+
+		char *tab = strchr(line, '\t');
+		if (tab != nullptr)
+		{
+			*tab = 0;
+			inputs.push_back(line);
+			outputs.push_back(tab + 1);
+		}
+		else
+		{
+			inputs.push_back(line);
+			outputs.push_back(std::string(line) + ".wav");
+		}
+	}
+	return !ferror(f);
+}
+
+int main(int argc, char **argv)
+{
+	ZMSXMidiDevice device = zmsx_mdev_default;
+	const char *args = "";
+	int subsong = 0;
+	double seconds = 0;
+	int threads = 0;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			Usage();
+			return 1;
+		}
+		const char *opt = argv[i];
+		const char *val = argv[++i];
+		if (!strcmp(opt, "-d"))
+		{
+			if (!ParseDevice(val, device))
+			{
+				fprintf(stderr, "Unknown device '%s'\n", val);
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-a")) args = val;
+		else if (!strcmp(opt, "-s")) subsong = atoi(val);
+		else if (!strcmp(opt, "-t")) seconds = atof(val);
+		else if (!strcmp(opt, "-j")) threads = atoi(val);
+		else if (!strcmp(opt, "-r"))
+		{
+			zmsx_config_set_int(zmusic_snd_outputrate, nullptr, atoi(val), nullptr);
+			zmsx_config_set_int(zmusic_mod_samplerate, nullptr, atoi(val), nullptr);
+		}
+		else
+		{
+			Usage();
+			return 1;
+		}
+	}
+	if (i != argc - 1)
+	{
+		Usage();
+		return 1;
+	}
+
+	std::vector<std::string> inputs, outputs;
+	bool fromstdin = !strcmp(argv[i], "-");
+	FILE *f = fromstdin ? stdin : fopen(argv[i], "r");
+	if (f == nullptr)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[i]);
+		return 1;
+	}
+	bool ok = ReadJobs(f, inputs, outputs);
+	if (!fromstdin) fclose(f);
+	if (!ok)
+	{
+		fprintf(stderr, "Could not read %s\n", argv[i]);
+		return 1;
+	}
+
+	std::vector<ZMSXRenderJob> jobs(inputs.size());
+	std::vector<ZMSXRenderResult> results(inputs.size());
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		jobs[j].input_path = inputs[j].c_str();
+		jobs[j].output_path = outputs[j].c_str();
+		jobs[j].device = device;
+		jobs[j].device_args = args;
+		jobs[j].subsong = subsong;
+		jobs[j].max_seconds = seconds;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int succeeded = zmsx_render_batch(jobs.data(), results.data(), (int)jobs.size(), threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double audio = 0;
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		auto &res = results[j];
+		if (res.success)
+		{
+			printf("ok    %8.2fs audio %8.2fs wall %8.1fx  %s\n", res.audio_seconds, res.wall_seconds, res.realtime_factor, jobs[j].input_path);
+			audio += res.audio_seconds;
+		}
+		else
+		{
+			printf("FAIL  %s: %s\n", jobs[j].input_path, res.error);
+		}
+	}
+	printf("%d of %d songs rendered, %.2fs of audio in %.2fs (%.1fx realtime)\n",
+		succeeded, (int)jobs.size(), audio, elapsed, elapsed > 0 ? audio / elapsed : 0.);
+
+	return succeeded == (int)jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,492 @@
+/*
+** zmsx-rtcheck.cpp
+** Checks that songs in realtime mode render without allocating or locking
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Usage: zmsx-rtcheck [options] file...
+**
+** Replaces the allocator and the mutex functions with versions that count
+** the calls the thread makes while it is inside zmsx_fill_stream. Every song
+** gets started with zmsx_snd_realtime set and rendered from its first block
+** on, with a pause, a volume change and a few live setting changes in
+** between. Any call counted fails the check. The songs of zmsx-bench -w make
+** a good input.
+**
+** With -r the song renders ahead on a worker thread, and the blocks are
+** pulled in real time so that the control requests meet the worker while
+** it renders. Build this with -fsanitize=thread to check that they do not
+** race with it. The sanitizer takes over malloc, so then the calls do not
+** get counted.
+**
+** In a library built with ZMSX_TRACE, the trace zones of the first block
+** also get checked: MIDI songs that play every loop once have to play
+** from their timeline right from the start.
+**
+** Replacing malloc needs glibc, anywhere else this only reports that it
+** cannot check anything.
+**
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zmsx.h"
+
+#if defined(__SANITIZE_THREAD__)
+#define THREAD_SANITIZER
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define THREAD_SANITIZER
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(THREAD_SANITIZER)
+#define COUNT_CALLS
+#endif
+
+#ifdef COUNT_CALLS
+#include <atomic>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#endif
+
+struct DeviceName
+{
+	const char *name;
+	ZMSXMidiDevice device;
+};
+
+static const DeviceName DeviceNames[] =
+{
+	{ "default", zmsx_mdev_default },
+	{ "opl", zmsx_mdev_opl },
+	{ "timidity", zmsx_mdev_timidity },
+	{ "fluidsynth", zmsx_mdev_fluidsynth },
+	{ "gus", zmsx_mdev_gus },
+	{ "wildmidi", zmsx_mdev_wildmidi },
+	{ "adl", zmsx_mdev_adl },
+	{ "opn", zmsx_mdev_opn },
+};
+
+static void Usage()
+{
+	fprintf(stderr,
+		"Usage: zmsx-rtcheck [options] file...\n"
+		"  -d <device>   MIDI device: default, opl, timidity, fluidsynth, gus,\n"
+		"                wildmidi, adl, opn\n"
+		"  -a <args>     device arguments, e.g. a sound font\n"
+		"  -g <file>     GENMIDI lump for the opl device\n"
+		"  -t <seconds>  audio to render per song, default 10\n"
+		"  -b <frames>   frames per block, default 512\n"
+		"  -r <ms>       render ahead by this much and pull blocks in real time\n"
+		"  -x            print a stack trace and abort on the first call\n");
+}
+
+#ifdef COUNT_CALLS
+
+//==========================================================================
+//
+// Interposed functions
+//
+// malloc and friends forward to glibc's own entry points, the locking
+// functions to the next definition, which gets looked up before any
+// song is opened.
+//
+//==========================================================================
+
+extern "C"
+{
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void *__libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void *ptr);
+}
+
+enum ECallKind
+{
+	CALL_Alloc,
+	CALL_Free,
+	CALL_Lock,
+	NUM_CALLKINDS
+};
+
+static const char *const CallKindNames[NUM_CALLKINDS] = { "allocations", "frees", "locks" };
+
+static thread_local bool InRender;
+static std::atomic<int> Calls[NUM_CALLKINDS];
+static bool AbortOnCall;
+
+static void Count(ECallKind kind)
+{
+	if (!InRender) return;
+	Calls[kind]++;
+	if (AbortOnCall)
+	{
+		InRender = false;
+		void *frames[64];
+		fprintf(stderr, "%s while rendering:\n", CallKindNames[kind]);
+		backtrace_symbols_fd(frames, backtrace(frames, 64), 2);
+		abort();
+	}
+}
+
+extern "C"
+{
+	void *malloc(size_t size)
+	{
+		Count(CALL_Alloc);
+		return __libc_malloc(size);
+	}
+
+	void *calloc(size_t count, size_t size)
+	{
+		Count(CALL_Alloc);
+		return __libc_calloc(count, size);
+	}
+
+	void *realloc(void *ptr, size_t size)
+	{
+		Count(CALL_Alloc);
+		return __libc_realloc(ptr, size);
+	}
+
+	void *memalign(size_t alignment, size_t size)
+	{
+		Count(CALL_Alloc);
+		return __libc_memalign(alignment, size);
+	}
+
+	void *aligned_alloc(size_t alignment, size_t size)
+	{
+		Count(CALL_Alloc);
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void **ptr, size_t alignment, size_t size)
+	{
+		Count(CALL_Alloc);
+		*ptr = __libc_memalign(alignment, size);
+		return *ptr != nullptr ? 0 : ENOMEM;
+	}
+
+	void free(void *ptr)
+	{
+		if (ptr != nullptr) Count(CALL_Free);
+		__libc_free(ptr);
+	}
+}
+
+// FluidSynth locks with GLib's mutexes, which do not go through pthreads.
+#define LOCK_FUNCTIONS(X) \
+	X(pthread_mutex_lock, int, (pthread_mutex_t *m), (m)) \
+	X(pthread_mutex_trylock, int, (pthread_mutex_t *m), (m)) \
+	X(pthread_rwlock_rdlock, int, (pthread_rwlock_t *l), (l)) \
+	X(pthread_rwlock_wrlock, int, (pthread_rwlock_t *l), (l)) \
+	X(pthread_cond_wait, int, (pthread_cond_t *c, pthread_mutex_t *m), (c, m)) \
+	X(g_mutex_lock, void, (void *m), (m)) \
+	X(g_rec_mutex_lock, void, (void *m), (m))
+
+#define DECLARE_REAL(name, ret, params, args) static ret (*Real_##name) params;
+LOCK_FUNCTIONS(DECLARE_REAL)
+
+#define DEFINE_WRAPPER(name, ret, params, args) \
+	extern "C" ret name params \
+	{ \
+		Count(CALL_Lock); \
+		return Real_##name args; \
+	}
+LOCK_FUNCTIONS(DEFINE_WRAPPER)
+
+static void LookUpLockFunctions()
+{
+#define LOOK_UP(name, ret, params, args) Real_##name = (decltype(Real_##name))dlsym(RTLD_NEXT, #name);
+	LOCK_FUNCTIONS(LOOK_UP)
+}
+
+#endif
+
+//==========================================================================
+//
+// Helpers
+//
+//==========================================================================
+
+static bool ParseDevice(const char *name, ZMSXMidiDevice &device)
+{
+	for (auto &dev : DeviceNames)
+	{
+		if (!strcmp(dev.name, name))
+		{
+			device = dev.device;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool LoadGenMidi(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (f == nullptr) return false;
+	std::vector<uint8_t> data(65536);
+	data.resize(fread(data.data(), 1, data.size(), f));
+	fclose(f);
+	// Accept the lump with or without its "#OPL_II#" header.
+	size_t offset = data.size() >= 8 && !memcmp(data.data(), "#OPL_II#", 8) ? 8 : 0;
+	if (data.size() < offset + 175 * 36) return false;
+	zmsx_set_genmidi(data.data() + offset);
+	return true;
+}
+
+static int SampleSize(ZMSXSampleType type)
+{
+	return type == zmsx_sample_uint8 ? 1 : type == zmsx_sample_int16 ? 2 : 4;
+}
+
+//==========================================================================
+//
+// PlaysFromTimeline
+//
+// Looks at the trace zones of the first block. Returns false only if they
+// show that a MIDI song without loops of its own went through the MIDI
+// source's subclass instead of the timeline. Without traces this cannot
+// tell, so it passes.
+//
+//==========================================================================
+
+static bool PlaysFromTimeline(ZMSXMusicStream *song)
+{
+	ZMSXSongInfo info;
+	if (!zmsx_get_song_info(song, &info) || info.num_tempo_changes == 0)
+	{ // Not a MIDI song.
+		return true;
+	}
+	if (info.loop_start_ms != 0 || info.loop_end_ms != info.duration_ms)
+	{ // Songs that loop by themselves are left to the subclass.
+		return true;
+	}
+	std::string trace = zmsx_trace_dump();
+	return trace.find("\"MIDISource::MakeEvents\"") == std::string::npos;
+}
+
+// The control requests a client makes while a song plays. They come from
+// this thread, outside of zmsx_fill_stream, like they would from a game's
+// main thread.
+static void ControlSong(ZMSXMusicStream *song, int step)
+{
+	switch (step)
+	{
+	case 0:
+		zmsx_pause(song);
+		break;
+
+	case 1:
+		zmsx_resume(song);
+		zmsx_config_set_float(zmusic_snd_musicvolume, song, 0.5f, nullptr);
+		zmsx_volume_changed(song);
+		break;
+
+	case 2:
+		zmsx_config_set_int(zmusic_adl_chips_count, song, 2, nullptr);
+		zmsx_config_set_int(zmusic_opn_chips_count, song, 2, nullptr);
+		zmsx_config_set_float(zmusic_fluid_reverb_roomsize, song, 0.5f, nullptr);
+		break;
+	}
+}
+
+//==========================================================================
+//
+// CheckSong
+//
+// Returns false if rendering the song allocated or locked, or if it did
+// not start playing from the timeline.
+//
+//==========================================================================
+
+static bool CheckSong(const char *filename, ZMSXMidiDevice device, const char *args, double seconds, int blockframes, bool realtime)
+{
+	ZMSXMusicStream *song = zmsx_open_song_file(filename, device, args);
+	if (song == nullptr)
+	{
+		printf("%s: skipped, %s\n", filename, *zmsx_get_last_error() ? zmsx_get_last_error() : "could not open it");
+		return true;
+	}
+	zmsx_trace_clear();
+	if (!zmsx_start(song, 0, false))
+	{
+		printf("%s: skipped, %s\n", filename, *zmsx_get_last_error() ? zmsx_get_last_error() : "could not start it");
+		zmsx_close(song);
+		return true;
+	}
+
+	ZMSXSoundStreamInfoEx info;
+	zmsx_get_stream_info_ex(song, &info);
+	if (info.buffer_size <= 0 || info.sample_rate <= 0)
+	{
+		printf("%s: skipped, not a streaming song\n", filename);
+		zmsx_close(song);
+		return true;
+	}
+	int channels = info.channel_config == zmsx_chancfg_mono ? 1 : 2;
+	int blockbytes = blockframes * channels * SampleSize(info.sample_type);
+	int blocks = std::max(1, (int)(seconds * info.sample_rate / blockframes));
+	std::vector<uint8_t> buffer(blockbytes);
+
+#ifdef COUNT_CALLS
+	int before[NUM_CALLKINDS];
+	for (int i = 0; i < NUM_CALLKINDS; i++) before[i] = Calls[i];
+#endif
+	bool timeline = true;
+	int done = 0;
+	for (bool more = true; more && done < blocks; done++)
+	{
+		// Three control steps, evenly spread over the song.
+		if (done > 0 && done % std::max(1, blocks / 4) == 0) ControlSong(song, done / std::max(1, blocks / 4) - 1);
+#ifdef COUNT_CALLS
+		InRender = true;
+#endif
+		more = zmsx_fill_stream(song, buffer.data(), blockbytes);
+#ifdef COUNT_CALLS
+		InRender = false;
+#endif
+		if (done == 0) timeline = PlaysFromTimeline(song);
+		if (realtime) std::this_thread::sleep_for(std::chrono::microseconds((int64_t)blockframes * 1000000 / info.sample_rate));
+	}
+	zmsx_close(song);
+
+	bool ok = timeline;
+	std::string counts = timeline ? "" : ", not played from the timeline";
+#ifdef COUNT_CALLS
+	for (int i = 0; i < NUM_CALLKINDS; i++)
+	{
+		int count = Calls[i] - before[i];
+		if (count == 0) continue;
+		counts += ", " + std::to_string(count) + " " + CallKindNames[i];
+		ok = false;
+	}
+#endif
+	printf("%s: %s, %d blocks%s\n", filename, ok ? "ok" : "FAILED", done, counts.c_str());
+	return ok;
+}
+
+//==========================================================================
+//
+// main
+//
+//==========================================================================
+
+int main(int argc, char **argv)
+{
+	ZMSXMidiDevice device = zmsx_mdev_default;
+	const char *args = "";
+	double seconds = 10;
+	int blockframes = 512;
+	int renderahead = 0;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++)
+	{
+		const char *opt = argv[i];
+		if (!strcmp(opt, "-x"))
+		{
+#ifdef COUNT_CALLS
+			AbortOnCall = true;
+#endif
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			Usage();
+			return 1;
+		}
+		const char *val = argv[++i];
+		if (!strcmp(opt, "-d"))
+		{
+			if (!ParseDevice(val, device))
+			{
+				fprintf(stderr, "Unknown device '%s'\n", val);
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-a")) args = val;
+		else if (!strcmp(opt, "-t")) seconds = atof(val);
+		else if (!strcmp(opt, "-b")) blockframes = std::max(1, atoi(val));
+		else if (!strcmp(opt, "-r")) renderahead = std::max(0, atoi(val));
+		else if (!strcmp(opt, "-g"))
+		{
+			if (!LoadGenMidi(val))
+			{
+				fprintf(stderr, "Could not load GENMIDI lump %s\n", val);
+				return 1;
+			}
+		}
+		else
+		{
+			Usage();
+			return 1;
+		}
+	}
+	if (i == argc)
+	{
+		Usage();
+		return 1;
+	}
+
+#if !defined(COUNT_CALLS) && !defined(THREAD_SANITIZER)
+	fprintf(stderr, "zmsx-rtcheck needs glibc to replace malloc, nothing checked\n");
+	return 1;
+#else
+#ifdef COUNT_CALLS
+	LookUpLockFunctions();
+#endif
+
+	// Rendering ahead moves the work to a thread of its own, so the calls
+	// only get counted for the audio thread's reads then.
+	zmsx_config_set_int(zmsx_snd_realtime, nullptr, 1, nullptr);
+	zmsx_config_set_int(zmsx_snd_renderahead, nullptr, renderahead, nullptr);
+
+	int failed = 0;
+	for (; i < argc; i++)
+	{
+		if (!CheckSong(argv[i], device, args, seconds, blockframes, renderahead > 0)) failed++;
+	}
+	if (failed > 0) printf("%d songs FAILED\n", failed);
+	return failed > 0 ? 1 : 0;
+#endif
+}
@@ -0,0 +1,195 @@
+/*
+** zmsx-scan.cpp
+** Times format identification and opening over a collection of songs
+**
+**---------------------------------------------------------------------------
+** Copyright 2026 The ZMSX contributors
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Usage: zmsx-scan [options] <listfile | ->
+**
+** The list file names one song per line, as a library scanner would see
+** them. Every file gets identified from its header and then opened and
+** closed again, and the time for both is reported per format.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "zmsx.h"
+
+struct FormatStats
+{
+	int Files = 0;
+	int Opened = 0;
+	double IdentifyTime = 0;
+	double OpenTime = 0;
+};
+
+static const char *const FormatNames[] =
+{
+	"unknown", "gzip", "midi", "cdda", "opl", "xa", "gme", "module", "sndfile", "mp3"
+};
+
+enum { NUM_FORMATS = sizeof(FormatNames) / sizeof(FormatNames[0]) };
+
+// Large enough for every signature zmsx_identify_song_format knows.
+enum { HEADER_SIZE = 1084 };
+
+static void Usage()
+{
+	fprintf(stderr,
+		"Usage: zmsx-scan [options] <listfile | ->\n"
+		"  -i            only identify, do not open the songs\n"
+		"  -p <passes>   scan the list this many times, default 1\n"
+		"  -v            print the result for every file\n");
+}
+
+static bool ReadList(FILE *f, std::vector<std::string> &files)
+{
+	char line[4096];
+	while (fgets(line, sizeof(line), f))
+	{
+		size_t len = strlen(line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = 0;
+		if (len == 0 || line[0] == '#') continue;
+		files.push_back(line);
+	}
+	return !ferror(f);
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	bool identifyonly = false;
+	bool verbose = false;
+	int passes = 1;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++)
+	{
+		if (!strcmp(argv[i], "-i")) identifyonly = true;
+		else if (!strcmp(argv[i], "-v")) verbose = true;
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc) passes = atoi(argv[++i]);
+		else
+		{
+			Usage();
+			return 1;
+		}
+	}
+	if (i != argc - 1 || passes < 1)
+	{
+		Usage();
+		return 1;
+	}
+
+	std::vector<std::string> files;
+	bool fromstdin = !strcmp(argv[i], "-");
+	FILE *f = fromstdin ? stdin : fopen(argv[i], "r");
+	if (f == nullptr)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[i]);
+		return 1;
+	}
+	bool ok = ReadList(f, files);
+	if (!fromstdin) fclose(f);
+	if (!ok)
+	{
+		fprintf(stderr, "Could not read %s\n", argv[i]);
+		return 1;
+	}
+
+	FormatStats stats[NUM_FORMATS];
+	uint8_t header[HEADER_SIZE];
+	auto total = std::chrono::steady_clock::now();
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (auto &name : files)
+		{
+			auto start = std::chrono::steady_clock::now();
+			FILE *song = fopen(name.c_str(), "rb");
+			if (song == nullptr)
+			{
+				if (pass == 0) fprintf(stderr, "Could not open %s\n", name.c_str());
+				continue;
+			}
+			size_t len = fread(header, 1, sizeof(header), song);
+			fclose(song);
+			ZMSXSongFormat format = zmsx_identify_song_format(header, len);
+			if ((unsigned)format >= NUM_FORMATS) format = zmsx_format_unknown;
+
+			auto &st = stats[format];
+			st.Files++;
+			st.IdentifyTime += Seconds(start);
+
+			if (identifyonly)
+			{
+				if (verbose && pass == 0) printf("%-8s %s\n", FormatNames[format], name.c_str());
+				continue;
+			}
+
+			start = std::chrono::steady_clock::now();
+			ZMSXMusicStream *stream = zmsx_open_song_file(name.c_str(), zmsx_mdev_default, nullptr);
+			if (stream != nullptr)
+			{
+				st.Opened++;
+				zmsx_close(stream);
+			}
+			st.OpenTime += Seconds(start);
+
+			if (verbose && pass == 0)
+			{
+				if (stream != nullptr) printf("%-8s %s\n", FormatNames[format], name.c_str());
+				else printf("%-8s %s: %s\n", FormatNames[format], name.c_str(), zmsx_get_last_error());
+			}
+		}
+	}
+	double elapsed = Seconds(total);
+
+	printf("%-8s %8s %8s %14s %14s\n", "format", "files", "opened", "identify (us)", "open (ms)");
+	int count = 0;
+	for (int j = 0; j < NUM_FORMATS; j++)
+	{
+		auto &st = stats[j];
+		if (st.Files == 0) continue;
+		printf("%-8s %8d %8d %14.2f %14.3f\n", FormatNames[j], st.Files, st.Opened,
+			st.IdentifyTime * 1e6 / st.Files, st.OpenTime * 1e3 / st.Files);
+		count += st.Files;
+	}
+	printf("%d files in %.3fs, %.0f files per second\n", count, elapsed, elapsed > 0 ? count / elapsed : 0.);
+	return 0;
+}